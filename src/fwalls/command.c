@@ -27,8 +27,10 @@
 #include <stdio.h>
 #include <errno.h>
 #include <ctype.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <limits.h>
 
 
 #include "../sshguard_log.h"
@@ -38,13 +40,43 @@
 
 #include "command.h"
 
-#define MAX_ADDRESSES_PER_LIST      2500
+/* bytes of the address list passed to COMMAND_BLOCK_LIST at once: a fraction
+ * of the room for arguments and environment, but not too much for the shell */
+#define COMMAND_LIST_MINLEN         4096
+#define COMMAND_LIST_MAXLEN         (64 * 1024)
+
+/* commands blocking lists of addresses run at once. Backends whose command
+ * doesn't stand concurrent runs define this to 1 */
+#ifndef COMMAND_BLOCK_JOBS
+#   define COMMAND_BLOCK_JOBS       4
+#endif
 
 #define COMMAND_ENVNAME_ADDR        "SSHG_ADDR"
 #define COMMAND_ENVNAME_ADDRKIND    "SSHG_ADDRKIND"
 #define COMMAND_ENVNAME_SERVICE     "SSHG_SERVICE"
 
+extern char **environ;
+
 static int run_command(const char *restrict command, const char *restrict addr, int addrkind, int service);
+static pid_t spawn_command(const char *restrict command, const char *restrict addr, int addrkind, int service);
+static int wait_command(pid_t pid);
+static char **command_env(const char *restrict addr, int addrkind, int service);
+static int system_command(const char *restrict command, char *const envp[]);
+static void exec_shell(const char *restrict command, char *const envp[]);
+
+/* position of an address in the list to block, to sort them by service */
+typedef struct {
+    int service;
+    int pos;
+} list_entry_t;
+
+/* order by service, then position. Callback for qsort() */
+static int list_entry_compare(const void *a, const void *b) {
+    const list_entry_t *ea = (const list_entry_t *)a, *eb = (const list_entry_t *)b;
+
+    if (ea->service != eb->service) return (ea->service < eb->service ? -1 : 1);
+    return (ea->pos > eb->pos) - (ea->pos < eb->pos);
+}
 
 
 int fw_init() {
@@ -60,8 +92,15 @@ int fw_block(const char *restrict addr, int addrkind, int service) {
 }
 
 int fw_block_list(const char *restrict addresses[], int addrkind, const int service_codes[]) {
-    /* block each address individually */
-    int i;
+    pid_t jobs[COMMAND_BLOCK_JOBS];
+    unsigned int running = 0, oldest = 0;
+    int i, first, num, maxcount, err = FWALL_OK;
+    size_t listmax, len, addrlen;
+    char *address_list;
+    list_entry_t *entries;
+#ifdef COMMAND_BLOCK_LIST
+    long argmax;
+#endif
 
     assert(addresses != NULL);
     assert(service_codes != NULL);
@@ -69,36 +108,79 @@ int fw_block_list(const char *restrict addresses[], int addrkind, const int serv
     if (addresses[0] == NULL) return FWALL_OK;
 
 #ifdef COMMAND_BLOCK_LIST
-    char address_list[MAX_ADDRESSES_PER_LIST * ADDRLEN];
-    address_list[0] = '\0';
-    strcpy(address_list, addresses[0]);
-    size_t first_free_char = strlen(address_list);
-    int j;
-    for (i = 1; addresses[i] != NULL; ++i) {
-        /* call list-blocking command passing SSHG_ADDRLIST env var as "addr1,addr2,...,addrN" */
-        address_list[first_free_char] = ',';
-        for (j = 0; addresses[i][j] != '\0'; ++j) {
-            address_list[++first_free_char] = addresses[i][j];
+    /* call list-blocking command passing SSHG_ADDR env var as "addr1,addr2,...,addrN" */
+    argmax = sysconf(_SC_ARG_MAX);
+    listmax = (argmax > 0 ? (size_t)argmax / 8 : COMMAND_LIST_MINLEN);
+    if (listmax < COMMAND_LIST_MINLEN) listmax = COMMAND_LIST_MINLEN;
+    if (listmax > COMMAND_LIST_MAXLEN) listmax = COMMAND_LIST_MAXLEN;
+    maxcount = INT_MAX;
+#else
+    /* block each address individually */
+    listmax = ADDRLEN;
+    maxcount = 1;
+#endif
+    for (num = 0; addresses[num] != NULL; ++num);
+    address_list = (char *)malloc(listmax);
+    entries = (list_entry_t *)malloc(num * sizeof(list_entry_t));
+    if (address_list == NULL || entries == NULL) {
+        free(address_list);
+        free(entries);
+        return FWALL_ERR;
+    }
+    /* addresses of each service together, each command takes one service */
+    for (i = 0; i < num; ++i) {
+        entries[i].service = service_codes[i];
+        entries[i].pos = i;
+    }
+    qsort(entries, num, sizeof(list_entry_t), list_entry_compare);
+
+    for (i = 0; i < num; ) {
+        /* gather addresses to the same service, as many as fit */
+        first = i;
+        len = 0;
+        while (i < num && entries[i].service == entries[first].service && i - first < maxcount) {
+            addrlen = strlen(addresses[entries[i].pos]);
+            if (len + (len > 0) + addrlen >= listmax) break;
+            if (len > 0) address_list[len++] = ',';
+            memcpy(address_list + len, addresses[entries[i].pos], addrlen);
+            len += addrlen;
+            ++i;
         }
-        ++first_free_char;
-
-        if (first_free_char >= sizeof(address_list)) {
-            sshguard_log(LOG_CRIT, "Wanted to bulk-block %d addresses, but my buffer can't take this many.", i);
-            return FWALL_ERR;
+        address_list[len] = '\0';
+        if (i == first) {
+            sshguard_log(LOG_ERR, "Address '%s' too long to block, skipping.", addresses[entries[i].pos]);
+            err = FWALL_ERR;
+            ++i;
+            continue;
         }
-    }
-    address_list[first_free_char] = '\0';
-
-    /* FIXME: we are blocking all addresses as they were to the same service */
-    return run_command(COMMAND_BLOCK_LIST, address_list, addrkind, service_codes[0]);
 
+        /* make room for this one, then start it */
+        if (running == COMMAND_BLOCK_JOBS) {
+            if (wait_command(jobs[oldest]) != 0) err = FWALL_ERR;
+            oldest = (oldest + 1) % COMMAND_BLOCK_JOBS;
+            --running;
+        }
+#ifdef COMMAND_BLOCK_LIST
+        jobs[(oldest + running) % COMMAND_BLOCK_JOBS] = spawn_command(COMMAND_BLOCK_LIST, address_list, addrkind, entries[first].service);
 #else
-    int err = FWALL_OK;
-    for (i = 0; addresses[i] != NULL; i++) {
-        /* repeatedly call single-blocking command for each address */
-        if (fw_block(addresses[i], addrkind, service_codes[i]) != FWALL_OK)
+        jobs[(oldest + running) % COMMAND_BLOCK_JOBS] = spawn_command(COMMAND_BLOCK, address_list, addrkind, entries[first].service);
+#endif
+        if (jobs[(oldest + running) % COMMAND_BLOCK_JOBS] == -1) {
+            sshguard_log(LOG_ERR, "Unable to run the blocking command: %s.", strerror(errno));
             err = FWALL_ERR;
+        } else {
+            ++running;
+        }
+        sshguard_log(LOG_DEBUG, "Blocking %d addresses of the list at once (service %d).", i - first, entries[first].service);
+    }
+
+    while (running > 0) {
+        if (wait_command(jobs[oldest]) != 0) err = FWALL_ERR;
+        oldest = (oldest + 1) % COMMAND_BLOCK_JOBS;
+        --running;
     }
+    free(address_list);
+    free(entries);
 
     if (err == FWALL_OK)
         sshguard_log(LOG_INFO, "Blocked %d addresses without errors.", i);
@@ -106,7 +188,6 @@ int fw_block_list(const char *restrict addresses[], int addrkind, const int serv
         sshguard_log(LOG_INFO, "Some errors while trying to block %d addresses.", i);
 
     return err;
-#endif
 }
 
 int fw_release(const char *restrict addr, int addrkind, int service) {
@@ -120,7 +201,7 @@ int fw_flush(void) {
     
 static int run_command(const char *restrict command, const char *restrict addr, int addrkind, int service) {
     int ret;
-    char *addrks, *servs;
+    char **envp;
 
 
     /* sanity check */
@@ -129,27 +210,16 @@ static int run_command(const char *restrict command, const char *restrict addr,
     if (addr != NULL) {
         assert(addrkind == ADDRKIND_IPv4 || addrkind == ADDRKIND_IPv6);
 
-        /* export information to the environment */
-        addrks = malloc(5);
-        servs = malloc(5);
-
-        snprintf(addrks, 5, "%d", addrkind);
-        snprintf(servs, 5, "%d", service);
+        /* pass information in the environment of the command, not of sshguard */
+        envp = command_env(addr, addrkind, service);
+        if (envp == NULL) return -1;
 
-        setenv(COMMAND_ENVNAME_ADDR, addr, 1);
-        setenv(COMMAND_ENVNAME_ADDRKIND, addrks, 1);
-        setenv(COMMAND_ENVNAME_SERVICE, servs, 1);
+        sshguard_log(LOG_DEBUG, "Setting environment: " COMMAND_ENVNAME_ADDR "=%s;" COMMAND_ENVNAME_ADDRKIND "=%d;" COMMAND_ENVNAME_SERVICE "=%d.", addr, addrkind, service);
 
-        sshguard_log(LOG_DEBUG, "Setting environment: " COMMAND_ENVNAME_ADDR "=%s;" COMMAND_ENVNAME_ADDRKIND "=%s;" COMMAND_ENVNAME_SERVICE "=%s.", addr, addrks, servs);
-
-        ret = system(command);
-
-        /* cleanup the environment */
-        unsetenv(COMMAND_ENVNAME_ADDR);
-        unsetenv(COMMAND_ENVNAME_ADDRKIND);
-        unsetenv(COMMAND_ENVNAME_SERVICE);
+        ret = system_command(command, envp);
+        free(envp);
     } else {
-        ret = system(command);
+        ret = system_command(command, environ);
     }
     
     ret = WEXITSTATUS(ret);
@@ -159,3 +229,96 @@ static int run_command(const char *restrict command, const char *restrict addr,
     return ret;
 }
 
+/* start command in background, with its environment set as for run_command() */
+static pid_t spawn_command(const char *restrict command, const char *restrict addr, int addrkind, int service) {
+    char **envp;
+    pid_t pid;
+
+    if (command == NULL || strlen(command) == 0) return 0;
+
+    /* the child of a threaded process must not allocate: make it ready before */
+    envp = command_env(addr, addrkind, service);
+    if (envp == NULL) return -1;
+
+    pid = fork();
+    if (pid == 0) exec_shell(command, envp);
+    free(envp);
+    return pid;
+}
+
+/* environment of sshguard, with the information on addr in place of any
+ * inherited. One block, to free() at once */
+static char **command_env(const char *restrict addr, int addrkind, int service) {
+    char **envp, *vars;
+    size_t n, i, k, addrlen, kindlen, servlen;
+
+    for (n = 0; environ[n] != NULL; ++n);
+    addrlen = strlen(COMMAND_ENVNAME_ADDR "=") + strlen(addr) + 1;
+    kindlen = strlen(COMMAND_ENVNAME_ADDRKIND "=") + 12;
+    servlen = strlen(COMMAND_ENVNAME_SERVICE "=") + 12;
+    envp = (char **)malloc((n + 4) * sizeof(char *) + addrlen + kindlen + servlen);
+    if (envp == NULL) return NULL;
+
+    /* the variables go after the array */
+    vars = (char *)(envp + n + 4);
+    for (i = k = 0; i < n; ++i) {
+        if (strncmp(environ[i], COMMAND_ENVNAME_ADDR "=", strlen(COMMAND_ENVNAME_ADDR "=")) == 0
+                || strncmp(environ[i], COMMAND_ENVNAME_ADDRKIND "=", strlen(COMMAND_ENVNAME_ADDRKIND "=")) == 0
+                || strncmp(environ[i], COMMAND_ENVNAME_SERVICE "=", strlen(COMMAND_ENVNAME_SERVICE "=")) == 0)
+            continue;
+        envp[k++] = environ[i];
+    }
+    snprintf(vars, addrlen, COMMAND_ENVNAME_ADDR "=%s", addr);
+    envp[k++] = vars;
+    vars += addrlen;
+    snprintf(vars, kindlen, COMMAND_ENVNAME_ADDRKIND "=%d", addrkind);
+    envp[k++] = vars;
+    vars += kindlen;
+    snprintf(vars, servlen, COMMAND_ENVNAME_SERVICE "=%d", service);
+    envp[k++] = vars;
+    envp[k] = NULL;
+
+    return envp;
+}
+
+/* wait for a command started with spawn_command(), and get its exit status */
+static int wait_command(pid_t pid) {
+    int status;
+
+    if (pid == 0) return 0;
+    while (waitpid(pid, & status, 0) == -1) {
+        if (errno != EINTR) return -1;
+    }
+    if (! WIFEXITED(status)) return -1;
+
+    sshguard_log(LOG_DEBUG, "Run blocking command (pid %d): exited %d.", (int)pid, WEXITSTATUS(status));
+    return WEXITSTATUS(status);
+}
+
+/* like system(), but the command does not get the signal mask of sshguard,
+ * and gets envp for environment */
+static int system_command(const char *restrict command, char *const envp[]) {
+    int status;
+    pid_t pid;
+
+    pid = fork();
+    if (pid == -1) return -1;
+    if (pid == 0) exec_shell(command, envp);
+
+    while (waitpid(pid, & status, 0) == -1) {
+        if (errno != EINTR) return -1;
+    }
+    return status;
+}
+
+/* in a child: run command with the shell, signals unblocked and envp for
+ * environment. Only async-signal-safe calls here. Never returns */
+static void exec_shell(const char *restrict command, char *const envp[]) {
+    sigset_t nosigs;
+
+    /* sshguard blocks SIGHUP for its reload handler; the command must not inherit that */
+    sigemptyset(& nosigs);
+    sigprocmask(SIG_SETMASK, & nosigs, NULL);
+    execle("/bin/sh", "sh", "-c", command, (char *)NULL, envp);
+    _exit(127);
+}
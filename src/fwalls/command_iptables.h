@@ -44,6 +44,9 @@
  * COMMAND_BLOCK_LIST can not be provided here, a sequence of calls to
  * COMMAND_BLOCK will be automatically used instead */
 
+/* concurrent iptables calls fail on the xtables lock: run one at a time */
+#define COMMAND_BLOCK_JOBS  1
+
 /* for releasing a blocked IP */
 /* the command will have the following variables in its environment:
  *  $SSHG_ADDR      the address to operate (e.g. 192.168.0.12)
@@ -29,6 +29,7 @@
 #include <simclist.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <signal.h>
 
 #include "../config.h"
 #include "../sshguard_log.h"
@@ -250,6 +251,7 @@ static ipfw_rulenumber_t ipfwmod_getrulenumber(void) {
 static int ipfwmod_runcommand(char *command, char *args) {
     char *argsvec[20];
     pid_t pid;
+    sigset_t nosigs;
     int i, j, ret;
     char *locargs = malloc(strlen(args)+1);
 
@@ -272,7 +274,9 @@ static int ipfwmod_runcommand(char *command, char *args) {
 
     pid = fork();
     if (pid == 0) {
-        /* in child; run command */
+        /* in child; run command, without the SIGHUP blocked by sshguard */
+        sigemptyset(& nosigs);
+        sigprocmask(SIG_SETMASK, & nosigs, NULL);
         execvp(argsvec[0], argsvec);
         sshguard_log(LOG_ERR, "Unable to run command: %s", strerror(errno));
         _Exit(1);
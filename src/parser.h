@@ -21,23 +21,61 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-/* also define global var yydebug = 1 for enabling debugging at runtime */
+/* for FAST_PARSER */
+#include "config.h"
+
+/* also define global var yydebug = 1 for enabling debugging at runtime,
+ * unless the parser is built for speed (configure --enable-fast-parser) */
+/* (the bison header may have set a default already) */
+#ifndef FAST_PARSER
+#undef YYDEBUG
 #define YYDEBUG 1
-#ifdef YYDEBUG
 extern int yydebug;
-extern int yy_flex_debug;
 #endif
 
 
 
+#include <sys/types.h>
+
 #include "sshguard_services.h"
 #include "sshguard_addresskind.h"
 #include "sshguard_attack.h"
+#include "sshguard_resolver.h"
 
-attack_t parsed_attack;
+/* state of a parser: its scanner, the attack being recognized, and what is
+ * known about each source it got lines from. Any number of contexts can
+ * parse at the same time, one per thread */
+typedef struct parser_ctx parser_ctx_t;
 
-/* this is defined in attack_scanner.c */
-int parse_line(int source_id, char *str);
+/* create a parser context. Scanner debugging follows yydebug. NULL on error */
+parser_ctx_t *parser_ctx_new(void);
 
-#endif
+/* have attacks naming their source by host name passed to resolved once the
+ * name resolves, instead of resolving it while parsing */
+void parser_ctx_set_resolved(parser_ctx_t *ctx, resolver_done_t resolved);
+
+/* get how many messages were looked up among those each source sent lately,
+ * and how many were found there, and so reused their outcome without parsing */
+void parser_ctx_get_stats(const parser_ctx_t *ctx, unsigned long *lookups, unsigned long *hits);
+
+/* destroy a parser context and all it knows about sources */
+void parser_ctx_free(parser_ctx_t *ctx);
 
+/* parse a log line from source_id; on success (0), store what was recognized in attack.
+ * Attacks waiting for their host name to resolve are not successes: they go to
+ * the callback set with parser_ctx_set_resolved() later.
+ * The line is scanned in place: str needs room for one more byte past its NUL */
+int parse_line(parser_ctx_t *ctx, int source_id, char *str, attack_t *attack);
+
+/* parse a bare message (no log banner) logged by program[pid] (NULL and 0 if
+ * unknown). Same room requirement on str as parse_line() */
+int parse_message(parser_ctx_t *ctx, int source_id, char *str, const char *program, size_t programlen, pid_t pid, attack_t *attack);
+
+/* account for a line of source_id that is not parsed, so that a "last message
+ * repeated" line after it is not taken for a repetition of the line before */
+void parse_skip_line(parser_ctx_t *ctx, int source_id);
+
+/* release the parser's memory of a source that will not send lines anymore */
+void parse_forget_source(parser_ctx_t *ctx, int source_id);
+
+#endif
@@ -1,14 +1,14 @@
-/* A Bison parser, made by GNU Bison 2.3.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
-/* Skeleton implementation for Bison's Yacc-like parsers in C
+/* Bison implementation for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989, 1990, 2000, 2001, 2002, 2003, 2004, 2005, 2006
-   Free Software Foundation, Inc.
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
 
-   This program is free software; you can redistribute it and/or modify
+   This program is free software: you can redistribute it and/or modify
    it under the terms of the GNU General Public License as published by
-   the Free Software Foundation; either version 2, or (at your option)
-   any later version.
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
 
    This program is distributed in the hope that it will be useful,
    but WITHOUT ANY WARRANTY; without even the implied warranty of
@@ -16,9 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program; if not, write to the Free Software
-   Foundation, Inc., 51 Franklin Street, Fifth Floor,
-   Boston, MA 02110-1301, USA.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -36,6 +34,10 @@
 /* C LALR(1) parser skeleton written by Richard Stallman, by
    simplifying the original so-called "semantic" parser.  */
 
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
 /* All symbols defined below should begin with yy or YY, to avoid
    infringing on user name space.  This should be done even for local
    variables, as they might otherwise be expanded by user macros.
@@ -43,117 +45,28 @@
    define necessary library symbols; they are noted "INFRINGES ON
    USER NAME SPACE" below.  */
 
-/* Identify Bison output.  */
-#define YYBISON 1
+/* Identify Bison output, and Bison version.  */
+#define YYBISON 30802
 
-/* Bison version.  */
-#define YYBISON_VERSION "2.3"
+/* Bison version string.  */
+#define YYBISON_VERSION "3.8.2"
 
 /* Skeleton name.  */
 #define YYSKELETON_NAME "yacc.c"
 
 /* Pure parsers.  */
-#define YYPURE 0
+#define YYPURE 1
 
-/* Using locations.  */
-#define YYLSP_NEEDED 0
+/* Push parsers.  */
+#define YYPUSH 0
 
+/* Pull parsers.  */
+#define YYPULL 1
 
 
-/* Tokens.  */
-#ifndef YYTOKENTYPE
-# define YYTOKENTYPE
-   /* Put the tokens into the symbol table, so that GDB and other debuggers
-      know about them.  */
-   enum yytokentype {
-     IPv4 = 258,
-     IPv6 = 259,
-     HOSTADDR = 260,
-     WORD = 261,
-     INTEGER = 262,
-     SYSLOG_BANNER_PID = 263,
-     LAST_LINE_REPEATED_N_TIMES = 264,
-     SYSLOG_BANNER = 265,
-     TIMESTAMP_SYSLOG = 266,
-     TIMESTAMP_TAI64 = 267,
-     AT_TIMESTAMP_TAI64 = 268,
-     METALOG_BANNER = 269,
-     SSH_INVALUSERPREF = 270,
-     SSH_NOTALLOWEDPREF = 271,
-     SSH_NOTALLOWEDSUFF = 272,
-     SSH_LOGINERR_PREF = 273,
-     SSH_LOGINERR_SUFF = 274,
-     SSH_LOGINERR_PAM = 275,
-     SSH_REVERSEMAP_PREF = 276,
-     SSH_REVERSEMAP_SUFF = 277,
-     SSH_NOIDENTIFSTR = 278,
-     SSH_BADPROTOCOLIDENTIF = 279,
-     DOVECOT_IMAP_LOGINERR_PREF = 280,
-     DOVECOT_IMAP_LOGINERR_SUFF = 281,
-     UWIMAP_LOGINERR = 282,
-     CYRUSIMAP_SASL_LOGINERR_PREF = 283,
-     CYRUSIMAP_SASL_LOGINERR_SUFF = 284,
-     CUCIPOP_AUTHFAIL = 285,
-     EXIM_ESMTP_AUTHFAIL_PREF = 286,
-     EXIM_ESMTP_AUTHFAIL_SUFF = 287,
-     SENDMAIL_RELAYDENIED_PREF = 288,
-     SENDMAIL_RELAYDENIED_SUFF = 289,
-     FREEBSDFTPD_LOGINERR_PREF = 290,
-     FREEBSDFTPD_LOGINERR_SUFF = 291,
-     PROFTPD_LOGINERR_PREF = 292,
-     PROFTPD_LOGINERR_SUFF = 293,
-     PUREFTPD_LOGINERR_PREF = 294,
-     PUREFTPD_LOGINERR_SUFF = 295,
-     VSFTPD_LOGINERR_PREF = 296,
-     VSFTPD_LOGINERR_SUFF = 297
-   };
-#endif
-/* Tokens.  */
-#define IPv4 258
-#define IPv6 259
-#define HOSTADDR 260
-#define WORD 261
-#define INTEGER 262
-#define SYSLOG_BANNER_PID 263
-#define LAST_LINE_REPEATED_N_TIMES 264
-#define SYSLOG_BANNER 265
-#define TIMESTAMP_SYSLOG 266
-#define TIMESTAMP_TAI64 267
-#define AT_TIMESTAMP_TAI64 268
-#define METALOG_BANNER 269
-#define SSH_INVALUSERPREF 270
-#define SSH_NOTALLOWEDPREF 271
-#define SSH_NOTALLOWEDSUFF 272
-#define SSH_LOGINERR_PREF 273
-#define SSH_LOGINERR_SUFF 274
-#define SSH_LOGINERR_PAM 275
-#define SSH_REVERSEMAP_PREF 276
-#define SSH_REVERSEMAP_SUFF 277
-#define SSH_NOIDENTIFSTR 278
-#define SSH_BADPROTOCOLIDENTIF 279
-#define DOVECOT_IMAP_LOGINERR_PREF 280
-#define DOVECOT_IMAP_LOGINERR_SUFF 281
-#define UWIMAP_LOGINERR 282
-#define CYRUSIMAP_SASL_LOGINERR_PREF 283
-#define CYRUSIMAP_SASL_LOGINERR_SUFF 284
-#define CUCIPOP_AUTHFAIL 285
-#define EXIM_ESMTP_AUTHFAIL_PREF 286
-#define EXIM_ESMTP_AUTHFAIL_SUFF 287
-#define SENDMAIL_RELAYDENIED_PREF 288
-#define SENDMAIL_RELAYDENIED_SUFF 289
-#define FREEBSDFTPD_LOGINERR_PREF 290
-#define FREEBSDFTPD_LOGINERR_SUFF 291
-#define PROFTPD_LOGINERR_PREF 292
-#define PROFTPD_LOGINERR_SUFF 293
-#define PUREFTPD_LOGINERR_PREF 294
-#define PUREFTPD_LOGINERR_SUFF 295
-#define VSFTPD_LOGINERR_PREF 296
-#define VSFTPD_LOGINERR_SUFF 297
 
 
-
-
-/* Copy the first part of user declarations.  */
+/* First part of user prologue.  */
 #line 1 "attack_parser.y"
 
 
@@ -194,108 +107,441 @@
 #include "../sshguard_log.h"
 #include "../sshguard_procauth.h"
 #include "../sshguard_logsuck.h"
+#include "../sshguard_prefilter.h"
+#include "../sshguard_banner.h"
+#include "../sshguard_resolver.h"
+#include "../sshguard_signatures.h"
+#include "../fnv.h"
 
- /* get to know MAX_FILES_POLLED */
+ /* get to know DEFAULT_ATTACKS_DANGEROUSNESS */
 #include "../sshguard.h"
 
 #include "../parser.h"
 
  /* stuff exported by the scanner */
-extern void scanner_init();
-extern void scanner_fin();
+extern void *scanner_new(int debugging);
+extern void scanner_free(void *scanner);
+extern void scanner_init(void *scanner, char *str, size_t len);
 extern int yylex();
 
+#ifdef SERVICE_SCANNERS
+ /* scanners with the rules of one family of services each, made of
+  * attack_scanner.l (see attack_scanner_family.awk) */
+extern void *scanner_login_new(int debugging);
+extern void scanner_login_free(void *scanner);
+extern void scanner_login_init(void *scanner, char *str, size_t len);
+extern int login_yylex();
+extern void *scanner_mail_new(int debugging);
+extern void scanner_mail_free(void *scanner);
+extern void scanner_mail_init(void *scanner, char *str, size_t len);
+extern int mail_yylex();
+extern void *scanner_ftp_new(int debugging);
+extern void scanner_ftp_free(void *scanner);
+extern void scanner_ftp_init(void *scanner, char *str, size_t len);
+extern int ftp_yylex();
+
+ /* lines of programs running services of one family only go to its scanner */
+static const struct {
+    int first_service, last_service;            /* services of the family, see sshguard_services.h */
+    void *(*scanner_new)(int debugging);
+    void (*scanner_free)(void *scanner);
+    void (*scanner_init)(void *scanner, char *str, size_t len);
+    int (*lex)();
+} scanner_families[] = {
+    { SERVICES_SSH,         SERVICES_SSH,       scanner_login_new,  scanner_login_free, scanner_login_init, login_yylex },
+    { SERVICES_UWIMAP,      SERVICES_SENDMAIL,  scanner_mail_new,   scanner_mail_free,  scanner_mail_init,  mail_yylex },
+    { SERVICES_FREEBSDFTPD, SERVICES_VSFTPD,    scanner_ftp_new,    scanner_ftp_free,   scanner_ftp_init,   ftp_yylex }
+};
+#define PARSER_SCANNER_FAMILIES     (sizeof(scanner_families) / sizeof(scanner_families[0]))
+
+ /* the scanner for lines of any program */
+static int (*const any_lex)() = yylex;
+
+ /* the grammar takes its tokens from the scanner chosen for the line */
+#define yylex   (*ctx->lex)
+#endif
+
  /* my function for reporting parse errors */
-static void yyerror(int source_id, const char *msg);
+static void yyerror(parser_ctx_t *ctx, void *scanner, const char *msg);
 
  /* Metadata used by the parser */
- /* per-source metadata */
+ /* messages remembered per source, for answering repetitions without parsing */
+#define PARSER_RECENT_SLOTS         8
+ /* longest message, and program name, remembered */
+#define PARSER_RECENT_MAXLEN        256
+#define PARSER_RECENT_PROGLEN       32
+
+ /* a message lately parsed, and its outcome */
 typedef struct {
+    Fnv32_t hash;
+    size_t len;                                 /* length of message; 0 if the slot is free */
+    char message[PARSER_RECENT_MAXLEN];
+    size_t programlen;
+    char program[PARSER_RECENT_PROGLEN];        /* program that logged it, as it affects parsing */
+    int result;                                 /* what parsing returned */
+    attack_t attack;                            /* if recognized */
+} recent_message_t;
+
+ /* per-source metadata */
+typedef struct source_metadata {
     sourceid_t id;
     int last_was_recognized;
     attack_t last_attack;
+    char last_pending_host[RESOLVER_MAX_NAMELEN];   /* host name of last_attack, if not resolved yet */
     unsigned int last_multiplicity;
+    recent_message_t recent[PARSER_RECENT_SLOTS];
+    unsigned int recent_next;           /* slot to reuse next */
+    struct source_metadata *next;       /* next source in the same bucket */
 } source_metadata_t;
 
- /* parser metadata */
-static struct {
-    unsigned int num_sources;
-    int current_source_index;
-    source_metadata_t sources[MAX_FILES_POLLED];
-} parser_metadata = { 0, -1 };
+ /* number of buckets for hashing sources. Sources are not limited to the
+  * MAX_FILES_POLLED files, as network senders come and go */
+#define PARSER_SOURCES_BUCKETS      256
+
+ /* parser context */
+struct parser_ctx {
+    void *scanner;                                      /* scanner feeding this parser */
+    attack_t attack;                                    /* attack being recognized */
+    char pending_host[RESOLVER_MAX_NAMELEN];            /* host name of attack, if not resolved yet */
+    resolver_done_t resolved;                           /* gets attacks resolved in background */
+    source_metadata_t *sources[PARSER_SOURCES_BUCKETS];
+    source_metadata_t *current_source;
+    int reusable;                                       /* whether the outcome depends on the message only */
+    unsigned long recent_lookups, recent_hits;          /* messages looked up among recent ones, and found */
+    signatures_cache_t *signatures;                     /* states of the signatures automaton reached */
+#ifdef SERVICE_SCANNERS
+    void *family_scanners[PARSER_SCANNER_FAMILIES];     /* scanners of scanner_families[] */
+    int (*lex)();                                       /* scanning function of the line being parsed */
+#endif
+};
+
+static recent_message_t *recent_find(parser_ctx_t *ctx, const char *str, size_t len, Fnv32_t hash, const char *program, size_t programlen);
+static recent_message_t *recent_reserve(parser_ctx_t *ctx, const char *str, size_t len, Fnv32_t hash, const char *program, size_t programlen);
+static void *line_scanner(parser_ctx_t *ctx, char *str, size_t len, const char *program, size_t programlen);
 
 
+#line 224 "attack_parser.c"
 
-/* Enabling traces.  */
+# ifndef YY_CAST
+#  ifdef __cplusplus
+#   define YY_CAST(Type, Val) static_cast<Type> (Val)
+#   define YY_REINTERPRET_CAST(Type, Val) reinterpret_cast<Type> (Val)
+#  else
+#   define YY_CAST(Type, Val) ((Type) (Val))
+#   define YY_REINTERPRET_CAST(Type, Val) ((Type) (Val))
+#  endif
+# endif
+# ifndef YY_NULLPTR
+#  if defined __cplusplus
+#   if 201103L <= __cplusplus
+#    define YY_NULLPTR nullptr
+#   else
+#    define YY_NULLPTR 0
+#   endif
+#  else
+#   define YY_NULLPTR ((void*)0)
+#  endif
+# endif
+
+/* Use api.header.include to #include this header
+   instead of duplicating it here.  */
+#ifndef YY_YY_Y_TAB_H_INCLUDED
+# define YY_YY_Y_TAB_H_INCLUDED
+/* Debug traces.  */
 #ifndef YYDEBUG
 # define YYDEBUG 0
 #endif
-
-/* Enabling verbose error messages.  */
-#ifdef YYERROR_VERBOSE
-# undef YYERROR_VERBOSE
-# define YYERROR_VERBOSE 1
-#else
-# define YYERROR_VERBOSE 0
+#if YYDEBUG
+extern int yydebug;
 #endif
 
-/* Enabling the token table.  */
-#ifndef YYTOKEN_TABLE
-# define YYTOKEN_TABLE 0
+/* Token kinds.  */
+#ifndef YYTOKENTYPE
+# define YYTOKENTYPE
+  enum yytokentype
+  {
+    YYEMPTY = -2,
+    YYEOF = 0,                     /* "end of file"  */
+    YYerror = 256,                 /* error  */
+    YYUNDEF = 257,                 /* "invalid token"  */
+    IPv4 = 258,                    /* IPv4  */
+    IPv6 = 259,                    /* IPv6  */
+    HOSTADDR = 260,                /* HOSTADDR  */
+    WORD = 261,                    /* WORD  */
+    INTEGER = 262,                 /* INTEGER  */
+    SYSLOG_BANNER_PID = 263,       /* SYSLOG_BANNER_PID  */
+    LAST_LINE_REPEATED_N_TIMES = 264, /* LAST_LINE_REPEATED_N_TIMES  */
+    SYSLOG_BANNER = 265,           /* SYSLOG_BANNER  */
+    TIMESTAMP_SYSLOG = 266,        /* TIMESTAMP_SYSLOG  */
+    TIMESTAMP_TAI64 = 267,         /* TIMESTAMP_TAI64  */
+    AT_TIMESTAMP_TAI64 = 268,      /* AT_TIMESTAMP_TAI64  */
+    METALOG_BANNER = 269,          /* METALOG_BANNER  */
+    SSH_INVALUSERPREF = 270,       /* SSH_INVALUSERPREF  */
+    SSH_NOTALLOWEDPREF = 271,      /* SSH_NOTALLOWEDPREF  */
+    SSH_NOTALLOWEDSUFF = 272,      /* SSH_NOTALLOWEDSUFF  */
+    SSH_LOGINERR_PREF = 273,       /* SSH_LOGINERR_PREF  */
+    SSH_LOGINERR_SUFF = 274,       /* SSH_LOGINERR_SUFF  */
+    SSH_LOGINERR_PAM = 275,        /* SSH_LOGINERR_PAM  */
+    SSH_REVERSEMAP_PREF = 276,     /* SSH_REVERSEMAP_PREF  */
+    SSH_REVERSEMAP_SUFF = 277,     /* SSH_REVERSEMAP_SUFF  */
+    SSH_NOIDENTIFSTR = 278,        /* SSH_NOIDENTIFSTR  */
+    SSH_BADPROTOCOLIDENTIF = 279,  /* SSH_BADPROTOCOLIDENTIF  */
+    DOVECOT_IMAP_LOGINERR_PREF = 280, /* DOVECOT_IMAP_LOGINERR_PREF  */
+    DOVECOT_IMAP_LOGINERR_SUFF = 281, /* DOVECOT_IMAP_LOGINERR_SUFF  */
+    UWIMAP_LOGINERR = 282,         /* UWIMAP_LOGINERR  */
+    CYRUSIMAP_SASL_LOGINERR_PREF = 283, /* CYRUSIMAP_SASL_LOGINERR_PREF  */
+    CYRUSIMAP_SASL_LOGINERR_SUFF = 284, /* CYRUSIMAP_SASL_LOGINERR_SUFF  */
+    CUCIPOP_AUTHFAIL = 285,        /* CUCIPOP_AUTHFAIL  */
+    EXIM_ESMTP_AUTHFAIL_PREF = 286, /* EXIM_ESMTP_AUTHFAIL_PREF  */
+    EXIM_ESMTP_AUTHFAIL_SUFF = 287, /* EXIM_ESMTP_AUTHFAIL_SUFF  */
+    SENDMAIL_RELAYDENIED_PREF = 288, /* SENDMAIL_RELAYDENIED_PREF  */
+    SENDMAIL_RELAYDENIED_SUFF = 289, /* SENDMAIL_RELAYDENIED_SUFF  */
+    FREEBSDFTPD_LOGINERR_PREF = 290, /* FREEBSDFTPD_LOGINERR_PREF  */
+    FREEBSDFTPD_LOGINERR_SUFF = 291, /* FREEBSDFTPD_LOGINERR_SUFF  */
+    PROFTPD_LOGINERR_PREF = 292,   /* PROFTPD_LOGINERR_PREF  */
+    PROFTPD_LOGINERR_SUFF = 293,   /* PROFTPD_LOGINERR_SUFF  */
+    PUREFTPD_LOGINERR_PREF = 294,  /* PUREFTPD_LOGINERR_PREF  */
+    PUREFTPD_LOGINERR_SUFF = 295,  /* PUREFTPD_LOGINERR_SUFF  */
+    VSFTPD_LOGINERR_PREF = 296,    /* VSFTPD_LOGINERR_PREF  */
+    VSFTPD_LOGINERR_SUFF = 297     /* VSFTPD_LOGINERR_SUFF  */
+  };
+  typedef enum yytokentype yytoken_kind_t;
 #endif
+/* Token kinds.  */
+#define YYEMPTY -2
+#define YYEOF 0
+#define YYerror 256
+#define YYUNDEF 257
+#define IPv4 258
+#define IPv6 259
+#define HOSTADDR 260
+#define WORD 261
+#define INTEGER 262
+#define SYSLOG_BANNER_PID 263
+#define LAST_LINE_REPEATED_N_TIMES 264
+#define SYSLOG_BANNER 265
+#define TIMESTAMP_SYSLOG 266
+#define TIMESTAMP_TAI64 267
+#define AT_TIMESTAMP_TAI64 268
+#define METALOG_BANNER 269
+#define SSH_INVALUSERPREF 270
+#define SSH_NOTALLOWEDPREF 271
+#define SSH_NOTALLOWEDSUFF 272
+#define SSH_LOGINERR_PREF 273
+#define SSH_LOGINERR_SUFF 274
+#define SSH_LOGINERR_PAM 275
+#define SSH_REVERSEMAP_PREF 276
+#define SSH_REVERSEMAP_SUFF 277
+#define SSH_NOIDENTIFSTR 278
+#define SSH_BADPROTOCOLIDENTIF 279
+#define DOVECOT_IMAP_LOGINERR_PREF 280
+#define DOVECOT_IMAP_LOGINERR_SUFF 281
+#define UWIMAP_LOGINERR 282
+#define CYRUSIMAP_SASL_LOGINERR_PREF 283
+#define CYRUSIMAP_SASL_LOGINERR_SUFF 284
+#define CUCIPOP_AUTHFAIL 285
+#define EXIM_ESMTP_AUTHFAIL_PREF 286
+#define EXIM_ESMTP_AUTHFAIL_SUFF 287
+#define SENDMAIL_RELAYDENIED_PREF 288
+#define SENDMAIL_RELAYDENIED_SUFF 289
+#define FREEBSDFTPD_LOGINERR_PREF 290
+#define FREEBSDFTPD_LOGINERR_SUFF 291
+#define PROFTPD_LOGINERR_PREF 292
+#define PROFTPD_LOGINERR_SUFF 293
+#define PUREFTPD_LOGINERR_PREF 294
+#define PUREFTPD_LOGINERR_SUFF 295
+#define VSFTPD_LOGINERR_PREF 296
+#define VSFTPD_LOGINERR_SUFF 297
 
+/* Value type.  */
 #if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
-typedef union YYSTYPE
-#line 78 "attack_parser.y"
+union YYSTYPE
 {
+#line 162 "attack_parser.y"
+
     char *str;
     int num;
-}
-/* Line 193 of yacc.c.  */
-#line 256 "attack_parser.c"
-	YYSTYPE;
-# define yystype YYSTYPE /* obsolescent; will be withdrawn */
-# define YYSTYPE_IS_DECLARED 1
+
+#line 366 "attack_parser.c"
+
+};
+typedef union YYSTYPE YYSTYPE;
 # define YYSTYPE_IS_TRIVIAL 1
+# define YYSTYPE_IS_DECLARED 1
 #endif
 
 
 
-/* Copy the second part of user declarations.  */
+
+int yyparse (parser_ctx_t *ctx, void *scanner);
+
+
+#endif /* !YY_YY_Y_TAB_H_INCLUDED  */
+/* Symbol kind.  */
+enum yysymbol_kind_t
+{
+  YYSYMBOL_YYEMPTY = -2,
+  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
+  YYSYMBOL_YYerror = 1,                    /* error  */
+  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
+  YYSYMBOL_IPv4 = 3,                       /* IPv4  */
+  YYSYMBOL_IPv6 = 4,                       /* IPv6  */
+  YYSYMBOL_HOSTADDR = 5,                   /* HOSTADDR  */
+  YYSYMBOL_WORD = 6,                       /* WORD  */
+  YYSYMBOL_INTEGER = 7,                    /* INTEGER  */
+  YYSYMBOL_SYSLOG_BANNER_PID = 8,          /* SYSLOG_BANNER_PID  */
+  YYSYMBOL_LAST_LINE_REPEATED_N_TIMES = 9, /* LAST_LINE_REPEATED_N_TIMES  */
+  YYSYMBOL_SYSLOG_BANNER = 10,             /* SYSLOG_BANNER  */
+  YYSYMBOL_TIMESTAMP_SYSLOG = 11,          /* TIMESTAMP_SYSLOG  */
+  YYSYMBOL_TIMESTAMP_TAI64 = 12,           /* TIMESTAMP_TAI64  */
+  YYSYMBOL_AT_TIMESTAMP_TAI64 = 13,        /* AT_TIMESTAMP_TAI64  */
+  YYSYMBOL_METALOG_BANNER = 14,            /* METALOG_BANNER  */
+  YYSYMBOL_SSH_INVALUSERPREF = 15,         /* SSH_INVALUSERPREF  */
+  YYSYMBOL_SSH_NOTALLOWEDPREF = 16,        /* SSH_NOTALLOWEDPREF  */
+  YYSYMBOL_SSH_NOTALLOWEDSUFF = 17,        /* SSH_NOTALLOWEDSUFF  */
+  YYSYMBOL_SSH_LOGINERR_PREF = 18,         /* SSH_LOGINERR_PREF  */
+  YYSYMBOL_SSH_LOGINERR_SUFF = 19,         /* SSH_LOGINERR_SUFF  */
+  YYSYMBOL_SSH_LOGINERR_PAM = 20,          /* SSH_LOGINERR_PAM  */
+  YYSYMBOL_SSH_REVERSEMAP_PREF = 21,       /* SSH_REVERSEMAP_PREF  */
+  YYSYMBOL_SSH_REVERSEMAP_SUFF = 22,       /* SSH_REVERSEMAP_SUFF  */
+  YYSYMBOL_SSH_NOIDENTIFSTR = 23,          /* SSH_NOIDENTIFSTR  */
+  YYSYMBOL_SSH_BADPROTOCOLIDENTIF = 24,    /* SSH_BADPROTOCOLIDENTIF  */
+  YYSYMBOL_DOVECOT_IMAP_LOGINERR_PREF = 25, /* DOVECOT_IMAP_LOGINERR_PREF  */
+  YYSYMBOL_DOVECOT_IMAP_LOGINERR_SUFF = 26, /* DOVECOT_IMAP_LOGINERR_SUFF  */
+  YYSYMBOL_UWIMAP_LOGINERR = 27,           /* UWIMAP_LOGINERR  */
+  YYSYMBOL_CYRUSIMAP_SASL_LOGINERR_PREF = 28, /* CYRUSIMAP_SASL_LOGINERR_PREF  */
+  YYSYMBOL_CYRUSIMAP_SASL_LOGINERR_SUFF = 29, /* CYRUSIMAP_SASL_LOGINERR_SUFF  */
+  YYSYMBOL_CUCIPOP_AUTHFAIL = 30,          /* CUCIPOP_AUTHFAIL  */
+  YYSYMBOL_EXIM_ESMTP_AUTHFAIL_PREF = 31,  /* EXIM_ESMTP_AUTHFAIL_PREF  */
+  YYSYMBOL_EXIM_ESMTP_AUTHFAIL_SUFF = 32,  /* EXIM_ESMTP_AUTHFAIL_SUFF  */
+  YYSYMBOL_SENDMAIL_RELAYDENIED_PREF = 33, /* SENDMAIL_RELAYDENIED_PREF  */
+  YYSYMBOL_SENDMAIL_RELAYDENIED_SUFF = 34, /* SENDMAIL_RELAYDENIED_SUFF  */
+  YYSYMBOL_FREEBSDFTPD_LOGINERR_PREF = 35, /* FREEBSDFTPD_LOGINERR_PREF  */
+  YYSYMBOL_FREEBSDFTPD_LOGINERR_SUFF = 36, /* FREEBSDFTPD_LOGINERR_SUFF  */
+  YYSYMBOL_PROFTPD_LOGINERR_PREF = 37,     /* PROFTPD_LOGINERR_PREF  */
+  YYSYMBOL_PROFTPD_LOGINERR_SUFF = 38,     /* PROFTPD_LOGINERR_SUFF  */
+  YYSYMBOL_PUREFTPD_LOGINERR_PREF = 39,    /* PUREFTPD_LOGINERR_PREF  */
+  YYSYMBOL_PUREFTPD_LOGINERR_SUFF = 40,    /* PUREFTPD_LOGINERR_SUFF  */
+  YYSYMBOL_VSFTPD_LOGINERR_PREF = 41,      /* VSFTPD_LOGINERR_PREF  */
+  YYSYMBOL_VSFTPD_LOGINERR_SUFF = 42,      /* VSFTPD_LOGINERR_SUFF  */
+  YYSYMBOL_43_ = 43,                       /* '['  */
+  YYSYMBOL_44_ = 44,                       /* ']'  */
+  YYSYMBOL_YYACCEPT = 45,                  /* $accept  */
+  YYSYMBOL_text = 46,                      /* text  */
+  YYSYMBOL_syslogent = 47,                 /* syslogent  */
+  YYSYMBOL_multilogent = 48,               /* multilogent  */
+  YYSYMBOL_metalogent = 49,                /* metalogent  */
+  YYSYMBOL_logmsg = 50,                    /* logmsg  */
+  YYSYMBOL_msg_single = 51,                /* msg_single  */
+  YYSYMBOL_msg_multiple = 52,              /* msg_multiple  */
+  YYSYMBOL_addr = 53,                      /* addr  */
+  YYSYMBOL_sshmsg = 54,                    /* sshmsg  */
+  YYSYMBOL_ssh_illegaluser = 55,           /* ssh_illegaluser  */
+  YYSYMBOL_ssh_authfail = 56,              /* ssh_authfail  */
+  YYSYMBOL_ssh_reversemapping = 57,        /* ssh_reversemapping  */
+  YYSYMBOL_ssh_noidentifstring = 58,       /* ssh_noidentifstring  */
+  YYSYMBOL_ssh_badprotocol = 59,           /* ssh_badprotocol  */
+  YYSYMBOL_dovecotmsg = 60,                /* dovecotmsg  */
+  YYSYMBOL_uwimapmsg = 61,                 /* uwimapmsg  */
+  YYSYMBOL_cyrusimapmsg = 62,              /* cyrusimapmsg  */
+  YYSYMBOL_cucipopmsg = 63,                /* cucipopmsg  */
+  YYSYMBOL_eximmsg = 64,                   /* eximmsg  */
+  YYSYMBOL_sendmailmsg = 65,               /* sendmailmsg  */
+  YYSYMBOL_freebsdftpdmsg = 66,            /* freebsdftpdmsg  */
+  YYSYMBOL_proftpdmsg = 67,                /* proftpdmsg  */
+  YYSYMBOL_pureftpdmsg = 68,               /* pureftpdmsg  */
+  YYSYMBOL_vsftpdmsg = 69                  /* vsftpdmsg  */
+};
+typedef enum yysymbol_kind_t yysymbol_kind_t;
+
 
 
-/* Line 216 of yacc.c.  */
-#line 269 "attack_parser.c"
 
 #ifdef short
 # undef short
 #endif
 
-#ifdef YYTYPE_UINT8
-typedef YYTYPE_UINT8 yytype_uint8;
-#else
-typedef unsigned char yytype_uint8;
+/* On compilers that do not define __PTRDIFF_MAX__ etc., make sure
+   <limits.h> and (if available) <stdint.h> are included
+   so that the code can choose integer types of a good width.  */
+
+#ifndef __PTRDIFF_MAX__
+# include <limits.h> /* INFRINGES ON USER NAME SPACE */
+# if defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stdint.h> /* INFRINGES ON USER NAME SPACE */
+#  define YY_STDINT_H
+# endif
 #endif
 
-#ifdef YYTYPE_INT8
-typedef YYTYPE_INT8 yytype_int8;
-#elif (defined __STDC__ || defined __C99__FUNC__ \
-     || defined __cplusplus || defined _MSC_VER)
+/* Narrow types that promote to a signed type and that can represent a
+   signed or unsigned integer of at least N bits.  In tables they can
+   save space and decrease cache pressure.  Promoting to a signed type
+   helps avoid bugs in integer arithmetic.  */
+
+#ifdef __INT_LEAST8_MAX__
+typedef __INT_LEAST8_TYPE__ yytype_int8;
+#elif defined YY_STDINT_H
+typedef int_least8_t yytype_int8;
+#else
 typedef signed char yytype_int8;
+#endif
+
+#ifdef __INT_LEAST16_MAX__
+typedef __INT_LEAST16_TYPE__ yytype_int16;
+#elif defined YY_STDINT_H
+typedef int_least16_t yytype_int16;
 #else
-typedef short int yytype_int8;
+typedef short yytype_int16;
+#endif
+
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
 #endif
 
-#ifdef YYTYPE_UINT16
-typedef YYTYPE_UINT16 yytype_uint16;
+#if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST8_TYPE__ yytype_uint8;
+#elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST8_MAX <= INT_MAX)
+typedef uint_least8_t yytype_uint8;
+#elif !defined __UINT_LEAST8_MAX__ && UCHAR_MAX <= INT_MAX
+typedef unsigned char yytype_uint8;
 #else
-typedef unsigned short int yytype_uint16;
+typedef short yytype_uint8;
 #endif
 
-#ifdef YYTYPE_INT16
-typedef YYTYPE_INT16 yytype_int16;
+#if defined __UINT_LEAST16_MAX__ && __UINT_LEAST16_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST16_TYPE__ yytype_uint16;
+#elif (!defined __UINT_LEAST16_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST16_MAX <= INT_MAX)
+typedef uint_least16_t yytype_uint16;
+#elif !defined __UINT_LEAST16_MAX__ && USHRT_MAX <= INT_MAX
+typedef unsigned short yytype_uint16;
 #else
-typedef short int yytype_int16;
+typedef int yytype_uint16;
+#endif
+
+#ifndef YYPTRDIFF_T
+# if defined __PTRDIFF_TYPE__ && defined __PTRDIFF_MAX__
+#  define YYPTRDIFF_T __PTRDIFF_TYPE__
+#  define YYPTRDIFF_MAXIMUM __PTRDIFF_MAX__
+# elif defined PTRDIFF_MAX
+#  ifndef ptrdiff_t
+#   include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  endif
+#  define YYPTRDIFF_T ptrdiff_t
+#  define YYPTRDIFF_MAXIMUM PTRDIFF_MAX
+# else
+#  define YYPTRDIFF_T long
+#  define YYPTRDIFF_MAXIMUM LONG_MAX
+# endif
 #endif
 
 #ifndef YYSIZE_T
@@ -303,55 +549,106 @@ typedef short int yytype_int16;
 #  define YYSIZE_T __SIZE_TYPE__
 # elif defined size_t
 #  define YYSIZE_T size_t
-# elif ! defined YYSIZE_T && (defined __STDC__ || defined __C99__FUNC__ \
-     || defined __cplusplus || defined _MSC_VER)
+# elif defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
 #  include <stddef.h> /* INFRINGES ON USER NAME SPACE */
 #  define YYSIZE_T size_t
 # else
-#  define YYSIZE_T unsigned int
+#  define YYSIZE_T unsigned
 # endif
 #endif
 
-#define YYSIZE_MAXIMUM ((YYSIZE_T) -1)
+#define YYSIZE_MAXIMUM                                  \
+  YY_CAST (YYPTRDIFF_T,                                 \
+           (YYPTRDIFF_MAXIMUM < YY_CAST (YYSIZE_T, -1)  \
+            ? YYPTRDIFF_MAXIMUM                         \
+            : YY_CAST (YYSIZE_T, -1)))
+
+#define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
+
+
+/* Stored state numbers (used for stacks). */
+typedef yytype_int8 yy_state_t;
+
+/* State numbers in computations.  */
+typedef int yy_state_fast_t;
 
 #ifndef YY_
 # if defined YYENABLE_NLS && YYENABLE_NLS
 #  if ENABLE_NLS
 #   include <libintl.h> /* INFRINGES ON USER NAME SPACE */
-#   define YY_(msgid) dgettext ("bison-runtime", msgid)
+#   define YY_(Msgid) dgettext ("bison-runtime", Msgid)
 #  endif
 # endif
 # ifndef YY_
-#  define YY_(msgid) msgid
+#  define YY_(Msgid) Msgid
+# endif
+#endif
+
+
+#ifndef YY_ATTRIBUTE_PURE
+# if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
+# else
+#  define YY_ATTRIBUTE_PURE
+# endif
+#endif
+
+#ifndef YY_ATTRIBUTE_UNUSED
+# if defined __GNUC__ && 2 < __GNUC__ + (7 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_UNUSED __attribute__ ((__unused__))
+# else
+#  define YY_ATTRIBUTE_UNUSED
 # endif
 #endif
 
 /* Suppress unused-variable warnings by "using" E.  */
 #if ! defined lint || defined __GNUC__
-# define YYUSE(e) ((void) (e))
+# define YY_USE(E) ((void) (E))
 #else
-# define YYUSE(e) /* empty */
+# define YY_USE(E) /* empty */
 #endif
 
-/* Identity function, used to suppress warnings about constant conditions.  */
-#ifndef lint
-# define YYID(n) (n)
-#else
-#if (defined __STDC__ || defined __C99__FUNC__ \
-     || defined __cplusplus || defined _MSC_VER)
-static int
-YYID (int i)
+/* Suppress an incorrect diagnostic about yylval being uninitialized.  */
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
+    _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+# endif
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
+    _Pragma ("GCC diagnostic pop")
 #else
-static int
-YYID (i)
-    int i;
+# define YY_INITIAL_VALUE(Value) Value
 #endif
-{
-  return i;
-}
+#ifndef YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END
+#endif
+#ifndef YY_INITIAL_VALUE
+# define YY_INITIAL_VALUE(Value) /* Nothing. */
+#endif
+
+#if defined __cplusplus && defined __GNUC__ && ! defined __ICC && 6 <= __GNUC__
+# define YY_IGNORE_USELESS_CAST_BEGIN                          \
+    _Pragma ("GCC diagnostic push")                            \
+    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+# define YY_IGNORE_USELESS_CAST_END            \
+    _Pragma ("GCC diagnostic pop")
 #endif
+#ifndef YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_END
+#endif
+
 
-#if ! defined yyoverflow || YYERROR_VERBOSE
+#define YY_ASSERT(E) ((void) (0 && (E)))
+
+#if !defined yyoverflow
 
 /* The parser invokes alloca or malloc; define the necessary symbols.  */
 
@@ -368,11 +665,11 @@ YYID (i)
 #    define alloca _alloca
 #   else
 #    define YYSTACK_ALLOC alloca
-#    if ! defined _ALLOCA_H && ! defined _STDLIB_H && (defined __STDC__ || defined __C99__FUNC__ \
-     || defined __cplusplus || defined _MSC_VER)
+#    if ! defined _ALLOCA_H && ! defined EXIT_SUCCESS
 #     include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
-#     ifndef _STDLIB_H
-#      define _STDLIB_H 1
+      /* Use EXIT_SUCCESS as a witness for stdlib.h.  */
+#     ifndef EXIT_SUCCESS
+#      define EXIT_SUCCESS 0
 #     endif
 #    endif
 #   endif
@@ -380,8 +677,8 @@ YYID (i)
 # endif
 
 # ifdef YYSTACK_ALLOC
-   /* Pacify GCC's `empty if-body' warning.  */
-#  define YYSTACK_FREE(Ptr) do { /* empty */; } while (YYID (0))
+   /* Pacify GCC's 'empty if-body' warning.  */
+#  define YYSTACK_FREE(Ptr) do { /* empty */; } while (0)
 #  ifndef YYSTACK_ALLOC_MAXIMUM
     /* The OS might guarantee only one guard page at the bottom of the stack,
        and a page size can be as small as 4096 bytes.  So we cannot safely
@@ -395,88 +692,89 @@ YYID (i)
 #  ifndef YYSTACK_ALLOC_MAXIMUM
 #   define YYSTACK_ALLOC_MAXIMUM YYSIZE_MAXIMUM
 #  endif
-#  if (defined __cplusplus && ! defined _STDLIB_H \
+#  if (defined __cplusplus && ! defined EXIT_SUCCESS \
        && ! ((defined YYMALLOC || defined malloc) \
-	     && (defined YYFREE || defined free)))
+             && (defined YYFREE || defined free)))
 #   include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
-#   ifndef _STDLIB_H
-#    define _STDLIB_H 1
+#   ifndef EXIT_SUCCESS
+#    define EXIT_SUCCESS 0
 #   endif
 #  endif
 #  ifndef YYMALLOC
 #   define YYMALLOC malloc
-#   if ! defined malloc && ! defined _STDLIB_H && (defined __STDC__ || defined __C99__FUNC__ \
-     || defined __cplusplus || defined _MSC_VER)
+#   if ! defined malloc && ! defined EXIT_SUCCESS
 void *malloc (YYSIZE_T); /* INFRINGES ON USER NAME SPACE */
 #   endif
 #  endif
 #  ifndef YYFREE
 #   define YYFREE free
-#   if ! defined free && ! defined _STDLIB_H && (defined __STDC__ || defined __C99__FUNC__ \
-     || defined __cplusplus || defined _MSC_VER)
+#   if ! defined free && ! defined EXIT_SUCCESS
 void free (void *); /* INFRINGES ON USER NAME SPACE */
 #   endif
 #  endif
 # endif
-#endif /* ! defined yyoverflow || YYERROR_VERBOSE */
-
+#endif /* !defined yyoverflow */
 
 #if (! defined yyoverflow \
      && (! defined __cplusplus \
-	 || (defined YYSTYPE_IS_TRIVIAL && YYSTYPE_IS_TRIVIAL)))
+         || (defined YYSTYPE_IS_TRIVIAL && YYSTYPE_IS_TRIVIAL)))
 
 /* A type that is properly aligned for any stack member.  */
 union yyalloc
 {
-  yytype_int16 yyss;
-  YYSTYPE yyvs;
-  };
+  yy_state_t yyss_alloc;
+  YYSTYPE yyvs_alloc;
+};
 
 /* The size of the maximum gap between one aligned stack and the next.  */
-# define YYSTACK_GAP_MAXIMUM (sizeof (union yyalloc) - 1)
+# define YYSTACK_GAP_MAXIMUM (YYSIZEOF (union yyalloc) - 1)
 
 /* The size of an array large to enough to hold all stacks, each with
    N elements.  */
 # define YYSTACK_BYTES(N) \
-     ((N) * (sizeof (yytype_int16) + sizeof (YYSTYPE)) \
+     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE)) \
       + YYSTACK_GAP_MAXIMUM)
 
-/* Copy COUNT objects from FROM to TO.  The source and destination do
-   not overlap.  */
-# ifndef YYCOPY
-#  if defined __GNUC__ && 1 < __GNUC__
-#   define YYCOPY(To, From, Count) \
-      __builtin_memcpy (To, From, (Count) * sizeof (*(From)))
-#  else
-#   define YYCOPY(To, From, Count)		\
-      do					\
-	{					\
-	  YYSIZE_T yyi;				\
-	  for (yyi = 0; yyi < (Count); yyi++)	\
-	    (To)[yyi] = (From)[yyi];		\
-	}					\
-      while (YYID (0))
-#  endif
-# endif
+# define YYCOPY_NEEDED 1
 
 /* Relocate STACK from its old location to the new one.  The
    local variables YYSIZE and YYSTACKSIZE give the old and new number of
    elements in the stack, and YYPTR gives the new location of the
    stack.  Advance YYPTR to a properly aligned location for the next
    stack.  */
-# define YYSTACK_RELOCATE(Stack)					\
-    do									\
-      {									\
-	YYSIZE_T yynewbytes;						\
-	YYCOPY (&yyptr->Stack, Stack, yysize);				\
-	Stack = &yyptr->Stack;						\
-	yynewbytes = yystacksize * sizeof (*Stack) + YYSTACK_GAP_MAXIMUM; \
-	yyptr += yynewbytes / sizeof (*yyptr);				\
-      }									\
-    while (YYID (0))
+# define YYSTACK_RELOCATE(Stack_alloc, Stack)                           \
+    do                                                                  \
+      {                                                                 \
+        YYPTRDIFF_T yynewbytes;                                         \
+        YYCOPY (&yyptr->Stack_alloc, Stack, yysize);                    \
+        Stack = &yyptr->Stack_alloc;                                    \
+        yynewbytes = yystacksize * YYSIZEOF (*Stack) + YYSTACK_GAP_MAXIMUM; \
+        yyptr += yynewbytes / YYSIZEOF (*yyptr);                        \
+      }                                                                 \
+    while (0)
 
 #endif
 
+#if defined YYCOPY_NEEDED && YYCOPY_NEEDED
+/* Copy COUNT objects from SRC to DST.  The source and destination do
+   not overlap.  */
+# ifndef YYCOPY
+#  if defined __GNUC__ && 1 < __GNUC__
+#   define YYCOPY(Dst, Src, Count) \
+      __builtin_memcpy (Dst, Src, YY_CAST (YYSIZE_T, (Count)) * sizeof (*(Src)))
+#  else
+#   define YYCOPY(Dst, Src, Count)              \
+      do                                        \
+        {                                       \
+          YYPTRDIFF_T yyi;                      \
+          for (yyi = 0; yyi < (Count); yyi++)   \
+            (Dst)[yyi] = (Src)[yyi];            \
+        }                                       \
+      while (0)
+#  endif
+# endif
+#endif /* !YYCOPY_NEEDED */
+
 /* YYFINAL -- State number of the termination state.  */
 #define YYFINAL  70
 /* YYLAST -- Last index in YYTABLE.  */
@@ -488,18 +786,23 @@ union yyalloc
 #define YYNNTS  25
 /* YYNRULES -- Number of rules.  */
 #define YYNRULES  48
-/* YYNRULES -- Number of states.  */
+/* YYNSTATES -- Number of states.  */
 #define YYNSTATES  84
 
-/* YYTRANSLATE(YYLEX) -- Bison symbol number corresponding to YYLEX.  */
-#define YYUNDEFTOK  2
+/* YYMAXUTOK -- Last valid token kind.  */
 #define YYMAXUTOK   297
 
-#define YYTRANSLATE(YYX)						\
-  ((unsigned int) (YYX) <= YYMAXUTOK ? yytranslate[YYX] : YYUNDEFTOK)
 
-/* YYTRANSLATE[YYLEX] -- Bison symbol number corresponding to YYLEX.  */
-static const yytype_uint8 yytranslate[] =
+/* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex, with out-of-bounds checking.  */
+#define YYTRANSLATE(YYX)                                \
+  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
+   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
+   : YYSYMBOL_YYUNDEF)
+
+/* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex.  */
+static const yytype_int8 yytranslate[] =
 {
        0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
@@ -534,137 +837,72 @@ static const yytype_uint8 yytranslate[] =
 };
 
 #if YYDEBUG
-/* YYPRHS[YYN] -- Index of the first RHS symbol of rule number YYN in
-   YYRHS.  */
-static const yytype_uint8 yyprhs[] =
+/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+static const yytype_int16 yyrline[] =
 {
-       0,     0,     3,     5,     7,     9,    11,    14,    17,    20,
-      23,    25,    27,    29,    31,    33,    35,    37,    39,    41,
-      43,    45,    47,    49,    51,    53,    55,    57,    59,    61,
-      63,    65,    67,    70,    74,    78,    81,    85,    88,    91,
-      95,   100,   104,   107,   111,   115,   119,   123,   127
+       0,   206,   206,   207,   208,   209,   222,   232,   237,   241,
+     247,   249,   253,   254,   255,   256,   257,   258,   259,   260,
+     261,   262,   263,   268,   291,   295,   299,   325,   327,   328,
+     329,   330,   335,   337,   341,   342,   346,   350,   354,   359,
+     364,   368,   373,   378,   382,   387,   392,   397,   402
 };
+#endif
 
-/* YYRHS -- A `-1'-separated list of the rules' RHS.  */
-static const yytype_int8 yyrhs[] =
-{
-      46,     0,    -1,    47,    -1,    48,    -1,    49,    -1,    50,
-      -1,     8,    50,    -1,    10,    50,    -1,    13,    50,    -1,
-      14,    50,    -1,    51,    -1,    52,    -1,    54,    -1,    60,
-      -1,    61,    -1,    62,    -1,    63,    -1,    64,    -1,    65,
-      -1,    66,    -1,    67,    -1,    68,    -1,    69,    -1,     9,
-      -1,     3,    -1,     4,    -1,     5,    -1,    55,    -1,    56,
-      -1,    57,    -1,    58,    -1,    59,    -1,    15,    53,    -1,
-      16,    53,    17,    -1,    18,    53,    19,    -1,    20,    53,
-      -1,    21,    53,    22,    -1,    23,    53,    -1,    24,    53,
-      -1,    25,    53,    26,    -1,    27,    43,    53,    44,    -1,
-      28,    53,    29,    -1,    30,    53,    -1,    31,    53,    32,
-      -1,    33,    53,    34,    -1,    35,    53,    36,    -1,    37,
-      53,    38,    -1,    39,    53,    40,    -1,    41,    53,    42,
-      -1
-};
+/** Accessing symbol of state STATE.  */
+#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
 
-/* YYRLINE[YYN] -- source line where rule number YYN was defined.  */
-static const yytype_uint16 yyrline[] =
-{
-       0,   122,   122,   123,   124,   125,   138,   148,   153,   157,
-     163,   165,   169,   170,   171,   172,   173,   174,   175,   176,
-     177,   178,   179,   184,   203,   207,   211,   262,   264,   265,
-     266,   267,   272,   274,   278,   279,   283,   287,   291,   296,
-     301,   305,   310,   315,   319,   324,   329,   334,   339
-};
-#endif
+#if YYDEBUG || 0
+/* The user-facing name of the symbol whose (internal) number is
+   YYSYMBOL.  No bounds checking.  */
+static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
 
-#if YYDEBUG || YYERROR_VERBOSE || YYTOKEN_TABLE
 /* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
    First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
 static const char *const yytname[] =
 {
-  "$end", "error", "$undefined", "IPv4", "IPv6", "HOSTADDR", "WORD",
-  "INTEGER", "SYSLOG_BANNER_PID", "LAST_LINE_REPEATED_N_TIMES",
-  "SYSLOG_BANNER", "TIMESTAMP_SYSLOG", "TIMESTAMP_TAI64",
-  "AT_TIMESTAMP_TAI64", "METALOG_BANNER", "SSH_INVALUSERPREF",
-  "SSH_NOTALLOWEDPREF", "SSH_NOTALLOWEDSUFF", "SSH_LOGINERR_PREF",
-  "SSH_LOGINERR_SUFF", "SSH_LOGINERR_PAM", "SSH_REVERSEMAP_PREF",
-  "SSH_REVERSEMAP_SUFF", "SSH_NOIDENTIFSTR", "SSH_BADPROTOCOLIDENTIF",
-  "DOVECOT_IMAP_LOGINERR_PREF", "DOVECOT_IMAP_LOGINERR_SUFF",
-  "UWIMAP_LOGINERR", "CYRUSIMAP_SASL_LOGINERR_PREF",
-  "CYRUSIMAP_SASL_LOGINERR_SUFF", "CUCIPOP_AUTHFAIL",
-  "EXIM_ESMTP_AUTHFAIL_PREF", "EXIM_ESMTP_AUTHFAIL_SUFF",
-  "SENDMAIL_RELAYDENIED_PREF", "SENDMAIL_RELAYDENIED_SUFF",
-  "FREEBSDFTPD_LOGINERR_PREF", "FREEBSDFTPD_LOGINERR_SUFF",
-  "PROFTPD_LOGINERR_PREF", "PROFTPD_LOGINERR_SUFF",
-  "PUREFTPD_LOGINERR_PREF", "PUREFTPD_LOGINERR_SUFF",
-  "VSFTPD_LOGINERR_PREF", "VSFTPD_LOGINERR_SUFF", "'['", "']'", "$accept",
-  "text", "syslogent", "multilogent", "metalogent", "logmsg", "msg_single",
-  "msg_multiple", "addr", "sshmsg", "ssh_illegaluser", "ssh_authfail",
-  "ssh_reversemapping", "ssh_noidentifstring", "ssh_badprotocol",
-  "dovecotmsg", "uwimapmsg", "cyrusimapmsg", "cucipopmsg", "eximmsg",
-  "sendmailmsg", "freebsdftpdmsg", "proftpdmsg", "pureftpdmsg",
-  "vsftpdmsg", 0
+  "\"end of file\"", "error", "\"invalid token\"", "IPv4", "IPv6",
+  "HOSTADDR", "WORD", "INTEGER", "SYSLOG_BANNER_PID",
+  "LAST_LINE_REPEATED_N_TIMES", "SYSLOG_BANNER", "TIMESTAMP_SYSLOG",
+  "TIMESTAMP_TAI64", "AT_TIMESTAMP_TAI64", "METALOG_BANNER",
+  "SSH_INVALUSERPREF", "SSH_NOTALLOWEDPREF", "SSH_NOTALLOWEDSUFF",
+  "SSH_LOGINERR_PREF", "SSH_LOGINERR_SUFF", "SSH_LOGINERR_PAM",
+  "SSH_REVERSEMAP_PREF", "SSH_REVERSEMAP_SUFF", "SSH_NOIDENTIFSTR",
+  "SSH_BADPROTOCOLIDENTIF", "DOVECOT_IMAP_LOGINERR_PREF",
+  "DOVECOT_IMAP_LOGINERR_SUFF", "UWIMAP_LOGINERR",
+  "CYRUSIMAP_SASL_LOGINERR_PREF", "CYRUSIMAP_SASL_LOGINERR_SUFF",
+  "CUCIPOP_AUTHFAIL", "EXIM_ESMTP_AUTHFAIL_PREF",
+  "EXIM_ESMTP_AUTHFAIL_SUFF", "SENDMAIL_RELAYDENIED_PREF",
+  "SENDMAIL_RELAYDENIED_SUFF", "FREEBSDFTPD_LOGINERR_PREF",
+  "FREEBSDFTPD_LOGINERR_SUFF", "PROFTPD_LOGINERR_PREF",
+  "PROFTPD_LOGINERR_SUFF", "PUREFTPD_LOGINERR_PREF",
+  "PUREFTPD_LOGINERR_SUFF", "VSFTPD_LOGINERR_PREF", "VSFTPD_LOGINERR_SUFF",
+  "'['", "']'", "$accept", "text", "syslogent", "multilogent",
+  "metalogent", "logmsg", "msg_single", "msg_multiple", "addr", "sshmsg",
+  "ssh_illegaluser", "ssh_authfail", "ssh_reversemapping",
+  "ssh_noidentifstring", "ssh_badprotocol", "dovecotmsg", "uwimapmsg",
+  "cyrusimapmsg", "cucipopmsg", "eximmsg", "sendmailmsg", "freebsdftpdmsg",
+  "proftpdmsg", "pureftpdmsg", "vsftpdmsg", YY_NULLPTR
 };
-#endif
 
-# ifdef YYPRINT
-/* YYTOKNUM[YYLEX-NUM] -- Internal token number corresponding to
-   token YYLEX-NUM.  */
-static const yytype_uint16 yytoknum[] =
+static const char *
+yysymbol_name (yysymbol_kind_t yysymbol)
 {
-       0,   256,   257,   258,   259,   260,   261,   262,   263,   264,
-     265,   266,   267,   268,   269,   270,   271,   272,   273,   274,
-     275,   276,   277,   278,   279,   280,   281,   282,   283,   284,
-     285,   286,   287,   288,   289,   290,   291,   292,   293,   294,
-     295,   296,   297,    91,    93
-};
-# endif
+  return yytname[yysymbol];
+}
+#endif
 
-/* YYR1[YYN] -- Symbol number of symbol that rule YYN derives.  */
-static const yytype_uint8 yyr1[] =
-{
-       0,    45,    46,    46,    46,    46,    47,    47,    48,    49,
-      50,    50,    51,    51,    51,    51,    51,    51,    51,    51,
-      51,    51,    51,    52,    53,    53,    53,    54,    54,    54,
-      54,    54,    55,    55,    56,    56,    57,    58,    59,    60,
-      61,    62,    63,    64,    65,    66,    67,    68,    69
-};
+#define YYPACT_NINF (-37)
 
-/* YYR2[YYN] -- Number of symbols composing right hand side of rule YYN.  */
-static const yytype_uint8 yyr2[] =
-{
-       0,     2,     1,     1,     1,     1,     2,     2,     2,     2,
-       1,     1,     1,     1,     1,     1,     1,     1,     1,     1,
-       1,     1,     1,     1,     1,     1,     1,     1,     1,     1,
-       1,     1,     2,     3,     3,     2,     3,     2,     2,     3,
-       4,     3,     2,     3,     3,     3,     3,     3,     3
-};
+#define yypact_value_is_default(Yyn) \
+  ((Yyn) == YYPACT_NINF)
 
-/* YYDEFACT[STATE-NAME] -- Default rule to reduce with in state
-   STATE-NUM when YYTABLE doesn't specify something else to do.  Zero
-   means the default is an error.  */
-static const yytype_uint8 yydefact[] =
-{
-       0,     0,    23,     0,     0,     0,     0,     0,     0,     0,
-       0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
-       0,     0,     0,     0,     2,     3,     4,     5,    10,    11,
-      12,    27,    28,    29,    30,    31,    13,    14,    15,    16,
-      17,    18,    19,    20,    21,    22,     6,     7,     8,     9,
-      24,    25,    26,    32,     0,     0,    35,     0,    37,    38,
-       0,     0,     0,    42,     0,     0,     0,     0,     0,     0,
-       1,    33,    34,    36,    39,     0,    41,    43,    44,    45,
-      46,    47,    48,    40
-};
+#define YYTABLE_NINF (-1)
 
-/* YYDEFGOTO[NTERM-NUM].  */
-static const yytype_int8 yydefgoto[] =
-{
-      -1,    23,    24,    25,    26,    27,    28,    29,    53,    30,
-      31,    32,    33,    34,    35,    36,    37,    38,    39,    40,
-      41,    42,    43,    44,    45
-};
+#define yytable_value_is_error(Yyn) \
+  0
 
 /* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
    STATE-NUM.  */
-#define YYPACT_NINF -37
 static const yytype_int8 yypact[] =
 {
        8,    35,   -37,    35,    35,    35,    77,    77,    77,    77,
@@ -678,6 +916,22 @@ static const yytype_int8 yypact[] =
      -37,   -37,   -37,   -37
 };
 
+/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
+   Performed when YYTABLE does not specify something else to do.  Zero
+   means the default is an error.  */
+static const yytype_int8 yydefact[] =
+{
+       0,     0,    23,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,     0,     2,     3,     4,     5,    10,    11,
+      12,    27,    28,    29,    30,    31,    13,    14,    15,    16,
+      17,    18,    19,    20,    21,    22,     6,     7,     8,     9,
+      24,    25,    26,    32,     0,     0,    35,     0,    37,    38,
+       0,     0,     0,    42,     0,     0,     0,     0,     0,     0,
+       1,    33,    34,    36,    39,     0,    41,    43,    44,    45,
+      46,    47,    48,    40
+};
+
 /* YYPGOTO[NTERM-NUM].  */
 static const yytype_int8 yypgoto[] =
 {
@@ -686,12 +940,18 @@ static const yytype_int8 yypgoto[] =
      -37,   -37,   -37,   -37,   -37
 };
 
-/* YYTABLE[YYPACT[STATE-NUM]].  What to do in state STATE-NUM.  If
-   positive, shift that token.  If negative, reduce the rule which
-   number is the opposite.  If zero, do what YYDEFACT says.
-   If YYTABLE_NINF, syntax error.  */
-#define YYTABLE_NINF -1
-static const yytype_uint8 yytable[] =
+/* YYDEFGOTO[NTERM-NUM].  */
+static const yytype_int8 yydefgoto[] =
+{
+       0,    23,    24,    25,    26,    27,    28,    29,    53,    30,
+      31,    32,    33,    34,    35,    36,    37,    38,    39,    40,
+      41,    42,    43,    44,    45
+};
+
+/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
+   positive, shift that token.  If negative, reduce the rule whose
+   number is the opposite.  If YYTABLE_NINF, syntax error.  */
+static const yytype_int8 yytable[] =
 {
       54,    55,    56,    57,    58,    59,    60,    61,    62,    63,
       64,    65,    66,    67,    68,    69,     1,     2,     3,    70,
@@ -717,9 +977,9 @@ static const yytype_int8 yycheck[] =
        3,     4,     5
 };
 
-/* YYSTOS[STATE-NUM] -- The (internal number of the) accessing
-   symbol of state STATE-NUM.  */
-static const yytype_uint8 yystos[] =
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
+static const yytype_int8 yystos[] =
 {
        0,     8,     9,    10,    13,    14,    15,    16,    18,    20,
       21,    23,    24,    25,    27,    28,    30,    31,    33,    35,
@@ -732,95 +992,61 @@ static const yytype_uint8 yystos[] =
       38,    40,    42,    44
 };
 
-#define yyerrok		(yyerrstatus = 0)
-#define yyclearin	(yychar = YYEMPTY)
-#define YYEMPTY		(-2)
-#define YYEOF		0
-
-#define YYACCEPT	goto yyacceptlab
-#define YYABORT		goto yyabortlab
-#define YYERROR		goto yyerrorlab
-
-
-/* Like YYERROR except do call yyerror.  This remains here temporarily
-   to ease the transition to the new meaning of YYERROR, for GCC.
-   Once GCC version 2 has supplanted version 1, this can go.  */
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr1[] =
+{
+       0,    45,    46,    46,    46,    46,    47,    47,    48,    49,
+      50,    50,    51,    51,    51,    51,    51,    51,    51,    51,
+      51,    51,    51,    52,    53,    53,    53,    54,    54,    54,
+      54,    54,    55,    55,    56,    56,    57,    58,    59,    60,
+      61,    62,    63,    64,    65,    66,    67,    68,    69
+};
 
-#define YYFAIL		goto yyerrlab
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr2[] =
+{
+       0,     2,     1,     1,     1,     1,     2,     2,     2,     2,
+       1,     1,     1,     1,     1,     1,     1,     1,     1,     1,
+       1,     1,     1,     1,     1,     1,     1,     1,     1,     1,
+       1,     1,     2,     3,     3,     2,     3,     2,     2,     3,
+       4,     3,     2,     3,     3,     3,     3,     3,     3
+};
 
-#define YYRECOVERING()  (!!yyerrstatus)
 
-#define YYBACKUP(Token, Value)					\
-do								\
-  if (yychar == YYEMPTY && yylen == 1)				\
-    {								\
-      yychar = (Token);						\
-      yylval = (Value);						\
-      yytoken = YYTRANSLATE (yychar);				\
-      YYPOPSTACK (1);						\
-      goto yybackup;						\
-    }								\
-  else								\
-    {								\
-      yyerror (source_id, YY_("syntax error: cannot back up")); \
-      YYERROR;							\
-    }								\
-while (YYID (0))
-
-
-#define YYTERROR	1
-#define YYERRCODE	256
-
-
-/* YYLLOC_DEFAULT -- Set CURRENT to span from RHS[1] to RHS[N].
-   If N is 0, then set CURRENT to the empty location which ends
-   the previous symbol: RHS[0] (always defined).  */
-
-#define YYRHSLOC(Rhs, K) ((Rhs)[K])
-#ifndef YYLLOC_DEFAULT
-# define YYLLOC_DEFAULT(Current, Rhs, N)				\
-    do									\
-      if (YYID (N))                                                    \
-	{								\
-	  (Current).first_line   = YYRHSLOC (Rhs, 1).first_line;	\
-	  (Current).first_column = YYRHSLOC (Rhs, 1).first_column;	\
-	  (Current).last_line    = YYRHSLOC (Rhs, N).last_line;		\
-	  (Current).last_column  = YYRHSLOC (Rhs, N).last_column;	\
-	}								\
-      else								\
-	{								\
-	  (Current).first_line   = (Current).last_line   =		\
-	    YYRHSLOC (Rhs, 0).last_line;				\
-	  (Current).first_column = (Current).last_column =		\
-	    YYRHSLOC (Rhs, 0).last_column;				\
-	}								\
-    while (YYID (0))
-#endif
+enum { YYENOMEM = -2 };
 
+#define yyerrok         (yyerrstatus = 0)
+#define yyclearin       (yychar = YYEMPTY)
 
-/* YY_LOCATION_PRINT -- Print the location on the stream.
-   This macro was not mandated originally: define only if we know
-   we won't break user code: when these are the locations we know.  */
+#define YYACCEPT        goto yyacceptlab
+#define YYABORT         goto yyabortlab
+#define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
 
-#ifndef YY_LOCATION_PRINT
-# if defined YYLTYPE_IS_TRIVIAL && YYLTYPE_IS_TRIVIAL
-#  define YY_LOCATION_PRINT(File, Loc)			\
-     fprintf (File, "%d.%d-%d.%d",			\
-	      (Loc).first_line, (Loc).first_column,	\
-	      (Loc).last_line,  (Loc).last_column)
-# else
-#  define YY_LOCATION_PRINT(File, Loc) ((void) 0)
-# endif
-#endif
 
+#define YYRECOVERING()  (!!yyerrstatus)
 
-/* YYLEX -- calling `yylex' with the right arguments.  */
+#define YYBACKUP(Token, Value)                                    \
+  do                                                              \
+    if (yychar == YYEMPTY)                                        \
+      {                                                           \
+        yychar = (Token);                                         \
+        yylval = (Value);                                         \
+        YYPOPSTACK (yylen);                                       \
+        yystate = *yyssp;                                         \
+        goto yybackup;                                            \
+      }                                                           \
+    else                                                          \
+      {                                                           \
+        yyerror (ctx, scanner, YY_("syntax error: cannot back up")); \
+        YYERROR;                                                  \
+      }                                                           \
+  while (0)
+
+/* Backward compatibility with an undocumented macro.
+   Use YYerror or YYUNDEF. */
+#define YYERRCODE YYUNDEF
 
-#ifdef YYLEX_PARAM
-# define YYLEX yylex (YYLEX_PARAM)
-#else
-# define YYLEX yylex ()
-#endif
 
 /* Enable debugging if requested.  */
 #if YYDEBUG
@@ -830,83 +1056,60 @@ while (YYID (0))
 #  define YYFPRINTF fprintf
 # endif
 
-# define YYDPRINTF(Args)			\
-do {						\
-  if (yydebug)					\
-    YYFPRINTF Args;				\
-} while (YYID (0))
-
-# define YY_SYMBOL_PRINT(Title, Type, Value, Location)			  \
-do {									  \
-  if (yydebug)								  \
-    {									  \
-      YYFPRINTF (stderr, "%s ", Title);					  \
-      yy_symbol_print (stderr,						  \
-		  Type, Value, source_id); \
-      YYFPRINTF (stderr, "\n");						  \
-    }									  \
-} while (YYID (0))
-
-
-/*--------------------------------.
-| Print this symbol on YYOUTPUT.  |
-`--------------------------------*/
-
-/*ARGSUSED*/
-#if (defined __STDC__ || defined __C99__FUNC__ \
-     || defined __cplusplus || defined _MSC_VER)
-static void
-yy_symbol_value_print (FILE *yyoutput, int yytype, YYSTYPE const * const yyvaluep, const int source_id)
-#else
+# define YYDPRINTF(Args)                        \
+do {                                            \
+  if (yydebug)                                  \
+    YYFPRINTF Args;                             \
+} while (0)
+
+
+
+
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
+do {                                                                      \
+  if (yydebug)                                                            \
+    {                                                                     \
+      YYFPRINTF (stderr, "%s ", Title);                                   \
+      yy_symbol_print (stderr,                                            \
+                  Kind, Value, ctx, scanner); \
+      YYFPRINTF (stderr, "\n");                                           \
+    }                                                                     \
+} while (0)
+
+
+/*-----------------------------------.
+| Print this symbol's value on YYO.  |
+`-----------------------------------*/
+
 static void
-yy_symbol_value_print (yyoutput, yytype, yyvaluep, source_id)
-    FILE *yyoutput;
-    int yytype;
-    YYSTYPE const * const yyvaluep;
-    const int source_id;
-#endif
+yy_symbol_value_print (FILE *yyo,
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, parser_ctx_t *ctx, void *scanner)
 {
+  FILE *yyoutput = yyo;
+  YY_USE (yyoutput);
+  YY_USE (ctx);
+  YY_USE (scanner);
   if (!yyvaluep)
     return;
-  YYUSE (source_id);
-# ifdef YYPRINT
-  if (yytype < YYNTOKENS)
-    YYPRINT (yyoutput, yytoknum[yytype], *yyvaluep);
-# else
-  YYUSE (yyoutput);
-# endif
-  switch (yytype)
-    {
-      default:
-	break;
-    }
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
 
 
-/*--------------------------------.
-| Print this symbol on YYOUTPUT.  |
-`--------------------------------*/
+/*---------------------------.
+| Print this symbol on YYO.  |
+`---------------------------*/
 
-#if (defined __STDC__ || defined __C99__FUNC__ \
-     || defined __cplusplus || defined _MSC_VER)
-static void
-yy_symbol_print (FILE *yyoutput, int yytype, YYSTYPE const * const yyvaluep, const int source_id)
-#else
 static void
-yy_symbol_print (yyoutput, yytype, yyvaluep, source_id)
-    FILE *yyoutput;
-    int yytype;
-    YYSTYPE const * const yyvaluep;
-    const int source_id;
-#endif
+yy_symbol_print (FILE *yyo,
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep, parser_ctx_t *ctx, void *scanner)
 {
-  if (yytype < YYNTOKENS)
-    YYFPRINTF (yyoutput, "token %s (", yytname[yytype]);
-  else
-    YYFPRINTF (yyoutput, "nterm %s (", yytname[yytype]);
+  YYFPRINTF (yyo, "%s %s (",
+             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
 
-  yy_symbol_value_print (yyoutput, yytype, yyvaluep, source_id);
-  YYFPRINTF (yyoutput, ")");
+  yy_symbol_value_print (yyo, yykind, yyvaluep, ctx, scanner);
+  YYFPRINTF (yyo, ")");
 }
 
 /*------------------------------------------------------------------.
@@ -914,81 +1117,68 @@ yy_symbol_print (yyoutput, yytype, yyvaluep, source_id)
 | TOP (included).                                                   |
 `------------------------------------------------------------------*/
 
-#if (defined __STDC__ || defined __C99__FUNC__ \
-     || defined __cplusplus || defined _MSC_VER)
-static void
-yy_stack_print (yytype_int16 *bottom, yytype_int16 *top)
-#else
 static void
-yy_stack_print (bottom, top)
-    yytype_int16 *bottom;
-    yytype_int16 *top;
-#endif
+yy_stack_print (yy_state_t *yybottom, yy_state_t *yytop)
 {
   YYFPRINTF (stderr, "Stack now");
-  for (; bottom <= top; ++bottom)
-    YYFPRINTF (stderr, " %d", *bottom);
+  for (; yybottom <= yytop; yybottom++)
+    {
+      int yybot = *yybottom;
+      YYFPRINTF (stderr, " %d", yybot);
+    }
   YYFPRINTF (stderr, "\n");
 }
 
-# define YY_STACK_PRINT(Bottom, Top)				\
-do {								\
-  if (yydebug)							\
-    yy_stack_print ((Bottom), (Top));				\
-} while (YYID (0))
+# define YY_STACK_PRINT(Bottom, Top)                            \
+do {                                                            \
+  if (yydebug)                                                  \
+    yy_stack_print ((Bottom), (Top));                           \
+} while (0)
 
 
 /*------------------------------------------------.
 | Report that the YYRULE is going to be reduced.  |
 `------------------------------------------------*/
 
-#if (defined __STDC__ || defined __C99__FUNC__ \
-     || defined __cplusplus || defined _MSC_VER)
 static void
-yy_reduce_print (YYSTYPE *yyvsp, int yyrule, const int source_id)
-#else
-static void
-yy_reduce_print (yyvsp, yyrule, source_id)
-    YYSTYPE *yyvsp;
-    int yyrule;
-    const int source_id;
-#endif
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
+                 int yyrule, parser_ctx_t *ctx, void *scanner)
 {
+  int yylno = yyrline[yyrule];
   int yynrhs = yyr2[yyrule];
   int yyi;
-  unsigned long int yylno = yyrline[yyrule];
-  YYFPRINTF (stderr, "Reducing stack by rule %d (line %lu):\n",
-	     yyrule - 1, yylno);
+  YYFPRINTF (stderr, "Reducing stack by rule %d (line %d):\n",
+             yyrule - 1, yylno);
   /* The symbols being reduced.  */
   for (yyi = 0; yyi < yynrhs; yyi++)
     {
-      fprintf (stderr, "   $%d = ", yyi + 1);
-      yy_symbol_print (stderr, yyrhs[yyprhs[yyrule] + yyi],
-		       &(yyvsp[(yyi + 1) - (yynrhs)])
-		       		       , source_id);
-      fprintf (stderr, "\n");
+      YYFPRINTF (stderr, "   $%d = ", yyi + 1);
+      yy_symbol_print (stderr,
+                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
+                       &yyvsp[(yyi + 1) - (yynrhs)], ctx, scanner);
+      YYFPRINTF (stderr, "\n");
     }
 }
 
-# define YY_REDUCE_PRINT(Rule)		\
-do {					\
-  if (yydebug)				\
-    yy_reduce_print (yyvsp, Rule, source_id); \
-} while (YYID (0))
+# define YY_REDUCE_PRINT(Rule)          \
+do {                                    \
+  if (yydebug)                          \
+    yy_reduce_print (yyssp, yyvsp, Rule, ctx, scanner); \
+} while (0)
 
 /* Nonzero means print parse trace.  It is left uninitialized so that
    multiple parsers can coexist.  */
 int yydebug;
 #else /* !YYDEBUG */
-# define YYDPRINTF(Args)
-# define YY_SYMBOL_PRINT(Title, Type, Value, Location)
+# define YYDPRINTF(Args) ((void) 0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
 # define YY_STACK_PRINT(Bottom, Top)
 # define YY_REDUCE_PRINT(Rule)
 #endif /* !YYDEBUG */
 
 
 /* YYINITDEPTH -- initial size of the parser's stacks.  */
-#ifndef	YYINITDEPTH
+#ifndef YYINITDEPTH
 # define YYINITDEPTH 200
 #endif
 
@@ -1003,279 +1193,33 @@ int yydebug;
 # define YYMAXDEPTH 10000
 #endif
 
-
 
-#if YYERROR_VERBOSE
 
-# ifndef yystrlen
-#  if defined __GLIBC__ && defined _STRING_H
-#   define yystrlen strlen
-#  else
-/* Return the length of YYSTR.  */
-#if (defined __STDC__ || defined __C99__FUNC__ \
-     || defined __cplusplus || defined _MSC_VER)
-static YYSIZE_T
-yystrlen (const char *yystr)
-#else
-static YYSIZE_T
-yystrlen (yystr)
-    const char *yystr;
-#endif
-{
-  YYSIZE_T yylen;
-  for (yylen = 0; yystr[yylen]; yylen++)
-    continue;
-  return yylen;
-}
-#  endif
-# endif
 
-# ifndef yystpcpy
-#  if defined __GLIBC__ && defined _STRING_H && defined _GNU_SOURCE
-#   define yystpcpy stpcpy
-#  else
-/* Copy YYSRC to YYDEST, returning the address of the terminating '\0' in
-   YYDEST.  */
-#if (defined __STDC__ || defined __C99__FUNC__ \
-     || defined __cplusplus || defined _MSC_VER)
-static char *
-yystpcpy (char *yydest, const char *yysrc)
-#else
-static char *
-yystpcpy (yydest, yysrc)
-    char *yydest;
-    const char *yysrc;
-#endif
-{
-  char *yyd = yydest;
-  const char *yys = yysrc;
 
-  while ((*yyd++ = *yys++) != '\0')
-    continue;
-
-  return yyd - 1;
-}
-#  endif
-# endif
-
-# ifndef yytnamerr
-/* Copy to YYRES the contents of YYSTR after stripping away unnecessary
-   quotes and backslashes, so that it's suitable for yyerror.  The
-   heuristic is that double-quoting is unnecessary unless the string
-   contains an apostrophe, a comma, or backslash (other than
-   backslash-backslash).  YYSTR is taken from yytname.  If YYRES is
-   null, do not copy; instead, return the length of what the result
-   would have been.  */
-static YYSIZE_T
-yytnamerr (char *yyres, const char *yystr)
-{
-  if (*yystr == '"')
-    {
-      YYSIZE_T yyn = 0;
-      char const *yyp = yystr;
-
-      for (;;)
-	switch (*++yyp)
-	  {
-	  case '\'':
-	  case ',':
-	    goto do_not_strip_quotes;
-
-	  case '\\':
-	    if (*++yyp != '\\')
-	      goto do_not_strip_quotes;
-	    /* Fall through.  */
-	  default:
-	    if (yyres)
-	      yyres[yyn] = *yyp;
-	    yyn++;
-	    break;
-
-	  case '"':
-	    if (yyres)
-	      yyres[yyn] = '\0';
-	    return yyn;
-	  }
-    do_not_strip_quotes: ;
-    }
-
-  if (! yyres)
-    return yystrlen (yystr);
-
-  return yystpcpy (yyres, yystr) - yyres;
-}
-# endif
-
-/* Copy into YYRESULT an error message about the unexpected token
-   YYCHAR while in state YYSTATE.  Return the number of bytes copied,
-   including the terminating null byte.  If YYRESULT is null, do not
-   copy anything; just return the number of bytes that would be
-   copied.  As a special case, return 0 if an ordinary "syntax error"
-   message will do.  Return YYSIZE_MAXIMUM if overflow occurs during
-   size calculation.  */
-static YYSIZE_T
-yysyntax_error (char *yyresult, int yystate, int yychar)
-{
-  int yyn = yypact[yystate];
-
-  if (! (YYPACT_NINF < yyn && yyn <= YYLAST))
-    return 0;
-  else
-    {
-      int yytype = YYTRANSLATE (yychar);
-      YYSIZE_T yysize0 = yytnamerr (0, yytname[yytype]);
-      YYSIZE_T yysize = yysize0;
-      YYSIZE_T yysize1;
-      int yysize_overflow = 0;
-      enum { YYERROR_VERBOSE_ARGS_MAXIMUM = 5 };
-      char const *yyarg[YYERROR_VERBOSE_ARGS_MAXIMUM];
-      int yyx;
-
-# if 0
-      /* This is so xgettext sees the translatable formats that are
-	 constructed on the fly.  */
-      YY_("syntax error, unexpected %s");
-      YY_("syntax error, unexpected %s, expecting %s");
-      YY_("syntax error, unexpected %s, expecting %s or %s");
-      YY_("syntax error, unexpected %s, expecting %s or %s or %s");
-      YY_("syntax error, unexpected %s, expecting %s or %s or %s or %s");
-# endif
-      char *yyfmt;
-      char const *yyf;
-      static char const yyunexpected[] = "syntax error, unexpected %s";
-      static char const yyexpecting[] = ", expecting %s";
-      static char const yyor[] = " or %s";
-      char yyformat[sizeof yyunexpected
-		    + sizeof yyexpecting - 1
-		    + ((YYERROR_VERBOSE_ARGS_MAXIMUM - 2)
-		       * (sizeof yyor - 1))];
-      char const *yyprefix = yyexpecting;
-
-      /* Start YYX at -YYN if negative to avoid negative indexes in
-	 YYCHECK.  */
-      int yyxbegin = yyn < 0 ? -yyn : 0;
-
-      /* Stay within bounds of both yycheck and yytname.  */
-      int yychecklim = YYLAST - yyn + 1;
-      int yyxend = yychecklim < YYNTOKENS ? yychecklim : YYNTOKENS;
-      int yycount = 1;
-
-      yyarg[0] = yytname[yytype];
-      yyfmt = yystpcpy (yyformat, yyunexpected);
-
-      for (yyx = yyxbegin; yyx < yyxend; ++yyx)
-	if (yycheck[yyx + yyn] == yyx && yyx != YYTERROR)
-	  {
-	    if (yycount == YYERROR_VERBOSE_ARGS_MAXIMUM)
-	      {
-		yycount = 1;
-		yysize = yysize0;
-		yyformat[sizeof yyunexpected - 1] = '\0';
-		break;
-	      }
-	    yyarg[yycount++] = yytname[yyx];
-	    yysize1 = yysize + yytnamerr (0, yytname[yyx]);
-	    yysize_overflow |= (yysize1 < yysize);
-	    yysize = yysize1;
-	    yyfmt = yystpcpy (yyfmt, yyprefix);
-	    yyprefix = yyor;
-	  }
-
-      yyf = YY_(yyformat);
-      yysize1 = yysize + yystrlen (yyf);
-      yysize_overflow |= (yysize1 < yysize);
-      yysize = yysize1;
-
-      if (yysize_overflow)
-	return YYSIZE_MAXIMUM;
-
-      if (yyresult)
-	{
-	  /* Avoid sprintf, as that infringes on the user's name space.
-	     Don't have undefined behavior even if the translation
-	     produced a string with the wrong number of "%s"s.  */
-	  char *yyp = yyresult;
-	  int yyi = 0;
-	  while ((*yyp = *yyf) != '\0')
-	    {
-	      if (*yyp == '%' && yyf[1] == 's' && yyi < yycount)
-		{
-		  yyp += yytnamerr (yyp, yyarg[yyi++]);
-		  yyf += 2;
-		}
-	      else
-		{
-		  yyp++;
-		  yyf++;
-		}
-	    }
-	}
-      return yysize;
-    }
-}
-#endif /* YYERROR_VERBOSE */
-
 
 /*-----------------------------------------------.
 | Release the memory associated to this symbol.  |
 `-----------------------------------------------*/
 
-/*ARGSUSED*/
-#if (defined __STDC__ || defined __C99__FUNC__ \
-     || defined __cplusplus || defined _MSC_VER)
-static void
-yydestruct (const char *yymsg, int yytype, YYSTYPE *yyvaluep, const int source_id)
-#else
 static void
-yydestruct (yymsg, yytype, yyvaluep, source_id)
-    const char *yymsg;
-    int yytype;
-    YYSTYPE *yyvaluep;
-    const int source_id;
-#endif
+yydestruct (const char *yymsg,
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep, parser_ctx_t *ctx, void *scanner)
 {
-  YYUSE (yyvaluep);
-  YYUSE (source_id);
-
+  YY_USE (yyvaluep);
+  YY_USE (ctx);
+  YY_USE (scanner);
   if (!yymsg)
     yymsg = "Deleting";
-  YY_SYMBOL_PRINT (yymsg, yytype, yyvaluep, yylocationp);
+  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
 
-  switch (yytype)
-    {
-
-      default:
-	break;
-    }
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
 }
-
-
-/* Prevent warnings from -Wmissing-prototypes.  */
-
-#ifdef YYPARSE_PARAM
-#if defined __STDC__ || defined __cplusplus
-int yyparse (void *YYPARSE_PARAM);
-#else
-int yyparse ();
-#endif
-#else /* ! YYPARSE_PARAM */
-#if defined __STDC__ || defined __cplusplus
-int yyparse (const int source_id);
-#else
-int yyparse ();
-#endif
-#endif /* ! YYPARSE_PARAM */
-
 
 
-/* The look-ahead symbol.  */
-int yychar;
-
-/* The semantic value of the look-ahead symbol.  */
-YYSTYPE yylval;
 
-/* Number of syntax errors so far.  */
-int yynerrs;
 
 
 
@@ -1283,200 +1227,193 @@ int yynerrs;
 | yyparse.  |
 `----------*/
 
-#ifdef YYPARSE_PARAM
-#if (defined __STDC__ || defined __C99__FUNC__ \
-     || defined __cplusplus || defined _MSC_VER)
-int
-yyparse (void *YYPARSE_PARAM)
-#else
-int
-yyparse (YYPARSE_PARAM)
-    void *YYPARSE_PARAM;
-#endif
-#else /* ! YYPARSE_PARAM */
-#if (defined __STDC__ || defined __C99__FUNC__ \
-     || defined __cplusplus || defined _MSC_VER)
 int
-yyparse (const int source_id)
-#else
-int
-yyparse (source_id)
-    const int source_id;
-#endif
-#endif
+yyparse (parser_ctx_t *ctx, void *scanner)
 {
-  
-  int yystate;
-  int yyn;
-  int yyresult;
-  /* Number of tokens to shift before error messages enabled.  */
-  int yyerrstatus;
-  /* Look-ahead token as an internal (translated) token number.  */
-  int yytoken = 0;
-#if YYERROR_VERBOSE
-  /* Buffer for error messages, and its allocated size.  */
-  char yymsgbuf[128];
-  char *yymsg = yymsgbuf;
-  YYSIZE_T yymsg_alloc = sizeof yymsgbuf;
-#endif
+/* Lookahead token kind.  */
+int yychar;
 
-  /* Three stacks and their tools:
-     `yyss': related to states,
-     `yyvs': related to semantic values,
-     `yyls': related to locations.
 
-     Refer to the stacks thru separate pointers, to allow yyoverflow
-     to reallocate them elsewhere.  */
+/* The semantic value of the lookahead symbol.  */
+/* Default value used for initialization, for pacifying older GCCs
+   or non-GCC compilers.  */
+YY_INITIAL_VALUE (static YYSTYPE yyval_default;)
+YYSTYPE yylval YY_INITIAL_VALUE (= yyval_default);
 
-  /* The state stack.  */
-  yytype_int16 yyssa[YYINITDEPTH];
-  yytype_int16 *yyss = yyssa;
-  yytype_int16 *yyssp;
+    /* Number of syntax errors so far.  */
+    int yynerrs = 0;
 
-  /* The semantic value stack.  */
-  YYSTYPE yyvsa[YYINITDEPTH];
-  YYSTYPE *yyvs = yyvsa;
-  YYSTYPE *yyvsp;
+    yy_state_fast_t yystate = 0;
+    /* Number of tokens to shift before error messages enabled.  */
+    int yyerrstatus = 0;
 
+    /* Refer to the stacks through separate pointers, to allow yyoverflow
+       to reallocate them elsewhere.  */
 
+    /* Their size.  */
+    YYPTRDIFF_T yystacksize = YYINITDEPTH;
 
-#define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
+    /* The state stack: array, bottom, top.  */
+    yy_state_t yyssa[YYINITDEPTH];
+    yy_state_t *yyss = yyssa;
+    yy_state_t *yyssp = yyss;
 
-  YYSIZE_T yystacksize = YYINITDEPTH;
+    /* The semantic value stack: array, bottom, top.  */
+    YYSTYPE yyvsa[YYINITDEPTH];
+    YYSTYPE *yyvs = yyvsa;
+    YYSTYPE *yyvsp = yyvs;
 
+  int yyn;
+  /* The return value of yyparse.  */
+  int yyresult;
+  /* Lookahead symbol kind.  */
+  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
   /* The variables used to return semantic value and location from the
      action routines.  */
   YYSTYPE yyval;
 
 
+
+#define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
+
   /* The number of symbols on the RHS of the reduced rule.
      Keep to zero when no symbol should be popped.  */
   int yylen = 0;
 
   YYDPRINTF ((stderr, "Starting parse\n"));
 
-  yystate = 0;
-  yyerrstatus = 0;
-  yynerrs = 0;
-  yychar = YYEMPTY;		/* Cause a token to be read.  */
-
-  /* Initialize stack pointers.
-     Waste one element of value and location stack
-     so that they stay on the same level as the state stack.
-     The wasted elements are never initialized.  */
-
-  yyssp = yyss;
-  yyvsp = yyvs;
+  yychar = YYEMPTY; /* Cause a token to be read.  */
 
   goto yysetstate;
 
+
 /*------------------------------------------------------------.
-| yynewstate -- Push a new state, which is found in yystate.  |
+| yynewstate -- push a new state, which is found in yystate.  |
 `------------------------------------------------------------*/
- yynewstate:
+yynewstate:
   /* In all cases, when you get here, the value and location stacks
      have just been pushed.  So pushing a state here evens the stacks.  */
   yyssp++;
 
- yysetstate:
-  *yyssp = yystate;
+
+/*--------------------------------------------------------------------.
+| yysetstate -- set current state (the top of the stack) to yystate.  |
+`--------------------------------------------------------------------*/
+yysetstate:
+  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
+  YY_ASSERT (0 <= yystate && yystate < YYNSTATES);
+  YY_IGNORE_USELESS_CAST_BEGIN
+  *yyssp = YY_CAST (yy_state_t, yystate);
+  YY_IGNORE_USELESS_CAST_END
+  YY_STACK_PRINT (yyss, yyssp);
 
   if (yyss + yystacksize - 1 <= yyssp)
+#if !defined yyoverflow && !defined YYSTACK_RELOCATE
+    YYNOMEM;
+#else
     {
       /* Get the current used size of the three stacks, in elements.  */
-      YYSIZE_T yysize = yyssp - yyss + 1;
+      YYPTRDIFF_T yysize = yyssp - yyss + 1;
 
-#ifdef yyoverflow
+# if defined yyoverflow
       {
-	/* Give user a chance to reallocate the stack.  Use copies of
-	   these so that the &'s don't force the real ones into
-	   memory.  */
-	YYSTYPE *yyvs1 = yyvs;
-	yytype_int16 *yyss1 = yyss;
-
-
-	/* Each stack pointer address is followed by the size of the
-	   data in use in that stack, in bytes.  This used to be a
-	   conditional around just the two extra args, but that might
-	   be undefined if yyoverflow is a macro.  */
-	yyoverflow (YY_("memory exhausted"),
-		    &yyss1, yysize * sizeof (*yyssp),
-		    &yyvs1, yysize * sizeof (*yyvsp),
-
-		    &yystacksize);
-
-	yyss = yyss1;
-	yyvs = yyvs1;
+        /* Give user a chance to reallocate the stack.  Use copies of
+           these so that the &'s don't force the real ones into
+           memory.  */
+        yy_state_t *yyss1 = yyss;
+        YYSTYPE *yyvs1 = yyvs;
+
+        /* Each stack pointer address is followed by the size of the
+           data in use in that stack, in bytes.  This used to be a
+           conditional around just the two extra args, but that might
+           be undefined if yyoverflow is a macro.  */
+        yyoverflow (YY_("memory exhausted"),
+                    &yyss1, yysize * YYSIZEOF (*yyssp),
+                    &yyvs1, yysize * YYSIZEOF (*yyvsp),
+                    &yystacksize);
+        yyss = yyss1;
+        yyvs = yyvs1;
       }
-#else /* no yyoverflow */
-# ifndef YYSTACK_RELOCATE
-      goto yyexhaustedlab;
-# else
+# else /* defined YYSTACK_RELOCATE */
       /* Extend the stack our own way.  */
       if (YYMAXDEPTH <= yystacksize)
-	goto yyexhaustedlab;
+        YYNOMEM;
       yystacksize *= 2;
       if (YYMAXDEPTH < yystacksize)
-	yystacksize = YYMAXDEPTH;
+        yystacksize = YYMAXDEPTH;
 
       {
-	yytype_int16 *yyss1 = yyss;
-	union yyalloc *yyptr =
-	  (union yyalloc *) YYSTACK_ALLOC (YYSTACK_BYTES (yystacksize));
-	if (! yyptr)
-	  goto yyexhaustedlab;
-	YYSTACK_RELOCATE (yyss);
-	YYSTACK_RELOCATE (yyvs);
-
+        yy_state_t *yyss1 = yyss;
+        union yyalloc *yyptr =
+          YY_CAST (union yyalloc *,
+                   YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
+        if (! yyptr)
+          YYNOMEM;
+        YYSTACK_RELOCATE (yyss_alloc, yyss);
+        YYSTACK_RELOCATE (yyvs_alloc, yyvs);
 #  undef YYSTACK_RELOCATE
-	if (yyss1 != yyssa)
-	  YYSTACK_FREE (yyss1);
+        if (yyss1 != yyssa)
+          YYSTACK_FREE (yyss1);
       }
 # endif
-#endif /* no yyoverflow */
 
       yyssp = yyss + yysize - 1;
       yyvsp = yyvs + yysize - 1;
 
-
-      YYDPRINTF ((stderr, "Stack size increased to %lu\n",
-		  (unsigned long int) yystacksize));
+      YY_IGNORE_USELESS_CAST_BEGIN
+      YYDPRINTF ((stderr, "Stack size increased to %ld\n",
+                  YY_CAST (long, yystacksize)));
+      YY_IGNORE_USELESS_CAST_END
 
       if (yyss + yystacksize - 1 <= yyssp)
-	YYABORT;
+        YYABORT;
     }
+#endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
 
-  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
+
+  if (yystate == YYFINAL)
+    YYACCEPT;
 
   goto yybackup;
 
+
 /*-----------.
 | yybackup.  |
 `-----------*/
 yybackup:
-
   /* Do appropriate processing given the current state.  Read a
-     look-ahead token if we need one and don't already have one.  */
+     lookahead token if we need one and don't already have one.  */
 
-  /* First try to decide what to do without reference to look-ahead token.  */
+  /* First try to decide what to do without reference to lookahead token.  */
   yyn = yypact[yystate];
-  if (yyn == YYPACT_NINF)
+  if (yypact_value_is_default (yyn))
     goto yydefault;
 
-  /* Not known => get a look-ahead token if don't already have one.  */
+  /* Not known => get a lookahead token if don't already have one.  */
 
-  /* YYCHAR is either YYEMPTY or YYEOF or a valid look-ahead symbol.  */
+  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
   if (yychar == YYEMPTY)
     {
-      YYDPRINTF ((stderr, "Reading a token: "));
-      yychar = YYLEX;
+      YYDPRINTF ((stderr, "Reading a token\n"));
+      yychar = yylex (&yylval, scanner);
     }
 
   if (yychar <= YYEOF)
     {
-      yychar = yytoken = YYEOF;
+      yychar = YYEOF;
+      yytoken = YYSYMBOL_YYEOF;
       YYDPRINTF ((stderr, "Now at end of input.\n"));
     }
+  else if (yychar == YYerror)
+    {
+      /* The scanner already issued an error message, process directly
+         to error recovery.  But do not keep the error token as
+         lookahead, it is too special and may lead us to an endless
+         loop in error recovery. */
+      yychar = YYUNDEF;
+      yytoken = YYSYMBOL_YYerror;
+      goto yyerrlab1;
+    }
   else
     {
       yytoken = YYTRANSLATE (yychar);
@@ -1491,30 +1428,26 @@ yybackup:
   yyn = yytable[yyn];
   if (yyn <= 0)
     {
-      if (yyn == 0 || yyn == YYTABLE_NINF)
-	goto yyerrlab;
+      if (yytable_value_is_error (yyn))
+        goto yyerrlab;
       yyn = -yyn;
       goto yyreduce;
     }
 
-  if (yyn == YYFINAL)
-    YYACCEPT;
-
   /* Count tokens shifted since error; after three, turn off error
      status.  */
   if (yyerrstatus)
     yyerrstatus--;
 
-  /* Shift the look-ahead token.  */
+  /* Shift the lookahead token.  */
   YY_SYMBOL_PRINT ("Shifting", yytoken, &yylval, &yylloc);
-
-  /* Discard the shifted token unless it is eof.  */
-  if (yychar != YYEOF)
-    yychar = YYEMPTY;
-
   yystate = yyn;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
   *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
 
+  /* Discard the shifted token.  */
+  yychar = YYEMPTY;
   goto yynewstate;
 
 
@@ -1529,14 +1462,14 @@ yydefault:
 
 
 /*-----------------------------.
-| yyreduce -- Do a reduction.  |
+| yyreduce -- do a reduction.  |
 `-----------------------------*/
 yyreduce:
   /* yyn is the number of a rule to reduce with.  */
   yylen = yyr2[yyn];
 
   /* If YYLEN is nonzero, implement the default value of the action:
-     `$$ = $1'.
+     '$$ = $1'.
 
      Otherwise, the following line sets YYVAL to garbage.
      This behavior is undocumented and Bison
@@ -1549,262 +1482,234 @@ yyreduce:
   YY_REDUCE_PRINT (yyn);
   switch (yyn)
     {
-        case 6:
-#line 138 "attack_parser.y"
-    {
+  case 6: /* syslogent: SYSLOG_BANNER_PID logmsg  */
+#line 222 "attack_parser.y"
+                             {
                         /* reject to accept if the pid has been forged */
-                        if (procauth_isauthoritative(parsed_attack.service, (yyvsp[(1) - (2)].num)) == -1) {
+                        if (procauth_isauthoritative(ctx->attack.service, (yyvsp[-1].num)) == -1) {
                             /* forged */
-                            sshguard_log(LOG_NOTICE, "Ignore attack as pid '%d' has been forged for service %d.", (yyvsp[(1) - (2)].num), parsed_attack.service);
+                            sshguard_log(LOG_NOTICE, "Ignore attack as pid '%d' has been forged for service %d.", (yyvsp[-1].num), ctx->attack.service);
                             YYABORT;
                         }
                     }
+#line 1496 "attack_parser.c"
     break;
 
-  case 10:
-#line 163 "attack_parser.y"
-    {   parser_metadata.sources[parser_metadata.current_source_index].last_multiplicity = 1;    }
+  case 10: /* logmsg: msg_single  */
+#line 247 "attack_parser.y"
+                        {   ctx->current_source->last_multiplicity = 1;    }
+#line 1502 "attack_parser.c"
     break;
 
-  case 11:
-#line 165 "attack_parser.y"
-    {   parser_metadata.sources[parser_metadata.current_source_index].last_multiplicity = (yyvsp[(1) - (1)].num); }
+  case 11: /* logmsg: msg_multiple  */
+#line 249 "attack_parser.y"
+                        {   ctx->current_source->last_multiplicity = (yyvsp[0].num); }
+#line 1508 "attack_parser.c"
     break;
 
-  case 12:
-#line 169 "attack_parser.y"
-    {   parsed_attack.service = SERVICES_SSH; }
+  case 12: /* msg_single: sshmsg  */
+#line 253 "attack_parser.y"
+                        {   ctx->attack.service = SERVICES_SSH; }
+#line 1514 "attack_parser.c"
     break;
 
-  case 13:
-#line 170 "attack_parser.y"
-    {   parsed_attack.service = SERVICES_DOVECOT; }
+  case 13: /* msg_single: dovecotmsg  */
+#line 254 "attack_parser.y"
+                        {   ctx->attack.service = SERVICES_DOVECOT; }
+#line 1520 "attack_parser.c"
     break;
 
-  case 14:
-#line 171 "attack_parser.y"
-    {   parsed_attack.service = SERVICES_UWIMAP; }
+  case 14: /* msg_single: uwimapmsg  */
+#line 255 "attack_parser.y"
+                        {   ctx->attack.service = SERVICES_UWIMAP; }
+#line 1526 "attack_parser.c"
     break;
 
-  case 15:
-#line 172 "attack_parser.y"
-    {   parsed_attack.service = SERVICES_CYRUSIMAP; }
+  case 15: /* msg_single: cyrusimapmsg  */
+#line 256 "attack_parser.y"
+                        {   ctx->attack.service = SERVICES_CYRUSIMAP; }
+#line 1532 "attack_parser.c"
     break;
 
-  case 16:
-#line 173 "attack_parser.y"
-    {   parsed_attack.service = SERVICES_CUCIPOP; }
+  case 16: /* msg_single: cucipopmsg  */
+#line 257 "attack_parser.y"
+                        {   ctx->attack.service = SERVICES_CUCIPOP; }
+#line 1538 "attack_parser.c"
     break;
 
-  case 17:
-#line 174 "attack_parser.y"
-    {   parsed_attack.service = SERVICES_EXIM; }
+  case 17: /* msg_single: eximmsg  */
+#line 258 "attack_parser.y"
+                        {   ctx->attack.service = SERVICES_EXIM; }
+#line 1544 "attack_parser.c"
     break;
 
-  case 18:
-#line 175 "attack_parser.y"
-    {   parsed_attack.service = SERVICES_SENDMAIL; }
+  case 18: /* msg_single: sendmailmsg  */
+#line 259 "attack_parser.y"
+                        {   ctx->attack.service = SERVICES_SENDMAIL; }
+#line 1550 "attack_parser.c"
     break;
 
-  case 19:
-#line 176 "attack_parser.y"
-    {   parsed_attack.service = SERVICES_FREEBSDFTPD; }
+  case 19: /* msg_single: freebsdftpdmsg  */
+#line 260 "attack_parser.y"
+                        {   ctx->attack.service = SERVICES_FREEBSDFTPD; }
+#line 1556 "attack_parser.c"
     break;
 
-  case 20:
-#line 177 "attack_parser.y"
-    {   parsed_attack.service = SERVICES_PROFTPD; }
+  case 20: /* msg_single: proftpdmsg  */
+#line 261 "attack_parser.y"
+                        {   ctx->attack.service = SERVICES_PROFTPD; }
+#line 1562 "attack_parser.c"
     break;
 
-  case 21:
-#line 178 "attack_parser.y"
-    {   parsed_attack.service = SERVICES_PUREFTPD; }
+  case 21: /* msg_single: pureftpdmsg  */
+#line 262 "attack_parser.y"
+                        {   ctx->attack.service = SERVICES_PUREFTPD; }
+#line 1568 "attack_parser.c"
     break;
 
-  case 22:
-#line 179 "attack_parser.y"
-    {   parsed_attack.service = SERVICES_VSFTPD; }
+  case 22: /* msg_single: vsftpdmsg  */
+#line 263 "attack_parser.y"
+                        {   ctx->attack.service = SERVICES_VSFTPD; }
+#line 1574 "attack_parser.c"
     break;
 
-  case 23:
-#line 184 "attack_parser.y"
-    {
+  case 23: /* msg_multiple: LAST_LINE_REPEATED_N_TIMES  */
+#line 268 "attack_parser.y"
+                                   {
+                        /* the outcome depends on the message before */
+                        ctx->reusable = 0;
+
                         /* the message repeated, was it an attack? */
-                        if (! parser_metadata.sources[parser_metadata.current_source_index].last_was_recognized) {
+                        if (! ctx->current_source->last_was_recognized) {
                             /* make sure this doesn't get recognized as an attack */
                             YYABORT;
                         }
                         
                         /* got a repeated attack */
-                        parsed_attack = parser_metadata.sources[parser_metadata.current_source_index].last_attack;
+                        ctx->attack = ctx->current_source->last_attack;
+                        strcpy(ctx->pending_host, ctx->current_source->last_pending_host);
                         /* restore previous "genuine" dangerousness, and build new one */
-                        parsed_attack.dangerousness = (yyvsp[(1) - (1)].num) * (parsed_attack.dangerousness / parser_metadata.sources[parser_metadata.current_source_index].last_multiplicity);
+                        ctx->attack.dangerousness = (yyvsp[0].num) * (ctx->attack.dangerousness / ctx->current_source->last_multiplicity);
 
                         /* pass up the multiplicity of this attack */
-                        (yyval.num) = (yyvsp[(1) - (1)].num);
+                        (yyval.num) = (yyvsp[0].num);
                     }
+#line 1598 "attack_parser.c"
     break;
 
-  case 24:
-#line 203 "attack_parser.y"
-    {
-                        parsed_attack.address.kind = ADDRKIND_IPv4;
-                        strcpy(parsed_attack.address.value, (yyvsp[(1) - (1)].str));
+  case 24: /* addr: IPv4  */
+#line 291 "attack_parser.y"
+                    {
+                        ctx->attack.address.kind = ADDRKIND_IPv4;
+                        strcpy(ctx->attack.address.value, (yyvsp[0].str));
                     }
+#line 1607 "attack_parser.c"
     break;
 
-  case 25:
-#line 207 "attack_parser.y"
-    {
-                        parsed_attack.address.kind = ADDRKIND_IPv6;
-                        strcpy(parsed_attack.address.value, (yyvsp[(1) - (1)].str));
+  case 25: /* addr: IPv6  */
+#line 295 "attack_parser.y"
+                    {
+                        ctx->attack.address.kind = ADDRKIND_IPv6;
+                        strcpy(ctx->attack.address.value, (yyvsp[0].str));
                     }
+#line 1616 "attack_parser.c"
     break;
 
-  case 26:
-#line 211 "attack_parser.y"
-    {
-                        struct addrinfo addrinfo_hints;
-                        struct addrinfo *addrinfo_result;
-                        int res;
-
-                        /* look up IPv4 first */
-                        memset(& addrinfo_hints, 0x00, sizeof(addrinfo_hints));
-                        addrinfo_hints.ai_family = AF_INET;
-                        res = getaddrinfo((yyvsp[(1) - (1)].str), NULL, & addrinfo_hints, & addrinfo_result);
-                        if (res == 0) {
-                            struct sockaddr_in *foo4;
-                            /* pick the first (IPv4) result address and return */
-                            parsed_attack.address.kind = ADDRKIND_IPv4;
-                            foo4 = (struct sockaddr_in *)(addrinfo_result->ai_addr);
-                            if (inet_ntop(AF_INET, & foo4->sin_addr, parsed_attack.address.value, addrinfo_result->ai_addrlen) == NULL) {
-                                freeaddrinfo(addrinfo_result);
-                                sshguard_log(LOG_ERR, "Unable to interpret resolution result as IPv4 address: %s. Giving up entry.", strerror(errno));
+  case 26: /* addr: HOSTADDR  */
+#line 299 "attack_parser.y"
+                    {
+                        /* the outcome depends on what's known of the name */
+                        ctx->reusable = 0;
+                        switch (resolver_lookup((yyvsp[0].str), & ctx->attack.address)) {
+                            case 0:
+                                /* known already */
+                                break;
+                            case -1:
+                                sshguard_log(LOG_DEBUG, "Name '%s' is known not to resolve. Giving up entry.", (yyvsp[0].str));
                                 YYABORT;
-                            }
-                        } else {
-                            sshguard_log(LOG_DEBUG, "Failed to resolve '%s' @ IPv4! Trying IPv6.", (yyvsp[(1) - (1)].str));
-                            /* try IPv6 */
-                            addrinfo_hints.ai_family = AF_INET6;
-                            res = getaddrinfo((yyvsp[(1) - (1)].str), NULL, & addrinfo_hints, & addrinfo_result);
-                            if (res == 0) {
-                                struct sockaddr_in6 *foo6;
-                                /* pick the first (IPv6) result address and return */
-                                parsed_attack.address.kind = ADDRKIND_IPv6;
-                                foo6 = (struct sockaddr_in6 *)(addrinfo_result->ai_addr);
-                                if (inet_ntop(AF_INET6, & foo6->sin6_addr, parsed_attack.address.value, addrinfo_result->ai_addrlen) == NULL) {
-                                    sshguard_log(LOG_ERR, "Unable to interpret resolution result as IPv6 address: %s. Giving up entry.", strerror(errno));
-                                    freeaddrinfo(addrinfo_result);
+                            default:
+                                /* resolve once the whole attack is recognized */
+                                if (strlen((yyvsp[0].str)) >= sizeof(ctx->pending_host)) {
+                                    sshguard_log(LOG_ERR, "Host name too long to resolve: '%s'. Giving up entry.", (yyvsp[0].str));
                                     YYABORT;
                                 }
-                            } else {
-                                sshguard_log(LOG_ERR, "Could not resolv '%s' in neither of IPv{4,6}. Giving up entry.", (yyvsp[(1) - (1)].str));
-                                YYABORT;
-                            }
+                                strcpy(ctx->pending_host, (yyvsp[0].str));
                         }
-
-                        sshguard_log(LOG_INFO, "Successfully resolved '%s' --> %d:'%s'.",
-                                (yyvsp[(1) - (1)].str), parsed_attack.address.kind, parsed_attack.address.value);
-                        freeaddrinfo(addrinfo_result);
                     }
+#line 1640 "attack_parser.c"
     break;
 
 
-/* Line 1267 of yacc.c.  */
-#line 1715 "attack_parser.c"
+#line 1644 "attack_parser.c"
+
       default: break;
     }
-  YY_SYMBOL_PRINT ("-> $$ =", yyr1[yyn], &yyval, &yyloc);
+  /* User semantic actions sometimes alter yychar, and that requires
+     that yytoken be updated with the new translation.  We take the
+     approach of translating immediately before every use of yytoken.
+     One alternative is translating here after every semantic action,
+     but that translation would be missed if the semantic action invokes
+     YYABORT, YYACCEPT, or YYERROR immediately after altering yychar or
+     if it invokes YYBACKUP.  In the case of YYABORT or YYACCEPT, an
+     incorrect destructor might then be invoked immediately.  In the
+     case of YYERROR or YYBACKUP, subsequent parser actions might lead
+     to an incorrect destructor call or verbose syntax error message
+     before the lookahead is translated.  */
+  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
 
   YYPOPSTACK (yylen);
   yylen = 0;
-  YY_STACK_PRINT (yyss, yyssp);
 
   *++yyvsp = yyval;
 
-
-  /* Now `shift' the result of the reduction.  Determine what state
+  /* Now 'shift' the result of the reduction.  Determine what state
      that goes to, based on the state we popped back to and the rule
      number reduced by.  */
-
-  yyn = yyr1[yyn];
-
-  yystate = yypgoto[yyn - YYNTOKENS] + *yyssp;
-  if (0 <= yystate && yystate <= YYLAST && yycheck[yystate] == *yyssp)
-    yystate = yytable[yystate];
-  else
-    yystate = yydefgoto[yyn - YYNTOKENS];
+  {
+    const int yylhs = yyr1[yyn] - YYNTOKENS;
+    const int yyi = yypgoto[yylhs] + *yyssp;
+    yystate = (0 <= yyi && yyi <= YYLAST && yycheck[yyi] == *yyssp
+               ? yytable[yyi]
+               : yydefgoto[yylhs]);
+  }
 
   goto yynewstate;
 
 
-/*------------------------------------.
-| yyerrlab -- here on detecting error |
-`------------------------------------*/
+/*--------------------------------------.
+| yyerrlab -- here on detecting error.  |
+`--------------------------------------*/
 yyerrlab:
+  /* Make sure we have latest lookahead translation.  See comments at
+     user semantic actions for why this is necessary.  */
+  yytoken = yychar == YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
   /* If not already recovering from an error, report this error.  */
   if (!yyerrstatus)
     {
       ++yynerrs;
-#if ! YYERROR_VERBOSE
-      yyerror (source_id, YY_("syntax error"));
-#else
-      {
-	YYSIZE_T yysize = yysyntax_error (0, yystate, yychar);
-	if (yymsg_alloc < yysize && yymsg_alloc < YYSTACK_ALLOC_MAXIMUM)
-	  {
-	    YYSIZE_T yyalloc = 2 * yysize;
-	    if (! (yysize <= yyalloc && yyalloc <= YYSTACK_ALLOC_MAXIMUM))
-	      yyalloc = YYSTACK_ALLOC_MAXIMUM;
-	    if (yymsg != yymsgbuf)
-	      YYSTACK_FREE (yymsg);
-	    yymsg = (char *) YYSTACK_ALLOC (yyalloc);
-	    if (yymsg)
-	      yymsg_alloc = yyalloc;
-	    else
-	      {
-		yymsg = yymsgbuf;
-		yymsg_alloc = sizeof yymsgbuf;
-	      }
-	  }
-
-	if (0 < yysize && yysize <= yymsg_alloc)
-	  {
-	    (void) yysyntax_error (yymsg, yystate, yychar);
-	    yyerror (source_id, yymsg);
-	  }
-	else
-	  {
-	    yyerror (source_id, YY_("syntax error"));
-	    if (yysize != 0)
-	      goto yyexhaustedlab;
-	  }
-      }
-#endif
+      yyerror (ctx, scanner, YY_("syntax error"));
     }
 
-
-
   if (yyerrstatus == 3)
     {
-      /* If just tried and failed to reuse look-ahead token after an
-	 error, discard it.  */
+      /* If just tried and failed to reuse lookahead token after an
+         error, discard it.  */
 
       if (yychar <= YYEOF)
-	{
-	  /* Return failure if at end of input.  */
-	  if (yychar == YYEOF)
-	    YYABORT;
-	}
+        {
+          /* Return failure if at end of input.  */
+          if (yychar == YYEOF)
+            YYABORT;
+        }
       else
-	{
-	  yydestruct ("Error: discarding",
-		      yytoken, &yylval, source_id);
-	  yychar = YYEMPTY;
-	}
+        {
+          yydestruct ("Error: discarding",
+                      yytoken, &yylval, ctx, scanner);
+          yychar = YYEMPTY;
+        }
     }
 
-  /* Else will try to reuse look-ahead token after shifting the error
+  /* Else will try to reuse lookahead token after shifting the error
      token.  */
   goto yyerrlab1;
 
@@ -1813,14 +1718,13 @@ yyerrlab:
 | yyerrorlab -- error raised explicitly by YYERROR.  |
 `---------------------------------------------------*/
 yyerrorlab:
+  /* Pacify compilers when the user code never invokes YYERROR and the
+     label yyerrorlab therefore never appears in user code.  */
+  if (0)
+    YYERROR;
+  ++yynerrs;
 
-  /* Pacify compilers like GCC when the user code never invokes
-     YYERROR and the label yyerrorlab therefore never appears in user
-     code.  */
-  if (/*CONSTCOND*/ 0)
-     goto yyerrorlab;
-
-  /* Do not reclaim the symbols of the rule which action triggered
+  /* Do not reclaim the symbols of the rule whose action triggered
      this YYERROR.  */
   YYPOPSTACK (yylen);
   yylen = 0;
@@ -1833,42 +1737,42 @@ yyerrorlab:
 | yyerrlab1 -- common code for both syntax error and YYERROR.  |
 `-------------------------------------------------------------*/
 yyerrlab1:
-  yyerrstatus = 3;	/* Each real token shifted decrements this.  */
+  yyerrstatus = 3;      /* Each real token shifted decrements this.  */
 
+  /* Pop stack until we find a state that shifts the error token.  */
   for (;;)
     {
       yyn = yypact[yystate];
-      if (yyn != YYPACT_NINF)
-	{
-	  yyn += YYTERROR;
-	  if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYTERROR)
-	    {
-	      yyn = yytable[yyn];
-	      if (0 < yyn)
-		break;
-	    }
-	}
+      if (!yypact_value_is_default (yyn))
+        {
+          yyn += YYSYMBOL_YYerror;
+          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
+            {
+              yyn = yytable[yyn];
+              if (0 < yyn)
+                break;
+            }
+        }
 
       /* Pop the current state because it cannot handle the error token.  */
       if (yyssp == yyss)
-	YYABORT;
+        YYABORT;
 
 
       yydestruct ("Error: popping",
-		  yystos[yystate], yyvsp, source_id);
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp, ctx, scanner);
       YYPOPSTACK (1);
       yystate = *yyssp;
       YY_STACK_PRINT (yyss, yyssp);
     }
 
-  if (yyn == YYFINAL)
-    YYACCEPT;
-
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
   *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
 
 
   /* Shift the error token.  */
-  YY_SYMBOL_PRINT ("Shifting", yystos[yyn], yyvsp, yylsp);
+  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
 
   yystate = yyn;
   goto yynewstate;
@@ -1879,105 +1783,379 @@ yyerrlab1:
 `-------------------------------------*/
 yyacceptlab:
   yyresult = 0;
-  goto yyreturn;
+  goto yyreturnlab;
+
 
 /*-----------------------------------.
 | yyabortlab -- YYABORT comes here.  |
 `-----------------------------------*/
 yyabortlab:
   yyresult = 1;
-  goto yyreturn;
+  goto yyreturnlab;
 
-#ifndef yyoverflow
-/*-------------------------------------------------.
-| yyexhaustedlab -- memory exhaustion comes here.  |
-`-------------------------------------------------*/
+
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
 yyexhaustedlab:
-  yyerror (source_id, YY_("memory exhausted"));
+  yyerror (ctx, scanner, YY_("memory exhausted"));
   yyresult = 2;
-  /* Fall through.  */
-#endif
+  goto yyreturnlab;
 
-yyreturn:
-  if (yychar != YYEOF && yychar != YYEMPTY)
-     yydestruct ("Cleanup: discarding lookahead",
-		 yytoken, &yylval, source_id);
-  /* Do not reclaim the symbols of the rule which action triggered
+
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
+  if (yychar != YYEMPTY)
+    {
+      /* Make sure we have latest lookahead translation.  See comments at
+         user semantic actions for why this is necessary.  */
+      yytoken = YYTRANSLATE (yychar);
+      yydestruct ("Cleanup: discarding lookahead",
+                  yytoken, &yylval, ctx, scanner);
+    }
+  /* Do not reclaim the symbols of the rule whose action triggered
      this YYABORT or YYACCEPT.  */
   YYPOPSTACK (yylen);
   YY_STACK_PRINT (yyss, yyssp);
   while (yyssp != yyss)
     {
       yydestruct ("Cleanup: popping",
-		  yystos[*yyssp], yyvsp, source_id);
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp, ctx, scanner);
       YYPOPSTACK (1);
     }
 #ifndef yyoverflow
   if (yyss != yyssa)
     YYSTACK_FREE (yyss);
 #endif
-#if YYERROR_VERBOSE
-  if (yymsg != yymsgbuf)
-    YYSTACK_FREE (yymsg);
+
+  return yyresult;
+}
+
+#line 405 "attack_parser.y"
+
+
+static void yyerror(parser_ctx_t *ctx, void *scanner, const char *msg) {
+    /* do nothing */
+    (void)ctx;
+    (void)scanner;
+    (void)msg;
+}
+
+parser_ctx_t *parser_ctx_new(void) {
+    parser_ctx_t *ctx;
+#ifdef SERVICE_SCANNERS
+    unsigned int f;
+#endif
+
+    ctx = (parser_ctx_t *)malloc(sizeof(parser_ctx_t));
+    if (ctx == NULL) return NULL;
+    memset(ctx, 0x00, sizeof(parser_ctx_t));
+
+#if YYDEBUG
+    ctx->scanner = scanner_new(yydebug);
+#else
+    ctx->scanner = scanner_new(0);
+#endif
+    if (ctx->scanner == NULL) {
+        free(ctx);
+        return NULL;
+    }
+#ifdef SERVICE_SCANNERS
+    for (f = 0; f < PARSER_SCANNER_FAMILIES; ++f) {
+#if YYDEBUG
+        ctx->family_scanners[f] = scanner_families[f].scanner_new(yydebug);
+#else
+        ctx->family_scanners[f] = scanner_families[f].scanner_new(0);
+#endif
+        if (ctx->family_scanners[f] == NULL) {
+            parser_ctx_free(ctx);
+            return NULL;
+        }
+    }
 #endif
-  /* Make sure YYID is used.  */
-  return YYID (yyresult);
+
+    /* if this fails, lines just all go to the scanner */
+    prefilter_init();
+
+    return ctx;
 }
 
+void parser_ctx_set_resolved(parser_ctx_t *ctx, resolver_done_t resolved) {
+    ctx->resolved = resolved;
+}
 
-#line 342 "attack_parser.y"
+void parser_ctx_get_stats(const parser_ctx_t *ctx, unsigned long *lookups, unsigned long *hits) {
+    *lookups = ctx->recent_lookups;
+    *hits = ctx->recent_hits;
+}
 
+void parser_ctx_free(parser_ctx_t *ctx) {
+    source_metadata_t *cursource, *next;
+    int i;
 
-static void yyerror(int source_id, const char *msg) { /* do nothing */ }
+    for (i = 0; i < PARSER_SOURCES_BUCKETS; ++i) {
+        for (cursource = ctx->sources[i]; cursource != NULL; cursource = next) {
+            next = cursource->next;
+            free(cursource);
+        }
+    }
+    scanner_free(ctx->scanner);
+    signatures_cache_free(ctx->signatures);
+#ifdef SERVICE_SCANNERS
+    for (i = 0; i < (int)PARSER_SCANNER_FAMILIES; ++i) {
+        if (ctx->family_scanners[i] != NULL)
+            scanner_families[i].scanner_free(ctx->family_scanners[i]);
+    }
+#endif
+    free(ctx);
+}
 
-static void init_structures(int source_id) {
-    int cnt;
+static void init_structures(parser_ctx_t *ctx, int source_id) {
+    source_metadata_t *cursource;
+    source_metadata_t **bucket;
 
     /* add metadata for this source, if new */
-    for (cnt = 0; cnt < parser_metadata.num_sources; ++cnt) {
-        if (parser_metadata.sources[cnt].id == source_id) break;
+    bucket = & ctx->sources[(sourceid_t)source_id % PARSER_SOURCES_BUCKETS];
+    for (cursource = *bucket; cursource != NULL; cursource = cursource->next) {
+        if (cursource->id == (sourceid_t)source_id) break;
     }
-    if (cnt == parser_metadata.num_sources) {
+    if (cursource == NULL) {
         /* new source! */
-        assert(cnt < MAX_FILES_POLLED);
-        parser_metadata.sources[cnt].id = source_id;
-        parser_metadata.sources[cnt].last_was_recognized = 0;
-        parser_metadata.sources[cnt].last_multiplicity = 1;
-
-        parser_metadata.num_sources++;
+        cursource = (source_metadata_t *)malloc(sizeof(source_metadata_t));
+        assert(cursource != NULL);
+        cursource->id = source_id;
+        cursource->last_was_recognized = 0;
+        cursource->last_multiplicity = 1;
+        cursource->last_pending_host[0] = '\0';
+        memset(cursource->recent, 0x00, sizeof(cursource->recent));
+        cursource->recent_next = 0;
+
+        cursource->next = *bucket;
+        *bucket = cursource;
     }
     
     /* initialize the attack structure */
-    parsed_attack.dangerousness = DEFAULT_ATTACKS_DANGEROUSNESS;
+    ctx->attack.dangerousness = DEFAULT_ATTACKS_DANGEROUSNESS;
+    ctx->pending_host[0] = '\0';
 
-    /* set current source index */
-    parser_metadata.current_source_index = cnt;
+    /* set current source */
+    ctx->current_source = cursource;
 }
 
-int parse_line(int source_id, char *str) {
+void parse_forget_source(parser_ctx_t *ctx, int source_id) {
+    source_metadata_t *cursource;
+    source_metadata_t **prev;
+
+    prev = & ctx->sources[(sourceid_t)source_id % PARSER_SOURCES_BUCKETS];
+    for (cursource = *prev; cursource != NULL; prev = & cursource->next, cursource = cursource->next) {
+        if (cursource->id != (sourceid_t)source_id) continue;
+
+        *prev = cursource->next;
+        if (ctx->current_source == cursource)
+            ctx->current_source = NULL;
+        free(cursource);
+        return;
+    }
+}
+
+/* run the scanner and grammar on str logged by program (NULL if unknown), and
+ * remember the outcome for source_id */
+static int parse_text(parser_ctx_t *ctx, int source_id, char *str, const char *program, size_t programlen, attack_t *attack) {
     int ret;
+    size_t len;
+    Fnv32_t hash;
+    recent_message_t *recent;
 
     /* initialize parser structures */
-    init_structures(source_id);
-
-    /* initialize scanner, do parse, finalize scanner */
-    scanner_init(str);
-    ret = yyparse(source_id);
-    scanner_fin();
+    init_structures(ctx, source_id);
+
+    if (signatures_match(& ctx->signatures, str, & ctx->attack, ctx->pending_host, sizeof(ctx->pending_host)) == 0) {
+        /* user signatures come first, and describe single attacks */
+        ctx->current_source->last_multiplicity = 1;
+        ret = 0;
+    } else if (! prefilter_candidate(str, program, programlen)) {
+        /* most lines are no attack: spare the scanner those that surely aren't */
+        ctx->current_source->last_was_recognized = 0;
+        return 1;
+    } else {
+        len = strlen(str);
+        hash = (len < PARSER_RECENT_MAXLEN) ? fnv_32a_str(str, FNV1_32A_INIT) : 0;
+        recent = recent_find(ctx, str, len, hash, program, programlen);
+        if (recent != NULL) {
+            /* floods repeat the same message: no need to parse it again */
+            ret = recent->result;
+            if (ret == 0) {
+                ctx->attack = recent->attack;
+                ctx->current_source->last_multiplicity = 1;
+            }
+        } else {
+            /* copy the message before the scanner alters it */
+            recent = recent_reserve(ctx, str, len, hash, program, programlen);
+
+            /* the scanner works on str itself, which flex wants ended by two NULs */
+            str[len + 1] = '\0';
+
+            /* point scanner to the line, do parse */
+            ctx->reusable = 1;
+            ret = yyparse(ctx, line_scanner(ctx, str, len, program, programlen));
+            if (recent != NULL && ctx->reusable) {
+                recent->result = ret;
+                recent->attack = ctx->attack;
+                recent->len = len;
+            }
+        }
+    }
 
     /* do post-parsing oeprations */
     if (ret == 0) {
         /* message recognized */
         /* update metadata on this source */
-        parser_metadata.sources[parser_metadata.current_source_index].last_was_recognized = 1;
-        parser_metadata.sources[parser_metadata.current_source_index].last_attack = parsed_attack;
+        ctx->current_source->last_was_recognized = 1;
+        ctx->current_source->last_attack = ctx->attack;
+        strcpy(ctx->current_source->last_pending_host, ctx->pending_host);
+        *attack = ctx->attack;
     } else {
         /* message not recognized */
-        parser_metadata.sources[parser_metadata.current_source_index].last_was_recognized = 0;
+        ctx->current_source->last_was_recognized = 0;
     }
 
     return ret;
 }
 
+/* get the scanner for str logged by program (NULL if unknown), pointed to str */
+static void *line_scanner(parser_ctx_t *ctx, char *str, size_t len, const char *program, size_t programlen) {
+#ifdef SERVICE_SCANNERS
+    const int *services;
+    unsigned int f, i;
+
+    /* the scanner of the family running all the services of program, if any */
+    services = (program != NULL ? prefilter_program_services(program, programlen) : NULL);
+    for (f = 0; services != NULL && f < PARSER_SCANNER_FAMILIES; ++f) {
+        for (i = 0; i < PREFILTER_MAX_PROGRAM_SERVICES && services[i] != 0; ++i) {
+            if (services[i] < scanner_families[f].first_service || services[i] > scanner_families[f].last_service) break;
+        }
+        if (i == PREFILTER_MAX_PROGRAM_SERVICES || services[i] == 0) {
+            scanner_families[f].scanner_init(ctx->family_scanners[f], str, len);
+            ctx->lex = scanner_families[f].lex;
+            return ctx->family_scanners[f];
+        }
+    }
+    ctx->lex = any_lex;
+#else
+    (void)program;
+    (void)programlen;
+#endif
+
+    scanner_init(ctx->scanner, str, len);
+    return ctx->scanner;
+}
+
+/* find a message among the recent ones of the current source */
+static recent_message_t *recent_find(parser_ctx_t *ctx, const char *str, size_t len, Fnv32_t hash, const char *program, size_t programlen) {
+    recent_message_t *recent;
+    int i;
+
+    if (len == 0 || len >= PARSER_RECENT_MAXLEN) return NULL;
+
+    ++ctx->recent_lookups;
+    for (i = 0; i < PARSER_RECENT_SLOTS; ++i) {
+        recent = & ctx->current_source->recent[i];
+        if (recent->hash == hash && recent->len == len && recent->programlen == programlen
+                && memcmp(recent->message, str, len) == 0
+                && (programlen == 0 || memcmp(recent->program, program, programlen) == 0)) {
+            ++ctx->recent_hits;
+            return recent;
+        }
+    }
+
+    return NULL;
+}
+
+/* take a slot for remembering a message of the current source, valid once
+ * its len is set. NULL if the message is too long to remember */
+static recent_message_t *recent_reserve(parser_ctx_t *ctx, const char *str, size_t len, Fnv32_t hash, const char *program, size_t programlen) {
+    source_metadata_t *cursource = ctx->current_source;
+    recent_message_t *recent;
+
+    if (len >= PARSER_RECENT_MAXLEN || programlen >= PARSER_RECENT_PROGLEN) return NULL;
+
+    /* replace the oldest */
+    recent = & cursource->recent[cursource->recent_next];
+    cursource->recent_next = (cursource->recent_next + 1) % PARSER_RECENT_SLOTS;
+
+    recent->hash = hash;
+    recent->len = 0;
+    memcpy(recent->message, str, len);
+    recent->programlen = programlen;
+    if (programlen > 0) memcpy(recent->program, program, programlen);
+
+    return recent;
+}
+
+/* give attack its address, if its host name is still to resolve. 0 if it has one */
+static int settle_address(parser_ctx_t *ctx, attack_t *attack) {
+    if (ctx->pending_host[0] == '\0') return 0;
+
+    /* the attack is decided when the name resolves */
+    if (ctx->resolved != NULL && resolver_submit(ctx->pending_host, attack, ctx->resolved) == 0) {
+        sshguard_log(LOG_DEBUG, "Attack from '%s' waits for the name to resolve.", ctx->pending_host);
+        return 1;
+    }
+
+    return (resolver_resolve(ctx->pending_host, & attack->address) == 0) ? 0 : -1;
+}
+
+/* parse a message logged by program[pid] (NULL and 0 if unknown) */
+static int parse_payload(parser_ctx_t *ctx, int source_id, char *str, const char *program, size_t programlen, pid_t pid, attack_t *attack) {
+    int ret;
 
+    ret = parse_text(ctx, source_id, str, program, programlen, attack);
 
+    /* reject to accept if the pid has been forged, as for syslog banners */
+    if (ret == 0 && pid > 0 && procauth_isauthoritative(attack->service, pid) == -1) {
+        sshguard_log(LOG_NOTICE, "Ignore attack as pid '%d' has been forged for service %d.", (int)pid, attack->service);
+        ctx->current_source->last_was_recognized = 0;
+        return -1;
+    }
+
+    return (ret == 0) ? settle_address(ctx, attack) : ret;
+}
+
+int parse_line(parser_ctx_t *ctx, int source_id, char *str, attack_t *attack) {
+    log_banner_t banner;
+    int ret;
+
+    /* split the banner by hand, so that the grammar only gets the message */
+    if (banner_split(str, & banner) == 0) {
+        if (banner_is_self(& banner)) {
+            /* our own messages are never attacks */
+            init_structures(ctx, source_id);
+            ctx->current_source->last_was_recognized = 0;
+            return 1;
+        }
+        return parse_payload(ctx, source_id, str + (banner.message - str), banner.program, banner.programlen, banner.pid, attack);
+    }
+
+    /* unusual banner, or none: the grammar knows the common ones too */
+    str += banner_skip_priority(str) - str;
+    ret = parse_text(ctx, source_id, str, NULL, 0, attack);
+    return (ret == 0) ? settle_address(ctx, attack) : ret;
+}
+
+void parse_skip_line(parser_ctx_t *ctx, int source_id) {
+    init_structures(ctx, source_id);
+    ctx->current_source->last_was_recognized = 0;
+}
+
+int parse_message(parser_ctx_t *ctx, int source_id, char *str, const char *program, size_t programlen, pid_t pid, attack_t *attack) {
+    if (program != NULL && banner_program_is_self(program, programlen)) {
+        /* our own messages are never attacks */
+        parse_skip_line(ctx, source_id);
+        return 1;
+    }
+
+    /* no banner: the grammar takes bare messages as they are */
+    return parse_payload(ctx, source_id, str, program, programlen, pid, attack);
+}
@@ -1,14 +1,14 @@
-/* A Bison parser, made by GNU Bison 2.3.  */
+/* A Bison parser, made by GNU Bison 3.8.2.  */
 
-/* Skeleton interface for Bison's Yacc-like parsers in C
+/* Bison interface for Yacc-like parsers in C
 
-   Copyright (C) 1984, 1989, 1990, 2000, 2001, 2002, 2003, 2004, 2005, 2006
-   Free Software Foundation, Inc.
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
 
-   This program is free software; you can redistribute it and/or modify
+   This program is free software: you can redistribute it and/or modify
    it under the terms of the GNU General Public License as published by
-   the Free Software Foundation; either version 2, or (at your option)
-   any later version.
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
 
    This program is distributed in the hope that it will be useful,
    but WITHOUT ANY WARRANTY; without even the implied warranty of
@@ -16,9 +16,7 @@
    GNU General Public License for more details.
 
    You should have received a copy of the GNU General Public License
-   along with this program; if not, write to the Free Software
-   Foundation, Inc., 51 Franklin Street, Fifth Floor,
-   Boston, MA 02110-1301, USA.  */
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
 
 /* As a special exception, you may create a larger work that contains
    part or all of the Bison parser skeleton and distribute that work
@@ -33,55 +31,77 @@
    This special exception was added by the Free Software Foundation in
    version 2.2 of Bison.  */
 
-/* Tokens.  */
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
+#ifndef YY_YY_ATTACK_PARSER_H_INCLUDED
+# define YY_YY_ATTACK_PARSER_H_INCLUDED
+/* Debug traces.  */
+#ifndef YYDEBUG
+# define YYDEBUG 0
+#endif
+#if YYDEBUG
+extern int yydebug;
+#endif
+
+/* Token kinds.  */
 #ifndef YYTOKENTYPE
 # define YYTOKENTYPE
-   /* Put the tokens into the symbol table, so that GDB and other debuggers
-      know about them.  */
-   enum yytokentype {
-     IPv4 = 258,
-     IPv6 = 259,
-     HOSTADDR = 260,
-     WORD = 261,
-     INTEGER = 262,
-     SYSLOG_BANNER_PID = 263,
-     LAST_LINE_REPEATED_N_TIMES = 264,
-     SYSLOG_BANNER = 265,
-     TIMESTAMP_SYSLOG = 266,
-     TIMESTAMP_TAI64 = 267,
-     AT_TIMESTAMP_TAI64 = 268,
-     METALOG_BANNER = 269,
-     SSH_INVALUSERPREF = 270,
-     SSH_NOTALLOWEDPREF = 271,
-     SSH_NOTALLOWEDSUFF = 272,
-     SSH_LOGINERR_PREF = 273,
-     SSH_LOGINERR_SUFF = 274,
-     SSH_LOGINERR_PAM = 275,
-     SSH_REVERSEMAP_PREF = 276,
-     SSH_REVERSEMAP_SUFF = 277,
-     SSH_NOIDENTIFSTR = 278,
-     SSH_BADPROTOCOLIDENTIF = 279,
-     DOVECOT_IMAP_LOGINERR_PREF = 280,
-     DOVECOT_IMAP_LOGINERR_SUFF = 281,
-     UWIMAP_LOGINERR = 282,
-     CYRUSIMAP_SASL_LOGINERR_PREF = 283,
-     CYRUSIMAP_SASL_LOGINERR_SUFF = 284,
-     CUCIPOP_AUTHFAIL = 285,
-     EXIM_ESMTP_AUTHFAIL_PREF = 286,
-     EXIM_ESMTP_AUTHFAIL_SUFF = 287,
-     SENDMAIL_RELAYDENIED_PREF = 288,
-     SENDMAIL_RELAYDENIED_SUFF = 289,
-     FREEBSDFTPD_LOGINERR_PREF = 290,
-     FREEBSDFTPD_LOGINERR_SUFF = 291,
-     PROFTPD_LOGINERR_PREF = 292,
-     PROFTPD_LOGINERR_SUFF = 293,
-     PUREFTPD_LOGINERR_PREF = 294,
-     PUREFTPD_LOGINERR_SUFF = 295,
-     VSFTPD_LOGINERR_PREF = 296,
-     VSFTPD_LOGINERR_SUFF = 297
-   };
+  enum yytokentype
+  {
+    YYEMPTY = -2,
+    YYEOF = 0,                     /* "end of file"  */
+    YYerror = 256,                 /* error  */
+    YYUNDEF = 257,                 /* "invalid token"  */
+    IPv4 = 258,                    /* IPv4  */
+    IPv6 = 259,                    /* IPv6  */
+    HOSTADDR = 260,                /* HOSTADDR  */
+    WORD = 261,                    /* WORD  */
+    INTEGER = 262,                 /* INTEGER  */
+    SYSLOG_BANNER_PID = 263,       /* SYSLOG_BANNER_PID  */
+    LAST_LINE_REPEATED_N_TIMES = 264, /* LAST_LINE_REPEATED_N_TIMES  */
+    SYSLOG_BANNER = 265,           /* SYSLOG_BANNER  */
+    TIMESTAMP_SYSLOG = 266,        /* TIMESTAMP_SYSLOG  */
+    TIMESTAMP_TAI64 = 267,         /* TIMESTAMP_TAI64  */
+    AT_TIMESTAMP_TAI64 = 268,      /* AT_TIMESTAMP_TAI64  */
+    METALOG_BANNER = 269,          /* METALOG_BANNER  */
+    SSH_INVALUSERPREF = 270,       /* SSH_INVALUSERPREF  */
+    SSH_NOTALLOWEDPREF = 271,      /* SSH_NOTALLOWEDPREF  */
+    SSH_NOTALLOWEDSUFF = 272,      /* SSH_NOTALLOWEDSUFF  */
+    SSH_LOGINERR_PREF = 273,       /* SSH_LOGINERR_PREF  */
+    SSH_LOGINERR_SUFF = 274,       /* SSH_LOGINERR_SUFF  */
+    SSH_LOGINERR_PAM = 275,        /* SSH_LOGINERR_PAM  */
+    SSH_REVERSEMAP_PREF = 276,     /* SSH_REVERSEMAP_PREF  */
+    SSH_REVERSEMAP_SUFF = 277,     /* SSH_REVERSEMAP_SUFF  */
+    SSH_NOIDENTIFSTR = 278,        /* SSH_NOIDENTIFSTR  */
+    SSH_BADPROTOCOLIDENTIF = 279,  /* SSH_BADPROTOCOLIDENTIF  */
+    DOVECOT_IMAP_LOGINERR_PREF = 280, /* DOVECOT_IMAP_LOGINERR_PREF  */
+    DOVECOT_IMAP_LOGINERR_SUFF = 281, /* DOVECOT_IMAP_LOGINERR_SUFF  */
+    UWIMAP_LOGINERR = 282,         /* UWIMAP_LOGINERR  */
+    CYRUSIMAP_SASL_LOGINERR_PREF = 283, /* CYRUSIMAP_SASL_LOGINERR_PREF  */
+    CYRUSIMAP_SASL_LOGINERR_SUFF = 284, /* CYRUSIMAP_SASL_LOGINERR_SUFF  */
+    CUCIPOP_AUTHFAIL = 285,        /* CUCIPOP_AUTHFAIL  */
+    EXIM_ESMTP_AUTHFAIL_PREF = 286, /* EXIM_ESMTP_AUTHFAIL_PREF  */
+    EXIM_ESMTP_AUTHFAIL_SUFF = 287, /* EXIM_ESMTP_AUTHFAIL_SUFF  */
+    SENDMAIL_RELAYDENIED_PREF = 288, /* SENDMAIL_RELAYDENIED_PREF  */
+    SENDMAIL_RELAYDENIED_SUFF = 289, /* SENDMAIL_RELAYDENIED_SUFF  */
+    FREEBSDFTPD_LOGINERR_PREF = 290, /* FREEBSDFTPD_LOGINERR_PREF  */
+    FREEBSDFTPD_LOGINERR_SUFF = 291, /* FREEBSDFTPD_LOGINERR_SUFF  */
+    PROFTPD_LOGINERR_PREF = 292,   /* PROFTPD_LOGINERR_PREF  */
+    PROFTPD_LOGINERR_SUFF = 293,   /* PROFTPD_LOGINERR_SUFF  */
+    PUREFTPD_LOGINERR_PREF = 294,  /* PUREFTPD_LOGINERR_PREF  */
+    PUREFTPD_LOGINERR_SUFF = 295,  /* PUREFTPD_LOGINERR_SUFF  */
+    VSFTPD_LOGINERR_PREF = 296,    /* VSFTPD_LOGINERR_PREF  */
+    VSFTPD_LOGINERR_SUFF = 297     /* VSFTPD_LOGINERR_SUFF  */
+  };
+  typedef enum yytokentype yytoken_kind_t;
 #endif
-/* Tokens.  */
+/* Token kinds.  */
+#define YYEMPTY -2
+#define YYEOF 0
+#define YYerror 256
+#define YYUNDEF 257
 #define IPv4 258
 #define IPv6 259
 #define HOSTADDR 260
@@ -123,23 +143,27 @@
 #define VSFTPD_LOGINERR_PREF 296
 #define VSFTPD_LOGINERR_SUFF 297
 
-
-
-
+/* Value type.  */
 #if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
-typedef union YYSTYPE
-#line 78 "attack_parser.y"
+union YYSTYPE
 {
+#line 162 "attack_parser.y"
+
     char *str;
     int num;
-}
-/* Line 1529 of yacc.c.  */
-#line 138 "attack_parser.h"
-	YYSTYPE;
-# define yystype YYSTYPE /* obsolescent; will be withdrawn */
-# define YYSTYPE_IS_DECLARED 1
+
+#line 156 "attack_parser.h"
+
+};
+typedef union YYSTYPE YYSTYPE;
 # define YYSTYPE_IS_TRIVIAL 1
+# define YYSTYPE_IS_DECLARED 1
 #endif
 
-extern YYSTYPE yylval;
 
+
+
+int yyparse (parser_ctx_t *ctx, void *scanner);
+
+
+#endif /* !YY_YY_ATTACK_PARSER_H_INCLUDED  */
@@ -37,42 +37,126 @@
 #include "../sshguard_log.h"
 #include "../sshguard_procauth.h"
 #include "../sshguard_logsuck.h"
+#include "../sshguard_prefilter.h"
+#include "../sshguard_banner.h"
+#include "../sshguard_resolver.h"
+#include "../sshguard_signatures.h"
+#include "../fnv.h"
 
- /* get to know MAX_FILES_POLLED */
+ /* get to know DEFAULT_ATTACKS_DANGEROUSNESS */
 #include "../sshguard.h"
 
 #include "../parser.h"
 
  /* stuff exported by the scanner */
-extern void scanner_init();
-extern void scanner_fin();
+extern void *scanner_new(int debugging);
+extern void scanner_free(void *scanner);
+extern void scanner_init(void *scanner, char *str, size_t len);
 extern int yylex();
 
+#ifdef SERVICE_SCANNERS
+ /* scanners with the rules of one family of services each, made of
+  * attack_scanner.l (see attack_scanner_family.awk) */
+extern void *scanner_login_new(int debugging);
+extern void scanner_login_free(void *scanner);
+extern void scanner_login_init(void *scanner, char *str, size_t len);
+extern int login_yylex();
+extern void *scanner_mail_new(int debugging);
+extern void scanner_mail_free(void *scanner);
+extern void scanner_mail_init(void *scanner, char *str, size_t len);
+extern int mail_yylex();
+extern void *scanner_ftp_new(int debugging);
+extern void scanner_ftp_free(void *scanner);
+extern void scanner_ftp_init(void *scanner, char *str, size_t len);
+extern int ftp_yylex();
+
+ /* lines of programs running services of one family only go to its scanner */
+static const struct {
+    int first_service, last_service;            /* services of the family, see sshguard_services.h */
+    void *(*scanner_new)(int debugging);
+    void (*scanner_free)(void *scanner);
+    void (*scanner_init)(void *scanner, char *str, size_t len);
+    int (*lex)();
+} scanner_families[] = {
+    { SERVICES_SSH,         SERVICES_SSH,       scanner_login_new,  scanner_login_free, scanner_login_init, login_yylex },
+    { SERVICES_UWIMAP,      SERVICES_SENDMAIL,  scanner_mail_new,   scanner_mail_free,  scanner_mail_init,  mail_yylex },
+    { SERVICES_FREEBSDFTPD, SERVICES_VSFTPD,    scanner_ftp_new,    scanner_ftp_free,   scanner_ftp_init,   ftp_yylex }
+};
+#define PARSER_SCANNER_FAMILIES     (sizeof(scanner_families) / sizeof(scanner_families[0]))
+
+ /* the scanner for lines of any program */
+static int (*const any_lex)() = yylex;
+
+ /* the grammar takes its tokens from the scanner chosen for the line */
+#define yylex   (*ctx->lex)
+#endif
+
  /* my function for reporting parse errors */
-static void yyerror(int source_id, const char *msg);
+static void yyerror(parser_ctx_t *ctx, void *scanner, const char *msg);
 
  /* Metadata used by the parser */
- /* per-source metadata */
+ /* messages remembered per source, for answering repetitions without parsing */
+#define PARSER_RECENT_SLOTS         8
+ /* longest message, and program name, remembered */
+#define PARSER_RECENT_MAXLEN        256
+#define PARSER_RECENT_PROGLEN       32
+
+ /* a message lately parsed, and its outcome */
 typedef struct {
+    Fnv32_t hash;
+    size_t len;                                 /* length of message; 0 if the slot is free */
+    char message[PARSER_RECENT_MAXLEN];
+    size_t programlen;
+    char program[PARSER_RECENT_PROGLEN];        /* program that logged it, as it affects parsing */
+    int result;                                 /* what parsing returned */
+    attack_t attack;                            /* if recognized */
+} recent_message_t;
+
+ /* per-source metadata */
+typedef struct source_metadata {
     sourceid_t id;
     int last_was_recognized;
     attack_t last_attack;
+    char last_pending_host[RESOLVER_MAX_NAMELEN];   /* host name of last_attack, if not resolved yet */
     unsigned int last_multiplicity;
+    recent_message_t recent[PARSER_RECENT_SLOTS];
+    unsigned int recent_next;           /* slot to reuse next */
+    struct source_metadata *next;       /* next source in the same bucket */
 } source_metadata_t;
 
- /* parser metadata */
-static struct {
-    unsigned int num_sources;
-    int current_source_index;
-    source_metadata_t sources[MAX_FILES_POLLED];
-} parser_metadata = { 0, -1 };
+ /* number of buckets for hashing sources. Sources are not limited to the
+  * MAX_FILES_POLLED files, as network senders come and go */
+#define PARSER_SOURCES_BUCKETS      256
+
+ /* parser context */
+struct parser_ctx {
+    void *scanner;                                      /* scanner feeding this parser */
+    attack_t attack;                                    /* attack being recognized */
+    char pending_host[RESOLVER_MAX_NAMELEN];            /* host name of attack, if not resolved yet */
+    resolver_done_t resolved;                           /* gets attacks resolved in background */
+    source_metadata_t *sources[PARSER_SOURCES_BUCKETS];
+    source_metadata_t *current_source;
+    int reusable;                                       /* whether the outcome depends on the message only */
+    unsigned long recent_lookups, recent_hits;          /* messages looked up among recent ones, and found */
+    signatures_cache_t *signatures;                     /* states of the signatures automaton reached */
+#ifdef SERVICE_SCANNERS
+    void *family_scanners[PARSER_SCANNER_FAMILIES];     /* scanners of scanner_families[] */
+    int (*lex)();                                       /* scanning function of the line being parsed */
+#endif
+};
+
+static recent_message_t *recent_find(parser_ctx_t *ctx, const char *str, size_t len, Fnv32_t hash, const char *program, size_t programlen);
+static recent_message_t *recent_reserve(parser_ctx_t *ctx, const char *str, size_t len, Fnv32_t hash, const char *program, size_t programlen);
+static void *line_scanner(parser_ctx_t *ctx, char *str, size_t len, const char *program, size_t programlen);
 
 %}
 
- /* parameter to the parsing function */
-%parse-param        { const int source_id };
+ /* parameters to the parsing function: no globals, so parsers can run in parallel */
+%parse-param        { parser_ctx_t *ctx }
+%parse-param        { void *scanner }
+%lex-param          { void *scanner }
 
-/* %pure-parser */
+%define api.pure
 %start text
 
 %union {
@@ -129,17 +213,17 @@ text:
 
 /* a syslog-generated log entry */
 /* EFFECT:
- * - the target address is stored in parsed_attack.address.value
- * - the target address kind is stored in parsed_attack.address.kind
+ * - the target address is stored in ctx->attack.address.value
+ * - the target address kind is stored in ctx->attack.address.kind
  */
 syslogent:
      /* timestamp hostname procname[pid]: logmsg */
     /*TIMESTAMP_SYSLOG hostname procname '[' INTEGER ']' ':' logmsg   {*/
     SYSLOG_BANNER_PID logmsg {
                         /* reject to accept if the pid has been forged */
-                        if (procauth_isauthoritative(parsed_attack.service, $1) == -1) {
+                        if (procauth_isauthoritative(ctx->attack.service, $1) == -1) {
                             /* forged */
-                            sshguard_log(LOG_NOTICE, "Ignore attack as pid '%d' has been forged for service %d.", $1, parsed_attack.service);
+                            sshguard_log(LOG_NOTICE, "Ignore attack as pid '%d' has been forged for service %d.", $1, ctx->attack.service);
                             YYABORT;
                         }
                     }
@@ -160,38 +244,42 @@ metalogent:
 /* the "payload" of a log entry: the oridinal message generated from a process */
 logmsg:
       /* individual messages */
-    msg_single          {   parser_metadata.sources[parser_metadata.current_source_index].last_multiplicity = 1;    }
+    msg_single          {   ctx->current_source->last_multiplicity = 1;    }
       /* messages with repeated attacks -- eg syslog's "last line repeated N times" */
-    | msg_multiple      {   parser_metadata.sources[parser_metadata.current_source_index].last_multiplicity = $1; }
+    | msg_multiple      {   ctx->current_source->last_multiplicity = $1; }
     ;
 
 msg_single:
-    sshmsg              {   parsed_attack.service = SERVICES_SSH; }
-    | dovecotmsg        {   parsed_attack.service = SERVICES_DOVECOT; }
-    | uwimapmsg         {   parsed_attack.service = SERVICES_UWIMAP; }
-    | cyrusimapmsg      {   parsed_attack.service = SERVICES_CYRUSIMAP; }
-    | cucipopmsg        {   parsed_attack.service = SERVICES_CUCIPOP; }
-    | eximmsg           {   parsed_attack.service = SERVICES_EXIM; }
-    | sendmailmsg       {   parsed_attack.service = SERVICES_SENDMAIL; }
-    | freebsdftpdmsg    {   parsed_attack.service = SERVICES_FREEBSDFTPD; }
-    | proftpdmsg        {   parsed_attack.service = SERVICES_PROFTPD; }
-    | pureftpdmsg       {   parsed_attack.service = SERVICES_PUREFTPD; }
-    | vsftpdmsg         {   parsed_attack.service = SERVICES_VSFTPD; }
+    sshmsg              {   ctx->attack.service = SERVICES_SSH; }
+    | dovecotmsg        {   ctx->attack.service = SERVICES_DOVECOT; }
+    | uwimapmsg         {   ctx->attack.service = SERVICES_UWIMAP; }
+    | cyrusimapmsg      {   ctx->attack.service = SERVICES_CYRUSIMAP; }
+    | cucipopmsg        {   ctx->attack.service = SERVICES_CUCIPOP; }
+    | eximmsg           {   ctx->attack.service = SERVICES_EXIM; }
+    | sendmailmsg       {   ctx->attack.service = SERVICES_SENDMAIL; }
+    | freebsdftpdmsg    {   ctx->attack.service = SERVICES_FREEBSDFTPD; }
+    | proftpdmsg        {   ctx->attack.service = SERVICES_PROFTPD; }
+    | pureftpdmsg       {   ctx->attack.service = SERVICES_PUREFTPD; }
+    | vsftpdmsg         {   ctx->attack.service = SERVICES_VSFTPD; }
     ;
 
 msg_multiple:
     /* syslog style  "last message repeated N times"  message */
     LAST_LINE_REPEATED_N_TIMES     {
+                        /* the outcome depends on the message before */
+                        ctx->reusable = 0;
+
                         /* the message repeated, was it an attack? */
-                        if (! parser_metadata.sources[parser_metadata.current_source_index].last_was_recognized) {
+                        if (! ctx->current_source->last_was_recognized) {
                             /* make sure this doesn't get recognized as an attack */
                             YYABORT;
                         }
                         
                         /* got a repeated attack */
-                        parsed_attack = parser_metadata.sources[parser_metadata.current_source_index].last_attack;
+                        ctx->attack = ctx->current_source->last_attack;
+                        strcpy(ctx->pending_host, ctx->current_source->last_pending_host);
                         /* restore previous "genuine" dangerousness, and build new one */
-                        parsed_attack.dangerousness = $1 * (parsed_attack.dangerousness / parser_metadata.sources[parser_metadata.current_source_index].last_multiplicity);
+                        ctx->attack.dangerousness = $1 * (ctx->attack.dangerousness / ctx->current_source->last_multiplicity);
 
                         /* pass up the multiplicity of this attack */
                         $$ = $1;
@@ -201,56 +289,31 @@ msg_multiple:
 /* an address */
 addr:
     IPv4            {
-                        parsed_attack.address.kind = ADDRKIND_IPv4;
-                        strcpy(parsed_attack.address.value, $1);
+                        ctx->attack.address.kind = ADDRKIND_IPv4;
+                        strcpy(ctx->attack.address.value, $1);
                     }
     | IPv6          {
-                        parsed_attack.address.kind = ADDRKIND_IPv6;
-                        strcpy(parsed_attack.address.value, $1);
+                        ctx->attack.address.kind = ADDRKIND_IPv6;
+                        strcpy(ctx->attack.address.value, $1);
                     }
     | HOSTADDR      {
-                        struct addrinfo addrinfo_hints;
-                        struct addrinfo *addrinfo_result;
-                        int res;
-
-                        /* look up IPv4 first */
-                        memset(& addrinfo_hints, 0x00, sizeof(addrinfo_hints));
-                        addrinfo_hints.ai_family = AF_INET;
-                        res = getaddrinfo($1, NULL, & addrinfo_hints, & addrinfo_result);
-                        if (res == 0) {
-                            struct sockaddr_in *foo4;
-                            /* pick the first (IPv4) result address and return */
-                            parsed_attack.address.kind = ADDRKIND_IPv4;
-                            foo4 = (struct sockaddr_in *)(addrinfo_result->ai_addr);
-                            if (inet_ntop(AF_INET, & foo4->sin_addr, parsed_attack.address.value, addrinfo_result->ai_addrlen) == NULL) {
-                                freeaddrinfo(addrinfo_result);
-                                sshguard_log(LOG_ERR, "Unable to interpret resolution result as IPv4 address: %s. Giving up entry.", strerror(errno));
+                        /* the outcome depends on what's known of the name */
+                        ctx->reusable = 0;
+                        switch (resolver_lookup($1, & ctx->attack.address)) {
+                            case 0:
+                                /* known already */
+                                break;
+                            case -1:
+                                sshguard_log(LOG_DEBUG, "Name '%s' is known not to resolve. Giving up entry.", $1);
                                 YYABORT;
-                            }
-                        } else {
-                            sshguard_log(LOG_DEBUG, "Failed to resolve '%s' @ IPv4! Trying IPv6.", $1);
-                            /* try IPv6 */
-                            addrinfo_hints.ai_family = AF_INET6;
-                            res = getaddrinfo($1, NULL, & addrinfo_hints, & addrinfo_result);
-                            if (res == 0) {
-                                struct sockaddr_in6 *foo6;
-                                /* pick the first (IPv6) result address and return */
-                                parsed_attack.address.kind = ADDRKIND_IPv6;
-                                foo6 = (struct sockaddr_in6 *)(addrinfo_result->ai_addr);
-                                if (inet_ntop(AF_INET6, & foo6->sin6_addr, parsed_attack.address.value, addrinfo_result->ai_addrlen) == NULL) {
-                                    sshguard_log(LOG_ERR, "Unable to interpret resolution result as IPv6 address: %s. Giving up entry.", strerror(errno));
-                                    freeaddrinfo(addrinfo_result);
+                            default:
+                                /* resolve once the whole attack is recognized */
+                                if (strlen($1) >= sizeof(ctx->pending_host)) {
+                                    sshguard_log(LOG_ERR, "Host name too long to resolve: '%s'. Giving up entry.", $1);
                                     YYABORT;
                                 }
-                            } else {
-                                sshguard_log(LOG_ERR, "Could not resolv '%s' in neither of IPv{4,6}. Giving up entry.", $1);
-                                YYABORT;
-                            }
+                                strcpy(ctx->pending_host, $1);
                         }
-
-                        sshguard_log(LOG_INFO, "Successfully resolved '%s' --> %d:'%s'.",
-                                $1, parsed_attack.address.kind, parsed_attack.address.value);
-                        freeaddrinfo(addrinfo_result);
                     }
     ;
 
@@ -341,55 +404,326 @@ vsftpdmsg:
 
 %%
 
-static void yyerror(int source_id, const char *msg) { /* do nothing */ }
+static void yyerror(parser_ctx_t *ctx, void *scanner, const char *msg) {
+    /* do nothing */
+    (void)ctx;
+    (void)scanner;
+    (void)msg;
+}
+
+parser_ctx_t *parser_ctx_new(void) {
+    parser_ctx_t *ctx;
+#ifdef SERVICE_SCANNERS
+    unsigned int f;
+#endif
+
+    ctx = (parser_ctx_t *)malloc(sizeof(parser_ctx_t));
+    if (ctx == NULL) return NULL;
+    memset(ctx, 0x00, sizeof(parser_ctx_t));
+
+#if YYDEBUG
+    ctx->scanner = scanner_new(yydebug);
+#else
+    ctx->scanner = scanner_new(0);
+#endif
+    if (ctx->scanner == NULL) {
+        free(ctx);
+        return NULL;
+    }
+#ifdef SERVICE_SCANNERS
+    for (f = 0; f < PARSER_SCANNER_FAMILIES; ++f) {
+#if YYDEBUG
+        ctx->family_scanners[f] = scanner_families[f].scanner_new(yydebug);
+#else
+        ctx->family_scanners[f] = scanner_families[f].scanner_new(0);
+#endif
+        if (ctx->family_scanners[f] == NULL) {
+            parser_ctx_free(ctx);
+            return NULL;
+        }
+    }
+#endif
+
+    /* if this fails, lines just all go to the scanner */
+    prefilter_init();
+
+    return ctx;
+}
+
+void parser_ctx_set_resolved(parser_ctx_t *ctx, resolver_done_t resolved) {
+    ctx->resolved = resolved;
+}
+
+void parser_ctx_get_stats(const parser_ctx_t *ctx, unsigned long *lookups, unsigned long *hits) {
+    *lookups = ctx->recent_lookups;
+    *hits = ctx->recent_hits;
+}
 
-static void init_structures(int source_id) {
-    int cnt;
+void parser_ctx_free(parser_ctx_t *ctx) {
+    source_metadata_t *cursource, *next;
+    int i;
+
+    for (i = 0; i < PARSER_SOURCES_BUCKETS; ++i) {
+        for (cursource = ctx->sources[i]; cursource != NULL; cursource = next) {
+            next = cursource->next;
+            free(cursource);
+        }
+    }
+    scanner_free(ctx->scanner);
+    signatures_cache_free(ctx->signatures);
+#ifdef SERVICE_SCANNERS
+    for (i = 0; i < (int)PARSER_SCANNER_FAMILIES; ++i) {
+        if (ctx->family_scanners[i] != NULL)
+            scanner_families[i].scanner_free(ctx->family_scanners[i]);
+    }
+#endif
+    free(ctx);
+}
+
+static void init_structures(parser_ctx_t *ctx, int source_id) {
+    source_metadata_t *cursource;
+    source_metadata_t **bucket;
 
     /* add metadata for this source, if new */
-    for (cnt = 0; cnt < parser_metadata.num_sources; ++cnt) {
-        if (parser_metadata.sources[cnt].id == source_id) break;
+    bucket = & ctx->sources[(sourceid_t)source_id % PARSER_SOURCES_BUCKETS];
+    for (cursource = *bucket; cursource != NULL; cursource = cursource->next) {
+        if (cursource->id == (sourceid_t)source_id) break;
     }
-    if (cnt == parser_metadata.num_sources) {
+    if (cursource == NULL) {
         /* new source! */
-        assert(cnt < MAX_FILES_POLLED);
-        parser_metadata.sources[cnt].id = source_id;
-        parser_metadata.sources[cnt].last_was_recognized = 0;
-        parser_metadata.sources[cnt].last_multiplicity = 1;
-
-        parser_metadata.num_sources++;
+        cursource = (source_metadata_t *)malloc(sizeof(source_metadata_t));
+        assert(cursource != NULL);
+        cursource->id = source_id;
+        cursource->last_was_recognized = 0;
+        cursource->last_multiplicity = 1;
+        cursource->last_pending_host[0] = '\0';
+        memset(cursource->recent, 0x00, sizeof(cursource->recent));
+        cursource->recent_next = 0;
+
+        cursource->next = *bucket;
+        *bucket = cursource;
     }
     
     /* initialize the attack structure */
-    parsed_attack.dangerousness = DEFAULT_ATTACKS_DANGEROUSNESS;
+    ctx->attack.dangerousness = DEFAULT_ATTACKS_DANGEROUSNESS;
+    ctx->pending_host[0] = '\0';
 
-    /* set current source index */
-    parser_metadata.current_source_index = cnt;
+    /* set current source */
+    ctx->current_source = cursource;
 }
 
-int parse_line(int source_id, char *str) {
+void parse_forget_source(parser_ctx_t *ctx, int source_id) {
+    source_metadata_t *cursource;
+    source_metadata_t **prev;
+
+    prev = & ctx->sources[(sourceid_t)source_id % PARSER_SOURCES_BUCKETS];
+    for (cursource = *prev; cursource != NULL; prev = & cursource->next, cursource = cursource->next) {
+        if (cursource->id != (sourceid_t)source_id) continue;
+
+        *prev = cursource->next;
+        if (ctx->current_source == cursource)
+            ctx->current_source = NULL;
+        free(cursource);
+        return;
+    }
+}
+
+/* run the scanner and grammar on str logged by program (NULL if unknown), and
+ * remember the outcome for source_id */
+static int parse_text(parser_ctx_t *ctx, int source_id, char *str, const char *program, size_t programlen, attack_t *attack) {
     int ret;
+    size_t len;
+    Fnv32_t hash;
+    recent_message_t *recent;
 
     /* initialize parser structures */
-    init_structures(source_id);
-
-    /* initialize scanner, do parse, finalize scanner */
-    scanner_init(str);
-    ret = yyparse(source_id);
-    scanner_fin();
+    init_structures(ctx, source_id);
+
+    if (signatures_match(& ctx->signatures, str, & ctx->attack, ctx->pending_host, sizeof(ctx->pending_host)) == 0) {
+        /* user signatures come first, and describe single attacks */
+        ctx->current_source->last_multiplicity = 1;
+        ret = 0;
+    } else if (! prefilter_candidate(str, program, programlen)) {
+        /* most lines are no attack: spare the scanner those that surely aren't */
+        ctx->current_source->last_was_recognized = 0;
+        return 1;
+    } else {
+        len = strlen(str);
+        hash = (len < PARSER_RECENT_MAXLEN) ? fnv_32a_str(str, FNV1_32A_INIT) : 0;
+        recent = recent_find(ctx, str, len, hash, program, programlen);
+        if (recent != NULL) {
+            /* floods repeat the same message: no need to parse it again */
+            ret = recent->result;
+            if (ret == 0) {
+                ctx->attack = recent->attack;
+                ctx->current_source->last_multiplicity = 1;
+            }
+        } else {
+            /* copy the message before the scanner alters it */
+            recent = recent_reserve(ctx, str, len, hash, program, programlen);
+
+            /* the scanner works on str itself, which flex wants ended by two NULs */
+            str[len + 1] = '\0';
+
+            /* point scanner to the line, do parse */
+            ctx->reusable = 1;
+            ret = yyparse(ctx, line_scanner(ctx, str, len, program, programlen));
+            if (recent != NULL && ctx->reusable) {
+                recent->result = ret;
+                recent->attack = ctx->attack;
+                recent->len = len;
+            }
+        }
+    }
 
     /* do post-parsing oeprations */
     if (ret == 0) {
         /* message recognized */
         /* update metadata on this source */
-        parser_metadata.sources[parser_metadata.current_source_index].last_was_recognized = 1;
-        parser_metadata.sources[parser_metadata.current_source_index].last_attack = parsed_attack;
+        ctx->current_source->last_was_recognized = 1;
+        ctx->current_source->last_attack = ctx->attack;
+        strcpy(ctx->current_source->last_pending_host, ctx->pending_host);
+        *attack = ctx->attack;
     } else {
         /* message not recognized */
-        parser_metadata.sources[parser_metadata.current_source_index].last_was_recognized = 0;
+        ctx->current_source->last_was_recognized = 0;
     }
 
     return ret;
 }
 
+/* get the scanner for str logged by program (NULL if unknown), pointed to str */
+static void *line_scanner(parser_ctx_t *ctx, char *str, size_t len, const char *program, size_t programlen) {
+#ifdef SERVICE_SCANNERS
+    const int *services;
+    unsigned int f, i;
+
+    /* the scanner of the family running all the services of program, if any */
+    services = (program != NULL ? prefilter_program_services(program, programlen) : NULL);
+    for (f = 0; services != NULL && f < PARSER_SCANNER_FAMILIES; ++f) {
+        for (i = 0; i < PREFILTER_MAX_PROGRAM_SERVICES && services[i] != 0; ++i) {
+            if (services[i] < scanner_families[f].first_service || services[i] > scanner_families[f].last_service) break;
+        }
+        if (i == PREFILTER_MAX_PROGRAM_SERVICES || services[i] == 0) {
+            scanner_families[f].scanner_init(ctx->family_scanners[f], str, len);
+            ctx->lex = scanner_families[f].lex;
+            return ctx->family_scanners[f];
+        }
+    }
+    ctx->lex = any_lex;
+#else
+    (void)program;
+    (void)programlen;
+#endif
+
+    scanner_init(ctx->scanner, str, len);
+    return ctx->scanner;
+}
+
+/* find a message among the recent ones of the current source */
+static recent_message_t *recent_find(parser_ctx_t *ctx, const char *str, size_t len, Fnv32_t hash, const char *program, size_t programlen) {
+    recent_message_t *recent;
+    int i;
+
+    if (len == 0 || len >= PARSER_RECENT_MAXLEN) return NULL;
+
+    ++ctx->recent_lookups;
+    for (i = 0; i < PARSER_RECENT_SLOTS; ++i) {
+        recent = & ctx->current_source->recent[i];
+        if (recent->hash == hash && recent->len == len && recent->programlen == programlen
+                && memcmp(recent->message, str, len) == 0
+                && (programlen == 0 || memcmp(recent->program, program, programlen) == 0)) {
+            ++ctx->recent_hits;
+            return recent;
+        }
+    }
+
+    return NULL;
+}
+
+/* take a slot for remembering a message of the current source, valid once
+ * its len is set. NULL if the message is too long to remember */
+static recent_message_t *recent_reserve(parser_ctx_t *ctx, const char *str, size_t len, Fnv32_t hash, const char *program, size_t programlen) {
+    source_metadata_t *cursource = ctx->current_source;
+    recent_message_t *recent;
+
+    if (len >= PARSER_RECENT_MAXLEN || programlen >= PARSER_RECENT_PROGLEN) return NULL;
+
+    /* replace the oldest */
+    recent = & cursource->recent[cursource->recent_next];
+    cursource->recent_next = (cursource->recent_next + 1) % PARSER_RECENT_SLOTS;
+
+    recent->hash = hash;
+    recent->len = 0;
+    memcpy(recent->message, str, len);
+    recent->programlen = programlen;
+    if (programlen > 0) memcpy(recent->program, program, programlen);
+
+    return recent;
+}
+
+/* give attack its address, if its host name is still to resolve. 0 if it has one */
+static int settle_address(parser_ctx_t *ctx, attack_t *attack) {
+    if (ctx->pending_host[0] == '\0') return 0;
+
+    /* the attack is decided when the name resolves */
+    if (ctx->resolved != NULL && resolver_submit(ctx->pending_host, attack, ctx->resolved) == 0) {
+        sshguard_log(LOG_DEBUG, "Attack from '%s' waits for the name to resolve.", ctx->pending_host);
+        return 1;
+    }
+
+    return (resolver_resolve(ctx->pending_host, & attack->address) == 0) ? 0 : -1;
+}
+
+/* parse a message logged by program[pid] (NULL and 0 if unknown) */
+static int parse_payload(parser_ctx_t *ctx, int source_id, char *str, const char *program, size_t programlen, pid_t pid, attack_t *attack) {
+    int ret;
+
+    ret = parse_text(ctx, source_id, str, program, programlen, attack);
 
+    /* reject to accept if the pid has been forged, as for syslog banners */
+    if (ret == 0 && pid > 0 && procauth_isauthoritative(attack->service, pid) == -1) {
+        sshguard_log(LOG_NOTICE, "Ignore attack as pid '%d' has been forged for service %d.", (int)pid, attack->service);
+        ctx->current_source->last_was_recognized = 0;
+        return -1;
+    }
+
+    return (ret == 0) ? settle_address(ctx, attack) : ret;
+}
+
+int parse_line(parser_ctx_t *ctx, int source_id, char *str, attack_t *attack) {
+    log_banner_t banner;
+    int ret;
+
+    /* split the banner by hand, so that the grammar only gets the message */
+    if (banner_split(str, & banner) == 0) {
+        if (banner_is_self(& banner)) {
+            /* our own messages are never attacks */
+            init_structures(ctx, source_id);
+            ctx->current_source->last_was_recognized = 0;
+            return 1;
+        }
+        return parse_payload(ctx, source_id, str + (banner.message - str), banner.program, banner.programlen, banner.pid, attack);
+    }
+
+    /* unusual banner, or none: the grammar knows the common ones too */
+    str += banner_skip_priority(str) - str;
+    ret = parse_text(ctx, source_id, str, NULL, 0, attack);
+    return (ret == 0) ? settle_address(ctx, attack) : ret;
+}
+
+void parse_skip_line(parser_ctx_t *ctx, int source_id) {
+    init_structures(ctx, source_id);
+    ctx->current_source->last_was_recognized = 0;
+}
+
+int parse_message(parser_ctx_t *ctx, int source_id, char *str, const char *program, size_t programlen, pid_t pid, attack_t *attack) {
+    if (program != NULL && banner_program_is_self(program, programlen)) {
+        /* our own messages are never attacks */
+        parse_skip_line(ctx, source_id);
+        return 1;
+    }
+
+    /* no banner: the grammar takes bare messages as they are */
+    return parse_payload(ctx, source_id, str, program, programlen, pid, attack);
+}
@@ -0,0 +1,54 @@
+# Copyright (c) 2011 Mij <mij@sshguard.net>
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#
+# SSHGuard. See http://www.sshguard.net
+#
+
+# Make the scanner of one family of services out of attack_scanner.l:
+#   awk -v family=login|mail|ftp -f attack_scanner_family.awk attack_scanner.l
+#
+# Rules returning a token of the services of another family are left out;
+# banners and common-use tokens stay. The functions exported by the scanner
+# get the family in their name (scanner_login_new() ...), as its flex
+# functions do with "flex -P login_yy".
+
+BEGIN {
+    # services of each family, by the prefix of their tokens in attack_parser.y
+    services["login"] = "SSH"
+    services["mail"] = "UWIMAP DOVECOT CYRUSIMAP CUCIPOP EXIM SENDMAIL"
+    services["ftp"] = "FREEBSDFTPD PROFTPD PUREFTPD VSFTPD"
+    if (! (family in services)) {
+        print "attack_scanner_family.awk: unknown family '" family "'" > "/dev/stderr"
+        exit 1
+    }
+    for (f in services) {
+        n = split(services[f], names, " ")
+        for (i = 1; i <= n; ++i) family_of[names[i]] = f
+    }
+}
+
+# a rule returning the token of some service
+match($0, /return [A-Z0-9]+_[A-Z0-9_]+;/) {
+    token = substr($0, RSTART + 7, RLENGTH - 8)
+    service = substr(token, 1, index(token, "_") - 1)
+    if ((service in family_of) && family_of[service] != family) next
+}
+
+{
+    gsub(/scanner_new\(/, "scanner_" family "_new(")
+    gsub(/scanner_free\(/, "scanner_" family "_free(")
+    gsub(/scanner_init\(/, "scanner_" family "_init(")
+    print
+}
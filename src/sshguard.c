@@ -53,14 +53,23 @@
 #include "sshguard_attack.h"
 /* subsystem for polling multiple log files and getting log entries */
 #include "sshguard_logsuck.h"
+/* looking for attacks in past logs at startup: backfill_run() */
+#include "sshguard_backfill.h"
+/* resolving host names of attackers in background */
+#include "sshguard_resolver.h"
+/* attack signatures of the user: signatures_load() */
+#include "sshguard_signatures.h"
+/* addresses blocked, for telling their lines without parsing: blocked_match_line() */
+#include "sshguard_blocked.h"
 
 #include "sshguard.h"
 
-#define MAX_LOGLINE_LEN     1000
-
 /* switch from 0 (normal) to 1 (suspended) with SIGTSTP and SIGCONT respectively */
 int suspended;
 
+/* parser for log entries read by the main loop */
+static parser_ctx_t *parser;
+
 
 /*      FUNDAMENTAL DATA STRUCTURES         */
 /* These lists are all lists of attacker_t structures.
@@ -91,35 +100,60 @@ int sshg_debugging = 0;
 /* mutex against races between insertions and pruning of lists */
 pthread_mutex_t list_mutex;
 
+/* mutex serializing attacks reported by the main loop and by resolver threads */
+static pthread_mutex_t report_mutex;
+/* set by finishup() under report_mutex: attacks reported later are dropped */
+static int exiting = 0;
+
+/* lines passed over as they came from addresses blocked already */
+static unsigned long blocked_lines = 0;
+
 
 /* fill an attacker_t structure for usage */
-static inline void attackerinit(attacker_t *restrict ipe, const attack_t *restrict attack);
+static inline void attackerinit(attacker_t *restrict ipe, const attack_t *restrict attack, time_t when);
 /* comparison operator for sorting offenders list */
 static int attackt_whenlast_comparator(const void *a, const void *b);
 
 /* get log lines in here. Hide the actual source and the method. Fill buf up
- * to buflen chars, return 0 for success, -1 for failure */
-static int read_log_line(char *restrict buf, size_t buflen, bool from_last_source, sourceid_t *restrict source_id);
-#ifdef EINTR
-/* get line unaffected by interrupts */
-static char *safe_fgets(char *restrict s, int size, FILE *restrict stream);
-#endif
+ * to buflen chars, return LOGSUCK_GOT_* for success, -1 for failure. Some
+ * sources provide attacks or bare messages: then fill info too */
+static int read_log_line(char *restrict buf, size_t buflen, bool from_last_source, sourceid_t *restrict source_id, logsuck_entryinfo_t *restrict info);
 /* handler for termination-related signals */
 static void sigfin_handler(int signo);
 /* handler for suspension/resume signals */
 static void sigstpcont_handler(int signo);
+/* thread taking reload signals, and what it does on them */
+static void *reloader(void *par);
+static void reload_configuration(void);
+/* release blocked addresses that are whitelisted now */
+static void release_whitelisted(void);
 /* called at exit(): flush blocked addresses and finalize subsystems */
 static void finishup(void);
 
 /* load blacklisted addresses and block them (if blacklist enabled) */
 static void process_blacklisted_addresses();
-/* handle an attack: addr is the author, addrkind its address kind, service the attacked service code */
-static void report_address(attack_t attack);
-/* cleanup false-alarm attackers from limbo list (ones with too few attacks in too much time) */
-static void purge_limbo_stale(void);
+/* handle an attack: addr is the author, addrkind its address kind, service the attacked service code, when the time it happened */
+static void report_address(attack_t attack, time_t when);
+/* take report_mutex, keeping termination signals from this thread meanwhile */
+static void report_lock(sigset_t *restrict oldsigs);
+static void report_unlock(const sigset_t *restrict oldsigs);
+/* account for an attack, with report_mutex held */
+static void account_attack(attack_t attack, time_t when);
+/* handle an attack found in past logs */
+static void report_past_address(attack_t attack, time_t when);
+/* handle an attack whose address was given as host name, once resolved */
+static void report_resolved_address(attack_t attack);
+/* cleanup false-alarm attackers from limbo list (ones with too few attacks in too much time, as of now) */
+static void purge_limbo_stale(time_t now);
 /* release blocked attackers after their penalty expired */
 static void *pardonBlocked(void *par);
 
+/* drop what the parser knows of a source that ended */
+static void forget_source(sourceid_t source_id);
+
+/* release blacklisted addresses not offending since the horizon (if expiry enabled) */
+static void expire_blacklisted(time_t now);
+
 /* create or destroy my own pidfile */
 static int my_pidfile_create();
 static void my_pidfile_destroy();
@@ -127,9 +161,14 @@ static void my_pidfile_destroy();
 
 int main(int argc, char *argv[]) {
     pthread_t tid;
+    sigset_t sigs;
     int retv;
     sourceid_t source_id;
-    char buf[MAX_LOGLINE_LEN];
+    char *buf;
+    logsuck_entryinfo_t info;
+    attack_t attack;
+    sshg_address_t blocked_address;
+    time_t now;
     
 
     /* initializations */
@@ -146,6 +185,7 @@ int main(int argc, char *argv[]) {
     list_attributes_seeker(& offenders, seeker_addr);
     list_attributes_comparator(& offenders, attackt_whenlast_comparator);
     pthread_mutex_init(& list_mutex, NULL);
+    pthread_mutex_init(& report_mutex, NULL);
 
 
     /* logging system */
@@ -183,6 +223,12 @@ int main(int argc, char *argv[]) {
 
     whitelist_conf_fin();
 
+    /* attack signatures of the user, if given */
+    if (opts.signatures_filename != NULL && signatures_load(opts.signatures_filename) != 0) {
+        fprintf(stderr, "Could not load signatures from '%s'. Terminating...\n", opts.signatures_filename);
+        exit(1);
+    }
+
     /* address blocking system */
     if (fw_init() != FWALL_OK) {
         sshguard_log(LOG_CRIT, "Could not init firewall. Terminating.\n");
@@ -200,15 +246,35 @@ int main(int argc, char *argv[]) {
 
     /* termination signals */
     signal(SIGTERM, sigfin_handler);
-    signal(SIGHUP, sigfin_handler);
     signal(SIGINT, sigfin_handler);
 
+    /* reload signal: kept from all threads but reloader(), which waits for it */
+    sigemptyset(& sigs);
+    sigaddset(& sigs, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, & sigs, NULL);
+
     /* load blacklisted addresses and block them (if requested) */
     process_blacklisted_addresses();
 
+#ifndef FAST_PARSER
     /* set debugging value for parser/scanner ... */
     yydebug = sshg_debugging;
-    yy_flex_debug = sshg_debugging;
+#endif
+
+    /* parser for the main loop; other threads parsing lines use their own */
+    parser = parser_ctx_new();
+    if (parser == NULL) {
+        sshguard_log(LOG_CRIT, "Could not initialize the parser. Terminating.");
+        exit(1);
+    }
+    logsuck_set_source_ended(forget_source);
+
+    /* resolve host names of attackers in background, not to stall the main loop */
+    if (resolver_init() == 0) {
+        parser_ctx_set_resolved(parser, report_resolved_address);
+    } else {
+        sshguard_log(LOG_ERR, "Could not start the resolver, host names will be resolved while parsing.");
+    }
     
     /* start thread for purging stale blocked addresses */
     if (pthread_create(&tid, NULL, pardonBlocked, NULL) != 0) {
@@ -216,6 +282,19 @@ int main(int argc, char *argv[]) {
         exit(2);
     }
 
+    /* start thread for reloading the configuration on request */
+    if (pthread_create(&tid, NULL, reloader, NULL) != 0) {
+        perror("pthread_create()");
+        exit(2);
+    }
+
+    /* catch up with attacks logged before we started */
+    if (opts.backfill_period > 0) {
+        if (backfill_run(time(NULL) - opts.backfill_period, opts.max_logline_len + 1, report_past_address) < 0) {
+            sshguard_log(LOG_ERR, "Unable to look for attacks in past logs.");
+        }
+    }
+
 
     /* initialization successful */
     
@@ -223,63 +302,96 @@ int main(int argc, char *argv[]) {
             opts.abuse_threshold, (unsigned int)opts.pardon_threshold, (unsigned int)opts.stale_threshold);
 
 
-    while (read_log_line(buf, MAX_LOGLINE_LEN, false, & source_id) == 0) {
+    /* room for the longest line allowed, plus the extra byte the parser scans in place */
+    buf = (char *)malloc(opts.max_logline_len + 2);
+    if (buf == NULL) {
+        sshguard_log(LOG_CRIT, "Unable to allocate line buffer of %u bytes. Terminating.", opts.max_logline_len + 2);
+        exit(1);
+    }
+
+    while ((retv = read_log_line(buf, opts.max_logline_len + 1, false, & source_id, & info)) >= 0) {
         if (suspended) continue;
 
-        retv = parse_line(source_id, buf);
-        if (retv != 0) {
-            /* sshguard_log(LOG_DEBUG, "Skip line '%s'", buf); */
+        /* lines of attackers blocked already need no parsing */
+        if (retv != LOGSUCK_GOT_ATTACK && blocked_match_line(buf, & blocked_address)) {
+            ++blocked_lines;
+            /* still at it: blacklisted ones must not age out (-x) */
+            if (opts.blacklist_filename != NULL)
+                blacklist_touch(& blocked_address, time(NULL));
+            parse_skip_line(parser, source_id);
             continue;
         }
 
+        switch (retv) {
+            case LOGSUCK_GOT_ATTACK:
+                /* decoded by the source already */
+                attack = info.attack;
+                break;
+
+            case LOGSUCK_GOT_MESSAGE:
+                /* bare message: no banner to scan */
+                if (parse_message(parser, source_id, buf, (info.program[0] != '\0' ? info.program : NULL), strlen(info.program), info.pid, & attack) != 0)
+                    continue;
+                break;
+
+            default:
+                retv = parse_line(parser, source_id, buf, & attack);
+                if (retv != 0) {
+                    /* sshguard_log(LOG_DEBUG, "Skip line '%s'", buf); */
+                    continue;
+                }
+        }
+
         /* extract the IP address */
-        sshguard_log(LOG_DEBUG, "Matched address %s:%d attacking service %d, dangerousness %u.", parsed_attack.address.value, parsed_attack.address.kind, parsed_attack.service, parsed_attack.dangerousness);
+        sshguard_log(LOG_DEBUG, "Matched address %s:%d attacking service %d, dangerousness %u.", attack.address.value, attack.address.kind, attack.service, attack.dangerousness);
        
-        /* report IP */
-        report_address(parsed_attack);
+        /* report IP, as of when the source says it was logged, if it does */
+        now = time(NULL);
+        report_address(attack, (info.when > 0 && info.when < now) ? info.when : now);
     }
 
     /* let exit() call finishup() */
     exit(0);
 }
 
-static int read_log_line(char *restrict buf, size_t buflen, bool from_last_source, sourceid_t *restrict source_id) {
-    /* must fill buf, and return 0 for success and -1 for error */
-
-    /* get logs from polled files ? */
-    if (opts.has_polled_files) {
-        /* logsuck_getline() reflects the 0/-1 codes already */
-        return logsuck_getline(buf, MAX_LOGLINE_LEN, from_last_source, source_id);
-    }
+static void forget_source(sourceid_t source_id) {
+    parse_forget_source(parser, source_id);
+}
 
-    /* otherwise, get logs from stdin */
-    if (source_id != NULL) *source_id = 0;
+static int read_log_line(char *restrict buf, size_t buflen, bool from_last_source, sourceid_t *restrict source_id, logsuck_entryinfo_t *restrict info) {
+    /* must fill buf, and return LOGSUCK_GOT_* for success and -1 for error */
 
-#ifdef EINTR
-    return (safe_fgets(buf, MAX_LOGLINE_LEN, stdin) != NULL ? 0 : -1);
-#else
-    return (fgets(buf, MAX_LOGLINE_LEN, stdin) != NULL ? 0 : -1);
-#endif
+    /* standard input is polled like any other source when none is given.
+     * logsuck_getline() reflects the LOGSUCK_GOT_* and -1 codes already */
+    return logsuck_getline(buf, buflen, from_last_source, source_id, info);
 }
 
-#ifdef EINTR
-static char *safe_fgets(char *restrict s, int size, FILE *restrict stream) {
-    char *restrict ret;
 
-    do {
-        clearerr(stream);
-        ret = fgets(s, size, stream);
-        if (ret != NULL)
-            return s;
-        if (errno != EINTR)
-            return NULL;
-    } while (ret == NULL && errno == EINTR);
+static void report_lock(sigset_t *restrict oldsigs) {
+    sigset_t sigs;
 
-    /* pretend we arrive here to make compiler happy */
-    return NULL;
+    /* finishup() takes report_mutex too: it must not run in its holder */
+    sigemptyset(& sigs);
+    sigaddset(& sigs, SIGTERM);
+    sigaddset(& sigs, SIGINT);
+    pthread_sigmask(SIG_BLOCK, & sigs, oldsigs);
+    pthread_mutex_lock(& report_mutex);
 }
-#endif
 
+static void report_unlock(const sigset_t *restrict oldsigs) {
+    pthread_mutex_unlock(& report_mutex);
+    pthread_sigmask(SIG_SETMASK, oldsigs, NULL);
+}
+
+static void report_address(attack_t attack, time_t when) {
+    sigset_t oldsigs;
+
+    report_lock(& oldsigs);
+    /* resolver threads may still call in while exiting */
+    if (! exiting)
+        account_attack(attack, when);
+    report_unlock(& oldsigs);
+}
 
 /*
  * This function is called every time an attack pattern is matched.
@@ -289,23 +401,28 @@ static char *safe_fgets(char *restrict s, int size, FILE *restrict stream) {
  * 2) block the attacker, if attacks > threshold (abuse)
  * 3) blacklist the address, if the number of abuses is excessive
  */
-static void report_address(attack_t attack) {
+static void account_attack(attack_t attack, time_t when) {
     attacker_t *tmpent = NULL;
     attacker_t *offenderent;
+    time_t pardontime = 0;
     int ret;
 
     assert(attack.address.value != NULL);
     assert(memchr(attack.address.value, '\0', sizeof(attack.address.value)) != NULL);
 
     /* clean list from stale entries */
-    purge_limbo_stale();
+    purge_limbo_stale(when);
 
     /* address already blocked? (can happen for 100 reasons) */
     pthread_mutex_lock(& list_mutex);
     tmpent = list_seek(& hell, & attack.address);
+    if (tmpent != NULL) pardontime = tmpent->pardontime;
     pthread_mutex_unlock(& list_mutex);
     if (tmpent != NULL) {
         sshguard_log(LOG_INFO, "Asked to block '%s', which was already blocked to my account.", attack.address.value);
+        /* blacklisted, and still at it: keep it from aging out (-x) */
+        if (pardontime == 0 && opts.blacklist_filename != NULL)
+            blacklist_touch(& attack.address, when);
         return;
     }
 
@@ -321,11 +438,11 @@ static void report_address(attack_t attack) {
     if (tmpent == NULL) { /* entry not already in list, add it */
         /* otherwise: insert the new item */
         tmpent = malloc(sizeof(attacker_t));
-        attackerinit(tmpent, & attack);
+        attackerinit(tmpent, & attack, when);
         list_append(&limbo, tmpent);
     } else {
         /* otherwise, the entry was already existing, update with new data */
-        tmpent->whenlast = time(NULL);
+        tmpent->whenlast = when;
         tmpent->numhits++;
         tmpent->cumulated_danger += attack.dangerousness;
     }
@@ -369,9 +486,10 @@ static void report_address(attack_t attack) {
 
         /* insert in the blacklisted db iff enabled */
         if (opts.blacklist_filename != NULL) {
-            switch (blacklist_lookup_address(opts.blacklist_filename, & offenderent->attack.address)) {
+            switch (blacklist_lookup_address(& offenderent->attack.address)) {
                 case 1:     /* in blacklist */
-                    /* do nothing */
+                    /* offending again: move its last offense forward, for expiry (-x) */
+                    blacklist_add(offenderent);
                     break;
                 case 0:     /* not in blacklist */
                     /* add it */
@@ -379,7 +497,7 @@ static void report_address(attack_t attack) {
                             offenderent->attack.address.value, offenderent->attack.address.kind,
                             offenderent->cumulated_danger, offenderent->numhits,
                             opts.blacklist_threshold);
-                    if (blacklist_add(opts.blacklist_filename, offenderent) != 0) {
+                    if (blacklist_add(offenderent) != 0) {
                         sshguard_log(LOG_ERR, "Could not blacklist offender: %s", strerror(errno));
                     }
                     break;
@@ -407,28 +525,40 @@ static void report_address(attack_t attack) {
     pthread_mutex_lock(& list_mutex);
     list_append(& hell, tmpent);
     pthread_mutex_unlock(& list_mutex);
+    if (blocked_add(& tmpent->attack.address) != 0)
+        sshguard_log(LOG_ERR, "Could not remember '%s' as blocked, its lines will be parsed.", tmpent->attack.address.value);
     assert(list_locate(& limbo, tmpent) >= 0);
     list_delete_at(& limbo, list_locate(& limbo, tmpent));
 }
 
-static inline void attackerinit(attacker_t *restrict ipe, const attack_t *restrict attack) {
+static void report_past_address(attack_t attack, time_t when) {
+    sshguard_log(LOG_DEBUG, "Matched address %s:%d attacking service %d, dangerousness %u, %lld seconds ago.", attack.address.value, attack.address.kind, attack.service, attack.dangerousness, (long long int)(time(NULL) - when));
+    report_address(attack, when);
+}
+
+static void report_resolved_address(attack_t attack) {
+    if (suspended) return;
+
+    sshguard_log(LOG_DEBUG, "Matched address %s:%d attacking service %d, dangerousness %u, once resolved.", attack.address.value, attack.address.kind, attack.service, attack.dangerousness);
+    report_address(attack, time(NULL));
+}
+
+static inline void attackerinit(attacker_t *restrict ipe, const attack_t *restrict attack, time_t when) {
     assert(ipe != NULL && attack != NULL);
     strcpy(ipe->attack.address.value, attack->address.value);
     ipe->attack.address.kind = attack->address.kind;
     ipe->attack.service = attack->service;
-    ipe->whenfirst = ipe->whenlast = time(NULL);
+    ipe->whenfirst = ipe->whenlast = when;
     ipe->numhits = 1;
     ipe->cumulated_danger = attack->dangerousness;
 }
 
-static void purge_limbo_stale(void) {
+static void purge_limbo_stale(time_t now) {
     attacker_t *tmpent;
-    time_t now;
     unsigned int pos = 0;
 
 
     sshguard_log(LOG_DEBUG, "Purging stale attackers.");
-    now = time(NULL);
     for (pos = 0; pos < list_size(&limbo); pos++) {
         tmpent = list_get_at(&limbo, pos);
         if (now - tmpent->whenfirst > opts.stale_threshold)
@@ -437,11 +567,13 @@ static void purge_limbo_stale(void) {
 }
 
 static void *pardonBlocked(void *par) {
-    time_t now;
+    time_t now, last_expiry, expiry_interval;
     attacker_t *tmpel;
     int ret, pos;
 
 
+    last_expiry = time(NULL);
+    expiry_interval = (opts.blacklist_horizon < BLACKLIST_EXPIRY_INTERVAL ? opts.blacklist_horizon : BLACKLIST_EXPIRY_INTERVAL);
     while (1) {
         /* wait some time, at most opts.pardon_threshold/3 + 1 sec */
         sleep(1 + ((unsigned int)rand() % (1+opts.pardon_threshold/2)));
@@ -460,6 +592,7 @@ static void *pardonBlocked(void *par) {
                 sshguard_log(LOG_INFO, "Releasing %s after %lld seconds.\n", tmpel->attack.address.value, (long long int)(now - tmpel->whenlast));
                 ret = fw_release(tmpel->attack.address.value, tmpel->attack.address.kind, tmpel->attack.service);
                 if (ret != FWALL_OK) sshguard_log(LOG_ERR, "Release command failed. Exited: %d", ret);
+                blocked_remove(& tmpel->attack.address);
                 list_delete_at(&hell, pos);
                 free(tmpel);
                 /* element removed, next element is at current index (don't step pos) */
@@ -468,6 +601,11 @@ static void *pardonBlocked(void *par) {
         }
         
         pthread_mutex_unlock(& list_mutex);
+
+        if (opts.blacklist_filename != NULL && opts.blacklist_horizon > 0 && now - last_expiry >= expiry_interval) {
+            expire_blacklisted(now);
+            last_expiry = now;
+        }
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &ret);
         pthread_testcancel();
     }
@@ -476,17 +614,188 @@ static void *pardonBlocked(void *par) {
     return NULL;
 }
 
+/* addresses to release: expired from the blacklist, or whitelisted since */
+struct blacklist_expired {
+    unsigned int num, max;
+    attacker_t *attackers;
+};
+
+/* callback for blacklist_expire() */
+static void collect_expired(const char *restrict address, int addrkind, int service, void *arg) {
+    struct blacklist_expired *exp = (struct blacklist_expired *)arg;
+    attacker_t *newattackers;
+
+    if (exp->num == exp->max) {
+        newattackers = (attacker_t *)realloc(exp->attackers, (exp->max > 0 ? 2 * exp->max : 64) * sizeof(attacker_t));
+        if (newattackers == NULL) {
+            sshguard_log(LOG_ERR, "Out of memory, blacklisted address '%s' expired but stays blocked until restart.", address);
+            return;
+        }
+        exp->attackers = newattackers;
+        exp->max = (exp->max > 0 ? 2 * exp->max : 64);
+    }
+    memset(& exp->attackers[exp->num], 0x00, sizeof(attacker_t));
+    strncpy(exp->attackers[exp->num].attack.address.value, address, sizeof(exp->attackers[exp->num].attack.address.value) - 1);
+    exp->attackers[exp->num].attack.address.kind = addrkind;
+    exp->attackers[exp->num].attack.service = service;
+    ++exp->num;
+}
+
+static void expire_blacklisted(time_t now) {
+    struct blacklist_expired exp;
+    attacker_t *tmpel;
+    unsigned int i;
+    int ret;
+
+    /* take them out of the blacklist all at once, then release them */
+    memset(& exp, 0x00, sizeof(exp));
+    if (blacklist_expire(now - opts.blacklist_horizon, collect_expired, & exp) <= 0)
+        return;
+
+    pthread_mutex_lock(& list_mutex);
+    for (i = 0; i < exp.num; ++i) {
+        sshguard_log(LOG_DEBUG, "Releasing blacklisted %s, not offending for %lld seconds.", exp.attackers[i].attack.address.value, (long long int)opts.blacklist_horizon);
+        ret = fw_release(exp.attackers[i].attack.address.value, exp.attackers[i].attack.address.kind, exp.attackers[i].attack.service);
+        if (ret != FWALL_OK) sshguard_log(LOG_ERR, "Release command failed. Exited: %d", ret);
+        blocked_remove(& exp.attackers[i].attack.address);
+        /* blacklisted during this run */
+        tmpel = list_seek(& hell, & exp.attackers[i].attack.address);
+        if (tmpel != NULL) {
+            list_delete_at(& hell, list_locate(& hell, tmpel));
+            free(tmpel);
+        }
+    }
+    pthread_mutex_unlock(& list_mutex);
+
+    free(exp.attackers);
+}
+
+/* callback for blacklist_foreach(), taking blacklisted addresses that are whitelisted now */
+static void collect_whitelisted(const char *restrict address, int addrkind, int service, void *arg) {
+    if (whitelist_match(address, addrkind))
+        collect_expired(address, addrkind, service, arg);
+}
+
+static void release_whitelisted(void) {
+    struct blacklist_expired rel;
+    attacker_t *tmpel;
+    sigset_t oldsigs;
+    unsigned int i, first_blacklisted;
+    int ret, pos;
+
+    memset(& rel, 0x00, sizeof(rel));
+
+    /* no attack is accounted meanwhile: those accounted already are in hell,
+     * and those accounted afterwards check the new whitelist */
+    report_lock(& oldsigs);
+    pthread_mutex_lock(& list_mutex);
+
+    /* blocked during this run; those blacklisted are taken from the blacklist below */
+    for (pos = 0; pos < list_size(& hell); pos++) {
+        tmpel = list_get_at(& hell, pos);
+        if (! whitelist_match(tmpel->attack.address.value, tmpel->attack.address.kind)) continue;
+        if (opts.blacklist_filename == NULL || blacklist_lookup_address(& tmpel->attack.address) != 1)
+            collect_expired(tmpel->attack.address.value, tmpel->attack.address.kind, tmpel->attack.service, & rel);
+        list_delete_at(& hell, pos);
+        free(tmpel);
+        /* element removed, next element is at current index (don't step pos) */
+        pos--;
+    }
+
+    /* blacklisted, during this run or before */
+    first_blacklisted = rel.num;
+    if (opts.blacklist_filename != NULL) {
+        blacklist_foreach(ADDRKIND_IPv4, collect_whitelisted, & rel);
+        blacklist_foreach(ADDRKIND_IPv6, collect_whitelisted, & rel);
+        for (i = first_blacklisted; i < rel.num; ++i) {
+            if (blacklist_remove(& rel.attackers[i].attack.address) != 0)
+                sshguard_log(LOG_ERR, "Could not remove whitelisted '%s' from the blacklist.", rel.attackers[i].attack.address.value);
+        }
+    }
+
+    /* release them all at once */
+    for (i = 0; i < rel.num; ++i) {
+        sshguard_log(LOG_DEBUG, "Releasing %s, whitelisted now.", rel.attackers[i].attack.address.value);
+        ret = fw_release(rel.attackers[i].attack.address.value, rel.attackers[i].attack.address.kind, rel.attackers[i].attack.service);
+        if (ret != FWALL_OK) sshguard_log(LOG_ERR, "Release command failed. Exited: %d", ret);
+        blocked_remove(& rel.attackers[i].attack.address);
+    }
+
+    pthread_mutex_unlock(& list_mutex);
+    report_unlock(& oldsigs);
+
+    if (rel.num > 0)
+        sshguard_log(LOG_NOTICE, "Released %u blocked addresses, whitelisted now (%u of them blacklisted).", rel.num, rel.num - first_blacklisted);
+    free(rel.attackers);
+}
+
+static void reload_configuration(void) {
+    sshguard_log(LOG_NOTICE, "Got reload signal, reloading whitelist and attack signatures.");
+
+    /* either replaces what is in use at once, or keeps it if it can't */
+    if (opts.signatures_filename != NULL && signatures_load(opts.signatures_filename) != 0)
+        sshguard_log(LOG_ERR, "Could not reload signatures from '%s', keeping those loaded.", opts.signatures_filename);
+    if (whitelist_reload() != 0) {
+        sshguard_log(LOG_ERR, "Could not reload the whitelist, keeping the current one.");
+        return;
+    }
+
+    release_whitelisted();
+}
+
+static void *reloader(void *par) {
+    sigset_t sigs;
+    int signo;
+
+    sigemptyset(& sigs);
+    sigaddset(& sigs, SIGHUP);
+    while (sigwait(& sigs, & signo) == 0) {
+        reload_configuration();
+    }
+
+    pthread_exit(NULL);
+    return NULL;
+}
+
 /* finalization routine */
 static void finishup(void) {
+    resolver_stats_t rstats;
+    unsigned long lookups, hits;
+    sigset_t oldsigs;
+
+    /* no attack is accounted from now on, nor is any accounting in progress */
+    report_lock(& oldsigs);
+    exiting = 1;
+    report_unlock(& oldsigs);
+
+    /* stop the resolver before what its callbacks use */
+    resolver_get_stats(& rstats);
+    if (resolver_fin() != 0) sshguard_log(LOG_ERR, "Could not finalize the resolver.");
+
     /* flush blocking rules */
     sshguard_log(LOG_NOTICE, "Got exit signal, flushing blocked addresses and exiting...");
     fw_flush();
     if (fw_fin() != FWALL_OK) sshguard_log(LOG_ERR, "Cound not finalize firewall.");
     if (whitelist_fin() != 0) sshguard_log(LOG_ERR, "Could not finalize the whitelisting system.");
     if (procauth_fin() != 0) sshguard_log(LOG_ERR, "Could not finalize the process authorization subsystem.");
-    if (opts.has_polled_files) {
-        if (logsuck_fin() != 0) sshguard_log(LOG_ERR, "Could not finalize the log polling subsystem.");
+    if (blacklist_fin() != 0) sshguard_log(LOG_ERR, "Could not write the blacklist file, recent additions are lost.");
+    if (parser != NULL) {
+        parser_ctx_get_stats(parser, & lookups, & hits);
+        if (lookups > 0)
+            sshguard_log(LOG_INFO, "Messages repeated lately by the same source: %lu of %lu (%.1f%%), not parsed again.",
+                    hits, lookups, 100.0 * hits / lookups);
     }
+    if (blocked_lines > 0)
+        sshguard_log(LOG_INFO, "Lines from addresses blocked already: %lu, not parsed.", blocked_lines);
+    blocked_fin();
+    if (rstats.hits + rstats.negative_hits + rstats.misses > 0) {
+        sshguard_log(LOG_INFO, "Host names looked up: %lu, cached: %lu (%lu not resolving); resolved: %lu (%lu failed) in %.3f seconds on average, %.3f at most.",
+                rstats.hits + rstats.negative_hits + rstats.misses, rstats.hits + rstats.negative_hits, rstats.negative_hits,
+                rstats.resolutions, rstats.failures,
+                (rstats.resolutions > 0) ? rstats.total_latency / rstats.resolutions : 0.0, rstats.max_latency);
+    }
+    signatures_fin();
+    if (logsuck_fin() != 0) sshguard_log(LOG_ERR, "Could not finalize the log polling subsystem.");
     sshguard_log_fin();
 }
 
@@ -516,67 +825,103 @@ static int attackt_whenlast_comparator(const void *a, const void *b) {
     return ((aa->whenlast > bb->whenlast) - (aa->whenlast < bb->whenlast));
 }
 
+/* addresses and service codes of one kind, copied out of the blacklist for fw_block_list() */
+struct blacklist_collect {
+    int addrkind;
+    unsigned int num, max;          /* entries gathered, room for them */
+    unsigned int blocked;           /* entries blocked so far */
+    unsigned int total;             /* entries to block */
+    unsigned int next_report;       /* entries blocked when to report progress next */
+    char (*addresses)[ADDRLEN];     /* addresses to block */
+    int *service_codes;             /* service codes resp to the given addresses */
+};
+
+/* block the entries gathered, by chunks */
+static void block_collected(struct blacklist_collect *restrict coll) {
+    const char *chunk[BLACKLIST_BLOCK_CHUNK + 1];   /* NULL-terminated array of (string) addresses to block */
+    sshg_address_t address;
+    unsigned int first, i, n;
+
+    for (first = 0; first < coll->num; first += n) {
+        n = (coll->num - first < BLACKLIST_BLOCK_CHUNK ? coll->num - first : BLACKLIST_BLOCK_CHUNK);
+        for (i = 0; i < n; ++i)
+            chunk[i] = coll->addresses[first + i];
+        chunk[n] = NULL;
+        if (fw_block_list(chunk, coll->addrkind, & coll->service_codes[first]) != FWALL_OK) {
+            sshguard_log(LOG_CRIT, "While blocking blacklisted addresses, the firewall refused to block!");
+        } else {
+            /* lines of these addresses need no parsing either */
+            address.kind = coll->addrkind;
+            for (i = 0; i < n; ++i) {
+                memcpy(address.value, chunk[i], sizeof(address.value));
+                if (blocked_add(& address) != 0)
+                    sshguard_log(LOG_ERR, "Could not remember '%s' as blocked, its lines will be parsed.", address.value);
+            }
+        }
+        coll->blocked += n;
+        if (coll->blocked >= coll->next_report) {
+            sshguard_log(LOG_INFO, "Blocking blacklisted addresses: %u of %u done.", coll->blocked, coll->total);
+            coll->next_report = coll->blocked + coll->total / 10;
+        }
+    }
+    coll->num = 0;
+}
+
+/* callback for blacklist_foreach(): addresses are valid until it returns, so copy them */
+static void collect_blacklisted(const char *restrict address, int addrkind, int service, void *arg) {
+    struct blacklist_collect *coll = (struct blacklist_collect *)arg;
+    char (*newaddresses)[ADDRLEN];
+    int *newservices;
+    unsigned int newmax;
+
+    if (coll->num == coll->max) {
+        newmax = (coll->max > 0 ? 2 * coll->max : BLACKLIST_BLOCK_CHUNK);
+        newaddresses = realloc(coll->addresses, newmax * sizeof(coll->addresses[0]));
+        if (newaddresses != NULL) coll->addresses = newaddresses;
+        newservices = realloc(coll->service_codes, newmax * sizeof(coll->service_codes[0]));
+        if (newservices != NULL) coll->service_codes = newservices;
+        if (newaddresses == NULL || newservices == NULL) {
+            sshguard_log(LOG_ERR, "Out of memory, blacklisted address '%s' is not blocked.", address);
+            return;
+        }
+        coll->max = newmax;
+    }
+    memset(coll->addresses[coll->num], 0x00, ADDRLEN);
+    strncpy(coll->addresses[coll->num], address, ADDRLEN - 1);
+    coll->service_codes[coll->num] = service;
+    ++coll->num;
+}
+
 static void process_blacklisted_addresses() {
-    list_t *blacklist;
-    const char **addresses;         /* NULL-terminated array of (string) addresses to block:  char *addresses[]  */
-    int *restrict service_codes;    /* array of service codes resp to the given addresses */
-    int i;
+    struct blacklist_collect coll;
 
 
     /* if blacklist enabled, block blacklisted addresses */
     if (opts.blacklist_filename == NULL)
         return;
 
-    blacklist = blacklist_load(opts.blacklist_filename);
-    if (blacklist == NULL) {
-        sshguard_log(LOG_NOTICE, "Blacklist file '%s' doesn't exist, I'll create it for you.\n", opts.blacklist_filename);
-        if (blacklist_create(opts.blacklist_filename) != 0) {
-            /* write to both destinations to make sure the user notice it */
-            fprintf(stderr, "Unable to create a blacklist file at '%s'! Terminating.\n", opts.blacklist_filename);
-            sshguard_log(LOG_CRIT, "Unable to create a blacklist file at '%s'! Terminating.\n", opts.blacklist_filename);
-            exit(1);
-        }
-        blacklist = blacklist_load(opts.blacklist_filename);
+    if (blacklist_init(opts.blacklist_filename) != 0) {
+        /* write to both destinations to make sure the user notice it */
+        fprintf(stderr, "Unable to load a blacklist file at '%s'! Terminating.\n", opts.blacklist_filename);
+        sshguard_log(LOG_CRIT, "Unable to load a blacklist file at '%s'! Terminating.\n", opts.blacklist_filename);
+        exit(1);
     }
 
-    /* blacklist enabled */
-    assert(blacklist != NULL);
-    size_t num_blacklisted = list_size(blacklist);
-    sshguard_log(LOG_INFO, "Blacklist loaded, blocking %lu addresses.", (long unsigned int)num_blacklisted);
-    /* prepare to call fw_block_list() to block in bulk */
-    /* two runs, one for each address kind (but allocate arrays once) */
-    addresses = (const char **)malloc(sizeof(const char *) * (num_blacklisted+1));
-    service_codes = (int *restrict)malloc(sizeof(int) * num_blacklisted);
-    int addrkind;
-    for (addrkind = ADDRKIND_IPv4; addrkind != -1; addrkind = (addrkind == ADDRKIND_IPv4 ? ADDRKIND_IPv6 : -1)) {
-        /* extract from blacklist only addresses (and resp. codes) of type addrkind */
-        i = 0;
-        list_iterator_start(blacklist);
-        while (list_iterator_hasnext(blacklist)) {
-            const attacker_t *bl_attacker = list_iterator_next(blacklist);
-            if (bl_attacker->attack.address.kind != addrkind)
-                continue;
-            sshguard_log(LOG_DEBUG, "Loaded from blacklist (%d): '%s:%d', service %d, last seen %s.", i,
-                    bl_attacker->attack.address.value, bl_attacker->attack.address.kind, bl_attacker->attack.service,
-                    ctime(& bl_attacker->whenlast));
-            addresses[i] = bl_attacker->attack.address.value;
-            service_codes[i] = bl_attacker->attack.service;
-            ++i;
-        }
-        list_iterator_stop(blacklist);
-        /* terminate array list */
-        addresses[i] = NULL;
-        /* do block addresses of this kind */
-        if (fw_block_list(addresses, addrkind, service_codes) != FWALL_OK) {
-            sshguard_log(LOG_CRIT, "While blocking blacklisted addresses, the firewall refused to block!");
-        }
+    /* blacklist enabled, and mapped in memory from now on */
+    memset(& coll, 0x00, sizeof(coll));
+    coll.total = blacklist_size();
+    sshguard_log(LOG_INFO, "Blacklist loaded, blocking %u addresses.", coll.total);
+    /* report progress every tenth, of large blacklists only */
+    coll.next_report = (coll.total > BLACKLIST_BLOCK_CHUNK ? coll.total / 10 : coll.total + 1);
+    /* one run for each address kind, as fw_block_list() takes one kind at a time.
+     * The firewall is run after blacklist_foreach() returns, not holding the blacklist */
+    for (coll.addrkind = ADDRKIND_IPv4; coll.addrkind != -1; coll.addrkind = (coll.addrkind == ADDRKIND_IPv4 ? ADDRKIND_IPv6 : -1)) {
+        blacklist_foreach(coll.addrkind, collect_blacklisted, & coll);
+        block_collected(& coll);
     }
-    /* free temporary arrays */
-    free(addresses);
-    free(service_codes);
-    /* free blacklist stuff */
-    list_destroy(blacklist);
-    free(blacklist);
+    free(coll.addresses);
+    free(coll.service_codes);
+    sshguard_log(LOG_DEBUG, "Blocked %u blacklisted addresses.", coll.blocked);
 }
 
 static int my_pidfile_create() {
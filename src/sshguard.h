@@ -40,6 +40,19 @@
 /* default "weight" of an attack */
 #define DEFAULT_ATTACKS_DANGEROUSNESS           10
 
+/* default length of the longest log line handled. Longer lines are truncated */
+#define DEFAULT_MAX_LOGLINE_LEN     4096
+/* lines can't be configured shorter than this */
+#define MIN_LOGLINE_LEN             128
+/* nor longer than this */
+#define MAX_LOGLINE_LEN             (1024 * 1024)
+
+
+/* seconds between passes expiring blacklisted addresses (at most, when -x is shorter) */
+#define BLACKLIST_EXPIRY_INTERVAL   (60 * 60)
+
+/* blacklisted addresses handed to the firewall at once, at startup */
+#define BLACKLIST_BLOCK_CHUNK   16384
 
 /* maximum number of recent offenders to retain in memory at once */
 #define MAX_OFFENDER_ITEMS      15
@@ -49,4 +62,7 @@
 /* maximum file polling interval when logs are idle (millisecs) */
 #define MAX_LOGPOLL_INTERVAL    1000
 
+/* maximum number of syslog senders connected over TCP at once */
+#define MAX_TCP_CONNECTIONS     4096
+
 #endif
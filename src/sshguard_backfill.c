@@ -0,0 +1,526 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#include "config.h"
+
+/* timegm() is not POSIX, but glibc and the BSDs have it out of the strict modes */
+#undef _XOPEN_SOURCE
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#if defined(HAVE_LIBZ)
+#   include <zlib.h>
+#endif
+
+#include "fnv.h"
+
+#include "sshguard.h"
+#include "sshguard_log.h"
+#include "sshguard_logsuck.h"
+#include "sshguard_banner.h"
+#include "parser.h"
+
+#include "sshguard_backfill.h"
+
+
+/* rotated siblings looked for, as in file.0 ... file.N[.gz] */
+#define BACKFILL_MAX_ROTATIONS      10
+
+/* files read at once */
+#define BACKFILL_MAX_THREADS        8
+
+/* bytes inflated at once from compressed files */
+#define BACKFILL_INFLATE_CHUNK      (64 * 1024)
+
+/* suffix of compressed files */
+#define BACKFILL_GZ_SUFFIX          ".gz"
+
+/* an attack found in the past */
+typedef struct {
+    attack_t attack;
+    time_t when;                    /* time it was logged at */
+    int job;                        /* index of the file it was found in... */
+    unsigned int seq;               /* ... and position there, for keeping the order of same-time attacks */
+} found_attack_t;
+
+/* a file to read */
+typedef struct {
+    char path[PATH_MAX];
+    int compressed;                 /* is it gzip-compressed? */
+    off_t limit;                    /* read up to here, or -1 for the whole file */
+    sourceid_t source_id;           /* ID for the parser */
+
+    found_attack_t *found;          /* attacks found ... */
+    size_t num_found;               /* ... how many ... */
+    size_t size_found;              /* ... and how many fit */
+} backfill_job_t;
+
+
+/* jobs, and next to be taken by workers */
+static backfill_job_t *jobs;
+static int num_jobs;
+static int next_job;
+static pthread_mutex_t jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* take lines logged since this time */
+static time_t since_time;
+/* current time, to tell the year of syslog timestamps */
+static time_t now_time;
+static struct tm now_tm;
+/* longest line handled */
+static size_t max_line_len;
+
+
+/* add the file and its rotated siblings to jobs. Return 0 on success, -1 on error */
+static int add_jobs(const char *restrict filename, off_t tail_offset);
+static int add_job(const char *restrict path, off_t limit);
+static void *worker(void *par);
+/* what a worker needs for reading files */
+typedef struct {
+    parser_ctx_t *parser;           /* parser of its own */
+    char *linebuf;                  /* room for the line being parsed */
+} worker_state_t;
+
+static void read_plain(backfill_job_t *restrict job, worker_state_t *restrict ws);
+#if defined(HAVE_LIBZ)
+static void read_compressed(backfill_job_t *restrict job, worker_state_t *restrict ws);
+#endif
+/* process complete lines in data. Return bytes consumed */
+static size_t process_lines(backfill_job_t *restrict job, const char *restrict data, size_t len, worker_state_t *restrict ws);
+static void process_line(backfill_job_t *restrict job, const char *restrict line, size_t len, worker_state_t *restrict ws);
+/* get the time a line was logged at, or -1 if unknown */
+static time_t line_timestamp(const char *restrict line);
+static int found_attack_comparator(const void *a, const void *b);
+
+
+int backfill_run(time_t since, size_t maxlinelen, backfill_report_t report) {
+    const char *names[MAX_FILES_POLLED];
+    off_t tail_offsets[MAX_FILES_POLLED];
+    pthread_t threads[BACKFILL_MAX_THREADS];
+    found_attack_t *all_found;
+    size_t num_found, attack;
+    int num_files, num_threads, i;
+
+    assert(report != NULL);
+
+    since_time = since;
+    now_time = time(NULL);
+    localtime_r(& now_time, & now_tm);
+    max_line_len = maxlinelen;
+
+    /* collect files to read */
+    jobs = NULL;
+    num_jobs = next_job = 0;
+    num_files = logsuck_list_files(names, tail_offsets, MAX_FILES_POLLED);
+    for (i = 0; i < num_files; ++i) {
+        if (add_jobs(names[i], tail_offsets[i]) != 0) {
+            free(jobs);
+            return -1;
+        }
+    }
+    if (num_jobs == 0) return 0;
+
+    /* read them in parallel */
+    sshguard_log(LOG_INFO, "Looking for attacks in %d log files since %lld seconds ago.", num_jobs, (long long int)(now_time - since));
+    num_threads = (num_jobs < BACKFILL_MAX_THREADS ? num_jobs : BACKFILL_MAX_THREADS);
+    for (i = 0; i < num_threads; ++i) {
+        if (pthread_create(& threads[i], NULL, worker, NULL) != 0) {
+            sshguard_log(LOG_ERR, "Unable to start thread for reading past logs: %s.", strerror(errno));
+            break;
+        }
+    }
+    if (i == 0) {
+        /* do it myself */
+        worker(NULL);
+    }
+    num_threads = i;
+    for (i = 0; i < num_threads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    /* put attacks from all files in chronological order */
+    num_found = 0;
+    for (i = 0; i < num_jobs; ++i) num_found += jobs[i].num_found;
+    all_found = (found_attack_t *)malloc((num_found > 0 ? num_found : 1) * sizeof(found_attack_t));
+    if (all_found == NULL) {
+        for (i = 0; i < num_jobs; ++i) free(jobs[i].found);
+        free(jobs);
+        return -1;
+    }
+    num_found = 0;
+    for (i = 0; i < num_jobs; ++i) {
+        if (jobs[i].num_found > 0)
+            memcpy(all_found + num_found, jobs[i].found, jobs[i].num_found * sizeof(found_attack_t));
+        num_found += jobs[i].num_found;
+        free(jobs[i].found);
+    }
+    free(jobs);
+    jobs = NULL;
+    qsort(all_found, num_found, sizeof(found_attack_t), found_attack_comparator);
+
+    /* replay them */
+    for (attack = 0; attack < num_found; ++attack) {
+        report(all_found[attack].attack, all_found[attack].when);
+    }
+    free(all_found);
+
+    sshguard_log(LOG_INFO, "Found %lu attacks in past logs.", (unsigned long)num_found);
+
+    return (int)num_found;
+}
+
+
+static int add_jobs(const char *restrict filename, off_t tail_offset) {
+    char path[PATH_MAX];
+    struct stat fileinfo;
+    int rot, gz;
+
+    /* the current file, up to where tailing began */
+    if (add_job(filename, tail_offset) != 0) return -1;
+
+    /* its rotated siblings, if updated recently enough to contain anything of interest */
+    for (rot = 0; rot <= BACKFILL_MAX_ROTATIONS; ++rot) {
+        for (gz = 0; gz < 2; ++gz) {
+            if (snprintf(path, sizeof(path), "%s.%d%s", filename, rot, (gz ? BACKFILL_GZ_SUFFIX : "")) >= (int)sizeof(path))
+                continue;
+            if (stat(path, & fileinfo) != 0 || ! S_ISREG(fileinfo.st_mode)) continue;
+            if (fileinfo.st_mtime < since_time) continue;
+            if (add_job(path, -1) != 0) return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int add_job(const char *restrict path, off_t limit) {
+    backfill_job_t *newjobs;
+    backfill_job_t *job;
+    size_t len;
+
+    newjobs = (backfill_job_t *)realloc(jobs, (num_jobs + 1) * sizeof(backfill_job_t));
+    if (newjobs == NULL) {
+        sshguard_log(LOG_ERR, "Unable to allocate memory for reading past logs.");
+        return -1;
+    }
+    jobs = newjobs;
+
+    job = & jobs[num_jobs];
+    strcpy(job->path, path);
+    len = strlen(path);
+    job->compressed = (len > strlen(BACKFILL_GZ_SUFFIX) && strcmp(path + len - strlen(BACKFILL_GZ_SUFFIX), BACKFILL_GZ_SUFFIX) == 0);
+    job->limit = limit;
+    job->source_id = fnv_32a_str(path, 0);
+    job->found = NULL;
+    job->num_found = job->size_found = 0;
+
+#if ! defined(HAVE_LIBZ)
+    if (job->compressed) {
+        sshguard_log(LOG_INFO, "Skipping compressed log '%s': built without zlib.", path);
+        return 0;
+    }
+#endif
+
+    ++num_jobs;
+    return 0;
+}
+
+static void *worker(void *par) {
+    backfill_job_t *job;
+    worker_state_t ws;
+    int idx;
+
+    (void)par;
+
+    /* one byte more for the parser, which scans lines in place */
+    ws.linebuf = (char *)malloc(max_line_len + 1);
+    ws.parser = parser_ctx_new();
+    if (ws.linebuf == NULL || ws.parser == NULL) {
+        sshguard_log(LOG_ERR, "Unable to set up thread for reading past logs.");
+        free(ws.linebuf);
+        if (ws.parser != NULL) parser_ctx_free(ws.parser);
+        return NULL;
+    }
+
+    while (1) {
+        pthread_mutex_lock(& jobs_mutex);
+        idx = next_job++;
+        pthread_mutex_unlock(& jobs_mutex);
+        if (idx >= num_jobs) break;
+
+        job = & jobs[idx];
+        sshguard_log(LOG_DEBUG, "Reading past log '%s'.", job->path);
+#if defined(HAVE_LIBZ)
+        if (job->compressed)
+            read_compressed(job, & ws);
+        else
+#endif
+            read_plain(job, & ws);
+
+        /* the parser won't hear again from this file */
+        parse_forget_source(ws.parser, job->source_id);
+    }
+
+    parser_ctx_free(ws.parser);
+    free(ws.linebuf);
+    return NULL;
+}
+
+/* map a file in memory. Return the mapping, or NULL if empty or on error */
+static void *map_file(const char *restrict path, off_t limit, size_t *restrict len) {
+    struct stat fileinfo;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        sshguard_log(LOG_NOTICE, "Unable to open past log '%s': %s.", path, strerror(errno));
+        return NULL;
+    }
+    if (fstat(fd, & fileinfo) != 0) {
+        close(fd);
+        return NULL;
+    }
+    *len = fileinfo.st_size;
+    if (limit >= 0 && limit < fileinfo.st_size) *len = limit;
+    if (*len == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    map = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        sshguard_log(LOG_NOTICE, "Unable to map past log '%s': %s.", path, strerror(errno));
+        return NULL;
+    }
+
+    return map;
+}
+
+static void read_plain(backfill_job_t *restrict job, worker_state_t *restrict ws) {
+    const char *data;
+    size_t len, done;
+
+    data = (const char *)map_file(job->path, job->limit, & len);
+    if (data == NULL) return;
+
+    done = process_lines(job, data, len, ws);
+    if (done < len && job->limit < 0) {
+        /* last line of a rotated file, without newline */
+        process_line(job, data + done, len - done, ws);
+    }
+
+    munmap((void *)data, len);
+}
+
+#if defined(HAVE_LIBZ)
+static void read_compressed(backfill_job_t *restrict job, worker_state_t *restrict ws) {
+    z_stream zs;
+    unsigned char *data;
+    char *outbuf;
+    size_t len, outsize, have, done;
+    int ret;
+
+    data = (unsigned char *)map_file(job->path, -1, & len);
+    if (data == NULL) return;
+
+    /* room for a chunk of inflated data, plus a partial line from the previous one */
+    outsize = BACKFILL_INFLATE_CHUNK + max_line_len;
+    outbuf = (char *)malloc(outsize);
+    memset(& zs, 0x00, sizeof(zs));
+    /* 32: detect gzip header */
+    if (outbuf == NULL || inflateInit2(& zs, 15 + 32) != Z_OK) {
+        sshguard_log(LOG_ERR, "Unable to inflate past log '%s'.", job->path);
+        free(outbuf);
+        munmap(data, len);
+        return;
+    }
+    zs.next_in = data;
+    zs.avail_in = len;
+
+    have = 0;
+    while (1) {
+        zs.next_out = (unsigned char *)outbuf + have;
+        zs.avail_out = outsize - have;
+        ret = inflate(& zs, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            sshguard_log(LOG_NOTICE, "Error inflating past log '%s': %s.", job->path, (zs.msg != NULL ? zs.msg : "corrupt data"));
+            break;
+        }
+        have = outsize - zs.avail_out;
+
+        done = process_lines(job, outbuf, have, ws);
+        if (done == 0 && have == outsize) {
+            /* line longer than allowed: take its head */
+            process_line(job, outbuf, have, ws);
+            done = have;
+        }
+        memmove(outbuf, outbuf + done, have - done);
+        have -= done;
+
+        if (ret == Z_STREAM_END) {
+            if (zs.avail_in == 0) break;
+            /* concatenated gzip members */
+            inflateReset(& zs);
+        } else if (ret == Z_BUF_ERROR && zs.avail_in == 0) {
+            /* truncated file */
+            break;
+        }
+    }
+    if (have > 0) {
+        /* last line, without newline */
+        process_line(job, outbuf, have, ws);
+    }
+
+    inflateEnd(& zs);
+    free(outbuf);
+    munmap(data, len);
+}
+#endif
+
+static size_t process_lines(backfill_job_t *restrict job, const char *restrict data, size_t len, worker_state_t *restrict ws) {
+    const char *nl;
+    size_t pos = 0;
+
+    while (pos < len && (nl = memchr(data + pos, '\n', len - pos)) != NULL) {
+        process_line(job, data + pos, nl - (data + pos), ws);
+        pos = nl - data + 1;
+    }
+
+    return pos;
+}
+
+static void process_line(backfill_job_t *restrict job, const char *restrict line, size_t len, worker_state_t *restrict ws) {
+    char *linebuf = ws->linebuf;
+    found_attack_t *found;
+    time_t when;
+
+    if (len > 0 && line[len-1] == '\r') --len;
+    if (len == 0) return;
+    if (len >= max_line_len) len = max_line_len - 1;
+    memcpy(linebuf, line, len);
+    linebuf[len] = '\0';
+
+    /* old enough to forget, or unknown age? */
+    when = line_timestamp(linebuf);
+    if (when == (time_t)-1 || when < since_time) return;
+
+    /* make room for an attack */
+    if (job->num_found == job->size_found) {
+        size_t newsize = (job->size_found == 0 ? 64 : 2 * job->size_found);
+        found = (found_attack_t *)realloc(job->found, newsize * sizeof(found_attack_t));
+        if (found == NULL) return;
+        job->found = found;
+        job->size_found = newsize;
+    }
+
+    found = & job->found[job->num_found];
+    if (parse_line(ws->parser, job->source_id, linebuf, & found->attack) == 0) {
+        found->when = when;
+        found->job = job - jobs;
+        found->seq = job->num_found;
+        ++job->num_found;
+    }
+}
+
+static time_t line_timestamp(const char *restrict line) {
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    const char *month;
+    struct tm tm;
+    time_t when;
+    int len, offhour, offmin;
+
+    memset(& tm, 0x00, sizeof(tm));
+    tm.tm_isdst = -1;
+
+    /* RFC 5424 puts "<PRI>1 " ahead of the timestamp */
+    line = banner_skip_priority(line);
+    if (line[0] == '1' && line[1] == ' ') line += 2;
+
+    if (isdigit((unsigned char)line[0])) {
+        /* RFC 3339, as in "2011-10-16T12:00:00.123+02:00" */
+        if (sscanf(line, "%4d-%2d-%2dT%2d:%2d:%2d%n", & tm.tm_year, & tm.tm_mon, & tm.tm_mday, & tm.tm_hour, & tm.tm_min, & tm.tm_sec, & len) != 6)
+            return (time_t)-1;
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        line += len;
+        /* fraction of second */
+        if (*line == '.') {
+            do ++line; while (isdigit((unsigned char)*line));
+        }
+        if (*line == 'Z' || *line == 'z')
+            return timegm(& tm);
+        if ((*line == '+' || *line == '-') && sscanf(line + 1, "%2d:%2d", & offhour, & offmin) == 2) {
+            when = timegm(& tm);
+            if (when == (time_t)-1) return when;
+            /* local time is ahead of UTC by a positive offset */
+            return (*line == '+') ? when - (offhour * 60 + offmin) * 60 : when + (offhour * 60 + offmin) * 60;
+        }
+        /* no zone, as some loggers do: take it as local time */
+        return mktime(& tm);
+    }
+
+    /* syslog, as in "Oct 16 12:00:00": no year */
+    if (strlen(line) < 15) return (time_t)-1;
+    for (month = months; *month != '\0'; month += 3) {
+        if (strncmp(line, month, 3) == 0) break;
+    }
+    if (*month == '\0') return (time_t)-1;
+    tm.tm_mon = (month - months) / 3;
+    if (sscanf(line + 3, " %d %d:%d:%d", & tm.tm_mday, & tm.tm_hour, & tm.tm_min, & tm.tm_sec) != 4)
+        return (time_t)-1;
+
+    /* this year, unless that is in the future */
+    tm.tm_year = now_tm.tm_year;
+    when = mktime(& tm);
+    if (when != (time_t)-1 && when > now_time + 24*60*60) {
+        memset(& tm, 0x00, sizeof(tm));
+        tm.tm_isdst = -1;
+        tm.tm_mon = (month - months) / 3;
+        sscanf(line + 3, " %d %d:%d:%d", & tm.tm_mday, & tm.tm_hour, & tm.tm_min, & tm.tm_sec);
+        tm.tm_year = now_tm.tm_year - 1;
+        when = mktime(& tm);
+    }
+
+    return when;
+}
+
+static int found_attack_comparator(const void *a, const void *b) {
+    const found_attack_t *fa = (const found_attack_t *)a;
+    const found_attack_t *fb = (const found_attack_t *)b;
+
+    if (fa->when != fb->when) return (fa->when < fb->when ? -1 : 1);
+    if (fa->job != fb->job) return fa->job - fb->job;
+    return (fa->seq < fb->seq ? -1 : (fa->seq > fb->seq));
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#ifndef SSHGUARD_BACKFILL_H
+#define SSHGUARD_BACKFILL_H
+
+#include <time.h>
+#include <stddef.h>
+
+#include "sshguard_attack.h"
+
+
+/* receives attacks found in the past, in the order they happened */
+typedef void (*backfill_report_t)(attack_t attack, time_t when);
+
+/**
+ * Look for attacks logged since a given time in the text files being
+ * polled, and in their rotated siblings ("file.1", "file.2.gz" ...).
+ *
+ * Files are read in parallel; compressed ones are inflated on the fly.
+ * Lines are taken only if their timestamp is known and not older than
+ * since. Attacks found are then passed to report in chronological order,
+ * with the time they were logged at.
+ *
+ * @param maxlinelen    longest line handled; longer ones are truncated
+ *
+ * @return number of attacks reported, or -1 on error
+ */
+int backfill_run(time_t since, size_t maxlinelen, backfill_report_t report);
+
+#endif
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#include <string.h>
+#include <strings.h>
+
+#include "sshguard_banner.h"
+
+
+/* what sshguard calls itself in its own log messages */
+#define SELF_PROGRAM_NAME           "sshguard"
+
+/* length of a TAI64N timestamp in hex digits */
+#define TAI64N_DIGITS               24
+
+#define IS_DIGIT(c)     ((c) >= '0' && (c) <= '9')
+
+static const char *skip_blanks(const char *str) {
+    while (*str == ' ') ++str;
+    return str;
+}
+
+/* match "Mmm dd hh:mm:ss" as the scanner's TIMESTAMP_SYSLOG; return what follows it, or NULL */
+static const char *match_syslog_timestamp(const char *str) {
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    int i;
+
+    for (i = 0; i < 36; i += 3) {
+        if (strncmp(str, months + i, 3) == 0) break;
+    }
+    if (i == 36 || str[3] != ' ') return NULL;
+    str = skip_blanks(str + 3);
+
+    /* day: 1-31, no leading zero */
+    if (*str < '1' || *str > '9') return NULL;
+    ++str;
+    if (IS_DIGIT(*str)) ++str;
+    if (*str != ' ') return NULL;
+    str = skip_blanks(str);
+
+    /* hh:mm:ss */
+    if (! (((str[0] == '0' || str[0] == '1') && IS_DIGIT(str[1])) || (str[0] == '2' && str[1] >= '0' && str[1] <= '4')))
+        return NULL;
+    if (str[2] != ':' || str[3] < '0' || str[3] > '5' || ! IS_DIGIT(str[4])) return NULL;
+    if (str[5] != ':' || str[6] < '0' || str[6] > '5' || ! IS_DIGIT(str[7])) return NULL;
+    return str + 8;
+}
+
+/* skip one RFC 5424 header field and the space after it; NULL if there is no such field */
+static const char *skip_field(const char *str) {
+    const char *cur;
+
+    for (cur = str; *cur != '\0' && *cur != ' '; ++cur);
+    return (cur == str || *cur != ' ') ? NULL : cur + 1;
+}
+
+/* skip RFC 5424 structured data: "-", or "[id param="value" ...]..." where
+ * values can hold "\]" and "\"". Return what follows it, or NULL */
+static const char *skip_structured_data(const char *str) {
+    const char *cur = str;
+    int quoted;
+
+    if (*cur == '-') return cur + 1;
+
+    while (*cur == '[') {
+        for (quoted = 0, ++cur; *cur != '\0'; ++cur) {
+            if (quoted) {
+                if (*cur == '\\' && cur[1] != '\0') ++cur;
+                else if (*cur == '"') quoted = 0;
+            } else if (*cur == '"') {
+                quoted = 1;
+            } else if (*cur == ']') {
+                break;
+            }
+        }
+        if (*cur != ']') return NULL;
+        ++cur;
+    }
+
+    return (cur == str) ? NULL : cur;
+}
+
+/* split an RFC 5424 banner "1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID SD [MSG]"
+ * (after PRI), where "-" stands for unknown fields. 0 on success */
+static int split_rfc5424(const char *line, log_banner_t *banner) {
+    const char *cur, *next;
+    pid_t pid;
+
+    /* version */
+    if (line[0] != '1' || line[1] != ' ') return -1;
+
+    /* timestamp and host */
+    cur = line + 2;
+    if ((next = skip_field(cur)) == NULL) return -1;
+    if (*cur != '-') banner->timestamp = cur;
+    cur = next;
+    if ((next = skip_field(cur)) == NULL) return -1;
+    if (*cur != '-') {
+        banner->host = cur;
+        banner->hostlen = next - 1 - cur;
+    }
+    cur = next;
+
+    /* program and its pid, if numeric */
+    if ((next = skip_field(cur)) == NULL) return -1;
+    if (*cur != '-' || next - 1 - cur > 1) {
+        banner->program = cur;
+        banner->programlen = next - 1 - cur;
+    }
+    cur = next;
+    if ((next = skip_field(cur)) == NULL) return -1;
+    for (pid = 0; IS_DIGIT(*cur); ++cur) {
+        pid = pid * 10 + (*cur - '0');
+    }
+    if (cur == next - 1) banner->pid = pid;
+    cur = next;
+
+    /* message ID, structured data, then the message (possibly none) */
+    if ((cur = skip_field(cur)) == NULL) return -1;
+    if ((cur = skip_structured_data(cur)) == NULL) return -1;
+    if (*cur == ' ') {
+        ++cur;
+        /* UTF-8 byte order mark */
+        if (strncmp(cur, "\xEF\xBB\xBF", 3) == 0) cur += 3;
+    } else if (*cur != '\0') {
+        return -1;
+    }
+    banner->message = cur;
+
+    return 0;
+}
+
+/* skip a Solaris message tag "[ID 123456 auth.info]", if any */
+static const char *skip_solaris_msgid(const char *str) {
+    const char *cur;
+
+    if (strncmp(str, "[ID ", 4) != 0) return str;
+    for (cur = str + 4; IS_DIGIT(*cur); ++cur);
+    if (cur == str + 4 || *cur != ' ') return str;
+    cur = strchr(cur, ']');
+    return (cur == NULL) ? str : cur + 1;
+}
+
+/* take "program[pid]: " or "program: " at str, if there; return the message start */
+static const char *split_program(const char *str, log_banner_t *banner) {
+    const char *cur;
+    pid_t pid;
+
+    for (cur = str; *cur != '\0' && *cur != ' ' && *cur != '[' && *cur != ':'; ++cur);
+    if (cur == str) return str;
+
+    if (*cur == ':') {
+        banner->program = str;
+        banner->programlen = cur - str;
+        return cur + 1;
+    }
+
+    if (*cur == '[' && IS_DIGIT(cur[1])) {
+        const char *pidstart = cur + 1;
+        for (pid = 0, ++cur; IS_DIGIT(*cur); ++cur) {
+            pid = pid * 10 + (*cur - '0');
+        }
+        if (cur[0] == ']' && cur[1] == ':') {
+            banner->program = str;
+            banner->programlen = pidstart - 1 - str;
+            banner->pid = pid;
+            return skip_solaris_msgid(skip_blanks(cur + 2));
+        }
+    }
+
+    /* no program name: the message starts right after the host */
+    return str;
+}
+
+const char *banner_skip_priority(const char *line) {
+    const char *cur;
+
+    if (line[0] != '<') return line;
+    for (cur = line + 1; cur < line + 4 && IS_DIGIT(*cur); ++cur);
+    return (cur > line + 1 && *cur == '>') ? cur + 1 : line;
+}
+
+int banner_split(const char *restrict line, log_banner_t *restrict banner) {
+    const char *cur;
+
+    memset(banner, 0x00, sizeof(log_banner_t));
+
+    /* "<PRI>", as sent over the network */
+    line = banner_skip_priority(line);
+
+    /* RFC 5424, told by its version right after PRI */
+    if (line[0] == '1' && line[1] == ' ') {
+        if (split_rfc5424(line, banner) == 0) return 0;
+        memset(banner, 0x00, sizeof(log_banner_t));
+        return -1;
+    }
+
+    /* multilog: "@" TAI64N timestamp */
+    if (line[0] == '@') {
+        for (cur = line + 1; cur < line + 1 + TAI64N_DIGITS; ++cur) {
+            if (! IS_DIGIT(*cur) && ! ((*cur | 0x20) >= 'a' && (*cur | 0x20) <= 'f')) return -1;
+        }
+        if (*cur != ' ') return -1;
+        banner->message = skip_blanks(cur);
+        return 0;
+    }
+
+    cur = match_syslog_timestamp(line);
+    if (cur == NULL || *cur != ' ') return -1;
+    banner->timestamp = line;
+    cur = skip_blanks(cur);
+
+    /* metalog: timestamp "[program] " */
+    if (*cur == '[') {
+        const char *end = strchr(cur, ']');
+        if (end == NULL || end == cur + 1 || end[1] != ' ') return -1;
+        banner->program = cur + 1;
+        banner->programlen = end - cur - 1;
+        banner->message = skip_blanks(end + 1);
+        return 0;
+    }
+
+    /* syslog: timestamp host [program[[pid]]:] */
+    banner->host = cur;
+    while (*cur != '\0' && *cur != ' ') ++cur;
+    banner->hostlen = cur - banner->host;
+    if (banner->hostlen == 0 || *cur != ' ') return -1;
+    cur = skip_blanks(cur);
+
+    banner->message = skip_blanks(split_program(cur, banner));
+    return 0;
+}
+
+int banner_is_self(const log_banner_t *restrict banner) {
+    return banner_program_is_self(banner->program, banner->programlen);
+}
+
+int banner_program_is_self(const char *restrict program, size_t programlen) {
+    return (programlen == sizeof(SELF_PROGRAM_NAME)-1
+            && strncasecmp(program, SELF_PROGRAM_NAME, programlen) == 0);
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#ifndef SSHGUARD_BANNER_H
+#define SSHGUARD_BANNER_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* parts of a log banner. Strings point into the line split, which is untouched */
+typedef struct {
+    const char *timestamp;      /* "Mmm dd hh:mm:ss", RFC 3339 (RFC 5424), or NULL (multilog) */
+    const char *host;           /* hostname, or NULL (metalog, multilog) */
+    size_t hostlen;
+    const char *program;        /* program name, or NULL if the banner has none */
+    size_t programlen;
+    pid_t pid;                  /* pid of the program, 0 if not given */
+    const char *message;        /* payload following the banner */
+} log_banner_t;
+
+/**
+ * Skip the "<PRI>" syslog puts ahead of messages sent over the network.
+ *
+ * @return what follows "<PRI>", or line itself if it has none
+ */
+const char *banner_skip_priority(const char *line);
+
+/**
+ * Split a log line into its banner and message, if it is from syslog
+ * ("Nov 22 09:58:58 freyja sshd[94637]: ..."), metalog
+ * ("Nov 22 09:58:58 [sshd] ..."), multilog ("@400000004b0d... ...") or
+ * RFC 5424 syslog ("<38>1 2011-11-22T09:58:58Z freyja sshd 94637 - - ...",
+ * whose structured data is skipped). Lines may start with "<PRI>".
+ *
+ * This takes a single pass on the banner and allocates nothing.
+ *
+ * @return 0 if the line has a banner (then banner is filled in), -1 if not
+ */
+int banner_split(const char *restrict line, log_banner_t *restrict banner);
+
+/**
+ * Tell if a banner is from sshguard itself, whose messages are never attacks.
+ *
+ * @return 1 if the banner is from sshguard, 0 otherwise
+ */
+int banner_is_self(const log_banner_t *restrict banner);
+
+/**
+ * Tell if a program name (not NUL-terminated) is that of sshguard itself,
+ * as banner_is_self() does for banners.
+ *
+ * @return 1 if program is sshguard, 0 otherwise
+ */
+int banner_program_is_self(const char *restrict program, size_t programlen);
+
+#endif
@@ -0,0 +1,576 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+/*
+ * Timings of the hot paths of sshguard, and a check of the attacks found in
+ * a sample log. Built and run by "make check" on sshguard_bench.log, whose
+ * "# attacks: N" line tells how many attacks must be found there; or by hand:
+ *
+ *  sshguard_bench [-n rounds] [-t threads] [-b entries] [-w entries] [logfile]
+ *
+ * -b gives the entries of the blacklist timed, -w the most entries of the
+ * whitelists timed (10, 1000, ... up to that, and that in a file). Their
+ * files are made up in a temporary directory.
+ *
+ * Exits 1 if the attacks found are not as many as told by the log, or if
+ * the blacklist loses more than the record torn at the end of its journal.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+
+#include "parser.h"
+#include "sshguard_log.h"
+#include "sshguard_procauth.h"
+#include "sshguard_prefilter.h"
+#include "sshguard_banner.h"
+#include "sshguard_attack.h"
+#include "sshguard_blacklist.h"
+#include "sshguard_whitelist.h"
+
+/* default rounds over the lines of the log */
+#define BENCH_ROUNDS            2000
+/* default threads parsing at the same time */
+#define BENCH_THREADS           4
+/* longest line taken from the log */
+#define BENCH_MAX_LINE_LEN      4096
+/* length of the made-up lines for timing the scanner on long lines */
+#define BENCH_LONG_LINE_LEN     3000
+/* default entries of the blacklist */
+#define BENCH_BLACKLIST_ENTRIES 10000
+/* default most entries of the whitelists */
+#define BENCH_WHITELIST_ENTRIES 100000
+/* entries added to the blacklist reloaded, before tearing its journal */
+#define BENCH_BLACKLIST_APPENDS 100
+/* addresses looked up in the blacklist and whitelist */
+#define BENCH_LOOKUPS           200000
+
+/* lines of the log */
+static char **lines;
+static unsigned int num_lines;
+static size_t total_bytes;
+
+/* rounds for each parsing thread */
+static unsigned int thread_rounds;
+
+/* addresses looked up in the blacklist and whitelist, made up beforehand */
+static char lookups[BENCH_LOOKUPS][ADDRLEN];
+
+
+static int load_log(const char *restrict filename, int *restrict expected);
+static int check_attacks(int expected);
+static void bench_prefilter(unsigned int rounds);
+static void bench_long_lines(unsigned int count);
+static void bench_parser(unsigned int rounds, unsigned int threads);
+static int bench_blacklist(const char *restrict dir, unsigned int entries);
+static void expired_entry(const char *restrict address, int addrkind, int service, void *arg);
+static int bench_whitelist(unsigned int entries);
+static int bench_whitelist_file(const char *restrict dir, unsigned int entries);
+static void *parse_rounds(void *par);
+static void make_address(char *restrict buf, size_t len, unsigned int n, int masked);
+static void make_lookups(unsigned int entries);
+static void clean_dir(const char *restrict dir);
+static double seconds_since(const struct timeval *restrict start);
+
+
+int main(int argc, char *argv[]) {
+    char defaultlog[BENCH_MAX_LINE_LEN], tmpdir[BENCH_MAX_LINE_LEN];
+    const char *logfile, *srcdir;
+    unsigned int rounds = BENCH_ROUNDS, threads = BENCH_THREADS;
+    unsigned int bl_entries = BENCH_BLACKLIST_ENTRIES, wl_entries = BENCH_WHITELIST_ENTRIES, n;
+    int expected, optch;
+
+    while ((optch = getopt(argc, argv, "n:t:b:w:")) != -1) {
+        switch (optch) {
+            case 'n':
+                rounds = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                threads = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                bl_entries = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            case 'w':
+                wl_entries = (unsigned int)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n rounds] [-t threads] [-b entries] [-w entries] [logfile]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (rounds == 0) rounds = 1;
+    if (threads == 0) threads = 1;
+
+    /* "make check" runs from the build directory */
+    if (optind < argc) {
+        logfile = argv[optind];
+    } else {
+        srcdir = getenv("srcdir");
+        snprintf(defaultlog, sizeof(defaultlog), "%s/sshguard_bench.log", (srcdir != NULL ? srcdir : "."));
+        logfile = defaultlog;
+    }
+
+    sshguard_log_init(0);
+    /* the parser asks it about the pids in log banners */
+    procauth_init();
+
+    if (load_log(logfile, & expected) != 0) {
+        fprintf(stderr, "Unable to read sample log '%s'.\n", logfile);
+        return 1;
+    }
+    /* timings of "configure --enable-fast-parser" builds differ */
+#ifdef FAST_PARSER
+    printf("Parser profile: fast.\n");
+#else
+    printf("Parser profile: default.\n");
+#endif
+    printf("%s: %u lines, %lu bytes.\n", logfile, num_lines, (unsigned long)total_bytes);
+
+    if (check_attacks(expected) != 0) return 1;
+
+    bench_prefilter(rounds);
+    bench_parser(rounds, 1);
+    if (threads > 1) bench_parser(rounds, threads);
+    bench_long_lines(rounds);
+
+    /* blacklist and whitelist files go in a directory of their own */
+    snprintf(tmpdir, sizeof(tmpdir), "%s/sshguard_bench.XXXXXX", (getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp"));
+    if (mkdtemp(tmpdir) == NULL) {
+        fprintf(stderr, "Unable to make a temporary directory.\n");
+        return 1;
+    }
+    if (bl_entries > 0 && bench_blacklist(tmpdir, bl_entries) != 0) {
+        clean_dir(tmpdir);
+        return 1;
+    }
+    for (n = 10; n <= wl_entries; n *= 100) {
+        if (bench_whitelist(n) != 0) {
+            clean_dir(tmpdir);
+            return 1;
+        }
+    }
+    if (wl_entries > 0 && bench_whitelist_file(tmpdir, wl_entries) != 0) {
+        clean_dir(tmpdir);
+        return 1;
+    }
+    clean_dir(tmpdir);
+
+    sshguard_log_fin();
+    return 0;
+}
+
+
+/* take the lines of filename, and the count of attacks it tells (-1 if none) */
+static int load_log(const char *restrict filename, int *restrict expected) {
+    char buf[BENCH_MAX_LINE_LEN];
+    unsigned int size = 0;
+    size_t len;
+    FILE *f;
+
+    f = fopen(filename, "r");
+    if (f == NULL) return -1;
+
+    *expected = -1;
+    while (fgets(buf, sizeof(buf), f) != NULL) {
+        len = strcspn(buf, "\n");
+        buf[len] = '\0';
+        if (buf[0] == '#') {
+            /* comment, or the count of attacks */
+            sscanf(buf, "# attacks: %d", expected);
+            continue;
+        }
+        if (num_lines == size) {
+            size = (size == 0 ? 128 : 2 * size);
+            lines = (char **)realloc(lines, size * sizeof(char *));
+        }
+        if (lines == NULL || (lines[num_lines] = strdup(buf)) == NULL) {
+            fclose(f);
+            return -1;
+        }
+        total_bytes += len + 1;
+        ++num_lines;
+    }
+    fclose(f);
+
+    return (num_lines > 0) ? 0 : -1;
+}
+
+/* parse the log once, and compare the attacks found with those expected */
+static int check_attacks(int expected) {
+    char buf[BENCH_MAX_LINE_LEN + 2];
+    parser_ctx_t *parser;
+    attack_t attack;
+    unsigned int i;
+    int found = 0;
+
+    parser = parser_ctx_new();
+    if (parser == NULL) return -1;
+    for (i = 0; i < num_lines; ++i) {
+        strcpy(buf, lines[i]);
+        if (parse_line(parser, 0, buf, & attack) == 0) ++found;
+    }
+    parser_ctx_free(parser);
+
+    if (expected >= 0 && found != expected) {
+        /* tell what was found, to compare with the log */
+        printf("FAIL: %d attacks found, %d expected:\n", found, expected);
+        parser = parser_ctx_new();
+        for (i = 0; i < num_lines; ++i) {
+            strcpy(buf, lines[i]);
+            if (parse_line(parser, 0, buf, & attack) == 0)
+                printf("  %-16s %s\n", attack.address.value, lines[i]);
+        }
+        parser_ctx_free(parser);
+        return -1;
+    }
+    printf("Attacks found: %d.\n", found);
+    return 0;
+}
+
+/* time the prefilter alone, on the messages the parser would give it */
+static void bench_prefilter(unsigned int rounds) {
+    log_banner_t banner;
+    struct timeval start;
+    unsigned int r, i, candidates = 0;
+    double secs;
+
+    prefilter_init();
+    gettimeofday(& start, NULL);
+    for (r = 0; r < rounds; ++r) {
+        for (i = 0; i < num_lines; ++i) {
+            if (banner_split(lines[i], & banner) == 0)
+                candidates += prefilter_candidate(banner.message, banner.program, banner.programlen);
+            else
+                candidates += prefilter_candidate(lines[i], NULL, 0);
+        }
+    }
+    secs = seconds_since(& start);
+
+    printf("Prefilter: %u of %u lines go on to the scanner, %.0f ns/line.\n",
+            candidates / rounds, num_lines, secs * 1e9 / (rounds * (double)num_lines));
+}
+
+/* time rounds of parsing the log, shared among threads (each with its own parser) */
+static void bench_parser(unsigned int rounds, unsigned int threads) {
+    pthread_t tids[64];
+    struct timeval start;
+    unsigned int i, started;
+    double secs;
+
+    if (threads > sizeof(tids)/sizeof(tids[0])) threads = sizeof(tids)/sizeof(tids[0]);
+    thread_rounds = (rounds + threads - 1) / threads;
+
+    gettimeofday(& start, NULL);
+    for (started = 0; started < threads; ++started) {
+        if (pthread_create(& tids[started], NULL, parse_rounds, NULL) != 0) break;
+    }
+    for (i = 0; i < started; ++i) pthread_join(tids[i], NULL);
+    secs = seconds_since(& start);
+
+    rounds = thread_rounds * started;
+    printf("Parser, %u thread(s): %u rounds in %.3f s, %.0f lines/s, %.1f MB/s, %.0f ns/line.\n",
+            started, rounds, secs, rounds * (double)num_lines / secs,
+            rounds * (double)total_bytes / secs / (1024 * 1024), secs * 1e9 / (rounds * (double)num_lines));
+}
+
+/* time the scanner on long attack lines, which it scans in place */
+static void bench_long_lines(unsigned int count) {
+    char buf[BENCH_LONG_LINE_LEN + 2];
+    const char *suffix = " from 10.1.0.1";
+    parser_ctx_t *parser;
+    attack_t attack;
+    struct timeval start;
+    unsigned int i, found = 0;
+    size_t len, padlen;
+    double secs;
+
+    parser = parser_ctx_new();
+    if (parser == NULL) return;
+    gettimeofday(& start, NULL);
+    for (i = 0; i < count; ++i) {
+        /* a user name as long as it takes, different every time */
+        len = (size_t)snprintf(buf, sizeof(buf), "Oct 18 06:27:03 gw sshd[20981]: Invalid user u%u", i);
+        padlen = BENCH_LONG_LINE_LEN - len - strlen(suffix);
+        memset(buf + len, 'a', padlen);
+        strcpy(buf + len + padlen, suffix);
+        if (parse_line(parser, 0, buf, & attack) == 0) ++found;
+    }
+    secs = seconds_since(& start);
+    parser_ctx_free(parser);
+
+    printf("Long lines: %u attacks in %u lines of %d bytes, %.1f us/line, %.1f MB/s.\n",
+            found, count, BENCH_LONG_LINE_LEN, secs * 1e6 / count,
+            count * (double)BENCH_LONG_LINE_LEN / secs / (1024 * 1024));
+}
+
+/* time adding to the blacklist, looking it up, and loading it back; then
+ * check that tearing the last record of its journal loses that one only */
+static int bench_blacklist(const char *restrict dir, unsigned int entries) {
+    char filename[BENCH_MAX_LINE_LEN], journalname[BENCH_MAX_LINE_LEN];
+    attacker_t attacker;
+    sshg_address_t address;
+    struct timeval start;
+    struct stat st;
+    unsigned int i, found = 0, kept;
+    double add_secs, fin_secs, load_secs, lookup_secs, append_secs;
+
+    if (snprintf(filename, sizeof(filename), "%s/blacklist", dir) >= (int)sizeof(filename)
+            || snprintf(journalname, sizeof(journalname), "%s%s", filename, BLACKLIST_JOURNAL_SUFFIX) >= (int)sizeof(journalname))
+        return -1;
+    if (blacklist_init(filename) != 0) {
+        printf("Blacklist: unable to create %s.\n", filename);
+        return -1;
+    }
+
+    memset(& attacker, 0x00, sizeof(attacker));
+    attacker.attack.address.kind = ADDRKIND_IPv4;
+    attacker.attack.service = 100;
+    attacker.attack.dangerousness = 10;
+    attacker.whenfirst = attacker.whenlast = time(NULL);
+    attacker.numhits = 1;
+    gettimeofday(& start, NULL);
+    for (i = 0; i < entries; ++i) {
+        make_address(attacker.attack.address.value, sizeof(attacker.attack.address.value), i, 0);
+        blacklist_add(& attacker);
+    }
+    add_secs = seconds_since(& start);
+    /* what is still pending goes to the file here */
+    gettimeofday(& start, NULL);
+    blacklist_fin();
+    fin_secs = seconds_since(& start);
+
+    gettimeofday(& start, NULL);
+    blacklist_init(filename);
+    load_secs = seconds_since(& start);
+
+    make_lookups(entries);
+    address.kind = ADDRKIND_IPv4;
+    gettimeofday(& start, NULL);
+    for (i = 0; i < BENCH_LOOKUPS; ++i) {
+        memcpy(address.value, lookups[i], sizeof(address.value));
+        found += (blacklist_lookup_address(& address) == 1);
+    }
+    lookup_secs = seconds_since(& start);
+    printf("Blacklist, %u entries (%u loaded back): %.1f us/add, %.1f ms to flush, %.1f ms to load, %.0f ns/lookup (%u found).\n",
+            entries, blacklist_size(), add_secs * 1e6 / entries, fin_secs * 1e3, load_secs * 1e3,
+            lookup_secs * 1e9 / BENCH_LOOKUPS, found);
+
+    /* as if the last addition was cut short by a crash */
+    for (i = 0; i < BENCH_BLACKLIST_APPENDS; ++i) {
+        make_address(attacker.attack.address.value, sizeof(attacker.attack.address.value), entries + BENCH_LOOKUPS + i, 0);
+        blacklist_add(& attacker);
+    }
+    gettimeofday(& start, NULL);
+    blacklist_fin();
+    append_secs = seconds_since(& start);
+    printf("Blacklist, %u more entries: %.1f ms to flush.\n", BENCH_BLACKLIST_APPENDS, append_secs * 1e3);
+    if (stat(journalname, & st) != 0 || st.st_size == 0 || truncate(journalname, st.st_size - 1) != 0) {
+        printf("FAIL: blacklist journal %s missing.\n", journalname);
+        return -1;
+    }
+    blacklist_init(filename);
+    kept = blacklist_size();
+    blacklist_fin();
+    if (kept != entries + BENCH_BLACKLIST_APPENDS - 1) {
+        printf("FAIL: blacklist with a torn journal: %u entries loaded back, %u expected.\n", kept, entries + BENCH_BLACKLIST_APPENDS - 1);
+        return -1;
+    }
+    printf("Blacklist with a torn journal: %u entries loaded back, the torn one dropped.\n", kept);
+
+    /* of two old entries, the one offending again must outlive an expiry */
+    if (snprintf(filename, sizeof(filename), "%s/blacklist.aging", dir) >= (int)sizeof(filename)
+            || blacklist_init(filename) != 0)
+        return -1;
+    attacker.whenfirst = attacker.whenlast = time(NULL) - 3600;
+    for (i = 0; i < 2; ++i) {
+        make_address(attacker.attack.address.value, sizeof(attacker.attack.address.value), i, 0);
+        blacklist_add(& attacker);
+    }
+    address.kind = ADDRKIND_IPv4;
+    make_address(address.value, sizeof(address.value), 0, 0);
+    blacklist_touch(& address, time(NULL));
+    blacklist_fin();
+    blacklist_init(filename);
+    blacklist_expire(time(NULL) - 1800, expired_entry, NULL);
+    kept = blacklist_size();
+    found = blacklist_lookup_address(& address);
+    blacklist_fin();
+    if (kept != 1 || found != 1) {
+        printf("FAIL: blacklist expiry: %u entries kept, the one offending again %s.\n", kept, found == 1 ? "among them" : "not");
+        return -1;
+    }
+    printf("Blacklist expiry: the entry offending again kept, the other dropped.\n");
+
+    return 0;
+}
+
+/* entries expired from the blacklist need nothing done. Callback for blacklist_expire() */
+static void expired_entry(const char *restrict address, int addrkind, int service, void *arg) {
+    (void)address;
+    (void)addrkind;
+    (void)service;
+    (void)arg;
+}
+
+/* time whitelist lookups of random addresses, with entries random /24 blocks */
+static int bench_whitelist(unsigned int entries) {
+    char buf[ADDRLEN];
+    struct timeval start;
+    unsigned int i, found = 0;
+    double secs;
+
+    if (whitelist_init() != 0 || whitelist_conf_init() != 0) return -1;
+    for (i = 0; i < entries; ++i) {
+        make_address(buf, sizeof(buf), i, 1);
+        whitelist_add_block4(buf, 24);
+    }
+    whitelist_conf_fin();
+
+    make_lookups(entries);
+    gettimeofday(& start, NULL);
+    for (i = 0; i < BENCH_LOOKUPS; ++i) {
+        found += (whitelist_match(lookups[i], ADDRKIND_IPv4) == 1);
+    }
+    secs = seconds_since(& start);
+    whitelist_fin();
+
+    /* make_lookups() takes half of them in the entries */
+    if (found != BENCH_LOOKUPS / 2) {
+        printf("FAIL: whitelist, %u blocks: %u of %u lookups found, %u expected.\n", entries, found, BENCH_LOOKUPS, BENCH_LOOKUPS / 2);
+        return -1;
+    }
+    printf("Whitelist, %u blocks: %.0f ns/lookup (%u of %u found).\n", entries, secs * 1e9 / BENCH_LOOKUPS, found, BENCH_LOOKUPS);
+
+    return 0;
+}
+
+/* time loading a whitelist file of entries /24 blocks, then again from its cache */
+static int bench_whitelist_file(const char *restrict dir, unsigned int entries) {
+    char filename[BENCH_MAX_LINE_LEN], cachename[BENCH_MAX_LINE_LEN], buf[ADDRLEN];
+    struct timeval start;
+    double secs[2];
+    unsigned int i;
+    int round, listed = 1, cached = 0;
+    FILE *f;
+
+    if (snprintf(filename, sizeof(filename), "%s/whitelist", dir) >= (int)sizeof(filename)
+            || snprintf(cachename, sizeof(cachename), "%s.cache", filename) >= (int)sizeof(cachename))
+        return -1;
+    f = fopen(filename, "w");
+    if (f == NULL) return -1;
+    fprintf(f, "# made up by sshguard_bench\n");
+    for (i = 0; i < entries; ++i) {
+        make_address(buf, sizeof(buf), i, 1);
+        fprintf(f, "%s/24\n", buf);
+    }
+    fclose(f);
+
+    /* first from the file itself, which saves the cache; then from the cache */
+    for (round = 0; round < 2; ++round) {
+        if (whitelist_init() != 0 || whitelist_conf_init() != 0) return -1;
+        gettimeofday(& start, NULL);
+        whitelist_file(filename, 1);
+        secs[round] = seconds_since(& start);
+        whitelist_conf_fin();
+        make_address(buf, sizeof(buf), entries - 1, 0);
+        listed &= (whitelist_match(buf, ADDRKIND_IPv4) == 1);
+        whitelist_fin();
+        if (round == 0) cached = (access(cachename, F_OK) == 0);
+    }
+
+    if (! listed || ! cached) {
+        printf("FAIL: whitelist file, %u blocks: %s.\n", entries, (! listed ? "entries lost" : "no cache saved"));
+        return -1;
+    }
+    printf("Whitelist file, %u blocks: %.1f ms to load, %.1f ms from its cache.\n",
+            entries, secs[0] * 1e3, secs[1] * 1e3);
+
+    return 0;
+}
+
+static void *parse_rounds(void *par) {
+    char buf[BENCH_MAX_LINE_LEN + 2];
+    parser_ctx_t *parser;
+    attack_t attack;
+    unsigned int r, i;
+
+    (void)par;
+
+    for (r = 0; r < thread_rounds; ++r) {
+        /* a new parser every round, or repeated lines only hit its cache */
+        parser = parser_ctx_new();
+        if (parser == NULL) return NULL;
+        for (i = 0; i < num_lines; ++i) {
+            strcpy(buf, lines[i]);
+            parse_line(parser, 0, buf, & attack);
+        }
+        parser_ctx_free(parser);
+    }
+    return NULL;
+}
+
+static double seconds_since(const struct timeval *restrict start) {
+    struct timeval now;
+
+    gettimeofday(& now, NULL);
+    return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1e6;
+}
+
+/* the n-th made-up IPv4 address, scattered over the address space; masked to its /24 */
+static void make_address(char *restrict buf, size_t len, unsigned int n, int masked) {
+    unsigned int a;
+
+    /* odd multiplier: different n give different /24 blocks, for n < 2^22 */
+    a = (n * 2654435761u) & 0x3FFFFF;
+    snprintf(buf, len, "%u.%u.%u.%u", 11 + (a >> 16), (a >> 8) & 0xFF, a & 0xFF, (masked ? 0 : 1 + n % 254));
+}
+
+/* make up the addresses to look up: the even ones among the first entries made up */
+static void make_lookups(unsigned int entries) {
+    unsigned int i;
+
+    for (i = 0; i < BENCH_LOOKUPS; ++i)
+        make_address(lookups[i], ADDRLEN, (i % 2 == 0 ? i / 2 % entries : entries + i), 0);
+}
+
+/* remove the files made up in dir, and dir */
+static void clean_dir(const char *restrict dir) {
+    char path[BENCH_MAX_LINE_LEN];
+    struct dirent *entry;
+    DIR *d;
+
+    d = opendir(dir);
+    if (d != NULL) {
+        while ((entry = readdir(d)) != NULL) {
+            if (entry->d_name[0] == '.') continue;
+            if (snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name) < (int)sizeof(path))
+                unlink(path);
+        }
+        closedir(d);
+    }
+    rmdir(dir);
+}
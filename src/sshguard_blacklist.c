@@ -23,214 +23,1026 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 /* for hton*() functions */
 #include <arpa/inet.h>
 #include <assert.h>
 
+#include <simclist.h>
+
+#include "fnv.h"
 #include "sshguard_addresskind.h"
 #include "sshguard_log.h"
 #include "sshguard_blacklist.h"
 
-#define BL_MAXBUF      50
-#define BL_NUMENT      5
+/* changes since the snapshot are kept in an array, and found through an
+ * open-addressing index of at least twice their number */
+#define BL_INITIAL_ENTRIES      64
+
+/* snapshot header: magic, then number of records and checksum of both */
+#define BL_MAGIC                "SSHGBL2\n"
+#define BL_MAGIC_UNSORTED       "SSHGBL1\n"
+#define BL_MAGIC_LEN            8
+#define BL_HEADER_LEN           (BL_MAGIC_LEN + 4 + 4)
+
+/* record: operation, entry as in the legacy format, then checksum of both.
+ * Snapshot records are sorted by address kind, then address */
+#define BL_OP_ADD               1
+#define BL_OP_REMOVE            2
+#define BL_RECORD_LEN           (4 + ATTACKER_T_LEN + 4)
+#define BL_RECORD_ADDRESS(rec)  ((rec) + 4)
+#define BL_RECORD_KIND(rec)     ((rec) + 4 + ADDRLEN)
+#define BL_RECORD_SERVICE(rec)  ((rec) + 4 + ADDRLEN + 4)
+#define BL_RECORD_WHENLAST(rec) ((rec) + 4 + ADDRLEN + 4 + 4 + 4)
+
+/* records read or written at once */
+#define BL_IO_RECORDS           256
+
+#if defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
+#   define bl_datasync(fd)      fdatasync(fd)
+#else
+#   define bl_datasync(fd)      fsync(fd)
+#endif
+
+/* an addition or removal since the snapshot */
+typedef struct {
+    attacker_t attacker;
+    int removed;                    /* the address is not blacklisted anymore */
+    unsigned int seq;               /* when last changed, to tell those in a new snapshot */
+} change_t;
+
+/* the blacklist, as in memory */
+static struct {
+    char *filename;
+    char *journalname;
+    int journal_fd;
+    unsigned int journal_records;   /* records in the journal file */
+    char *map;                      /* the snapshot file, mapped read-only */
+    size_t map_len;
+    const char *records;            /* records of the snapshot, in map */
+    unsigned int num_records;
+    change_t *changes;
+    unsigned int num_changes, max_changes;
+    unsigned int *index;            /* position in changes + 1, or 0 if free */
+    unsigned int index_size;
+    unsigned int seq;               /* of the last change */
+    unsigned int num_listed;        /* addresses blacklisted, all told */
+    char *pending;                  /* records yet to append to the journal */
+    unsigned int num_pending, max_pending;
+    int journal_failed;             /* records were lost, the snapshot must be rewritten */
+    int compact_requested;          /* changes were not journaled, the snapshot must be rewritten */
+    int stop;                       /* the writer must terminate */
+} bl;
+
+/* guards bl; the writer waits on bl_changed for records to write */
+static pthread_mutex_t bl_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bl_changed = PTHREAD_COND_INITIALIZER;
+static pthread_t bl_writer;
+static int bl_writer_running = 0;
+
+static void *attacker_unserializer(const void *restrict el, uint32_t *restrict len);
+static uint32_t checksum(const char *restrict buf, size_t len);
+static void entry_encode(char *restrict buf, const attacker_t *restrict attacker);
+static void entry_decode(const char *restrict buf, attacker_t *restrict attacker);
+static void record_encode(char *restrict buf, int op, const attacker_t *restrict attacker);
+static int record_decode(const char *restrict buf, int *restrict op, attacker_t *restrict attacker);
+static int record_valid(const char *restrict rec);
+static int record_compare(const void *a, const void *b);
+static const char *snapshot_find(const char *restrict key);
+static int is_listed(const sshg_address_t *restrict addr);
+static int snapshot_has(const sshg_address_t *restrict addr);
+static const char *snapshot_find_address(const sshg_address_t *restrict addr);
+static unsigned int *index_slot(const sshg_address_t *restrict addr);
+static int index_grow(void);
+static void index_rebuild(void);
+static int set_entry(int op, const attacker_t *restrict attacker);
+static int touch_entry(const sshg_address_t *restrict addr, time_t when);
+static int queue_record(int op, const attacker_t *restrict attacker);
+static int load_legacy(void);
+static int load_unsorted(int fd);
+static int map_snapshot(void);
+static int replay_journal(void);
+static int write_snapshot(char *restrict changes, unsigned int num_changes);
+static int append_journal(const char *restrict records, unsigned int num);
+static int compact(void);
+static void *writer(void *arg);
 
 
 /*          UTILITY FUNCTIONS           */
 
-/* seeks an address (key) into a list element (el). Callback for SimCList */
-static int seeker_addr(const void *el, const void *key) {
-    const sshg_address_t *adr = (const sshg_address_t *)key;
-    const attacker_t *atk = (const attacker_t *)el;
+/* unserialize an entry in the legacy format (SimCList dump). Callback for SimCList */
+static void *attacker_unserializer(const void *restrict el, uint32_t *restrict len) {
+    attacker_t *atkr = malloc(sizeof(attacker_t));
 
-    assert(atk != NULL && adr != NULL);
-    
-    if (atk->attack.address.kind != adr->kind) return 0;
-    return (strcmp(atk->attack.address.value, adr->value) == 0);
+    if (atkr == NULL) return NULL;
+    memset(atkr, 0x00, sizeof(attacker_t));
+    entry_decode((const char *)el, atkr);
+    *len = ATTACKER_T_LEN;
+
+    return atkr;
 }
 
-/* use custom comparator for portability: don't know sizeof(time_t) */
-/*
-static int time_comparator(const void *a, const void *b) {
-    const attacker_t *atka = (const attacker_t *)a;
-    const attacker_t *atkb = (const attacker_t *)b;
+/* FNV-1a over a buffer */
+static uint32_t checksum(const char *restrict buf, size_t len) {
+    uint32_t hval = FNV1_32A_INIT;
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        hval ^= (uint32_t)(unsigned char)buf[i];
+        hval *= 0x01000193;    /* 32 bit FNV prime */
+    }
+
+    return hval;
+}
 
-    return ((atka->whenfirst < atkb->whenfirst) - (atka->whenfirst > atkb->whenfirst));
+static void put_uint32(char *restrict buf, uint32_t val) {
+    val = htonl(val);
+    memcpy(buf, & val, sizeof(val));
 }
-*/
 
-static void *attacker_serializer(const void *restrict el, uint32_t *restrict len) {
-    /* buffer for serialization operations */
-    char *serialization_buf;
-    attacker_t atkr = *(const attacker_t *restrict)el;
+static uint32_t get_uint32(const char *restrict buf) {
     uint32_t val;
-    
 
-    if (el == NULL || len == NULL) return NULL;
+    memcpy(& val, buf, sizeof(val));
+    return ntohl(val);
+}
 
-    serialization_buf = (char *)malloc(ATTACKER_T_LEN);
-    if (serialization_buf == NULL) return NULL;
+/* store attacker into ATTACKER_T_LEN bytes at buf, as in the legacy format */
+static void entry_encode(char *restrict buf, const attacker_t *restrict attacker) {
+    char *pos = buf;
+
+    memset(buf, 0x00, ATTACKER_T_LEN);
+    /* the address always takes the room of the longest one (possible "tail" stays 0-filled) */
+    memcpy(pos, attacker->attack.address.value, strnlen(attacker->attack.address.value, ADDRLEN - 1));
+    pos += ADDRLEN;
+    put_uint32(pos, (uint32_t)attacker->attack.address.kind);
+    pos += 4;
+    put_uint32(pos, (uint32_t)attacker->attack.service);
+    pos += 4;
+    put_uint32(pos, (uint32_t)attacker->whenfirst);
+    pos += 4;
+    put_uint32(pos, (uint32_t)attacker->whenlast);
+    pos += 4;
+    put_uint32(pos, (uint32_t)attacker->pardontime);
+    pos += 4;
+    put_uint32(pos, (uint32_t)attacker->cumulated_danger);
+    pos += 4;
+
+    assert(pos == buf + ATTACKER_T_LEN);
+}
 
-    memset(serialization_buf, 0x00, ATTACKER_T_LEN);
-    *len = 0;
+/* read attacker from ATTACKER_T_LEN bytes at buf */
+static void entry_decode(const char *restrict buf, attacker_t *restrict attacker) {
+    const char *pos = buf;
+
+    memcpy(attacker->attack.address.value, pos, ADDRLEN);
+    attacker->attack.address.value[ADDRLEN - 1] = '\0';
+    pos += ADDRLEN;
+    attacker->attack.address.kind = (int)get_uint32(pos);
+    pos += 4;
+    attacker->attack.service = (int)get_uint32(pos);
+    pos += 4;
+    attacker->whenfirst = (time_t)get_uint32(pos);
+    pos += 4;
+    attacker->whenlast = (time_t)get_uint32(pos);
+    pos += 4;
+    attacker->pardontime = (time_t)get_uint32(pos);
+    pos += 4;
+    attacker->cumulated_danger = get_uint32(pos);
+    pos += 4;
+    attacker->numhits = 0;
+
+    assert(pos == buf + ATTACKER_T_LEN);
+}
 
+/* store an operation on attacker into BL_RECORD_LEN bytes at buf */
+static void record_encode(char *restrict buf, int op, const attacker_t *restrict attacker) {
+    put_uint32(buf, (uint32_t)op);
+    entry_encode(buf + 4, attacker);
+    put_uint32(buf + 4 + ATTACKER_T_LEN, checksum(buf, 4 + ATTACKER_T_LEN));
+}
 
-    /* store the attacker address first */
-    switch (atkr.attack.address.kind) {
-        case ADDRKIND_IPv4:
-            memcpy(serialization_buf, ((const attacker_t *restrict)el)->attack.address.value, INET_ADDRSTRLEN);
-            break;
+/* read the record at buf. Return 0 if successful, -1 if it is corrupted */
+static int record_decode(const char *restrict buf, int *restrict op, attacker_t *restrict attacker) {
+    if (get_uint32(buf + 4 + ATTACKER_T_LEN) != checksum(buf, 4 + ATTACKER_T_LEN)) return -1;
+    *op = (int)get_uint32(buf);
+    entry_decode(buf + 4, attacker);
+    if (*op != BL_OP_ADD && *op != BL_OP_REMOVE) return -1;
+    if (attacker->attack.address.kind != ADDRKIND_IPv4 && attacker->attack.address.kind != ADDRKIND_IPv6) return -1;
 
-        case ADDRKIND_IPv6:
-            memcpy(serialization_buf, ((const attacker_t *restrict)el)->attack.address.value, INET6_ADDRSTRLEN);
-            break;
+    return 0;
+}
+
+/* whether the snapshot record at rec is intact, and ends its address */
+static int record_valid(const char *restrict rec) {
+    return (BL_RECORD_ADDRESS(rec)[ADDRLEN - 1] == '\0' && get_uint32(rec + 4 + ATTACKER_T_LEN) == checksum(rec, 4 + ATTACKER_T_LEN));
+}
+
+/* order records by address kind, then address. Callback for qsort() */
+static int record_compare(const void *a, const void *b) {
+    uint32_t kinda = get_uint32(BL_RECORD_KIND((const char *)a));
+    uint32_t kindb = get_uint32(BL_RECORD_KIND((const char *)b));
+
+    if (kinda != kindb) return (kinda < kindb ? -1 : 1);
+    return memcmp(BL_RECORD_ADDRESS((const char *)a), BL_RECORD_ADDRESS((const char *)b), ADDRLEN);
+}
+
+/* read len bytes, unless the file ends first. Return the bytes read, or -1 on error */
+static ssize_t read_full(int fd, char *restrict buf, size_t len) {
+    size_t done = 0;
+    ssize_t ret;
+
+    while (done < len) {
+        ret = read(fd, buf + done, len - done);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (ret == 0) break;
+        done += (size_t)ret;
     }
 
-    /* but always leap by the longest address (possible "tail" stays 0-filled) */
-    *len += ADDRLEN;
+    return (ssize_t)done;
+}
 
-    val = htonl((uint32_t)atkr.attack.address.kind);
-    memcpy(serialization_buf+*len, & val, sizeof(val));
-    *len += sizeof(val);
+static int write_full(int fd, const char *restrict buf, size_t len) {
+    ssize_t ret;
+
+    while (len > 0) {
+        ret = write(fd, buf, len);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += ret;
+        len -= (size_t)ret;
+    }
 
-    val = htonl((uint32_t)atkr.attack.service);
-    memcpy(serialization_buf+*len, & val, sizeof(val));
-    *len += sizeof(val);
+    return 0;
+}
 
-    val = htonl((uint32_t)atkr.whenfirst);
-    memcpy(serialization_buf+*len, & val, sizeof(val));
-    *len += sizeof(val);
 
-    val = htonl((uint32_t)atkr.whenlast);
-    memcpy(serialization_buf+*len, & val, sizeof(val));
-    *len += sizeof(val);
+/*          INTERFACE FUNCTIONS             */
+int blacklist_init(const char *filename) {
+    char magic[BL_MAGIC_LEN];
+    int fd, convert = 0;
+
+    memset(& bl, 0x00, sizeof(bl));
+    bl.journal_fd = -1;
+    bl.filename = strdup(filename);
+    bl.journalname = (char *)malloc(strlen(filename) + sizeof(BLACKLIST_JOURNAL_SUFFIX));
+    if (bl.filename == NULL || bl.journalname == NULL || index_grow() != 0) return -1;
+    sprintf(bl.journalname, "%s%s", filename, BLACKLIST_JOURNAL_SUFFIX);
+
+    fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        if (errno != ENOENT) {
+            sshguard_log(LOG_ERR, "Unable to read blacklist file '%s': %s.", filename, strerror(errno));
+            return -1;
+        }
+        sshguard_log(LOG_NOTICE, "Blacklist file '%s' doesn't exist, I'll create it for you.", filename);
+        convert = 1;
+    } else if (read_full(fd, magic, BL_MAGIC_LEN) != BL_MAGIC_LEN || memcmp(magic, BL_MAGIC, BL_MAGIC_LEN) != 0) {
+        /* a snapshot with records unsorted, or a SimCList dump of older versions */
+        if (memcmp(magic, BL_MAGIC_UNSORTED, BL_MAGIC_LEN) == 0) {
+            convert = load_unsorted(fd);
+            close(fd);
+        } else {
+            close(fd);
+            convert = load_legacy();
+        }
+        if (convert != 0) return -1;
+        convert = 1;
+    } else {
+        close(fd);
+        if (map_snapshot() != 0) return -1;
+    }
 
-    val = htonl((uint32_t)atkr.pardontime);
-    memcpy(serialization_buf+*len, & val, sizeof(val));
-    *len += sizeof(val);
+    if (replay_journal() != 0) return -1;
+    if (convert && compact() != 0) return -1;
 
-    val = htonl((uint32_t)atkr.cumulated_danger);
-    memcpy(serialization_buf+*len, & val, sizeof(val));
-    *len += sizeof(val);
+    /* additions are appended in background */
+    bl.stop = 0;
+    if (pthread_create(& bl_writer, NULL, writer, NULL) != 0) {
+        sshguard_log(LOG_ERR, "Unable to start the blacklist writer, changes will be written right away: %s.", strerror(errno));
+    } else {
+        bl_writer_running = 1;
+    }
 
-    assert(*len == ATTACKER_T_LEN);
+    return 0;
+}
 
-    return serialization_buf;
+unsigned int blacklist_size(void) {
+    return bl.num_listed;
 }
 
+void blacklist_foreach(int addrkind, blacklist_visit_t visit, void *arg) {
+    char key[BL_RECORD_LEN];
+    const char *rec, *end;
+    sshg_address_t addr;
+    unsigned int i;
+
+    pthread_mutex_lock(& bl_mutex);
+
+    /* entries of the snapshot, straight from the mapping, from the first of addrkind */
+    memset(key, 0x00, sizeof(key));
+    put_uint32(BL_RECORD_KIND(key), (uint32_t)addrkind);
+    end = bl.records + (size_t)bl.num_records * BL_RECORD_LEN;
+    for (rec = snapshot_find(key); rec < end && get_uint32(BL_RECORD_KIND(rec)) == (uint32_t)addrkind; rec += BL_RECORD_LEN) {
+        if (! record_valid(rec)) continue;
+        if (bl.num_changes > 0) {
+            /* changed since, see below */
+            memcpy(addr.value, BL_RECORD_ADDRESS(rec), ADDRLEN);
+            addr.kind = addrkind;
+            if (*index_slot(& addr) != 0) continue;
+        }
+        visit(BL_RECORD_ADDRESS(rec), addrkind, (int)get_uint32(BL_RECORD_SERVICE(rec)), arg);
+    }
 
-static void *attacker_unserializer(const void *restrict el, uint32_t *restrict len) {
-    attacker_t *atkr = malloc(sizeof(attacker_t));
-    *atkr = *(const attacker_t *restrict)el;
-    uint32_t val;
+    /* entries added since */
+    for (i = 0; i < bl.num_changes; ++i) {
+        if (bl.changes[i].removed || bl.changes[i].attacker.attack.address.kind != addrkind) continue;
+        visit(bl.changes[i].attacker.attack.address.value, addrkind, bl.changes[i].attacker.attack.service, arg);
+    }
 
-    memcpy(atkr->attack.address.value, el, ADDRLEN);
-    *len = ADDRLEN;
+    pthread_mutex_unlock(& bl_mutex);
+}
 
-    memcpy(&val, el + *len, sizeof(val));
-    atkr->attack.address.kind = ntohl(val);
-    *len += sizeof(val);
+int blacklist_add(const attacker_t *restrict newel) {
+    int ret = 0;
+
+    pthread_mutex_lock(& bl_mutex);
+    if (! is_listed(& newel->attack.address)) {
+        ret = set_entry(BL_OP_ADD, newel);
+        if (ret == 0) {
+            sshguard_log(LOG_DEBUG, "Attacker '%s:%d' blacklisted. Blacklist now %u entries.", newel->attack.address.value, newel->attack.address.kind, bl.num_listed);
+            ret = queue_record(BL_OP_ADD, newel);
+        }
+    } else {
+        /* offending again: move its last offense forward, for aging */
+        ret = touch_entry(& newel->attack.address, newel->whenlast);
+    }
+    pthread_mutex_unlock(& bl_mutex);
 
-    memcpy(&val, el + *len, sizeof(val));
-    atkr->attack.service = ntohl(val);
-    *len += sizeof(val);
+    return ret;
+}
 
-    memcpy(&val, el + *len, sizeof(val));
-    atkr->whenfirst = ntohl(val);
-    *len += sizeof(val);
+int blacklist_touch(const sshg_address_t *restrict addr, time_t when) {
+    int ret = 0;
 
-    memcpy(&val, el + *len, sizeof(val));
-    atkr->whenlast = ntohl(val);
-    *len += sizeof(val);
+    pthread_mutex_lock(& bl_mutex);
+    if (is_listed(addr)) ret = touch_entry(addr, when);
+    pthread_mutex_unlock(& bl_mutex);
+
+    return ret;
+}
 
-    memcpy(&val, el + *len, sizeof(val));
-    atkr->pardontime = ntohl(val);
-    *len += sizeof(val);
+int blacklist_remove(const sshg_address_t *restrict addr) {
+    attacker_t gone;
+    int ret = 0;
+
+    pthread_mutex_lock(& bl_mutex);
+    if (is_listed(addr)) {
+        memset(& gone, 0x00, sizeof(gone));
+        gone.attack.address = *addr;
+        ret = set_entry(BL_OP_REMOVE, & gone);
+        if (ret == 0) {
+            sshguard_log(LOG_DEBUG, "Address '%s:%d' removed from blacklist. Blacklist now %u entries.", addr->value, addr->kind, bl.num_listed);
+            ret = queue_record(BL_OP_REMOVE, & gone);
+        }
+    }
+    pthread_mutex_unlock(& bl_mutex);
 
-    memcpy(&val, el + *len, sizeof(val));
-    atkr->cumulated_danger = ntohl(val);
-    *len += sizeof(val);
+    return ret;
+}
 
-    assert(*len == ATTACKER_T_LEN);
+int blacklist_expire(time_t before, blacklist_visit_t expired, void *arg) {
+    const char *rec, *end;
+    attacker_t gone;
+    unsigned int i, num_changes;
+    int num = 0, failed = 0;
+
+    pthread_mutex_lock(& bl_mutex);
+
+    /* changes first: removals below add more */
+    num_changes = bl.num_changes;
+    for (i = 0; ! failed && i < num_changes; ++i) {
+        if (bl.changes[i].removed || bl.changes[i].attacker.whenlast >= before) continue;
+        gone = bl.changes[i].attacker;
+        expired(gone.attack.address.value, gone.attack.address.kind, gone.attack.service, arg);
+        failed = (set_entry(BL_OP_REMOVE, & gone) != 0);
+        num += ! failed;
+    }
 
-    return atkr;
+    end = bl.records + (size_t)bl.num_records * BL_RECORD_LEN;
+    for (rec = bl.records; ! failed && rec < end; rec += BL_RECORD_LEN) {
+        if ((time_t)get_uint32(BL_RECORD_WHENLAST(rec)) >= before || ! record_valid(rec)) continue;
+        memset(& gone, 0x00, sizeof(gone));
+        entry_decode(rec + 4, & gone);
+        /* changed since: handled above */
+        if (*index_slot(& gone.attack.address) != 0) continue;
+        expired(gone.attack.address.value, gone.attack.address.kind, gone.attack.service, arg);
+        failed = (set_entry(BL_OP_REMOVE, & gone) != 0);
+        num += ! failed;
+    }
+
+    /* not journaled: the snapshot is rewritten once, with all of them */
+    if (num > 0) {
+        sshguard_log(LOG_INFO, "%d blacklisted addresses expired, blacklist now %u entries.", num, bl.num_listed);
+        bl.compact_requested = 1;
+        pthread_cond_signal(& bl_changed);
+    }
+    pthread_mutex_unlock(& bl_mutex);
+
+    if (num > 0 && ! bl_writer_running && compact() == 0) {
+        bl.compact_requested = 0;
+    }
+
+    return num;
 }
 
+int blacklist_lookup_address(const sshg_address_t *restrict addr) {
+    int found;
 
+    pthread_mutex_lock(& bl_mutex);
+    found = is_listed(addr);
+    pthread_mutex_unlock(& bl_mutex);
 
-/*          INTERFACE FUNCTIONS             */
-list_t *blacklist_load(const char *filename) {
-    list_t * blacklist = (list_t *)malloc(sizeof(list_t));
+    sshguard_log(LOG_DEBUG, "Looking for address '%s:%d'... %s.", addr->value, addr->kind, (found ? "found" : "not found"));
+
+    return found;
+}
+
+int blacklist_fin(void) {
+    int ret = 0;
+
+    if (bl_writer_running) {
+        /* let the writer write what's left, and terminate */
+        pthread_mutex_lock(& bl_mutex);
+        bl.stop = 1;
+        pthread_cond_signal(& bl_changed);
+        pthread_mutex_unlock(& bl_mutex);
+        pthread_join(bl_writer, NULL);
+        bl_writer_running = 0;
+    }
+    if (bl.num_pending > 0 && append_journal(bl.pending, bl.num_pending) != 0) {
+        bl.journal_failed = 1;
+    }
+    if (bl.journal_failed || bl.compact_requested) {
+        ret = compact();
+    }
+
+    if (bl.journal_fd != -1) close(bl.journal_fd);
+    if (bl.map != NULL) munmap(bl.map, bl.map_len);
+    free(bl.pending);
+    free(bl.changes);
+    free(bl.index);
+    free(bl.journalname);
+    free(bl.filename);
+    memset(& bl, 0x00, sizeof(bl));
+    bl.journal_fd = -1;
+
+    return ret;
+}
+
+
+/*          INTERNALS           */
+
+/* first record of the snapshot not ordered before key (or the end) */
+static const char *snapshot_find(const char *restrict key) {
+    unsigned int lo = 0, hi = bl.num_records, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (record_compare(bl.records + (size_t)mid * BL_RECORD_LEN, key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return bl.records + (size_t)lo * BL_RECORD_LEN;
+}
+
+/* whether addr is blacklisted: as changed lately, or as in the snapshot. With bl_mutex held */
+/* move the last offense of listed addr forward to when. With bl_mutex held */
+static int touch_entry(const sshg_address_t *restrict addr, time_t when) {
+    attacker_t known;
+    unsigned int pos;
+    const char *rec;
+
+    pos = *index_slot(addr);
+    if (pos != 0) {
+        known = bl.changes[pos - 1].attacker;
+    } else {
+        rec = snapshot_find_address(addr);
+        entry_decode(rec + 4, & known);
+    }
+
+    /* a flood must not journal a record per line */
+    if (when < known.whenlast + BLACKLIST_TOUCH_INTERVAL) return 0;
+    known.whenlast = when;
+    if (set_entry(BL_OP_ADD, & known) != 0) return -1;
+    return queue_record(BL_OP_ADD, & known);
+}
+
+/* whether addr is listed. With bl_mutex held */
+static int is_listed(const sshg_address_t *restrict addr) {
+    unsigned int pos;
+
+    pos = *index_slot(addr);
+    if (pos != 0) return ! bl.changes[pos - 1].removed;
+    return snapshot_has(addr);
+}
 
-    list_init(blacklist);
-    list_attributes_unserializer(blacklist, attacker_unserializer);
+/* whether addr is in the snapshot */
+static int snapshot_has(const sshg_address_t *restrict addr) {
+    return (snapshot_find_address(addr) != NULL);
+}
+
+/* the record of addr in the snapshot, or NULL if missing */
+static const char *snapshot_find_address(const sshg_address_t *restrict addr) {
+    char key[BL_RECORD_LEN];
+    const char *rec;
+
+    if (bl.num_records == 0) return NULL;
+
+    memset(key, 0x00, sizeof(key));
+    memcpy(BL_RECORD_ADDRESS(key), addr->value, strnlen(addr->value, ADDRLEN - 1));
+    put_uint32(BL_RECORD_KIND(key), (uint32_t)addr->kind);
+    rec = snapshot_find(key);
+
+    if (rec < bl.records + (size_t)bl.num_records * BL_RECORD_LEN && record_compare(rec, key) == 0 && record_valid(rec))
+        return rec;
+    return NULL;
+}
+
+/* slot of the index for addr: where it is, or where it would go. With bl_mutex held */
+static unsigned int *index_slot(const sshg_address_t *restrict addr) {
+    unsigned int pos;
+    const attacker_t *el;
+
+    pos = (fnv_32a_str(addr->value, FNV1_32A_INIT) ^ (unsigned int)addr->kind) & (bl.index_size - 1);
+    for (; bl.index[pos] != 0; pos = (pos + 1) & (bl.index_size - 1)) {
+        el = & bl.changes[bl.index[pos] - 1].attacker;
+        if (el->attack.address.kind == addr->kind && strcmp(el->attack.address.value, addr->value) == 0) break;
+    }
+
+    return & bl.index[pos];
+}
+
+/* double the room for changes and the index. With bl_mutex held */
+static int index_grow(void) {
+    change_t *newchanges;
+    unsigned int *newindex;
+    unsigned int newmax = (bl.max_changes > 0 ? 2 * bl.max_changes : BL_INITIAL_ENTRIES);
+
+    /* on failures, both stay as they were: max_changes is only raised at last */
+    newchanges = (change_t *)realloc(bl.changes, newmax * sizeof(change_t));
+    if (newchanges == NULL) return -1;
+    bl.changes = newchanges;
+
+    newindex = (unsigned int *)malloc(2 * newmax * sizeof(unsigned int));
+    if (newindex == NULL) return -1;
+    free(bl.index);
+    bl.index = newindex;
+    bl.index_size = 2 * newmax;
+    bl.max_changes = newmax;
+    index_rebuild();
+
+    return 0;
+}
+
+/* index all changes from scratch. With bl_mutex held */
+static void index_rebuild(void) {
+    unsigned int i;
+
+    memset(bl.index, 0x00, bl.index_size * sizeof(unsigned int));
+    for (i = 0; i < bl.num_changes; ++i) {
+        *index_slot(& bl.changes[i].attacker.attack.address) = i + 1;
+    }
+}
 
-    if (list_restore_file(blacklist, filename, NULL) != 0) {
-        return NULL;
+/* record an addition or removal (additions of entries known already are
+ * updates). With bl_mutex held, or before the writer runs */
+static int set_entry(int op, const attacker_t *restrict attacker) {
+    unsigned int *slot;
+    int was = is_listed(& attacker->attack.address);
+
+    slot = index_slot(& attacker->attack.address);
+    if (*slot == 0) {
+        if (op == BL_OP_REMOVE && ! was) return 0;
+        if (bl.num_changes == bl.max_changes) {
+            if (index_grow() != 0) {
+                sshguard_log(LOG_ERR, "Out of memory for blacklist entries.");
+                return -1;
+            }
+            slot = index_slot(& attacker->attack.address);
+        }
+        *slot = ++bl.num_changes;
     }
+    bl.changes[*slot - 1].attacker = *attacker;
+    bl.changes[*slot - 1].removed = (op == BL_OP_REMOVE);
+    bl.changes[*slot - 1].seq = ++bl.seq;
+    bl.num_listed += (op == BL_OP_ADD) - was;
 
-    return blacklist;
+    return 0;
+}
+
+/* have an operation appended to the journal. With bl_mutex held */
+static int queue_record(int op, const attacker_t *restrict attacker) {
+    char *newpending;
+
+    if (bl.num_pending == bl.max_pending) {
+        newpending = (char *)realloc(bl.pending, (bl.max_pending > 0 ? 2 * bl.max_pending : BL_IO_RECORDS) * BL_RECORD_LEN);
+        if (newpending == NULL) {
+            sshguard_log(LOG_ERR, "Out of memory for blacklist changes, the blacklist file will miss one.");
+            return -1;
+        }
+        bl.pending = newpending;
+        bl.max_pending = (bl.max_pending > 0 ? 2 * bl.max_pending : BL_IO_RECORDS);
+    }
+    record_encode(bl.pending + bl.num_pending * BL_RECORD_LEN, op, attacker);
+    ++bl.num_pending;
+
+    if (bl_writer_running) {
+        pthread_cond_signal(& bl_changed);
+        return 0;
+    }
+    /* no writer, write right away */
+    if (append_journal(bl.pending, bl.num_pending) != 0) return -1;
+    bl.num_pending = 0;
+    return 0;
 }
 
-int blacklist_create(const char *filename) {
+/* load a blacklist in the format of older versions, for conversion */
+static int load_legacy(void) {
     list_t blacklist;
+    attacker_t *el;
+    char *legacyname;
+    int ret = 0;
 
     list_init(& blacklist);
-    list_attributes_serializer(& blacklist, attacker_serializer);
-
-    if (list_dump_file(& blacklist, filename, NULL) != 0)
+    list_attributes_unserializer(& blacklist, attacker_unserializer);
+    if (list_restore_file(& blacklist, bl.filename, NULL) != 0) {
+        sshguard_log(LOG_ERR, "Unable to read blacklist file '%s': not a blacklist.", bl.filename);
+        list_destroy(& blacklist);
         return -1;
+    }
 
+    list_iterator_start(& blacklist);
+    while (list_iterator_hasnext(& blacklist)) {
+        el = (attacker_t *)list_iterator_next(& blacklist);
+        if (ret == 0) ret = set_entry(BL_OP_ADD, el);
+        free(el);
+    }
+    list_iterator_stop(& blacklist);
     list_destroy(& blacklist);
+    if (ret != 0) return -1;
+
+    /* keep the original aside, it will be replaced */
+    legacyname = (char *)malloc(strlen(bl.filename) + sizeof(".legacy"));
+    if (legacyname == NULL) return -1;
+    sprintf(legacyname, "%s.legacy", bl.filename);
+    unlink(legacyname);
+    if (link(bl.filename, legacyname) != 0) {
+        sshguard_log(LOG_WARNING, "Unable to keep a copy of blacklist file '%s' at '%s': %s.", bl.filename, legacyname, strerror(errno));
+    }
+    sshguard_log(LOG_NOTICE, "Blacklist file '%s' will be converted to the new format (%u entries), original kept at '%s'.", bl.filename, bl.num_listed, legacyname);
+    free(legacyname);
+
+    /* a journal, if any, can't belong to this file */
+    unlink(bl.journalname);
+
+    return 0;
+}
+
+/* load a snapshot with records unsorted, past its magic, for conversion */
+static int load_unsorted(int fd) {
+    char header[BL_HEADER_LEN];
+    char *buf;
+    unsigned int num, i, j, n;
+    attacker_t attacker;
+    int op;
+
+    memcpy(header, BL_MAGIC_UNSORTED, BL_MAGIC_LEN);
+    if (read_full(fd, header + BL_MAGIC_LEN, BL_HEADER_LEN - BL_MAGIC_LEN) != BL_HEADER_LEN - BL_MAGIC_LEN
+            || get_uint32(header + BL_MAGIC_LEN + 4) != checksum(header, BL_MAGIC_LEN + 4)) {
+        sshguard_log(LOG_ERR, "Unable to read blacklist file '%s': corrupted header.", bl.filename);
+        return -1;
+    }
+    num = get_uint32(header + BL_MAGIC_LEN);
+
+    buf = (char *)malloc(BL_IO_RECORDS * BL_RECORD_LEN);
+    if (buf == NULL) return -1;
+    for (i = 0; i < num; i += n) {
+        n = (num - i < BL_IO_RECORDS ? num - i : BL_IO_RECORDS);
+        if (read_full(fd, buf, (size_t)n * BL_RECORD_LEN) != (ssize_t)n * BL_RECORD_LEN) {
+            sshguard_log(LOG_ERR, "Blacklist file '%s' is truncated: %u entries of %u read.", bl.filename, i, num);
+            break;
+        }
+        for (j = 0; j < n; ++j) {
+            if (record_decode(buf + j * BL_RECORD_LEN, & op, & attacker) == 0 && op == BL_OP_ADD && set_entry(op, & attacker) != 0) {
+                free(buf);
+                return -1;
+            }
+        }
+    }
+    free(buf);
+    sshguard_log(LOG_NOTICE, "Blacklist file '%s' will be sorted (%u entries).", bl.filename, bl.num_listed);
 
     return 0;
 }
 
-int blacklist_add(const char *restrict filename, const attacker_t *restrict newel) {
-    list_t *blacklist = blacklist_load(filename);
+/* map the snapshot read-only, in place of the previous one. With bl_mutex held, or before the writer runs */
+static int map_snapshot(void) {
+    struct stat st;
+    char *map;
+    unsigned int num;
+    int fd;
+
+    fd = open(bl.filename, O_RDONLY);
+    if (fd == -1 || fstat(fd, & st) != 0 || st.st_size < BL_HEADER_LEN) {
+        sshguard_log(LOG_ERR, "Unable to read blacklist file '%s': %s.", bl.filename, (fd == -1 || st.st_size >= BL_HEADER_LEN) ? strerror(errno) : "truncated header");
+        if (fd != -1) close(fd);
+        return -1;
+    }
+    map = (char *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        sshguard_log(LOG_ERR, "Unable to map blacklist file '%s': %s.", bl.filename, strerror(errno));
+        return -1;
+    }
 
-    if (blacklist == NULL)
+    if (memcmp(map, BL_MAGIC, BL_MAGIC_LEN) != 0 || get_uint32(map + BL_MAGIC_LEN + 4) != checksum(map, BL_MAGIC_LEN + 4)) {
+        sshguard_log(LOG_ERR, "Unable to read blacklist file '%s': corrupted header.", bl.filename);
+        munmap(map, (size_t)st.st_size);
         return -1;
+    }
+    num = get_uint32(map + BL_MAGIC_LEN);
+    if ((size_t)st.st_size < BL_HEADER_LEN + (size_t)num * BL_RECORD_LEN) {
+        sshguard_log(LOG_ERR, "Blacklist file '%s' is truncated: %lu entries of %u found.", bl.filename,
+                (unsigned long)((st.st_size - BL_HEADER_LEN) / BL_RECORD_LEN), num);
+        num = (unsigned int)((st.st_size - BL_HEADER_LEN) / BL_RECORD_LEN);
+    }
 
-    list_attributes_serializer(blacklist, attacker_serializer);
+    if (bl.map != NULL) {
+        munmap(bl.map, bl.map_len);
+    }
+    bl.map = map;
+    bl.map_len = (size_t)st.st_size;
+    bl.records = map + BL_HEADER_LEN;
+    bl.num_records = num;
+    bl.num_listed = num;
 
-    list_prepend(blacklist, newel);
+    return 0;
+}
 
-    if (list_dump_file(blacklist, filename, NULL) != 0) {
-        list_destroy(blacklist);
-        free(blacklist);
+/* apply the journal to the entries loaded, and open it for appending */
+static int replay_journal(void) {
+    char *buf;
+    attacker_t attacker;
+    ssize_t got;
+    off_t valid = 0;
+    unsigned int i;
+    int op, fd, torn = 0;
+
+    fd = open(bl.journalname, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd == -1) {
+        sshguard_log(LOG_ERR, "Unable to open blacklist journal '%s': %s.", bl.journalname, strerror(errno));
         return -1;
     }
 
-    sshguard_log(LOG_DEBUG, "Attacker '%s:%d' blacklisted. Blacklist now %d entries.", newel->attack.address.value, newel->attack.address.kind, list_size(blacklist));
+    buf = (char *)malloc(BL_IO_RECORDS * BL_RECORD_LEN);
+    if (buf == NULL) {
+        close(fd);
+        return -1;
+    }
+    while (! torn && (got = read_full(fd, buf, BL_IO_RECORDS * BL_RECORD_LEN)) > 0) {
+        for (i = 0; i < (size_t)got / BL_RECORD_LEN; ++i) {
+            if (record_decode(buf + i * BL_RECORD_LEN, & op, & attacker) != 0) {
+                torn = 1;
+                break;
+            }
+            if (set_entry(op, & attacker) != 0) {
+                free(buf);
+                close(fd);
+                return -1;
+            }
+            valid += BL_RECORD_LEN;
+            ++bl.journal_records;
+        }
+        if (got % BL_RECORD_LEN != 0) torn = 1;
+    }
+    free(buf);
+
+    /* a crash while appending can leave a partial record at the end */
+    if (lseek(fd, 0, SEEK_END) != valid) {
+        sshguard_log(LOG_WARNING, "Blacklist journal '%s' has a partial record past %u valid ones, dropping it.", bl.journalname, bl.journal_records);
+        if (ftruncate(fd, valid) != 0) {
+            sshguard_log(LOG_ERR, "Unable to truncate blacklist journal '%s': %s.", bl.journalname, strerror(errno));
+            close(fd);
+            return -1;
+        }
+    }
+    close(fd);
 
-    list_destroy(blacklist);
-    free(blacklist);
+    bl.journal_fd = open(bl.journalname, O_WRONLY | O_APPEND);
+    if (bl.journal_fd == -1) {
+        sshguard_log(LOG_ERR, "Unable to open blacklist journal '%s': %s.", bl.journalname, strerror(errno));
+        return -1;
+    }
 
     return 0;
 }
 
+/* write a new snapshot: the records of the current one, merged with the
+ * sorted records of changes. Replace the old snapshot all at once */
+static int write_snapshot(char *restrict changes, unsigned int num_changes) {
+    char header[BL_HEADER_LEN];
+    char *tmpname, *buf;
+    const char *rec, *end, *out;
+    unsigned int j, n, num = 0;
+    int cmp, fd, ret = 0;
+
+    tmpname = (char *)malloc(strlen(bl.filename) + sizeof(".tmp"));
+    buf = (char *)malloc(BL_IO_RECORDS * BL_RECORD_LEN);
+    if (tmpname == NULL || buf == NULL) {
+        free(tmpname);
+        free(buf);
+        return -1;
+    }
+    sprintf(tmpname, "%s.tmp", bl.filename);
+
+    fd = open(tmpname, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd == -1) {
+        ret = -1;
+    } else {
+        /* header last, when the number of records is known */
+        memset(header, 0x00, sizeof(header));
+        ret = write_full(fd, header, BL_HEADER_LEN);
+
+        rec = bl.records;
+        end = bl.records + (size_t)bl.num_records * BL_RECORD_LEN;
+        j = n = 0;
+        while (ret == 0 && (rec < end || j < num_changes)) {
+            if (rec < end && ! record_valid(rec)) {
+                rec += BL_RECORD_LEN;
+                continue;
+            }
+            /* a change overrides the record it equals */
+            cmp = (rec >= end ? 1 : (j >= num_changes ? -1 : record_compare(rec, changes + (size_t)j * BL_RECORD_LEN)));
+            if (cmp < 0) {
+                out = rec;
+                rec += BL_RECORD_LEN;
+            } else {
+                out = changes + (size_t)j * BL_RECORD_LEN;
+                if (cmp == 0) rec += BL_RECORD_LEN;
+                ++j;
+                if (get_uint32(out) == BL_OP_REMOVE) continue;
+            }
+            memcpy(buf + (size_t)n * BL_RECORD_LEN, out, BL_RECORD_LEN);
+            ++num;
+            if (++n == BL_IO_RECORDS) {
+                ret = write_full(fd, buf, (size_t)n * BL_RECORD_LEN);
+                n = 0;
+            }
+        }
+        if (ret == 0 && n > 0) ret = write_full(fd, buf, (size_t)n * BL_RECORD_LEN);
+
+        memcpy(header, BL_MAGIC, BL_MAGIC_LEN);
+        put_uint32(header + BL_MAGIC_LEN, num);
+        put_uint32(header + BL_MAGIC_LEN + 4, checksum(header, BL_MAGIC_LEN + 4));
+        if (ret == 0 && pwrite(fd, header, BL_HEADER_LEN, 0) != BL_HEADER_LEN) ret = -1;
+
+        /* a crash must find either the old snapshot or the whole new one */
+        if (ret == 0) ret = fsync(fd);
+        if (close(fd) != 0) ret = -1;
+        if (ret == 0) ret = rename(tmpname, bl.filename);
+    }
+    if (ret != 0) {
+        sshguard_log(LOG_ERR, "Unable to write blacklist file '%s': %s.", bl.filename, strerror(errno));
+        unlink(tmpname);
+    }
+    free(tmpname);
+    free(buf);
 
-int blacklist_lookup_address(const char *restrict filename, const sshg_address_t *restrict addr) {
-    attacker_t *restrict el;
-    list_t *restrict blacklist = blacklist_load(filename);
+    return ret;
+}
 
-    if (blacklist == NULL)
+/* append records to the journal, for good */
+static int append_journal(const char *restrict records, unsigned int num) {
+    if (write_full(bl.journal_fd, records, (size_t)num * BL_RECORD_LEN) != 0 || bl_datasync(bl.journal_fd) != 0) {
+        sshguard_log(LOG_ERR, "Unable to write blacklist journal '%s': %s.", bl.journalname, strerror(errno));
         return -1;
+    }
+    bl.journal_records += num;
 
-    sshguard_log(LOG_DEBUG, "Looking for address '%s:%d'...", addr->value, addr->kind);
-    list_attributes_seeker(blacklist, seeker_addr);
+    return 0;
+}
 
-    el = list_seek(blacklist, addr);
+/* merge the changes into a new snapshot, and empty the journal. From the
+ * writer only, or before it runs */
+static int compact(void) {
+    char *changes;
+    unsigned int i, num, seq;
+
+    /* write a copy, not to hold lookups meanwhile. Changes made after it
+     * stay in memory, and are appended to the journal emptied */
+    pthread_mutex_lock(& bl_mutex);
+    num = bl.num_changes;
+    seq = bl.seq;
+    changes = (char *)malloc((num > 0 ? num : 1) * BL_RECORD_LEN);
+    if (changes != NULL) {
+        for (i = 0; i < num; ++i) {
+            record_encode(changes + (size_t)i * BL_RECORD_LEN, (bl.changes[i].removed ? BL_OP_REMOVE : BL_OP_ADD), & bl.changes[i].attacker);
+        }
+    }
+    pthread_mutex_unlock(& bl_mutex);
+    if (changes == NULL) return -1;
 
-    list_destroy(blacklist);
-    free(blacklist);
+    /* the snapshot stays the same meanwhile: only compact() replaces it */
+    qsort(changes, num, BL_RECORD_LEN, record_compare);
+    if (write_snapshot(changes, num) != 0) {
+        free(changes);
+        return -1;
+    }
+    free(changes);
 
-    if (el != NULL)
-        sshguard_log(LOG_DEBUG, "Found!");
-    else
-        sshguard_log(LOG_DEBUG, "Not found.");
+    /* switch to the new snapshot, and forget changes it has */
+    pthread_mutex_lock(& bl_mutex);
+    if (map_snapshot() != 0) {
+        pthread_mutex_unlock(& bl_mutex);
+        return -1;
+    }
+    for (i = 0, num = 0; i < bl.num_changes; ++i) {
+        if (bl.changes[i].seq > seq) {
+            bl.changes[num++] = bl.changes[i];
+        }
+    }
+    bl.num_changes = num;
+    index_rebuild();
+    /* count again the changes the snapshot lacks */
+    for (i = 0; i < bl.num_changes; ++i) {
+        bl.num_listed += (! bl.changes[i].removed) - snapshot_has(& bl.changes[i].attacker.attack.address);
+    }
+    pthread_mutex_unlock(& bl_mutex);
+
+    if (ftruncate(bl.journal_fd, 0) != 0 || bl_datasync(bl.journal_fd) != 0) {
+        sshguard_log(LOG_ERR, "Unable to empty blacklist journal '%s': %s.", bl.journalname, strerror(errno));
+        return -1;
+    }
+    sshguard_log(LOG_INFO, "Blacklist journal merged into '%s' (%u records, now %u entries).", bl.filename, bl.journal_records, bl.num_records);
+    bl.journal_records = 0;
 
-    return (el != NULL);
+    return 0;
 }
 
+/* append changes to the journal in background, and compact it when large */
+static void *writer(void *arg) {
+    char *records;
+    unsigned int num;
+
+    int rewrite;
+
+    pthread_mutex_lock(& bl_mutex);
+    while (1) {
+        if (bl.num_pending == 0 && ! bl.compact_requested) {
+            if (bl.stop) break;
+            pthread_cond_wait(& bl_changed, & bl_mutex);
+            continue;
+        }
+
+        /* take the pending records, for changes to queue more meanwhile */
+        records = bl.pending;
+        num = bl.num_pending;
+        bl.pending = NULL;
+        bl.num_pending = bl.max_pending = 0;
+        rewrite = bl.compact_requested;
+        bl.compact_requested = 0;
+        pthread_mutex_unlock(& bl_mutex);
+
+        /* if records are lost, the next snapshot will have them from memory */
+        if (num > 0 && append_journal(records, num) != 0) bl.journal_failed = 1;
+        free(records);
+
+        if (rewrite || bl.journal_failed || (bl.journal_records >= BLACKLIST_COMPACT_RECORDS && bl.journal_records > bl.num_records)) {
+            if (compact() == 0) {
+                bl.journal_failed = 0;
+            } else if (rewrite) {
+                /* try again with the next change */
+                bl.journal_failed = 1;
+            }
+        }
+        pthread_mutex_lock(& bl_mutex);
+    }
+    pthread_mutex_unlock(& bl_mutex);
+
+    return NULL;
+}
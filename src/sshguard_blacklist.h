@@ -21,52 +21,119 @@
 #ifndef SSHGUARD_BLACKLIST_H
 #define SSHGUARD_BLACKLIST_H
 
-#include <simclist.h>
-
 #include "sshguard_attack.h"
 
+/*
+ * The blacklist is kept in two files: a snapshot, at the filename given,
+ * and a journal of later additions and removals, at the same filename with
+ * BLACKLIST_JOURNAL_SUFFIX. Both are sequences of fixed-length records,
+ * each with its own checksum. The records of the snapshot are sorted, and
+ * looked up in place with the file mapped in memory. The journal is merged into a new snapshot
+ * when it grows beyond BLACKLIST_COMPACT_RECORDS records, and beyond the
+ * records of the snapshot.
+ */
+#define BLACKLIST_JOURNAL_SUFFIX    ".journal"
+#define BLACKLIST_COMPACT_RECORDS   1024
+/* seconds an entry's last offense moves forward by at least, when touched */
+#define BLACKLIST_TOUCH_INTERVAL    60
+
+/* callback for visiting the entries of the blacklist */
+typedef void (*blacklist_visit_t)(const char *restrict address, int addrkind, int service, void *arg);
+
 /**
- * Load the blacklist contained at a given filename.
- *
- * Load the blacklist from a file with full path specified at "filename" into
- * a list_t object, and return it.
+ * Load the blacklist at a given filename, and keep it in memory for all
+ * other blacklist_*() functions. The file is created if missing, and
+ * converted if in the format of older versions (saving the original with
+ * a ".legacy" suffix).
  *
  * @param filename  full path of the file containing the black list
- * @return          NULL in case of error, or a list containing blacklisted entries
+ * @return          0 if successful, -1 otherwise
  */
-list_t *blacklist_load(const char *filename);
+int blacklist_init(const char *filename);
 
 /**
- * Create an empty blacklist.
- *
- * Create an empty blacklist file at "filename". If such file already
- * exists, it is overwritten.
+ * Get the number of entries in the blacklist.
+ */
+unsigned int blacklist_size(void);
+
+/**
+ * Call visit on each entry of the blacklist with addresses of a given kind.
  *
- * @param filename  full path of the file to create
- * @return          0 if successfull, non-0 otherwise
+ * Most entries are visited in the blacklist file as mapped in memory, so
+ * address is only valid during the call. visit must not call other
+ * blacklist_*() functions.
  */
-int blacklist_create(const char *filename);
+void blacklist_foreach(int addrkind, blacklist_visit_t visit, void *arg);
 
 /**
  * Add an entry to the blacklist.
  *
- * @param filename  full path of the file containing the black list
+ * The entry is known to blacklist_lookup_address() right away, and it is
+ * appended to the journal in background (together with other entries
+ * added meanwhile).
+ *
+ * If the address is blacklisted already, its last offense is updated
+ * instead, as for blacklist_expire().
+ *
  * @param newel     ip entry to add
  *
  * @return          0 if successful, non-0 otherwise
  */
-int blacklist_add(const char *restrict filename, const attacker_t *restrict newel);
+int blacklist_add(const attacker_t *restrict newel);
+
+/**
+ * Remove an entry from the blacklist.
+ *
+ * The removal is effective right away, and appended to the journal in
+ * background.
+ *
+ * @param addr      address to remove (value + type)
+ *
+ * @return          0 if successful (or addr is not blacklisted), -1 otherwise
+ */
+int blacklist_remove(const sshg_address_t *restrict addr);
 
+/**
+ * Move forward the last offense of a blacklisted address, that offended
+ * again while blocked, so that blacklist_expire() ages it from then.
+ *
+ * Updates closer than BLACKLIST_TOUCH_INTERVAL to the current last offense
+ * are dropped, so that a flood does not grow the journal.
+ *
+ * @param addr      address that offended (value + type)
+ * @param when      time of the offense
+ *
+ * @return          0 if successful (or addr is not blacklisted), -1 otherwise
+ */
+int blacklist_touch(const sshg_address_t *restrict addr, time_t when);
+
+/**
+ * Remove the entries whose last offense is older than a given time.
+ *
+ * The removals are effective right away, and written to the blacklist file
+ * in background all at once, by rewriting the snapshot.
+ *
+ * @param before    entries last offending before this time are removed
+ * @param expired   called for each entry removed, as with blacklist_foreach()
+ *
+ * @return          the number of entries removed
+ */
+int blacklist_expire(time_t before, blacklist_visit_t expired, void *arg);
 
 /**
  * Lookup if an address is present in the blacklist.
  *
- * @param filename  full path of the file containing the black list
  * @param addr      address to look up (value + type)
  *
  * @return          <0 if error; 1 if (addr,addrkind) present in blacklist, 0 otherwise
  */
-int blacklist_lookup_address(const char *restrict filename, const sshg_address_t *restrict addr);
+int blacklist_lookup_address(const sshg_address_t *restrict addr);
 
-#endif
+/**
+ * Write pending changes to the journal, and drop the blacklist from memory.
+ *
+ * @return          0 if successful, -1 if the file could not be written
+ */
+int blacklist_fin(void);
 
+#endif
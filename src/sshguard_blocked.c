@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "fnv.h"
+
+#include "sshguard_blocked.h"
+
+
+/* characters IP addresses are made of */
+#define IS_IPADDR_CHAR(c)   (((c) >= '0' && (c) <= '9') || ((c) >= 'a' && (c) <= 'f') || ((c) >= 'A' && (c) <= 'F') \
+                                || (c) == '.' || (c) == ':')
+
+/* a blocked address, in binary form: IPv4 in 4 bytes, IPv6 in 16 */
+typedef struct blocked_entry {
+    unsigned char addr[16];
+    size_t len;
+    struct blocked_entry *next;
+} blocked_entry_t;
+
+static pthread_mutex_t blocked_mutex = PTHREAD_MUTEX_INITIALIZER;
+static blocked_entry_t *blocked[BLOCKED_BUCKETS];
+static unsigned int num_blocked = 0;
+
+
+static size_t address_bytes(const char *restrict str, unsigned char *restrict bytes);
+static blocked_entry_t **find_entry(const unsigned char *restrict bytes, size_t len);
+
+
+int blocked_add(const sshg_address_t *restrict address) {
+    blocked_entry_t *entry, **pos;
+    unsigned char bytes[16];
+    size_t len;
+
+    len = address_bytes(address->value, bytes);
+    if (len == 0) return -1;
+
+    pthread_mutex_lock(& blocked_mutex);
+    pos = find_entry(bytes, len);
+    if (*pos == NULL) {
+        entry = (blocked_entry_t *)malloc(sizeof(blocked_entry_t));
+        if (entry == NULL) {
+            pthread_mutex_unlock(& blocked_mutex);
+            return -1;
+        }
+        memcpy(entry->addr, bytes, len);
+        entry->len = len;
+        entry->next = NULL;
+        *pos = entry;
+        ++num_blocked;
+    }
+    pthread_mutex_unlock(& blocked_mutex);
+
+    return 0;
+}
+
+void blocked_remove(const sshg_address_t *restrict address) {
+    blocked_entry_t *entry, **pos;
+    unsigned char bytes[16];
+    size_t len;
+
+    len = address_bytes(address->value, bytes);
+    if (len == 0) return;
+
+    pthread_mutex_lock(& blocked_mutex);
+    pos = find_entry(bytes, len);
+    if (*pos != NULL) {
+        entry = *pos;
+        *pos = entry->next;
+        free(entry);
+        --num_blocked;
+    }
+    pthread_mutex_unlock(& blocked_mutex);
+}
+
+int blocked_match_line(const char *restrict line, sshg_address_t *restrict address) {
+    const char *cur, *end;
+    char candidate[INET6_ADDRSTRLEN];
+    unsigned char bytes[16];
+    size_t len, numlen, i;
+    int found = 0, dots, colons;
+
+    /* nothing blocked, nothing to look for. Stale reads only cost a parse */
+    if (num_blocked == 0) return 0;
+
+    pthread_mutex_lock(& blocked_mutex);
+    for (cur = line; *cur != '\0'; cur = end) {
+        /* next run of characters that may form an IP address */
+        if (! IS_IPADDR_CHAR(*cur)) {
+            end = cur + 1;
+            continue;
+        }
+        for (end = cur; IS_IPADDR_CHAR(*end); ++end);
+
+        /* allow for trailing punctuation, as in "from 1.2.3.4." */
+        len = end - cur;
+        while (len > 0 && (cur[len-1] == '.' || (cur[len-1] == ':' && (len < 2 || cur[len-2] != ':')))) --len;
+        if (len == 0 || len >= sizeof(candidate)) continue;
+
+        /* words and plain numbers are no addresses */
+        dots = colons = 0;
+        for (i = 0; i < len; ++i) {
+            if (cur[i] == '.') ++dots;
+            else if (cur[i] == ':') ++colons;
+        }
+        if (dots != 3 && colons < 2) continue;
+        memcpy(candidate, cur, len);
+        candidate[len] = '\0';
+        numlen = address_bytes(candidate, bytes);
+        if (numlen == 0) continue;
+
+        /* an address: all must be blocked */
+        if (*find_entry(bytes, numlen) == NULL) {
+            found = 0;
+            break;
+        }
+        /* the first one, as the parser would have it */
+        if (! found && address != NULL) {
+            address->kind = (numlen == 4 ? ADDRKIND_IPv4 : ADDRKIND_IPv6);
+            strcpy(address->value, candidate);
+        }
+        found = 1;
+    }
+    pthread_mutex_unlock(& blocked_mutex);
+
+    return found;
+}
+
+void blocked_fin(void) {
+    blocked_entry_t *entry, *next;
+    int i;
+
+    pthread_mutex_lock(& blocked_mutex);
+    for (i = 0; i < BLOCKED_BUCKETS; ++i) {
+        for (entry = blocked[i]; entry != NULL; entry = next) {
+            next = entry->next;
+            free(entry);
+        }
+        blocked[i] = NULL;
+    }
+    num_blocked = 0;
+    pthread_mutex_unlock(& blocked_mutex);
+}
+
+
+/* binary form of an address, IPv4-mapped IPv6 addresses as IPv4. 0 if not an address */
+static size_t address_bytes(const char *restrict str, unsigned char *restrict bytes) {
+    struct in_addr addr4;
+    struct in6_addr addr6;
+
+    if (inet_pton(AF_INET, str, & addr4) == 1) {
+        memcpy(bytes, & addr4, 4);
+        return 4;
+    }
+    if (inet_pton(AF_INET6, str, & addr6) == 1) {
+        if (IN6_IS_ADDR_V4MAPPED(& addr6)) {
+            memcpy(bytes, & addr6.s6_addr[12], 4);
+            return 4;
+        }
+        memcpy(bytes, & addr6, 16);
+        return 16;
+    }
+
+    return 0;
+}
+
+/* where an address is, or would go, in the set. With blocked_mutex held */
+static blocked_entry_t **find_entry(const unsigned char *restrict bytes, size_t len) {
+    blocked_entry_t **pos;
+    Fnv32_t hash = FNV1_32A_INIT;
+    size_t i;
+
+    /* FNV-1a */
+    for (i = 0; i < len; ++i) {
+        hash = (hash ^ bytes[i]) * 0x01000193u;
+    }
+
+    for (pos = & blocked[hash % BLOCKED_BUCKETS]; *pos != NULL; pos = & (*pos)->next) {
+        if ((*pos)->len == len && memcmp((*pos)->addr, bytes, len) == 0) break;
+    }
+    return pos;
+}
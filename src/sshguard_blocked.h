@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#ifndef SSHGUARD_BLOCKED_H
+#define SSHGUARD_BLOCKED_H
+
+#include "sshguard_addresskind.h"
+
+/* buckets of the set of blocked addresses */
+#define BLOCKED_BUCKETS             1024
+
+/**
+ * Add an address to the set of those blocked. Can be called from any
+ * thread.
+ *
+ * @return 0 on success, -1 on error (the address is malformed, or no
+ *          memory is left)
+ */
+int blocked_add(const sshg_address_t *restrict address);
+
+/**
+ * Remove an address from the set of those blocked.
+ */
+void blocked_remove(const sshg_address_t *restrict address);
+
+/**
+ * Tell whether a log line surely comes from blocked addresses, without
+ * parsing it: the line has some IP address in it, and all of its IP
+ * addresses are blocked. Lines mentioning any other address, or none, are
+ * left to the parser.
+ *
+ * @param line      the log line
+ * @param address   if not NULL, set to the first address of a matching line,
+ *                  as written there
+ *
+ * @return 1 if the line only mentions blocked addresses, 0 otherwise
+ */
+int blocked_match_line(const char *restrict line, sshg_address_t *restrict address);
+
+/**
+ * Empty the set of blocked addresses.
+ */
+void blocked_fin(void);
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#if defined(HAVE_UTMPX_H)
+#   include <utmpx.h>
+#endif
+
+#include "sshguard.h"
+#include "sshguard_services.h"
+
+#include "sshguard_btmp.h"
+
+
+/* btmp files are a Linux thing, and only there utmpx carries the binary address */
+#if defined(HAVE_UTMPX_H) && defined(__linux__)
+#   define BTMP_SUPPORTED
+#endif
+
+
+#ifdef BTMP_SUPPORTED
+
+/* line recorded by sshd for failed logins, as in "ssh:notty" */
+#define BTMP_SSHD_LINE          "ssh"
+
+size_t btmp_record_size(void) {
+    assert(sizeof(struct utmpx) <= BTMP_MAX_RECORD_LEN);
+    return sizeof(struct utmpx);
+}
+
+int btmp_decode(const void *restrict record, attack_t *restrict attack, time_t *restrict when) {
+    struct utmpx ux;
+    const uint32_t *addr;
+
+    assert(record != NULL);
+    assert(attack != NULL);
+
+    /* copy out: record may be unaligned */
+    memcpy(& ux, record, sizeof(ux));
+
+    /* which service is this about? */
+    if (strncmp(ux.ut_line, BTMP_SSHD_LINE, strlen(BTMP_SSHD_LINE)) != 0)
+        return -1;
+    attack->service = SERVICES_SSH;
+    attack->dangerousness = DEFAULT_ATTACKS_DANGEROUSNESS;
+
+    /* get address, in network byte order */
+    addr = (const uint32_t *)ux.ut_addr_v6;
+    if (addr[1] == 0 && addr[2] == 0 && addr[3] == 0) {
+        if (addr[0] == 0) {
+            /* no address recorded */
+            return -1;
+        }
+        /* IPv4 */
+        attack->address.kind = ADDRKIND_IPv4;
+        if (inet_ntop(AF_INET, & addr[0], attack->address.value, sizeof(attack->address.value)) == NULL)
+            return -1;
+    } else if (addr[0] == 0 && addr[1] == 0 && addr[2] == htonl(0x0000ffff)) {
+        /* IPv4-mapped IPv6 */
+        attack->address.kind = ADDRKIND_IPv4;
+        if (inet_ntop(AF_INET, & addr[3], attack->address.value, sizeof(attack->address.value)) == NULL)
+            return -1;
+    } else {
+        attack->address.kind = ADDRKIND_IPv6;
+        if (inet_ntop(AF_INET6, addr, attack->address.value, sizeof(attack->address.value)) == NULL)
+            return -1;
+    }
+
+    if (when != NULL) *when = ux.ut_tv.tv_sec;
+
+    return 0;
+}
+
+#else
+
+size_t btmp_record_size(void) {
+    return 0;
+}
+
+int btmp_decode(const void *restrict record, attack_t *restrict attack, time_t *restrict when) {
+    return -1;
+}
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#ifndef SSHGUARD_BTMP_H
+#define SSHGUARD_BTMP_H
+
+#include <stddef.h>
+#include <time.h>
+
+#include "sshguard_attack.h"
+
+/* upper bound to the size of btmp records on any platform */
+#define BTMP_MAX_RECORD_LEN         1024
+
+/**
+ * Tell the size of records in btmp files (failed logins), as written by
+ * login programs through utmpx.
+ *
+ * @return size of a record in bytes, or 0 if btmp files are not supported
+ *          on this platform
+ */
+size_t btmp_record_size(void);
+
+/**
+ * Decode a btmp record into an attack.
+ *
+ * Only records of failed logins from remote addresses to services we
+ * know about make attacks. The record must be btmp_record_size() long.
+ * When not NULL, when is set to the time of the failed login.
+ *
+ * @return 0 if attack was filled, -1 if the record is not an attack
+ */
+int btmp_decode(const void *restrict record, attack_t *restrict attack, time_t *restrict when);
+
+#endif
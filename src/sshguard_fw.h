@@ -76,8 +76,8 @@ int fw_block(const char *restrict addr, int addrkind, int service);
 /**
  * Block a list of addresses.
  *
- * Block a given list of addresses, all of the same kind and
- * destined to the same service.
+ * Block a given list of addresses, all of the same kind. The list can be
+ * arbitrarily long: backends split it as they need.
  *
  * @param addresses     an array of strings, one per address to be blocked
  * @param addrkind      the type of all addresses in addresses[]
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sshguard_log.h"
+
+#include "sshguard_journal.h"
+
+
+/* bytes of the stream buffered per reader. Larger fields are truncated */
+#define JOURNAL_BUFSIZE         (64 * 1024)
+
+/* longer keys are taken as garbage */
+#define JOURNAL_MAX_KEY_LEN     256
+
+/* longer binary values are taken as a corrupt stream (journald takes 768 MB at most) */
+#define JOURNAL_MAX_VALUE_LEN   ((uint64_t)1 << 30)
+
+struct journal_reader {
+    char buf[JOURNAL_BUFSIZE];          /* data read and not yet consumed... */
+    size_t start;                       /* ... begins here ... */
+    size_t len;                         /* ... and is this long */
+
+    journal_entry_t cur;                /* entry being assembled */
+    int cur_has_message;                /* did it have a MESSAGE field so far? */
+    int cur_has_source_time;            /* was the time given by the sender? */
+
+    uint64_t skip;                      /* bytes to drop of a binary field too big for the buffer */
+    int skip_line;                      /* drop data up to the next LF (text field too big for the buffer) */
+};
+
+
+/* parse fields from buffered data. Return 0 if an entry was completed, 1 if more data is needed */
+static int parse_fields(journal_reader_t *restrict reader, journal_entry_t *restrict entry);
+/* fill current entry with a field, if relevant */
+static void handle_field(journal_reader_t *restrict reader, const char *key, size_t keylen, const char *value, size_t valuelen);
+static void reset_entry(journal_reader_t *restrict reader);
+
+
+journal_reader_t *journal_reader_new(void) {
+    journal_reader_t *reader;
+
+    reader = (journal_reader_t *)malloc(sizeof(journal_reader_t));
+    if (reader == NULL) return NULL;
+    journal_reader_reset(reader);
+
+    return reader;
+}
+
+void journal_reader_reset(journal_reader_t *restrict reader) {
+    assert(reader != NULL);
+
+    reader->start = reader->len = 0;
+    reader->skip = 0;
+    reader->skip_line = 0;
+    reset_entry(reader);
+}
+
+void journal_reader_free(journal_reader_t *restrict reader) {
+    free(reader);
+}
+
+int journal_read(journal_reader_t *restrict reader, int fd, journal_entry_t *restrict entry) {
+    ssize_t ret;
+
+    assert(reader != NULL);
+    assert(entry != NULL);
+
+    while (1) {
+        /* got an entry already buffered? */
+        if (parse_fields(reader, entry) == 0)
+            return 0;
+
+        /* make room for more data */
+        if (reader->start > 0) {
+            memmove(reader->buf, reader->buf + reader->start, reader->len);
+            reader->start = 0;
+        }
+        assert(reader->len < sizeof(reader->buf));
+
+        ret = read(fd, reader->buf + reader->len, sizeof(reader->buf) - reader->len);
+        if (ret > 0) {
+            reader->len += ret;
+            continue;
+        }
+        if (ret == 0) return 2;
+#ifdef EINTR
+        if (errno == EINTR) continue;
+#endif
+        if (errno == EAGAIN) return 1;
+        return -1;
+    }
+}
+
+
+/* drop n bytes from the head of the buffer */
+static inline void consume(journal_reader_t *restrict reader, size_t n) {
+    assert(n <= reader->len);
+    reader->start += n;
+    reader->len -= n;
+    if (reader->len == 0) reader->start = 0;
+}
+
+static int parse_fields(journal_reader_t *restrict reader, journal_entry_t *restrict entry) {
+    const char *data, *nl, *eq;
+    size_t linelen, avail, hdrlen, n;
+    uint64_t valuelen;
+    int i;
+
+    while (reader->len > 0) {
+        data = reader->buf + reader->start;
+        avail = reader->len;
+
+        /* drop the rest of fields that did not fit in the buffer */
+        if (reader->skip > 0) {
+            n = (reader->skip < avail ? reader->skip : avail);
+            consume(reader, n);
+            reader->skip -= n;
+            continue;
+        }
+        if (reader->skip_line) {
+            nl = memchr(data, '\n', avail);
+            if (nl == NULL) {
+                consume(reader, avail);
+                break;
+            }
+            consume(reader, nl - data + 1);
+            reader->skip_line = 0;
+            continue;
+        }
+
+        nl = memchr(data, '\n', avail);
+        if (nl == NULL) {
+            if (avail == sizeof(reader->buf)) {
+                /* a line longer than the whole buffer: can't be of use */
+                sshguard_log(LOG_INFO, "Dropping too long field in journal stream.");
+                reader->skip_line = 1;
+                consume(reader, avail);
+            }
+            break;
+        }
+        linelen = nl - data;
+
+        /* empty line: end of entry */
+        if (linelen == 0) {
+            consume(reader, 1);
+            if (reader->cur_has_message) {
+                *entry = reader->cur;
+                reset_entry(reader);
+                return 0;
+            }
+            reset_entry(reader);
+            continue;
+        }
+
+        /* text field: "KEY=value\n" */
+        eq = memchr(data, '=', linelen);
+        if (eq != NULL) {
+            handle_field(reader, data, eq - data, eq + 1, linelen - (eq - data) - 1);
+            consume(reader, linelen + 1);
+            continue;
+        }
+
+        /* binary field: "KEY\n", 64 bit little endian length, value, "\n" */
+        if (linelen > JOURNAL_MAX_KEY_LEN) {
+            consume(reader, linelen + 1);
+            continue;
+        }
+        hdrlen = linelen + 1 + 8;
+        if (avail < hdrlen) break;
+        valuelen = 0;
+        for (i = 7; i >= 0; --i) {
+            valuelen = (valuelen << 8) | (unsigned char)data[linelen + 1 + i];
+        }
+        if (valuelen > JOURNAL_MAX_VALUE_LEN) {
+            /* no sense in the length: drop the entry, and start over at the next LF */
+            sshguard_log(LOG_NOTICE, "Dropping entry with a field of %llu bytes in journal stream.", (unsigned long long)valuelen);
+            reset_entry(reader);
+            reader->skip_line = 1;
+            consume(reader, hdrlen);
+            continue;
+        }
+        if (valuelen + hdrlen + 1 <= avail) {
+            handle_field(reader, data, linelen, data + hdrlen, valuelen);
+            consume(reader, hdrlen + valuelen + 1);
+            continue;
+        }
+        if (valuelen + hdrlen + 1 <= sizeof(reader->buf)) {
+            /* wait for the rest */
+            break;
+        }
+        /* too big to hold: take the head, drop the rest when it comes */
+        handle_field(reader, data, linelen, data + hdrlen, avail - hdrlen);
+        reader->skip = valuelen + hdrlen + 1 - avail;
+        consume(reader, avail);
+    }
+
+    return 1;
+}
+
+#define KEY_IS(key, keylen, name)      ((keylen) == sizeof(name) - 1 && memcmp((key), (name), (keylen)) == 0)
+
+static void handle_field(journal_reader_t *restrict reader, const char *key, size_t keylen, const char *value, size_t valuelen) {
+    char numbuf[24];
+    size_t i;
+
+    if (KEY_IS(key, keylen, "MESSAGE")) {
+        if (valuelen >= sizeof(reader->cur.message))
+            valuelen = sizeof(reader->cur.message) - 1;
+        /* of multi-line messages, take the first line, as syslog would have it alone */
+        for (i = 0; i < valuelen && value[i] != '\0' && value[i] != '\n' && value[i] != '\r'; ++i) {
+            reader->cur.message[i] = value[i];
+        }
+        reader->cur.message[i] = '\0';
+        reader->cur_has_message = 1;
+        return;
+    }
+
+    if (KEY_IS(key, keylen, "_COMM")) {
+        if (valuelen >= sizeof(reader->cur.program))
+            valuelen = sizeof(reader->cur.program) - 1;
+        memcpy(reader->cur.program, value, valuelen);
+        reader->cur.program[valuelen] = '\0';
+        return;
+    }
+
+    /* the rest are numbers */
+    if (valuelen >= sizeof(numbuf)) return;
+    memcpy(numbuf, value, valuelen);
+    numbuf[valuelen] = '\0';
+
+    if (KEY_IS(key, keylen, "_PID")) {
+        reader->cur.pid = (pid_t)strtol(numbuf, NULL, 10);
+    } else if (KEY_IS(key, keylen, "_SOURCE_REALTIME_TIMESTAMP")) {
+        /* microseconds since the epoch, as given by the sender */
+        reader->cur.when = (time_t)(strtoull(numbuf, NULL, 10) / 1000000);
+        reader->cur_has_source_time = 1;
+    } else if (KEY_IS(key, keylen, "__REALTIME_TIMESTAMP")) {
+        /* microseconds since the epoch, as received by the journal */
+        if (! reader->cur_has_source_time)
+            reader->cur.when = (time_t)(strtoull(numbuf, NULL, 10) / 1000000);
+    }
+}
+
+static void reset_entry(journal_reader_t *restrict reader) {
+    reader->cur.message[0] = '\0';
+    reader->cur.program[0] = '\0';
+    reader->cur.pid = 0;
+    reader->cur.when = 0;
+    reader->cur_has_message = 0;
+    reader->cur_has_source_time = 0;
+}
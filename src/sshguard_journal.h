@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#ifndef SSHGUARD_JOURNAL_H
+#define SSHGUARD_JOURNAL_H
+
+#include <sys/types.h>
+#include <time.h>
+
+
+/* longest message kept from an entry. Longer ones are truncated */
+#define JOURNAL_MAX_MESSAGE_LEN     1024
+
+/* longest program name kept from an entry */
+#define JOURNAL_MAX_PROGRAM_LEN     64
+
+/* an entry of the journal, limited to the fields we care about */
+typedef struct {
+    char message[JOURNAL_MAX_MESSAGE_LEN];  /* MESSAGE: the bare message, no banner */
+    char program[JOURNAL_MAX_PROGRAM_LEN];  /* _COMM: the name of the logging program, or "" */
+    pid_t pid;                              /* _PID: the logging process, or 0 if unknown */
+    time_t when;                            /* when the message was logged, or 0 if unknown */
+} journal_entry_t;
+
+/* state of a reader of a stream in journal export format */
+typedef struct journal_reader journal_reader_t;
+
+
+/**
+ * Create a reader of a stream in journal export format, as produced by
+ * "journalctl -o export".
+ *
+ * @return the reader, or NULL on error
+ */
+journal_reader_t *journal_reader_new(void);
+
+/**
+ * Discard any partial data in the reader, e.g. when its stream is reopened.
+ */
+void journal_reader_reset(journal_reader_t *restrict reader);
+
+/**
+ * Release a reader.
+ */
+void journal_reader_free(journal_reader_t *restrict reader);
+
+/**
+ * Get the next entry carrying a message from a stream, without blocking.
+ *
+ * Data read from fd and not yet making up an entry is kept in the reader
+ * for the next call. Entries without MESSAGE are skipped.
+ *
+ * @return 0 if entry was filled, 1 if no complete entry is available, 2 if
+ *          no entry is available and the stream is at its end, -1 on error
+ */
+int journal_read(journal_reader_t *restrict reader, int fd, journal_entry_t *restrict entry);
+
+#endif
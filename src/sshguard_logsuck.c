@@ -42,6 +42,7 @@
 #include <sys/stat.h>
 /* to sleep POSIX-compatibly with select() */
 #include <sys/time.h>
+#include <sys/select.h>
 
 
 #include "fnv.h"
@@ -49,6 +50,9 @@
 
 #include "sshguard.h"
 #include "sshguard_log.h"
+#include "sshguard_tcpsource.h"
+#include "sshguard_btmp.h"
+#include "sshguard_journal.h"
 
 
 #include "sshguard_logsuck.h"
@@ -62,8 +66,45 @@
 /* factor of growth of the interval between polls while in idle */
 #define     LOGPOLL_INTERVAL_GROWTHFACTOR     0.03
 
+/* initial size of line buffers. They grow up to the longest line allowed */
+#define     LOGSUCK_LINEBUF_INITIAL_SIZE      4096
+
+/* kinds of sources */
+#define LOGSUCK_SOURCE_FILE     0       /* a file in the filesystem, possibly rotated */
+#define LOGSUCK_SOURCE_STDIN    1       /* standard input */
+#define LOGSUCK_SOURCE_TCP      2       /* syslog senders connecting over TCP (all of them) */
+
+/* formats of data in sources */
+#define LOGSUCK_FORMAT_TEXT     0       /* log lines */
+#define LOGSUCK_FORMAT_BTMP     1       /* binary records of failed logins */
+#define LOGSUCK_FORMAT_JOURNAL  2       /* journal export format */
+
+/* is this source a file in the filesystem? */
+#define LOGSUCK_IS_FILE(s)      ((s)->kind == LOGSUCK_SOURCE_FILE)
+
+/* prefix of source names for listening on TCP */
+#define LOGSUCK_TCP_PREFIX      "tcp:"
+/* prefix of source names for btmp files */
+#define LOGSUCK_BTMP_PREFIX     "btmp:"
+/* prefix of source names for journal export streams */
+#define LOGSUCK_JOURNAL_PREFIX  "journal:"
+
+/* data read from a text source, and not yet returned as lines */
+typedef struct {
+    char *data;                         /* buffer, allocated at first read */
+    size_t size;                        /* its size */
+    size_t start;                       /* unconsumed data begins here ... */
+    size_t len;                         /* ... and is this long */
+    size_t scanned;                     /* bytes of it known not to contain a newline */
+    int truncating;                     /* dropping the rest of a line longer than allowed */
+} linebuf_t;
+
 /* metainformation on a source */
 typedef struct {
+    int kind;                           /* LOGSUCK_SOURCE_* */
+    int format;                         /* LOGSUCK_FORMAT_* */
+    journal_reader_t *journal;          /* reader state, for LOGSUCK_FORMAT_JOURNAL */
+    linebuf_t *lines;                   /* buffered data, for LOGSUCK_FORMAT_TEXT */
     char filename[PATH_MAX];            /* filename in the filesystem */
     sourceid_t source_id;               /* filename-based ID of source, constant across rotations */
 
@@ -71,6 +112,7 @@ typedef struct {
     int active;                         /* is the source active? 0/1 */
     int current_descriptor;             /* current file descriptor, if active */
     int current_serial_number;          /* current serial number of the source, if active */
+    off_t tail_offset;                  /* where tailing began when the source was added, or -1 */
 } source_entry_t;
 
 /* list of source_entry_t elements */
@@ -82,6 +124,8 @@ static int kq;
 static struct kevent kevs[2*MAX_FILES_POLLED];
 /* timeout for kevent() polling */
 static struct timespec kev_timeout;
+/* zero timeout, for checking events without waiting */
+static struct timespec kev_nowait;
 
 /* refresh inactive files that possibly reappeared. This is cheaper than refresh_files() */
 static int refresh_inactive_files();
@@ -93,12 +137,40 @@ static void set_kevs();
 /* how many files we are actively polling (may decrease at runtime if some "disappear" */
 static int num_sources_active = 0;
 
+/* how many sources may come back after going inactive (files, TCP senders) */
+static int num_sources_revivable = 0;
+
 /* index of last file polled (used if insisting on source is required) */
 static int index_last_read = -1;
 
+/* the source entry standing for all TCP senders, if any */
+static source_entry_t *tcp_source = NULL;
+
+/* who to tell when a source ends for good */
+static logsuck_source_ended_t source_ended_callback = NULL;
+
+#if defined(HAVE_KQUEUE)
+/* alternate between TCP senders and files when both have data */
+static int tcp_turn = 0;
+#endif
+
 
-/* read a line from a file descriptor into a buffer */
-static int read_from(const source_entry_t *restrict source, char *restrict buf, size_t buflen);
+/* start listening on a TCP endpoint, adding the TCP source at the first one */
+static int add_tcpsource(const char *restrict endpoint);
+/* forward the end of a source to the callback, if any */
+static void source_ended(sourceid_t source_id);
+/* read records from a btmp source until one is an attack. Return 1 if got one, 0 if none, -1 on error */
+static int read_record(source_entry_t *restrict source, logsuck_entryinfo_t *restrict info);
+/* read the next message from a journal source. Return 1 if got one, 0 if none, 2 at end of stream, -1 on error */
+static int read_journal(source_entry_t *restrict source, char *restrict buf, size_t buflen, logsuck_entryinfo_t *restrict info);
+/* read what the next entry of a source has. Return LOGSUCK_GOT_* or -1 if nothing got */
+static int read_entry(source_entry_t *restrict source, char *restrict buf, size_t buflen, logsuck_entryinfo_t *restrict info);
+/* read the next line of a text source into buf. Return 1 if got one, 0 if none, 2 at end of stream, -1 on error */
+static int read_line(source_entry_t *restrict source, char *restrict buf, size_t buflen);
+#if defined(HAVE_KQUEUE)
+/* tell if a source may give an entry without waiting for new data */
+static int has_buffered_entry(const source_entry_t *restrict source);
+#endif
 static void deactivate_source(source_entry_t *restrict s);
 
 /* restore (open + update) a source previously inactive, then reappeared */
@@ -141,6 +213,8 @@ int logsuck_init() {
     /* re-test sources every this interval */
     kev_timeout.tv_sec = 1;
     kev_timeout.tv_nsec = 500 * 1000 * 1000;
+    kev_nowait.tv_sec = 0;
+    kev_nowait.tv_nsec = 0;
 #endif
 
     return 0;
@@ -150,6 +224,27 @@ int logsuck_add_logsource(const char *restrict filename) {
     source_entry_t cursource;
 
     assert(filename != NULL);
+
+    cursource.format = LOGSUCK_FORMAT_TEXT;
+    cursource.journal = NULL;
+    cursource.lines = NULL;
+    cursource.tail_offset = -1;
+
+    if (strncmp(filename, LOGSUCK_TCP_PREFIX, strlen(LOGSUCK_TCP_PREFIX)) == 0) {
+        return add_tcpsource(filename + strlen(LOGSUCK_TCP_PREFIX));
+    }
+    if (strncmp(filename, LOGSUCK_BTMP_PREFIX, strlen(LOGSUCK_BTMP_PREFIX)) == 0) {
+        if (btmp_record_size() == 0) {
+            sshguard_log(LOG_ERR, "Files of failed logins ('%s') are not supported on this system.", filename);
+            return -1;
+        }
+        cursource.format = LOGSUCK_FORMAT_BTMP;
+        filename += strlen(LOGSUCK_BTMP_PREFIX);
+    } else if (strncmp(filename, LOGSUCK_JOURNAL_PREFIX, strlen(LOGSUCK_JOURNAL_PREFIX)) == 0) {
+        cursource.format = LOGSUCK_FORMAT_JOURNAL;
+        filename += strlen(LOGSUCK_JOURNAL_PREFIX);
+    }
+
     if (list_size(& sources_list) >= MAX_FILES_POLLED) {
         sshguard_log(LOG_CRIT, "I can monitor at most %u files! See MAX_FILES_POLLED.", MAX_FILES_POLLED);
         return -1;
@@ -163,10 +258,25 @@ int logsuck_add_logsource(const char *restrict filename) {
     /* compute source id (based on filename) */
     cursource.source_id = fnv_32a_str(filename, 0);
 
+    if (cursource.format == LOGSUCK_FORMAT_JOURNAL) {
+        cursource.journal = journal_reader_new();
+        if (cursource.journal == NULL) {
+            sshguard_log(LOG_ERR, "Unable to allocate reader for journal '%s'.", filename);
+            return -1;
+        }
+    } else if (cursource.format == LOGSUCK_FORMAT_TEXT) {
+        cursource.lines = (linebuf_t *)calloc(1, sizeof(linebuf_t));
+        if (cursource.lines == NULL) {
+            sshguard_log(LOG_ERR, "Unable to allocate buffer for '%s'.", filename);
+            return -1;
+        }
+    }
+
     /* open and store file descriptor */
     if (strcmp(filename, "-") == 0) {
         int fflags;
         /* read from standard input */
+        cursource.kind = LOGSUCK_SOURCE_STDIN;
         cursource.current_descriptor = STDIN_FILENO;
         cursource.current_serial_number = 0;
         /* set O_NONBLOCK as the other sources (but this is already open) */
@@ -180,6 +290,8 @@ int logsuck_add_logsource(const char *restrict filename) {
     } else {
         struct stat fileinfo;
 
+        cursource.kind = LOGSUCK_SOURCE_FILE;
+
         /* get current serial number */
         if (stat(filename, & fileinfo) != 0) {
             sshguard_log(LOG_ERR, "File '%s' vanished while adding!", filename);
@@ -191,7 +303,8 @@ int logsuck_add_logsource(const char *restrict filename) {
             return -1;
         }
         /* move to the end of file */
-        lseek(cursource.current_descriptor, 0, SEEK_END); /* safe to fail if file is named pipe */
+        cursource.tail_offset = lseek(cursource.current_descriptor, 0, SEEK_END); /* safe to fail if file is named pipe */
+        ++num_sources_revivable;
     }
 
     /* do add */
@@ -206,12 +319,14 @@ int logsuck_add_logsource(const char *restrict filename) {
     return 0;
 }
 
-int logsuck_getline(char *restrict buf, size_t buflen, bool from_previous_source, sourceid_t *restrict whichsource) {
+int logsuck_getline(char *restrict buf, size_t buflen, bool from_previous_source, sourceid_t *restrict whichsource, logsuck_entryinfo_t *restrict info) {
     int ret;
 #if ! defined(HAVE_KQUEUE)
     /* use active poll through non-blocking read()s */
     int sleep_interval;
     struct timeval sleepstruct;
+    fd_set waitfds;
+    int pos, maxfd, only_waitable;
 #endif
     source_entry_t *restrict readentry;
 
@@ -220,12 +335,19 @@ int logsuck_getline(char *restrict buf, size_t buflen, bool from_previous_source
     if (from_previous_source && index_last_read >= 0) {
         /* get source to read from */
         readentry = (source_entry_t *restrict)list_get_at(& sources_list, index_last_read);
-        if (readentry->active) {
+        if (readentry->kind == LOGSUCK_SOURCE_TCP || readentry->format != LOGSUCK_FORMAT_TEXT) {
+            /* these deliver whole messages only */
+            sshguard_log(LOG_DEBUG, "Can't insist reading from '%s'.", readentry->filename);
+        } else if (readentry->active) {
             sshguard_log(LOG_DEBUG, "Sticking to '%s' to get next line.", readentry->filename);
-            if (whichsource != NULL) *whichsource = readentry->source_id;
-            return read_from(readentry, buf, buflen);
+            ret = read_entry(readentry, buf, buflen, info);
+            if (ret >= 0) {
+                if (whichsource != NULL) *whichsource = readentry->source_id;
+                return ret;
+            }
+        } else {
+            sshguard_log(LOG_ERR, "Source '%s' no longer active; can't insist reading from it.", readentry->filename);
         }
-        sshguard_log(LOG_ERR, "Source '%s' no longer active; can't insist reading from it.", readentry->filename);
     }
 
 #if defined(HAVE_KQUEUE)
@@ -234,10 +356,47 @@ int logsuck_getline(char *restrict buf, size_t buflen, bool from_previous_source
     refresh_files();
     sshguard_log(LOG_DEBUG, "Start polling.");
     while (1) {
-        if (num_sources_active == list_size(& sources_list)) {
-            ret = kevent(kq, NULL, 0, kevs, 1, NULL);
-        } else {
-            ret = kevent(kq, NULL, 0, kevs, 1, & kev_timeout);
+        ret = 0;
+        if (tcp_source != NULL) {
+            /* TCP senders may have messages buffered already, with no new event */
+            tcp_turn = ! tcp_turn;
+            if (tcp_turn && tcpsource_getline(buf, buflen, whichsource) == 0) {
+                info->when = 0;
+                return LOGSUCK_GOT_LINE;
+            }
+            ret = kevent(kq, NULL, 0, kevs, 1, & kev_nowait);
+            if (ret == 0 && ! tcp_turn && tcpsource_getline(buf, buflen, whichsource) == 0) {
+                info->when = 0;
+                return LOGSUCK_GOT_LINE;
+            }
+        }
+        if (ret == 0) {
+            /* sources may have entries buffered already, with no new event */
+            list_iterator_start(& sources_list);
+            while (list_iterator_hasnext(& sources_list)) {
+                readentry = (source_entry_t *restrict)list_iterator_next(& sources_list);
+                if (! readentry->active || ! has_buffered_entry(readentry)) continue;
+                ret = read_entry(readentry, buf, buflen, info);
+                if (ret >= 0) {
+                    list_iterator_stop(& sources_list);
+                    if (whichsource != NULL) *whichsource = readentry->source_id;
+                    return ret;
+                }
+            }
+            list_iterator_stop(& sources_list);
+            ret = 0;
+        }
+        if (num_sources_active == 0 && num_sources_revivable == 0) {
+            /* all sources ended for good */
+            sshguard_log(LOG_NOTICE, "All log sources ended.");
+            return -1;
+        }
+        if (ret == 0) {
+            if (num_sources_active == list_size(& sources_list)) {
+                ret = kevent(kq, NULL, 0, kevs, 1, NULL);
+            } else {
+                ret = kevent(kq, NULL, 0, kevs, 1, & kev_timeout);
+            }
         }
         if (ret > 0) {
             if (kevs[0].filter == EVFILT_READ) {
@@ -246,7 +405,12 @@ int logsuck_getline(char *restrict buf, size_t buflen, bool from_previous_source
                 readentry = list_seek(& sources_list, & kevs[0].ident);
                 assert(readentry != NULL);
                 assert(readentry->active);
-                return read_from(readentry, buf, buflen);
+                /* TCP senders are served on the next round */
+                if (readentry->kind == LOGSUCK_SOURCE_TCP) continue;
+                ret = read_entry(readentry, buf, buflen, info);
+                if (ret < 0) continue;
+                if (whichsource != NULL) *whichsource = readentry->source_id;
+                return ret;
             } else {
                 /* some source deleted or rotated: test all sources */
                 refresh_files();
@@ -266,7 +430,7 @@ int logsuck_getline(char *restrict buf, size_t buflen, bool from_previous_source
     /* poll all files until some stuff is read (in random order, until data is found) */
     sleep_interval = 20;
     while (1) {
-        int pos, start;
+        int start;
 
         /* attempt to redeem disappeared files */
         refresh_files();
@@ -278,36 +442,57 @@ int logsuck_getline(char *restrict buf, size_t buflen, bool from_previous_source
             index_last_read = pos % list_size(& sources_list);
             readentry = (source_entry_t *restrict)list_get_at(& sources_list, index_last_read);
             if (! readentry->active) continue;
+            if (readentry->kind == LOGSUCK_SOURCE_TCP) {
+                /* whole messages from any TCP sender */
+                if (tcpsource_getline(buf, buflen, whichsource) == 0) {
+                    sshguard_log(LOG_DEBUG, "Got message from TCP sender.");
+                    info->when = 0;
+                    return LOGSUCK_GOT_LINE;
+                }
+                continue;
+            }
             /* sshguard_log(LOG_DEBUG, "Attempting to read from '%s'.", readentry->filename); */
-            ret = read(readentry->current_descriptor, & buf[0], 1);
-            switch (ret) {
-                case 1:
-                    /* ignore blank lines */
-                    if (buf[0] == '\n') continue;
-                    /* there is stuff. Read rest of the line */
-                    sshguard_log(LOG_DEBUG, "Read line from '%s'.", readentry->filename);
-                    if (whichsource != NULL) *whichsource = readentry->source_id;
-                    return read_from(readentry, & buf[1], buflen-1);
-
-                case -1:
-#ifdef EINTR
-                    if (errno == EINTR) {
-                        continue;
-                    }
-#endif
-                    if (errno != EAGAIN) {
-                        /* error */
-                        sshguard_log(LOG_NOTICE, "Error while reading from file '%s': %s.", readentry->filename, strerror(errno));
-                        deactivate_source(readentry);
-                    }
+            ret = read_entry(readentry, buf, buflen, info);
+            if (ret < 0) continue;
+            if (whichsource != NULL) *whichsource = readentry->source_id;
+            return ret;
+        }
+        if (num_sources_active == 0 && num_sources_revivable == 0) {
+            /* all sources ended for good */
+            sshguard_log(LOG_NOTICE, "All log sources ended.");
+            return -1;
+        }
+        /* wake up as soon as standard input or TCP senders have something:
+         * if they are all the sources, there is nothing else to wait for */
+        FD_ZERO(& waitfds);
+        maxfd = -1;
+        only_waitable = 1;
+        for (pos = 0; pos < list_size(& sources_list); ++pos) {
+            readentry = (source_entry_t *restrict)list_get_at(& sources_list, pos);
+            if (readentry->kind == LOGSUCK_SOURCE_FILE) {
+                only_waitable = 0;
+                continue;
+            }
+            if (! readentry->active) continue;
+            if (readentry->current_descriptor < 0) {
+                only_waitable = 0;
+                continue;
             }
+            FD_SET(readentry->current_descriptor, & waitfds);
+            if (readentry->current_descriptor > maxfd) maxfd = readentry->current_descriptor;
+        }
+        if (only_waitable && maxfd >= 0) {
+            sshguard_log(LOG_DEBUG, "Nothing new on any source. Wait for new data.");
+            select(maxfd + 1, & waitfds, NULL, NULL, NULL);
+            continue;
         }
+
         /* no data. Wait for something with exponential backoff, up to LOGSUCK_MAX_WAIT */
         sshguard_log(LOG_DEBUG, "Nothing new on any file. Wait %d millisecs for new data.", sleep_interval);
         /* sleep, POSIX-compatibly */
         sleepstruct.tv_sec = sleep_interval / 1000;
         sleepstruct.tv_usec = (sleep_interval % 1000)*1000;
-        select(0, NULL, NULL, NULL, & sleepstruct);
+        select(maxfd + 1, & waitfds, NULL, NULL, & sleepstruct);
         /* update sleep interval for next call */
         if (sleep_interval < MAX_LOGPOLL_INTERVAL) {
             sleep_interval = sleep_interval + 1+(LOGPOLL_INTERVAL_GROWTHFACTOR*sleep_interval);
@@ -322,6 +507,29 @@ int logsuck_getline(char *restrict buf, size_t buflen, bool from_previous_source
     return -1;
 }
 
+int logsuck_list_files(const char *names[], off_t tail_offsets[], int maxnames) {
+    const source_entry_t *source;
+    int num = 0;
+
+    list_iterator_start(& sources_list);
+    while (list_iterator_hasnext(& sources_list) && num < maxnames) {
+        source = (const source_entry_t *)list_iterator_next(& sources_list);
+        /* only regular files of lines can be read from the past */
+        if (source->kind != LOGSUCK_SOURCE_FILE || source->format != LOGSUCK_FORMAT_TEXT || source->tail_offset < 0)
+            continue;
+        names[num] = source->filename;
+        tail_offsets[num] = source->tail_offset;
+        ++num;
+    }
+    list_iterator_stop(& sources_list);
+
+    return num;
+}
+
+void logsuck_set_source_ended(logsuck_source_ended_t callback) {
+    source_ended_callback = callback;
+}
+
 int logsuck_fin() {
     source_entry_t *restrict myentry;
 
@@ -330,46 +538,292 @@ int logsuck_fin() {
     while (list_iterator_hasnext(& sources_list)) {
         myentry = (source_entry_t *restrict)list_iterator_next(& sources_list);
 
-        close(myentry->current_descriptor);
+        if (myentry->kind == LOGSUCK_SOURCE_TCP) {
+            tcpsource_fin();
+            continue;
+        }
+        if (myentry->journal != NULL)
+            journal_reader_free(myentry->journal);
+        if (myentry->lines != NULL) {
+            free(myentry->lines->data);
+            free(myentry->lines);
+        }
+        if (myentry->active)
+            close(myentry->current_descriptor);
     }
     list_iterator_stop(& sources_list);
 
     list_destroy(& sources_list);
+    tcp_source = NULL;
+
+    return 0;
+}
+
+
+static int add_tcpsource(const char *restrict endpoint) {
+    source_entry_t cursource;
+
+    if (tcp_source == NULL) {
+        /* first endpoint: one source entry stands for all TCP senders */
+        if (list_size(& sources_list) >= MAX_FILES_POLLED) {
+            sshguard_log(LOG_CRIT, "I can monitor at most %u files! See MAX_FILES_POLLED.", MAX_FILES_POLLED);
+            return -1;
+        }
+        if (tcpsource_init(source_ended) != 0) {
+            sshguard_log(LOG_ERR, "Unable to receive syslog messages over TCP.");
+            return -1;
+        }
+        cursource.kind = LOGSUCK_SOURCE_TCP;
+        cursource.format = LOGSUCK_FORMAT_TEXT;
+        cursource.journal = NULL;
+        cursource.lines = NULL;
+        cursource.tail_offset = -1;
+        snprintf(cursource.filename, sizeof(cursource.filename), "%s%s", LOGSUCK_TCP_PREFIX, endpoint);
+        /* senders have their own IDs. This is never used */
+        cursource.source_id = fnv_32a_str(cursource.filename, 0);
+        cursource.current_descriptor = tcpsource_descriptor();
+        cursource.current_serial_number = 0;
+        cursource.active = 1;
+        ++num_sources_active;
+        ++num_sources_revivable;
+        list_append(& sources_list, & cursource);
+        tcp_source = (source_entry_t *)list_get_at(& sources_list, list_size(& sources_list) - 1);
+#if defined(HAVE_KQUEUE)
+        set_kevs();
+#endif
+    }
+
+    if (tcpsource_listen(endpoint) != 0) {
+        sshguard_log(LOG_ERR, "Unable to listen for syslog messages on '%s'.", endpoint);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void source_ended(sourceid_t source_id) {
+    if (source_ended_callback != NULL)
+        source_ended_callback(source_id);
+}
+
+static int read_entry(source_entry_t *restrict source, char *restrict buf, size_t buflen, logsuck_entryinfo_t *restrict info) {
+    int ret;
+
+    switch (source->format) {
+        case LOGSUCK_FORMAT_BTMP:
+            /* decode attacks from binary records */
+            ret = read_record(source, info);
+            return (ret == 1 ? LOGSUCK_GOT_ATTACK : -1);
+
+        case LOGSUCK_FORMAT_JOURNAL:
+            ret = read_journal(source, buf, buflen, info);
+            if (ret == 1) return LOGSUCK_GOT_MESSAGE;
+            break;
+
+        default:
+            ret = read_line(source, buf, buflen);
+            if (ret == 1) {
+                info->when = 0;
+                return LOGSUCK_GOT_LINE;
+            }
+    }
+
+    if (ret == 2 && source->kind == LOGSUCK_SOURCE_STDIN) {
+        /* standard input won't come back */
+        sshguard_log(LOG_INFO, "Reached end of standard input.");
+        deactivate_source(source);
+    }
+    return -1;
+}
+
+#if defined(HAVE_KQUEUE)
+static int has_buffered_entry(const source_entry_t *restrict source) {
+    const linebuf_t *lb = source->lines;
+
+    switch (source->format) {
+        case LOGSUCK_FORMAT_JOURNAL:
+            /* can't tell cheaply: give it a try */
+            return 1;
+
+        case LOGSUCK_FORMAT_TEXT:
+            return lb != NULL && lb->len > lb->scanned
+                && memchr(lb->data + lb->start + lb->scanned, '\n', lb->len - lb->scanned) != NULL;
+    }
 
     return 0;
 }
+#endif
 
+/* drop n bytes from the head of a line buffer */
+static inline void linebuf_consume(linebuf_t *restrict lb, size_t n) {
+    assert(n <= lb->len);
+    lb->start += n;
+    lb->len -= n;
+    lb->scanned = 0;
+    if (lb->len == 0) lb->start = 0;
+}
 
-static int read_from(const source_entry_t *restrict source, char *restrict buf, size_t buflen) {
-    int i, ret, bullets;
+/* copy the first len bytes of a line buffer into buf, without line terminators */
+static void linebuf_copy(const linebuf_t *restrict lb, size_t len, char *restrict buf, size_t buflen) {
+    const char *line = lb->data + lb->start;
 
-    /* read until error, newline reached, or buffer exhausted */
-    i = 0;
-    bullets = 10;   /* 10 bullets for the writer to not make us wait */
-    do {
-        ret = read(source->current_descriptor, & buf[i++], 1);
+    if (len > 0 && line[len-1] == '\r') --len;
+    if (len >= buflen) len = buflen - 1;
+    memcpy(buf, line, len);
+    buf[len] = '\0';
+}
+
+static int read_line(source_entry_t *restrict source, char *restrict buf, size_t buflen) {
+    linebuf_t *restrict lb = source->lines;
+    const char *nl;
+    size_t linelen, newsize;
+    ssize_t ret;
+    char *newdata;
+
+    assert(lb != NULL);
+    assert(buflen > 1);
+
+    if (lb->data == NULL) {
+        /* lines can't be longer than the caller's buffer */
+        lb->size = (buflen < LOGSUCK_LINEBUF_INITIAL_SIZE ? buflen : LOGSUCK_LINEBUF_INITIAL_SIZE);
+        lb->data = (char *)malloc(lb->size);
+        if (lb->data == NULL) {
+            sshguard_log(LOG_ERR, "Unable to allocate buffer for '%s'.", source->filename);
+            return -1;
+        }
+        lb->start = lb->len = lb->scanned = 0;
+        lb->truncating = 0;
+    }
+
+    while (1) {
+        /* return a line if one is buffered already */
+        while (lb->len > lb->scanned) {
+            nl = memchr(lb->data + lb->start + lb->scanned, '\n', lb->len - lb->scanned);
+            if (nl == NULL) {
+                lb->scanned = lb->len;
+                break;
+            }
+            linelen = nl - (lb->data + lb->start);
+            if (lb->truncating) {
+                /* tail of a truncated line */
+                lb->truncating = 0;
+                linebuf_consume(lb, linelen + 1);
+                continue;
+            }
+            linebuf_copy(lb, linelen, buf, buflen);
+            linebuf_consume(lb, linelen + 1);
+            /* ignore blank lines */
+            if (buf[0] == '\0') continue;
+            sshguard_log(LOG_DEBUG, "Read line from '%s'.", source->filename);
+            return 1;
+        }
+
+        /* make room for more data */
+        if (lb->start > 0) {
+            memmove(lb->data, lb->data + lb->start, lb->len);
+            lb->start = 0;
+        }
+        if (lb->len == lb->size) {
+            if (lb->size < buflen) {
+                /* grow up to the longest line allowed */
+                newsize = (2 * lb->size < buflen ? 2 * lb->size : buflen);
+                newdata = (char *)realloc(lb->data, newsize);
+                if (newdata == NULL) {
+                    sshguard_log(LOG_ERR, "Unable to grow buffer for '%s' to %lu bytes.", source->filename, (unsigned long)newsize);
+                    return -1;
+                }
+                lb->data = newdata;
+                lb->size = newsize;
+            } else if (lb->truncating) {
+                /* still in the tail of a truncated line */
+                linebuf_consume(lb, lb->len);
+            } else {
+                /* line longer than allowed: attacks are told early in lines, keep the head */
+                sshguard_log(LOG_INFO, "Truncating line longer than %lu bytes from '%s'.", (unsigned long)buflen - 1, source->filename);
+                linebuf_copy(lb, lb->len, buf, buflen);
+                linebuf_consume(lb, lb->len);
+                lb->truncating = 1;
+                return 1;
+            }
+        }
+
+        /* read a block */
+        ret = read(source->current_descriptor, lb->data + lb->len, lb->size - lb->len);
+        if (ret > 0) {
+            lb->len += ret;
+            continue;
+        }
         if (ret == 0) {
-            /* if we're reading ahead of the writer, sit down wait some times */
-            usleep(20 * 1000);
-            --bullets;
-        }
-    } while (ret >= 0 && buf[i-1] != '\n' && i < buflen-2 && bullets > 0);
-    buf[i] = '\0';
-    if (bullets == 0) {
-        /* what's up with the writer? read() patiented forever! Discard this entry. */
-        sshguard_log(LOG_INFO, "Discarding partial log entry '%s': source %u cannot starve the others.", buf, source->source_id);
-        buf[0] = '\0';
+            if (source->kind == LOGSUCK_SOURCE_STDIN && lb->len > 0 && ! lb->truncating) {
+                /* last line of the stream, without newline */
+                linebuf_copy(lb, lb->len, buf, buflen);
+                linebuf_consume(lb, lb->len);
+                return 1;
+            }
+            return 2;
+        }
+#ifdef EINTR
+        if (errno == EINTR) continue;
+#endif
+        if (errno == EAGAIN) return 0;
+        sshguard_log(LOG_NOTICE, "Error while reading from file '%s': %s.", source->filename, strerror(errno));
+        deactivate_source(source);
         return -1;
     }
-    /* check result */
-    if (i >= buflen) {
-        sshguard_log(LOG_ERR, "Increase buffer, %lu was insufficient for '%s'.", (long unsigned int)buflen, buf);
+}
+
+static int read_journal(source_entry_t *restrict source, char *restrict buf, size_t buflen, logsuck_entryinfo_t *restrict info) {
+    journal_entry_t entry;
+    int ret;
+
+    ret = journal_read(source->journal, source->current_descriptor, & entry);
+    if (ret == 1 || ret == 2) return (ret == 1 ? 0 : 2);
+    if (ret < 0) {
+        sshguard_log(LOG_NOTICE, "Error while reading from journal '%s': %s.", source->filename, strerror(errno));
+        deactivate_source(source);
         return -1;
     }
 
-    return 0;
+    sshguard_log(LOG_DEBUG, "Got message from '%s'[%d] in journal '%s'.", entry.program, (int)entry.pid, source->filename);
+    strncpy(buf, entry.message, buflen);
+    buf[buflen-1] = '\0';
+    snprintf(info->program, sizeof(info->program), "%s", entry.program);
+    info->pid = entry.pid;
+    info->when = entry.when;
+
+    return 1;
 }
 
+static int read_record(source_entry_t *restrict source, logsuck_entryinfo_t *restrict info) {
+    char record[BTMP_MAX_RECORD_LEN];
+    size_t reclen = btmp_record_size();
+    ssize_t ret;
+
+    while (1) {
+        ret = read(source->current_descriptor, record, reclen);
+        if (ret == (ssize_t)reclen) {
+            if (btmp_decode(record, & info->attack, & info->when) == 0) {
+                sshguard_log(LOG_DEBUG, "Decoded attack from '%s'.", source->filename);
+                return 1;
+            }
+            /* not of interest, try next */
+            continue;
+        }
+        if (ret > 0) {
+            /* caught the writer in the middle of a record. Get it whole next time */
+            lseek(source->current_descriptor, -ret, SEEK_CUR);
+            return 0;
+        }
+        if (ret == 0) return 0;
+#ifdef EINTR
+        if (errno == EINTR) continue;
+#endif
+        if (errno == EAGAIN) return 0;
+        sshguard_log(LOG_NOTICE, "Error while reading from file '%s': %s.", source->filename, strerror(errno));
+        deactivate_source(source);
+        return -1;
+    }
+}
 
 #if defined(HAVE_KQUEUE)
 /* refresh only inactive files. When active ones change, kqueue() will notify for complete call */
@@ -423,8 +877,8 @@ static int refresh_files() {
     while (list_iterator_hasnext(& sources_list)) {
         myentry = (source_entry_t *)list_iterator_next(& sources_list);
 
-        /* skip stdin */
-        if (myentry->current_descriptor == STDIN_FILENO) continue;
+        /* skip stdin and TCP senders */
+        if (! LOGSUCK_IS_FILE(myentry)) continue;
 
         /* check the current serial number of the filename */
         if (stat(myentry->filename, & fileinfo) != 0) {
@@ -453,7 +907,7 @@ static int refresh_files() {
 
         /* descriptor and source ready! */
 #if defined(HAVE_KQUEUE)
-        if (myentry->current_descriptor != STDIN_FILENO) {
+        if (LOGSUCK_IS_FILE(myentry)) {
             /* this is a file. Monitor deletion/renaming as well */
 			EV_SET(& kevs[kevs_num], myentry->current_descriptor, EVFILT_VNODE,
 			    EV_ADD | EV_ENABLE | EV_CLEAR,
@@ -497,6 +951,13 @@ static int activate_source(source_entry_t *restrict srcent, const struct stat *f
     }
     srcent->current_serial_number = fileinfo->st_ino;
     srcent->active = 1;
+    /* a new file: forget partial data of the old one */
+    if (srcent->journal != NULL)
+        journal_reader_reset(srcent->journal);
+    if (srcent->lines != NULL) {
+        srcent->lines->start = srcent->lines->len = srcent->lines->scanned = 0;
+        srcent->lines->truncating = 0;
+    }
 
     ++num_sources_active;
 
@@ -528,7 +989,7 @@ static void set_kevs() {
         source = (const source_entry_t *)list_iterator_next(& sources_list);
         if (! source->active) continue;
 
-        if (source->current_descriptor != STDIN_FILENO) {
+        if (LOGSUCK_IS_FILE(source)) {
             /* this is a file. Monitor deletion/renaming as well */
 			EV_SET(& kevs[kevs_num], source->current_descriptor, EVFILT_VNODE,
 			    EV_ADD | EV_ENABLE | EV_CLEAR,
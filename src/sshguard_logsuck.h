@@ -23,10 +23,33 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "sshguard_attack.h"
 
 
 typedef uint32_t sourceid_t;
 
+/* told about a source that ended for good */
+typedef void (*logsuck_source_ended_t)(sourceid_t source_id);
+
+/* what logsuck_getline() got */
+#define LOGSUCK_GOT_LINE        0       /* a log line, in buf */
+#define LOGSUCK_GOT_ATTACK      1       /* an attack, decoded from a binary source */
+#define LOGSUCK_GOT_MESSAGE     2       /* a bare message (no banner) from a structured source, in buf */
+
+/* longest program name told about a message */
+#define LOGSUCK_MAX_PROGRAM_LEN 64
+
+/* what else sources tell about entries, besides lines */
+typedef struct {
+    attack_t attack;                    /* LOGSUCK_GOT_ATTACK: the attack */
+    char program[LOGSUCK_MAX_PROGRAM_LEN];  /* LOGSUCK_GOT_MESSAGE: the logging program, or "" if unknown */
+    pid_t pid;                          /* LOGSUCK_GOT_MESSAGE: the logging process, or 0 if unknown */
+    time_t when;                        /* when the entry was logged, or 0 if unknown */
+} logsuck_entryinfo_t;
+
 /**
  * Initialize the logsuck subsystem.
  *
@@ -37,6 +60,12 @@ int logsuck_init();
 /**
  * Add a log file to be polled.
  *
+ * A filename prefixed by "btmp:" is a file of failed logins in binary
+ * format, whose records are decoded into attacks directly. A filename
+ * prefixed by "journal:" is a stream in journal export format ("-" for
+ * standard input). A filename prefixed by "tcp:" is an endpoint to accept
+ * syslog senders from.
+ *
  * @return 0 on success, -1 on error
  */
 int logsuck_add_logsource(const char *restrict filename);
@@ -44,11 +73,32 @@ int logsuck_add_logsource(const char *restrict filename);
 /**
  * Get the first whole log line coming from any log file configured.
  *
+ * Binary sources deliver attacks instead of lines, and structured sources
+ * deliver bare messages: info tells the rest about them.
+ *
  * @param from_previous_source  read from the same source of previous message
  *
- * @return 0 on success, -1 on error
+ * @return LOGSUCK_GOT_* on success, -1 on error
+ */
+int logsuck_getline(char *restrict buf, size_t buflen, bool from_previous_source, sourceid_t *restrict whichsource, logsuck_entryinfo_t *restrict info);
+
+/**
+ * Set the function to tell when a source ends for good, as a network sender
+ * disconnecting, so whoever keeps state about sources can drop it.
+ *
+ * @param callback  function to call, or NULL for none
+ */
+void logsuck_set_source_ended(logsuck_source_ended_t callback);
+
+/**
+ * Get the text files being polled, with the offset where tailing began
+ * for each, for reading what they logged before.
+ *
+ * Names remain valid until logsuck_fin().
+ *
+ * @return number of files stored in names and tail_offsets, at most maxnames
  */
-int logsuck_getline(char *restrict buf, size_t buflen, bool from_previous_source, sourceid_t *restrict whichsource);
+int logsuck_list_files(const char *names[], off_t tail_offsets[], int maxnames);
 
 /**
  * Finalize the logsuck subsystem.
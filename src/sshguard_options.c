@@ -48,11 +48,15 @@ int get_options_cmdline(int argc, char *argv[]) {
     opts.blacklist_filename = NULL;
     opts.my_pidfile = NULL;
     opts.blacklist_threshold = DEFAULT_BLACKLIST_THRESHOLD;
+    opts.blacklist_horizon = 0;
     opts.pardon_threshold = DEFAULT_PARDON_THRESHOLD;
     opts.stale_threshold = DEFAULT_STALE_THRESHOLD;
     opts.abuse_threshold = DEFAULT_ABUSE_THRESHOLD;
     opts.has_polled_files = 0;
-    while ((optch = getopt(argc, argv, "b:p:s:a:w:f:l:i:vdh")) != -1) {
+    opts.max_logline_len = DEFAULT_MAX_LOGLINE_LEN;
+    opts.backfill_period = 0;
+    opts.signatures_filename = NULL;
+    while ((optch = getopt(argc, argv, "b:x:p:s:a:w:W:f:l:i:m:r:e:vdh")) != -1) {
         switch (optch) {
             case 'b':   /* threshold for blacklisting (num abuses >= this implies permanent block */
                 opts.blacklist_filename = (char *)malloc(strlen(optarg)+1);
@@ -69,6 +73,15 @@ int get_options_cmdline(int argc, char *argv[]) {
                 }
                 break;
 
+            case 'x':   /* expiry of blacklisted addresses */
+                opts.blacklist_horizon = strtol(optarg, (char **)NULL, 10);
+                if (opts.blacklist_horizon < 1) {
+                    fprintf(stderr, "Doesn't make sense to expire blacklisted addresses after less than 1 second. Terminating.\n");
+					usage();
+					return -1;
+                }
+                break;
+
             case 'd':   /* (historical) debugging */
                 fprintf(stderr, "Debugging mode now uses environment variable. Run:\n\tenv SSHGUARD_DEBUG=\"\" %s ...\n", argv[0]);
                 return -1;
@@ -106,7 +119,7 @@ int get_options_cmdline(int argc, char *argv[]) {
             case 'w':   /* whitelist entries */
                 if (optarg[0] == '/' || optarg[0] == '.') {
                     /* add from file */
-                    if (whitelist_file(optarg) != 0) {
+                    if (whitelist_file(optarg, 0) != 0) {
                         fprintf(stderr, "Could not handle whitelisting for %s.\n", optarg);
 						usage();
 						return -1;
@@ -121,6 +134,14 @@ int get_options_cmdline(int argc, char *argv[]) {
                 }
                 break;
 
+            case 'W':   /* whitelist file, kept compiled in a cache file */
+                if (whitelist_file(optarg, 1) != 0) {
+                    fprintf(stderr, "Could not handle whitelisting for %s.\n", optarg);
+					usage();
+					return -1;
+                }
+                break;
+
             case 'f':   /* process pid authorization */
                 if (procauth_addprocess(optarg) != 0) {
                     fprintf(stderr, "Could not parse service pid configuration '%s'.\n", optarg);
@@ -140,6 +161,44 @@ int get_options_cmdline(int argc, char *argv[]) {
                 opts.has_polled_files = 1;
                 break;
 
+            case 'm':   /* longest log line handled */
+                {
+                    long linelen;
+                    char *endptr;
+
+                    linelen = strtol(optarg, & endptr, 10);
+                    if (endptr == optarg || *endptr != '\0') {
+                        fprintf(stderr, "Line length '%s' is not a number. Terminating.\n", optarg);
+                        usage();
+                        return -1;
+                    }
+                    if (linelen < MIN_LOGLINE_LEN) {
+                        fprintf(stderr, "Doesn't make sense to have log lines shorter than %d bytes. Terminating.\n", MIN_LOGLINE_LEN);
+                        usage();
+                        return -1;
+                    }
+                    if (linelen > MAX_LOGLINE_LEN) {
+                        fprintf(stderr, "Log lines longer than %d bytes are not handled. Terminating.\n", MAX_LOGLINE_LEN);
+                        usage();
+                        return -1;
+                    }
+                    opts.max_logline_len = (unsigned int)linelen;
+                }
+                break;
+
+            case 'r':   /* look back in logs at startup */
+                opts.backfill_period = strtol(optarg, (char **)NULL, 10);
+                if (opts.backfill_period < 0) {
+                    fprintf(stderr, "Doesn't make sense to look back a negative number of seconds. Terminating.\n");
+					usage();
+					return -1;
+                }
+                break;
+
+            case 'e':   /* file of attack signatures */
+                opts.signatures_filename = optarg;
+                break;
+
             case 'i':   /* specify pidfile for my PID */
                 opts.my_pidfile = optarg;
                 break;
@@ -155,18 +214,31 @@ int get_options_cmdline(int argc, char *argv[]) {
         }
     }
 
+    if (! opts.has_polled_files) {
+        /* no source given: poll standard input, as any other source */
+        if (logsuck_init() != 0 || logsuck_add_logsource("-") != 0) {
+            fprintf(stderr, "Unable to poll from standard input!\n");
+            return -1;
+        }
+    }
+
     return 0;
 }
 
 static void usage(void) {
-    fprintf(stderr, "Usage:\nsshguard [-b <thr:file>] [-w <whlst>]{0,n} [-a num] [-p sec] [-s sec]\n\t[-l <source>] [-f <srv:pidfile>]{0,n} [-i <pidfile>] [-v]\n");
+    fprintf(stderr, "Usage:\nsshguard [-b <thr:file>] [-x sec] [-w <whlst>]{0,n} [-a num] [-p sec] [-s sec]\n\t[-l <source>] [-m bytes] [-r sec] [-e <file>] [-f <srv:pidfile>]{0,n} [-i <pidfile>] [-v]\n");
     /* fprintf(stderr, "\t-d\tDebugging mode: don't fork to background, and dump activity to stderr.\n"); */
     fprintf(stderr, "\t-b\tBlacklist: thr = number of abuses before blacklisting, file = blacklist filename.\n");
+    fprintf(stderr, "\t-x\tSeconds after which releasing a blacklisted address that offended no more (off)\n");
     fprintf(stderr, "\t-a\tNumber of hits after which blocking an address (%d)\n", DEFAULT_ABUSE_THRESHOLD);
     fprintf(stderr, "\t-p\tSeconds after which unblocking a blocked address (%d)\n", DEFAULT_PARDON_THRESHOLD);
     fprintf(stderr, "\t-w\tWhitelisting of addr/host/block, or take from file if starts with \"/\" or \".\" (repeatable)\n");
+    fprintf(stderr, "\t-W\tTake whitelist from file, and keep it compiled in file.cache for faster starts (repeatable)\n");
     fprintf(stderr, "\t-s\tSeconds after which forgetting about a cracker candidate (%d)\n", DEFAULT_STALE_THRESHOLD);
     fprintf(stderr, "\t-l\tAdd the given log source to Log Sucker's monitored sources (off)\n");
+    fprintf(stderr, "\t-m\tLength of the longest log line handled, longer ones are truncated (%d)\n", DEFAULT_MAX_LOGLINE_LEN);
+    fprintf(stderr, "\t-r\tAt startup, look for attacks logged by the -l files in the past seconds (off)\n");
+    fprintf(stderr, "\t-e\tRecognize also the attacks described in the given signatures file (off)\n");
     fprintf(stderr, "\t-f\t\"authenticate\" service's logs through its process pid, as in pidfile\n");
     fprintf(stderr, "\t-i\tWhen started, save PID in the given file; useful for startup scripts (off)\n");
     fprintf(stderr, "\t-v\tDump version message to stderr, supply this when reporting bugs\n");
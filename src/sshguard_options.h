@@ -29,7 +29,11 @@ typedef struct {
     unsigned int blacklist_threshold;   /* number of abuses after which blacklisting the attacker */
     char *my_pidfile;                   /* NULL if disabled, or string with filename where user wants my PID tracked */
     char *blacklist_filename;           /* NULL to disable blacklist, or path of the blacklist file */
-    int has_polled_files;               /* true if we are polling log any file, false if reading from stdin */
+    time_t blacklist_horizon;           /* blacklisted addresses not offending for this long are released (0 to disable) */
+    int has_polled_files;               /* true if log sources were given, false if reading from stdin only */
+    unsigned int max_logline_len;       /* length of the longest log line handled, longer ones are truncated */
+    time_t backfill_period;             /* at startup, look for attacks logged in this many past seconds (0 to disable) */
+    char *signatures_filename;          /* NULL if disabled, or path of the file with the user's attack signatures */
 } sshg_opts;
 
 
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sshguard_log.h"
+#include "sshguard_services.h"
+
+#include "sshguard_prefilter.h"
+
+
+/*
+ * Fixed text found in every line matching an attack signature of the
+ * scanner (parser/attack_scanner.l), with the service whose signatures
+ * use it. Each signature needs at least one of these: keep them in sync
+ * when adding signatures.
+ */
+static const struct {
+    int service;                    /* SERVICES_ALL if any program logs it */
+    const char *text;
+} keywords[] = {
+    /* syslog's repetition of the previous message, which may be an attack */
+    { SERVICES_ALL,         "last message repeated " },
+    { SERVICES_SSH,         "Invalid user " },
+    { SERVICES_SSH,         "User " },
+    { SERVICES_SSH,         "Failed " },
+    { SERVICES_SSH,         "error: PAM: " },
+    { SERVICES_SSH,         "POSSIBLE BREAK-IN ATTEMPT!" },
+    { SERVICES_SSH,         "Did not receive identification string from " },
+    { SERVICES_SSH,         "Bad protocol version identification" },
+    { SERVICES_DOVECOT,     "imap-login: Aborted login (auth failed, " },
+    { SERVICES_UWIMAP,      "Login failed user=" },
+    { SERVICES_CYRUSIMAP,   "badlogin: " },
+    { SERVICES_CUCIPOP,     "authentication failure " },
+    { SERVICES_EXIM,        " auth_plaintext authenticator failed for " },
+    { SERVICES_SENDMAIL,    "Relaying denied. IP name lookup failed [" },
+    { SERVICES_FREEBSDFTPD, "FTP LOGIN FAILED FROM " },
+    { SERVICES_PROFTPD,     " no such user " },
+    { SERVICES_PROFTPD,     "(Login failed): " },
+    { SERVICES_PUREFTPD,    ") [WARNING] Authentication failed for user " },
+    { SERVICES_VSFTPD,      "FAIL LOGIN: Client \"" },
+    { 0, NULL }
+};
+
+/*
+ * Program names (as in log banners) of known services. Lines from these
+ * programs are only looked for the keywords of their services; lines from
+ * any other program, or from unknown ones, for all keywords. Names that
+ * several implementations use (as "imapd", for UW and Cyrus) list the
+ * services of all of them.
+ */
+static const struct {
+    const char *name;
+    int services[PREFILTER_MAX_PROGRAM_SERVICES];  /* ends early with 0 if fewer */
+} programs[] = {
+    { "sshd",       { SERVICES_SSH } },
+    { "dovecot",    { SERVICES_DOVECOT } },
+    { "imapd",      { SERVICES_UWIMAP, SERVICES_CYRUSIMAP } },
+    { "ipop3d",     { SERVICES_UWIMAP } },
+    { "cucipop",    { SERVICES_CUCIPOP } },
+    { "exim",       { SERVICES_EXIM } },
+    { "exim4",      { SERVICES_EXIM } },
+    { "sendmail",   { SERVICES_SENDMAIL } },
+    { "sm-mta",     { SERVICES_SENDMAIL } },
+    { "ftpd",       { SERVICES_FREEBSDFTPD, SERVICES_PROFTPD, SERVICES_PUREFTPD, SERVICES_VSFTPD } },
+    { "proftpd",    { SERVICES_PROFTPD } },
+    { "pure-ftpd",  { SERVICES_PUREFTPD } },
+    { "vsftpd",     { SERVICES_VSFTPD } },
+    { NULL, { 0 } }
+};
+
+/* an automaton state */
+typedef uint16_t pf_state_t;
+
+/* an automaton (Aho-Corasick, with failure links resolved into a full
+ * transition table). Bytes not in any of its keywords share class 0 */
+typedef struct {
+    uint8_t byte_class[256];        /* class of each byte */
+    unsigned int num_classes;
+    unsigned int num_states;
+    pf_state_t *next;               /* num_states x num_classes transitions */
+    uint8_t *accepting;             /* does reaching a state complete a keyword? */
+} pf_automaton_t;
+
+/* the automaton for all keywords, then one per set of services in programs[] */
+#define PF_MAX_AUTOMATA     16
+static pf_automaton_t automata[PF_MAX_AUTOMATA];
+static unsigned int num_automata;
+
+/* automaton for lines of each entry in programs[] */
+static unsigned int program_automaton[sizeof(programs)/sizeof(programs[0])];
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+static int init_result = -1;
+
+static void build_automata(void);
+static int build_automaton(pf_automaton_t *restrict automaton, const int *restrict services);
+static int service_wanted(int service, const int *restrict services);
+static int find_program(const char *restrict program, size_t programlen);
+
+
+int prefilter_init(void) {
+    pthread_once(& init_once, build_automata);
+    return init_result;
+}
+
+int prefilter_candidate(const char *restrict line, const char *restrict program, size_t programlen) {
+    const pf_automaton_t *automaton = & automata[0];
+    const unsigned char *p;
+    pf_state_t state = 0;
+    int i;
+
+    /* no automaton, no filtering */
+    if (init_result != 0) return 1;
+
+    /* known programs only log attacks on their own service */
+    if (program != NULL && (i = find_program(program, programlen)) >= 0)
+        automaton = & automata[program_automaton[i]];
+
+    for (p = (const unsigned char *)line; *p != '\0'; ++p) {
+        state = automaton->next[state * automaton->num_classes + automaton->byte_class[*p]];
+        if (automaton->accepting[state]) return 1;
+    }
+
+    return 0;
+}
+
+const int *prefilter_program_services(const char *restrict program, size_t programlen) {
+    int i;
+
+    i = find_program(program, programlen);
+    return (i >= 0 ? programs[i].services : NULL);
+}
+
+
+static void build_automata(void) {
+    unsigned int i, j;
+
+    if (build_automaton(& automata[0], NULL) != 0) {
+        sshguard_log(LOG_ERR, "Unable to allocate the line prefilter, all lines will be parsed.");
+        return;
+    }
+    num_automata = 1;
+
+    for (i = 0; programs[i].name != NULL; ++i) {
+        /* programs of the same services share their automaton */
+        for (j = 0; j < i && memcmp(programs[j].services, programs[i].services, sizeof(programs[i].services)) != 0; ++j);
+        if (j < i) {
+            program_automaton[i] = program_automaton[j];
+            continue;
+        }
+
+        /* failing this, the program just gets the automaton for all keywords */
+        program_automaton[i] = 0;
+        if (num_automata < PF_MAX_AUTOMATA && build_automaton(& automata[num_automata], programs[i].services) == 0)
+            program_automaton[i] = num_automata++;
+    }
+
+    init_result = 0;
+    sshguard_log(LOG_DEBUG, "Line prefilter ready: %u keywords, %u states, %u per-service automata.", (unsigned int)(sizeof(keywords)/sizeof(keywords[0]) - 1), automata[0].num_states, num_automata - 1);
+}
+
+/* build the automaton for the keywords of services, or of all services if NULL */
+static int build_automaton(pf_automaton_t *restrict automaton, const int *restrict services) {
+    size_t max_states;
+    pf_state_t *fail, *queue;
+    unsigned int i, c, head, tail;
+    const char *kw;
+    pf_state_t state, s;
+
+#define KEYWORD_WANTED(i)   (services == NULL || keywords[i].service == SERVICES_ALL || service_wanted(keywords[i].service, services))
+
+    /* equivalence classes of bytes */
+    memset(automaton->byte_class, 0x00, sizeof(automaton->byte_class));
+    automaton->num_classes = 1;
+    max_states = 1;
+    for (i = 0; keywords[i].text != NULL; ++i) {
+        if (! KEYWORD_WANTED(i)) continue;
+        for (kw = keywords[i].text; *kw != '\0'; ++kw) {
+            if (automaton->byte_class[(unsigned char)*kw] == 0)
+                automaton->byte_class[(unsigned char)*kw] = automaton->num_classes++;
+        }
+        max_states += strlen(keywords[i].text);
+    }
+
+    automaton->next = (pf_state_t *)calloc(max_states * automaton->num_classes, sizeof(pf_state_t));
+    automaton->accepting = (uint8_t *)calloc(max_states, sizeof(uint8_t));
+    fail = (pf_state_t *)calloc(max_states, sizeof(pf_state_t));
+    queue = (pf_state_t *)malloc(max_states * sizeof(pf_state_t));
+    if (automaton->next == NULL || automaton->accepting == NULL || fail == NULL || queue == NULL) {
+        free(automaton->next);
+        free(automaton->accepting);
+        free(fail);
+        free(queue);
+        return -1;
+    }
+
+    /* trie of keywords. 0 is the root; no transition goes back to it yet */
+    automaton->num_states = 1;
+    for (i = 0; keywords[i].text != NULL; ++i) {
+        if (! KEYWORD_WANTED(i)) continue;
+        state = 0;
+        for (kw = keywords[i].text; *kw != '\0'; ++kw) {
+            c = automaton->byte_class[(unsigned char)*kw];
+            if (automaton->next[state * automaton->num_classes + c] == 0)
+                automaton->next[state * automaton->num_classes + c] = automaton->num_states++;
+            state = automaton->next[state * automaton->num_classes + c];
+        }
+        automaton->accepting[state] = 1;
+    }
+
+#undef KEYWORD_WANTED
+
+    /* resolve failure links breadth-first into the transition table */
+    head = tail = 0;
+    for (c = 0; c < automaton->num_classes; ++c) {
+        s = automaton->next[c];
+        if (s != 0) {
+            fail[s] = 0;
+            queue[tail++] = s;
+        }
+    }
+    while (head < tail) {
+        state = queue[head++];
+        /* a keyword ending inside another one counts as well */
+        if (automaton->accepting[fail[state]]) automaton->accepting[state] = 1;
+        for (c = 0; c < automaton->num_classes; ++c) {
+            s = automaton->next[state * automaton->num_classes + c];
+            if (s != 0) {
+                fail[s] = automaton->next[fail[state] * automaton->num_classes + c];
+                queue[tail++] = s;
+            } else {
+                automaton->next[state * automaton->num_classes + c] = automaton->next[fail[state] * automaton->num_classes + c];
+            }
+        }
+    }
+
+    free(fail);
+    free(queue);
+    return 0;
+}
+
+/* is service among services (PREFILTER_MAX_PROGRAM_SERVICES at most, ending early with 0)? */
+static int service_wanted(int service, const int *restrict services) {
+    unsigned int i;
+
+    for (i = 0; i < PREFILTER_MAX_PROGRAM_SERVICES && services[i] != 0; ++i) {
+        if (services[i] == service) return 1;
+    }
+    return 0;
+}
+
+/* position of program in programs[], or -1 if not there */
+static int find_program(const char *restrict program, size_t programlen) {
+    int i;
+
+    for (i = 0; programs[i].name != NULL; ++i) {
+        if (strncmp(programs[i].name, program, programlen) == 0 && programs[i].name[programlen] == '\0')
+            return i;
+    }
+    return -1;
+}
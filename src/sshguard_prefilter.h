@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#ifndef SSHGUARD_PREFILTER_H
+#define SSHGUARD_PREFILTER_H
+
+#include <stddef.h>
+
+/* services a program name is known to run, at most */
+#define PREFILTER_MAX_PROGRAM_SERVICES  4
+
+/**
+ * Set up the prefilter. Safe to call any number of times, from any thread.
+ *
+ * @return 0 on success, -1 on error
+ */
+int prefilter_init(void);
+
+/**
+ * Tell if a log line may describe an attack, before paying for the scanner
+ * and parser on it.
+ *
+ * Every attack signature contains some fixed text (as "Invalid user " or
+ * "FAIL LOGIN: "): lines containing none of them can't be attacks. Lines
+ * that do may still not be. All fixed texts are looked for in a single pass.
+ *
+ * If the program that logged the line is known to run some services, only
+ * the fixed texts of those services are looked for.
+ *
+ * @param program       name of the program that logged line (not
+ *                      NUL-terminated), or NULL if not known
+ * @param programlen    length of program
+ *
+ * @return 1 if the line is a candidate attack, 0 if it is surely not
+ */
+int prefilter_candidate(const char *restrict line, const char *restrict program, size_t programlen);
+
+/**
+ * Get the services a program is known to run, from the same table of
+ * program names the prefilter uses.
+ *
+ * @param program       name of the program (not NUL-terminated)
+ * @param programlen    length of program
+ *
+ * @return PREFILTER_MAX_PROGRAM_SERVICES services at most, ending early with
+ *         0 if fewer; or NULL if the program is not known
+ */
+const int *prefilter_program_services(const char *restrict program, size_t programlen);
+
+#endif
@@ -25,26 +25,64 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include <simclist.h>
 
 #include "sshguard_log.h"
 #include "sshguard_procauth.h"
 
+/* generations of descendants of a service process that are authoritative
+ * too: its children and grandchildren (as sshd's per-connection and
+ * privilege-separated processes). Not more, as users' shells descend from
+ * sshd as well */
+#define PROCAUTH_MAX_GENERATIONS    2
+
+/* parents of processes remembered, and for how long (seconds) */
+#define PROCAUTH_PPID_CACHE_SIZE    64
+#define PROCAUTH_PPID_CACHE_TTL     5
+
 typedef struct {
     int service_code;
     char *filename;
     pid_t current_pid;
+    /* pidfile as last read, not to read it again until it changes */
+    int pidfile_known;
+    dev_t pidfile_dev;
+    ino_t pidfile_ino;
+    time_t pidfile_mtime;
+    off_t pidfile_size;
+    pid_t pidfile_pid;
 } procpid;
 
+/* a process, and its parent as last seen */
+typedef struct {
+    pid_t pid;
+    pid_t ppid;
+    time_t when;
+} ppid_entry;
+
 size_t procpid_meter(const void *el) {
     return sizeof(procpid);
 }
 
 /* list of services whose serving process ID has to assured authentic */
 list_t proclist;
+/* parsers in several threads may check pids at once */
+static pthread_mutex_t proclist_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* whether parents can be read from /proc/<pid>/stat, or are asked to ps */
+static int have_procfs;
+/* parents of processes lately checked, with proclist_mutex */
+static ppid_entry ppid_cache[PROCAUTH_PPID_CACHE_SIZE];
 
-static pid_t procauth_getprocpid(char *filename);
+static int procauth_check(int service_code, pid_t pid);
+static pid_t procauth_getprocpid(procpid *pp);
 static int procauth_ischildof(pid_t child, pid_t parent);
+static pid_t procauth_getppid(pid_t pid);
+static pid_t procfs_getppid(pid_t pid);
+static pid_t ps_getppid(pid_t pid);
 
 
 
@@ -52,6 +90,8 @@ int procauth_init() {
     /* assume random number generator already seeded */
     list_init(&proclist);
     list_attributes_copy(&proclist, procpid_meter, 1);
+    memset(ppid_cache, 0x00, sizeof(ppid_cache));
+    have_procfs = (access("/proc/self/stat", R_OK) == 0);
 
     return 0;
 }
@@ -85,11 +125,12 @@ int procauth_addprocess(char *conf) {
     if (sscanf(conf, "%d:%s", &srvcode, pidfilename) != 2)
         return -1;
 
+    memset(& pp, 0x00, sizeof(pp));
     pp.service_code = srvcode;
     pp.filename = (char *)malloc(strlen(pidfilename) + 1);
     strcpy(pp.filename, pidfilename);
     /* get current pid */
-    pp.current_pid = procauth_getprocpid(pidfilename);
+    pp.current_pid = procauth_getprocpid(& pp);
 
     /* append process block to the list */
     list_append(&proclist, &pp);
@@ -107,7 +148,7 @@ int procauth_refreshpids() {
     list_iterator_start(&proclist);
     while (list_iterator_hasnext(&proclist)) {
         pp = (procpid *)list_iterator_next(&proclist);
-        newpid  = procauth_getprocpid(pp->filename);
+        newpid  = procauth_getprocpid(pp);
         if (newpid != pp->current_pid) changed++;
         pp->current_pid = newpid;
     }
@@ -118,6 +159,16 @@ int procauth_refreshpids() {
 }
 
 int procauth_isauthoritative(int service_code, pid_t pid) {
+    int ret;
+
+    pthread_mutex_lock(& proclist_mutex);
+    ret = procauth_check(service_code, pid);
+    pthread_mutex_unlock(& proclist_mutex);
+
+    return ret;
+}
+
+static int procauth_check(int service_code, pid_t pid) {
     procpid *pp;
 
     list_iterator_start(&proclist);
@@ -129,7 +180,7 @@ int procauth_isauthoritative(int service_code, pid_t pid) {
             if (pp->current_pid == pid) /* authoritative */
                 return 1;
             else {
-                pp->current_pid = procauth_getprocpid(pp->filename);
+                pp->current_pid = procauth_getprocpid(pp);
                 if (pp->current_pid == -1) {        /* error accessing pidfile */
                     return 0;
                 } else {
@@ -149,84 +200,165 @@ int procauth_isauthoritative(int service_code, pid_t pid) {
     return 0;
 }
 
-static pid_t procauth_getprocpid(char *filename) {
+static pid_t procauth_getprocpid(procpid *pp) {
     FILE *pf;
     pid_t pid;
+    struct stat st;
 
-    pf = fopen(filename, "r");
+    if (stat(pp->filename, & st) != 0) {
+        sshguard_log(LOG_NOTICE, "unable to open pidfile '%s': %s.", pp->filename, strerror(errno));
+        pp->pidfile_known = 0;
+        return -1;
+    }
+
+    /* same file as last read? */
+    if (pp->pidfile_known && st.st_dev == pp->pidfile_dev && st.st_ino == pp->pidfile_ino
+            && st.st_mtime == pp->pidfile_mtime && st.st_size == pp->pidfile_size) {
+        return pp->pidfile_pid;
+    }
+
+    pf = fopen(pp->filename, "r");
     if (pf == NULL) {
-        sshguard_log(LOG_NOTICE, "unable to open pidfile '%s': %s.", filename, strerror(errno));
+        sshguard_log(LOG_NOTICE, "unable to open pidfile '%s': %s.", pp->filename, strerror(errno));
+        pp->pidfile_known = 0;
         return -1;
     }
 
     if (fscanf(pf, "%d", &pid) != 1) {
-        sshguard_log(LOG_INFO, "pid file '%s' malformed. Expecting one pid.", filename);
+        sshguard_log(LOG_INFO, "pid file '%s' malformed. Expecting one pid.", pp->filename);
+        fclose(pf);
+        pp->pidfile_known = 0;
         return -1;
     }
     fclose(pf);
 
+    pp->pidfile_known = 1;
+    pp->pidfile_dev = st.st_dev;
+    pp->pidfile_ino = st.st_ino;
+    pp->pidfile_mtime = st.st_mtime;
+    pp->pidfile_size = st.st_size;
+    pp->pidfile_pid = pid;
+
     return pid;
 }
 
 static int procauth_ischildof(pid_t child, pid_t parent) {
-    int ischild;
+    pid_t cur;
+    int gen;
+
+    sshguard_log(LOG_DEBUG, "Testing if %d descends from %d.", (int)child, (int)parent);
+
+    /* walk up the ancestry of child */
+    for (cur = child, gen = 0; gen < PROCAUTH_MAX_GENERATIONS; ++gen) {
+        cur = procauth_getppid(cur);
+        if (cur == -2) {
+            /* no answer */
+            return 0;
+        }
+        if (cur == parent) {
+            sshguard_log(LOG_INFO, "Process %d descends from %d.", (int)child, (int)parent);
+            return 1;
+        }
+        /* gone, or orphan */
+        if (cur <= 1) break;
+    }
+
+    sshguard_log(LOG_INFO, "Process %d does not descend from %d.", (int)child, (int)parent);
+    return -1;
+}
+
+/* parent of a process: -1 if there is no such process, -2 if unknown */
+static pid_t procauth_getppid(pid_t pid) {
+    ppid_entry *entry;
+    time_t now;
+    pid_t ppid;
+
+    now = time(NULL);
+    entry = & ppid_cache[(unsigned int)pid % PROCAUTH_PPID_CACHE_SIZE];
+    if (entry->pid == pid && now - entry->when <= PROCAUTH_PPID_CACHE_TTL) {
+        return entry->ppid;
+    }
+
+    ppid = have_procfs ? procfs_getppid(pid) : ps_getppid(pid);
+    if (ppid >= 0) {
+        entry->pid = pid;
+        entry->ppid = ppid;
+        entry->when = now;
+    }
+
+    return ppid;
+}
+
+/* parent of a process as in /proc/<pid>/stat */
+static pid_t procfs_getppid(pid_t pid) {
+    char buf[512];
+    const char *cur;
+    ssize_t len;
+    int fd, ppid;
+
+    snprintf(buf, sizeof(buf), "/proc/%d/stat", (int)pid);
+    fd = open(buf, O_RDONLY);
+    if (fd == -1) {
+        return (errno == ENOENT) ? -1 : -2;
+    }
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0) return -2;
+    buf[len] = '\0';
+
+    /* "pid (command) state ppid ...", where command can hold anything */
+    cur = strrchr(buf, ')');
+    if (cur == NULL || sscanf(cur + 1, " %*c %d", & ppid) != 1) return -2;
+
+    return (pid_t)ppid;
+}
+
+/* parent of a process, asking ps */
+static pid_t ps_getppid(pid_t pid) {
     int ret;
-    int curchild, curparent;
+    int ppid;
     char mystring[20];
     int ps2me[2];
-    pid_t pid;
+    pid_t pspid;
     FILE *psout;
 
-
-    sshguard_log(LOG_DEBUG, "Testing if %d is child of %d.", (int)child, (int)parent);
-
     if (pipe(ps2me) == -1) {
         sshguard_log(LOG_ERR, "Can't create pipe! %s.", strerror(errno));
-        return 0;
+        return -2;
     }
 
     /* execute ps command, pipe result to us */
-    if ((pid = fork()) == 0) {
+    snprintf(mystring, sizeof(mystring), "%d", (int)pid);
+    if ((pspid = fork()) == 0) {
         /* child */
         close(0);
         dup2(ps2me[1], 1);
 
-        sshguard_log(LOG_DEBUG, "Running 'ps axo pid,ppid'.");
-        execlp("ps", "ps", "axo", "pid,ppid", NULL);
+        sshguard_log(LOG_DEBUG, "Running 'ps -o ppid= -p %s'.", mystring);
+        execlp("ps", "ps", "-o", "ppid=", "-p", mystring, NULL);
 
-        sshguard_log(LOG_ERR, "Unable to run 'ps axo pid,ppid': %s.", strerror(errno));
+        sshguard_log(LOG_ERR, "Unable to run 'ps -o ppid= -p %s': %s.", mystring, strerror(errno));
         exit(-1);
     }
 
     /* father */
     close(ps2me[1]);
 
-    /* read lines returned the ps' output, and match pschild_re */
     psout = fdopen(ps2me[0], "r");
-    if (psout == NULL) return 0;
-
-    ischild = 0;
-    while (fgets(mystring, sizeof(mystring), psout) != NULL) {
-        /* sshguard_log(LOG_DEBUG, "Testing child/parent line: '%s' --> %d@%d", mystring, curchild, curparent); */
-        sscanf(mystring, " %d %d ", & curchild, & curparent);
-        if (curchild == child && curparent == parent) {
-            ischild = 1;
-            break;
-        }
+    if (psout == NULL) return -2;
+
+    if (fgets(mystring, sizeof(mystring), psout) == NULL || sscanf(mystring, " %d", & ppid) != 1) {
+        /* ps says nothing of processes not there */
+        ppid = -1;
     }
 
-    waitpid(pid, & ret, 0);
+    waitpid(pspid, & ret, 0);
     fclose(psout);
-    if (! WIFEXITED(ret) || WEXITSTATUS(ret) != 0) {
+    /* (ps exits 1 for processes not there, and we exit 255 if ps won't run) */
+    if (! WIFEXITED(ret) || WEXITSTATUS(ret) == 255 || (WEXITSTATUS(ret) != 0 && ppid != -1)) {
         sshguard_log(LOG_ERR, "ps command failed to run.");
-        return 0;
+        return -2;
     }
-    
-    sshguard_log(LOG_INFO, "Process %d %s child of %d.", (int)child, (ischild ? "is" : "is not"), (int)parent);
-    /* return YES or NO answer */
-    if (ischild)
-        return 1;
 
-    return -1;
+    return (pid_t)ppid;
 }
-
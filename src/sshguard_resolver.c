@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "fnv.h"
+#include "sshguard_log.h"
+
+#include "sshguard_resolver.h"
+
+
+#define CACHE_BUCKETS       256
+
+/* a name known to resolve (or not) */
+typedef struct cache_entry {
+    struct cache_entry *next;       /* next entry in the same bucket */
+    time_t expires;
+    int resolved;                   /* 0 if the name did not resolve */
+    sshg_address_t address;
+    char name[];
+} cache_entry_t;
+
+/* an attack waiting for its name to be resolved */
+typedef struct waiter {
+    struct waiter *next;
+    attack_t attack;
+    resolver_done_t done;
+} waiter_t;
+
+/* a name to resolve, with all attacks waiting for it */
+typedef struct job {
+    struct job *next;
+    waiter_t *waiters;
+    char name[RESOLVER_MAX_NAMELEN];
+} job_t;
+
+/* all resolver state is protected by this */
+static pthread_mutex_t resolver_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_available = PTHREAD_COND_INITIALIZER;
+
+static cache_entry_t *cache[CACHE_BUCKETS];
+static unsigned int cache_entries;
+
+static job_t *queued_head, *queued_tail;    /* jobs waiting for a thread */
+static job_t *running;                      /* jobs being resolved */
+
+static pthread_t threads[RESOLVER_THREADS];
+static unsigned int num_threads;
+static int stopping;
+
+static resolver_stats_t stats;
+
+
+static int cache_get(const char *restrict name, sshg_address_t *restrict addr, time_t now);
+static void cache_put(const char *restrict name, int resolved, const sshg_address_t *restrict addr, time_t now);
+static job_t *find_job(job_t *list, const char *name);
+static int resolve_name(const char *restrict name, sshg_address_t *restrict addr);
+static void *resolver_thread(void *par);
+static void free_jobs(job_t *job);
+
+
+int resolver_init(void) {
+    pthread_mutex_lock(& resolver_mutex);
+    stopping = 0;
+    for (num_threads = 0; num_threads < RESOLVER_THREADS; ++num_threads) {
+        if (pthread_create(& threads[num_threads], NULL, resolver_thread, NULL) != 0) break;
+    }
+    pthread_mutex_unlock(& resolver_mutex);
+
+    if (num_threads == 0) {
+        sshguard_log(LOG_ERR, "Unable to start any resolver thread: %s.", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int resolver_lookup(const char *restrict name, sshg_address_t *restrict addr) {
+    int ret;
+
+    pthread_mutex_lock(& resolver_mutex);
+    ret = cache_get(name, addr, time(NULL));
+    switch (ret) {
+        case 0:
+            ++stats.hits;
+            break;
+        case -1:
+            ++stats.negative_hits;
+            break;
+        default:
+            ++stats.misses;
+    }
+    pthread_mutex_unlock(& resolver_mutex);
+
+    return ret;
+}
+
+int resolver_resolve(const char *restrict name, sshg_address_t *restrict addr) {
+    int ret;
+
+    ret = resolver_lookup(name, addr);
+    if (ret != 1) return ret;
+
+    ret = resolve_name(name, addr);
+    pthread_mutex_lock(& resolver_mutex);
+    cache_put(name, (ret == 0), addr, time(NULL));
+    pthread_mutex_unlock(& resolver_mutex);
+
+    return ret;
+}
+
+int resolver_submit(const char *restrict name, const attack_t *restrict attack, resolver_done_t done) {
+    waiter_t *waiter;
+    job_t *job;
+    attack_t resolved;
+
+    if (strlen(name) >= RESOLVER_MAX_NAMELEN) return -1;
+
+    waiter = (waiter_t *)malloc(sizeof(waiter_t));
+    if (waiter == NULL) return -1;
+    waiter->attack = *attack;
+    waiter->done = done;
+
+    pthread_mutex_lock(& resolver_mutex);
+    if (num_threads == 0) {
+        pthread_mutex_unlock(& resolver_mutex);
+        free(waiter);
+        return -1;
+    }
+
+    /* resolved meanwhile? */
+    resolved = *attack;
+    switch (cache_get(name, & resolved.address, time(NULL))) {
+        case 0:
+            pthread_mutex_unlock(& resolver_mutex);
+            free(waiter);
+            done(resolved);
+            return 0;
+        case -1:
+            pthread_mutex_unlock(& resolver_mutex);
+            free(waiter);
+            return 0;
+    }
+
+    /* join a resolution of the same name, or make a new one */
+    job = find_job(running, name);
+    if (job == NULL) job = find_job(queued_head, name);
+    if (job == NULL) {
+        job = (job_t *)malloc(sizeof(job_t));
+        if (job == NULL) {
+            pthread_mutex_unlock(& resolver_mutex);
+            free(waiter);
+            return -1;
+        }
+        strcpy(job->name, name);
+        job->waiters = NULL;
+        job->next = NULL;
+        if (queued_tail == NULL) queued_head = job;
+        else queued_tail->next = job;
+        queued_tail = job;
+        pthread_cond_signal(& jobs_available);
+    }
+    waiter->next = job->waiters;
+    job->waiters = waiter;
+    pthread_mutex_unlock(& resolver_mutex);
+
+    return 0;
+}
+
+void resolver_get_stats(resolver_stats_t *restrict out) {
+    pthread_mutex_lock(& resolver_mutex);
+    *out = stats;
+    pthread_mutex_unlock(& resolver_mutex);
+}
+
+int resolver_fin(void) {
+    cache_entry_t *entry;
+    unsigned int i;
+
+    pthread_mutex_lock(& resolver_mutex);
+    stopping = 1;
+    pthread_cond_broadcast(& jobs_available);
+    pthread_mutex_unlock(& resolver_mutex);
+
+    /* threads stuck in a resolution are not waited for */
+    for (i = 0; i < num_threads; ++i) {
+        pthread_detach(threads[i]);
+    }
+
+    pthread_mutex_lock(& resolver_mutex);
+    num_threads = 0;
+    free_jobs(queued_head);
+    queued_head = queued_tail = NULL;
+    for (i = 0; i < CACHE_BUCKETS; ++i) {
+        while (cache[i] != NULL) {
+            entry = cache[i];
+            cache[i] = entry->next;
+            free(entry);
+        }
+    }
+    cache_entries = 0;
+    pthread_mutex_unlock(& resolver_mutex);
+
+    return 0;
+}
+
+
+static void *resolver_thread(void *par) {
+    job_t *job, **prev;
+    waiter_t *waiter;
+    sshg_address_t addr;
+    struct timeval start, end;
+    double latency;
+    int ret;
+
+    pthread_mutex_lock(& resolver_mutex);
+    while (1) {
+        while (! stopping && queued_head == NULL)
+            pthread_cond_wait(& jobs_available, & resolver_mutex);
+        if (stopping) break;
+
+        /* move the job from queued to running */
+        job = queued_head;
+        queued_head = job->next;
+        if (queued_head == NULL) queued_tail = NULL;
+        job->next = running;
+        running = job;
+        pthread_mutex_unlock(& resolver_mutex);
+
+        gettimeofday(& start, NULL);
+        ret = resolve_name(job->name, & addr);
+        gettimeofday(& end, NULL);
+        latency = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+
+        pthread_mutex_lock(& resolver_mutex);
+        /* new requests for this name will be answered by the cache */
+        cache_put(job->name, (ret == 0), & addr, time(NULL));
+        for (prev = & running; *prev != job; prev = & (*prev)->next);
+        *prev = job->next;
+        ++stats.resolutions;
+        if (ret != 0) ++stats.failures;
+        stats.total_latency += latency;
+        if (latency > stats.max_latency) stats.max_latency = latency;
+        if (stopping) {
+            job->next = NULL;
+            free_jobs(job);
+            break;
+        }
+        pthread_mutex_unlock(& resolver_mutex);
+
+        sshguard_log(LOG_DEBUG, "Resolving '%s' took %.3f seconds.", job->name, latency);
+        while (job->waiters != NULL) {
+            waiter = job->waiters;
+            job->waiters = waiter->next;
+            if (ret == 0) {
+                waiter->attack.address = addr;
+                waiter->done(waiter->attack);
+            }
+            free(waiter);
+        }
+        free(job);
+
+        pthread_mutex_lock(& resolver_mutex);
+    }
+    pthread_mutex_unlock(& resolver_mutex);
+
+    return NULL;
+}
+
+static int resolve_name(const char *restrict name, sshg_address_t *restrict addr) {
+    struct addrinfo addrinfo_hints;
+    struct addrinfo *addrinfo_result;
+    const void *rawaddr;
+
+    /* look up IPv4 first */
+    memset(& addrinfo_hints, 0x00, sizeof(addrinfo_hints));
+    addrinfo_hints.ai_family = AF_INET;
+    if (getaddrinfo(name, NULL, & addrinfo_hints, & addrinfo_result) == 0) {
+        addr->kind = ADDRKIND_IPv4;
+        rawaddr = & ((struct sockaddr_in *)addrinfo_result->ai_addr)->sin_addr;
+    } else {
+        sshguard_log(LOG_DEBUG, "Failed to resolve '%s' @ IPv4! Trying IPv6.", name);
+        /* try IPv6 */
+        addrinfo_hints.ai_family = AF_INET6;
+        if (getaddrinfo(name, NULL, & addrinfo_hints, & addrinfo_result) != 0) {
+            sshguard_log(LOG_ERR, "Could not resolve '%s' in neither of IPv{4,6}. Giving up entry.", name);
+            return -1;
+        }
+        addr->kind = ADDRKIND_IPv6;
+        rawaddr = & ((struct sockaddr_in6 *)addrinfo_result->ai_addr)->sin6_addr;
+    }
+
+    if (inet_ntop(addrinfo_result->ai_family, rawaddr, addr->value, sizeof(addr->value)) == NULL) {
+        sshguard_log(LOG_ERR, "Unable to interpret resolution result as IPv%d address: %s. Giving up entry.", addr->kind, strerror(errno));
+        freeaddrinfo(addrinfo_result);
+        return -1;
+    }
+    freeaddrinfo(addrinfo_result);
+
+    sshguard_log(LOG_INFO, "Successfully resolved '%s' --> %d:'%s'.", name, addr->kind, addr->value);
+    return 0;
+}
+
+/* with resolver_mutex held */
+static int cache_get(const char *restrict name, sshg_address_t *restrict addr, time_t now) {
+    cache_entry_t *entry;
+
+    for (entry = cache[fnv_32a_str(name, FNV1_32A_INIT) % CACHE_BUCKETS]; entry != NULL; entry = entry->next) {
+        if (strcmp(entry->name, name) == 0) {
+            if (entry->expires <= now) return 1;
+            if (! entry->resolved) return -1;
+            *addr = entry->address;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* with resolver_mutex held */
+static void cache_put(const char *restrict name, int resolved, const sshg_address_t *restrict addr, time_t now) {
+    cache_entry_t **bucket, **prev, *entry;
+
+    /* drop expired entries in the bucket, and any previous entry for name */
+    bucket = & cache[fnv_32a_str(name, FNV1_32A_INIT) % CACHE_BUCKETS];
+    for (prev = bucket; *prev != NULL; ) {
+        entry = *prev;
+        if (entry->expires <= now || strcmp(entry->name, name) == 0) {
+            *prev = entry->next;
+            free(entry);
+            --cache_entries;
+        } else {
+            prev = & entry->next;
+        }
+    }
+
+    /* full: this one will just be resolved again */
+    if (cache_entries >= RESOLVER_CACHE_SIZE) return;
+
+    entry = (cache_entry_t *)malloc(sizeof(cache_entry_t) + strlen(name) + 1);
+    if (entry == NULL) return;
+    strcpy(entry->name, name);
+    entry->resolved = resolved;
+    if (resolved) entry->address = *addr;
+    entry->expires = now + (resolved ? RESOLVER_POSITIVE_TTL : RESOLVER_NEGATIVE_TTL);
+    entry->next = *bucket;
+    *bucket = entry;
+    ++cache_entries;
+}
+
+static job_t *find_job(job_t *list, const char *name) {
+    for (; list != NULL; list = list->next) {
+        if (strcmp(list->name, name) == 0) return list;
+    }
+    return NULL;
+}
+
+static void free_jobs(job_t *job) {
+    job_t *next;
+    waiter_t *waiter;
+
+    for (; job != NULL; job = next) {
+        next = job->next;
+        while (job->waiters != NULL) {
+            waiter = job->waiters;
+            job->waiters = waiter->next;
+            free(waiter);
+        }
+        free(job);
+    }
+}
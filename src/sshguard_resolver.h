@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#ifndef SSHGUARD_RESOLVER_H
+#define SSHGUARD_RESOLVER_H
+
+#include <time.h>
+
+#include "sshguard_addresskind.h"
+#include "sshguard_attack.h"
+
+/* longest host name taken for resolution, terminator included */
+#define RESOLVER_MAX_NAMELEN        256
+
+/* threads resolving names in background */
+#define RESOLVER_THREADS            4
+
+/* seconds to remember the address a name resolved to */
+#define RESOLVER_POSITIVE_TTL       3600
+/* seconds to remember that a name could not be resolved */
+#define RESOLVER_NEGATIVE_TTL       300
+
+/* maximum number of names remembered */
+#define RESOLVER_CACHE_SIZE         4096
+
+/* called from a resolver thread with an attack whose address has been resolved */
+typedef void (*resolver_done_t)(attack_t attack);
+
+/* activity of the resolver since its initialization */
+typedef struct {
+    unsigned long hits;             /* lookups answered by the cache with an address */
+    unsigned long negative_hits;    /* lookups answered by the cache with a failure */
+    unsigned long misses;           /* lookups the cache could not answer */
+    unsigned long resolutions;      /* names actually resolved (or tried) */
+    unsigned long failures;         /* ...of which could not be resolved */
+    double total_latency;           /* seconds spent in all resolutions */
+    double max_latency;             /* seconds spent in the slowest resolution */
+} resolver_stats_t;
+
+/**
+ * Initialize the resolver and start its threads.
+ *
+ * @return 0 on success, -1 on error
+ */
+int resolver_init(void);
+
+/**
+ * Look up the address of a host name in the cache, without resolving it.
+ * The address is stored in addr if known.
+ *
+ * @return 0 if the address is known, -1 if the name is known to not
+ *          resolve, 1 if nothing is known about the name
+ */
+int resolver_lookup(const char *restrict name, sshg_address_t *restrict addr);
+
+/**
+ * Resolve a host name now (IPv4 first, then IPv6), through the cache.
+ * This blocks the caller for as long as resolution takes.
+ *
+ * @return 0 if the address has been stored in addr, -1 if not resolved
+ */
+int resolver_resolve(const char *restrict name, sshg_address_t *restrict addr);
+
+/**
+ * Resolve the host name of an attack in background. Once resolved, the
+ * attack is passed to done with its address filled in; attacks from names
+ * not resolving are dropped. Requests for names already being resolved
+ * wait on the same resolution.
+ *
+ * @return 0 if resolution has been queued, -1 on error
+ */
+int resolver_submit(const char *restrict name, const attack_t *restrict attack, resolver_done_t done);
+
+/**
+ * Get the activity of the resolver so far.
+ */
+void resolver_get_stats(resolver_stats_t *restrict stats);
+
+/**
+ * Stop the resolver threads and drop pending resolutions.
+ *
+ * Threads in the middle of a resolution are not waited for: the callback
+ * of such a resolution may still be called afterwards.
+ *
+ * @return 0 on success, -1 on error
+ */
+int resolver_fin(void);
+
+#endif
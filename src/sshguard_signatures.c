@@ -0,0 +1,676 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sshguard_log.h"
+
+#include "sshguard_signatures.h"
+
+
+/* longest line in a signatures file */
+#define SIGNATURES_LINE_LEN         1024
+
+/* most backtracking steps for finding the address in a matching message */
+#define CAPTURE_MAX_STEPS           65536
+
+/* characters addresses (IPv4, IPv6, host names) are made of */
+#define IS_ADDR_CHAR(c)     (((c) >= '0' && (c) <= '9') || ((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z') \
+                                || (c) == '.' || (c) == ':' || (c) == '-' || (c) == '_')
+
+/* elements of patterns */
+#define ELEM_LITERAL        0       /* the character in ch */
+#define ELEM_ANY            1       /* any text ("*") */
+#define ELEM_ADDR_FIRST     2       /* first character of the address */
+#define ELEM_ADDR_REST      3       /* other characters of the address, if any */
+#define ELEM_MATCHED        4       /* (automaton positions only) end of pattern */
+
+typedef struct {
+    unsigned char type;
+    unsigned char ch;
+} sig_elem_t;
+
+typedef struct {
+    int service;
+    unsigned int dangerousness;
+    unsigned int len;               /* number of elements */
+    unsigned int first_pos;         /* automaton position of the first element */
+    sig_elem_t *elems;
+} signature_t;
+
+/*
+ * A set of signatures, compiled. Each state of the automaton recognizing
+ * them stands for the positions (elements of patterns) reached in all
+ * patterns at once, and moves on by classes of equivalent bytes. A sigdb
+ * is not changed once loaded, and is shared by all the parsers.
+ */
+typedef struct {
+    signature_t *sigs;
+    unsigned int num_sigs;
+
+    /* positions: each element of each pattern, plus its end */
+    unsigned int num_positions;
+    unsigned char *pos_type;
+    unsigned char *pos_ch;
+    unsigned int *pos_sig;
+
+    uint8_t byte_class[256];
+    int class_is_addr[256];
+    unsigned int num_classes;
+
+    unsigned int words;             /* length of a set of positions, in words */
+    uint32_t *start;                /* the set of positions of the start state */
+
+    unsigned int refs;              /* held by sigdb and by caches, under sigdb_lock */
+} sigdb_t;
+
+/*
+ * The states of the automaton of a sigdb that one parser reached. States
+ * are built when first reached, and all dropped when they run out.
+ */
+struct signatures_cache {
+    sigdb_t *db;                    /* the states are of this one */
+    unsigned int num_states, max_states;
+    uint32_t *sets;                 /* the set of positions of each state */
+    uint32_t *next;                 /* num_states x num_classes transitions, or STATE_UNKNOWN */
+    int *accept;                    /* signature completed in each state, or -1 */
+    int *hash;                      /* states by their set of positions */
+    unsigned int hash_size;
+    uint32_t *scratch;              /* set of positions being built */
+};
+
+/* transition not built yet */
+#define STATE_UNKNOWN       UINT32_MAX
+
+#define SET_ADD(set, p)     ((set)[(p)/32] |= (1u << ((p)%32)))
+
+/* signatures in use; swapped as a whole when loading */
+static pthread_mutex_t sigdb_lock = PTHREAD_MUTEX_INITIALIZER;
+static sigdb_t *sigdb = NULL;
+
+
+static int parse_signature(const char *restrict line, signature_t *restrict sig);
+static int compile(sigdb_t *restrict db);
+static sigdb_t *hold_sigdb(signatures_cache_t *restrict cache);
+static void release_sigdb(sigdb_t *db);
+static int cache_prepare(signatures_cache_t *restrict cache, sigdb_t *restrict db);
+static void cache_clear(signatures_cache_t *restrict cache);
+static int add_state(signatures_cache_t *restrict cache, const uint32_t *restrict set);
+static uint32_t step(signatures_cache_t *restrict cache, uint32_t state, unsigned int c);
+static void free_sigdb(sigdb_t *db);
+static int find_address(const signature_t *restrict sig, const char *restrict message, const char **restrict start, const char **restrict end);
+static int match_here(const sig_elem_t *restrict elems, unsigned int len, const char *restrict str, const char **restrict start, const char **restrict end, unsigned int *restrict steps);
+static int store_address(const char *restrict start, size_t len, attack_t *restrict attack, char *restrict host, size_t hostlen);
+
+
+int signatures_load(const char *restrict filename) {
+    FILE *f;
+    char line[SIGNATURES_LINE_LEN];
+    sigdb_t *db, *old;
+    unsigned int lineno = 0;
+    size_t len;
+
+    f = fopen(filename, "r");
+    if (f == NULL) {
+        sshguard_log(LOG_ERR, "Unable to open signatures file '%s': %s.", filename, strerror(errno));
+        return -1;
+    }
+
+    db = (sigdb_t *)calloc(1, sizeof(sigdb_t));
+    if (db == NULL) {
+        fclose(f);
+        return -1;
+    }
+    db->sigs = (signature_t *)calloc(SIGNATURES_MAX, sizeof(signature_t));
+    if (db->sigs == NULL) {
+        free(db);
+        fclose(f);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        ++lineno;
+        len = strlen(line);
+        if (len > 0 && line[len-1] != '\n' && ! feof(f)) {
+            sshguard_log(LOG_ERR, "Signatures file '%s', line %u: too long.", filename, lineno);
+            break;
+        }
+        /* drop trailing blanks */
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r' || line[len-1] == ' ' || line[len-1] == '\t'))
+            line[--len] = '\0';
+        if (len == 0 || line[0] == '#') continue;
+
+        if (db->num_sigs == SIGNATURES_MAX) {
+            sshguard_log(LOG_ERR, "Signatures file '%s': more than %d signatures.", filename, SIGNATURES_MAX);
+            break;
+        }
+        if (parse_signature(line, & db->sigs[db->num_sigs]) != 0) {
+            sshguard_log(LOG_ERR, "Signatures file '%s', line %u: bad signature.", filename, lineno);
+            break;
+        }
+        ++db->num_sigs;
+    }
+    if (ferror(f) || ! feof(f)) {
+        /* stopped on errors */
+        fclose(f);
+        free_sigdb(db);
+        return -1;
+    }
+    fclose(f);
+
+    if (compile(db) != 0) {
+        sshguard_log(LOG_ERR, "Signatures file '%s': out of memory.", filename);
+        free_sigdb(db);
+        return -1;
+    }
+
+    /* parsers move to the new one on their next message */
+    db->refs = 1;
+    pthread_mutex_lock(& sigdb_lock);
+    old = sigdb;
+    sigdb = db;
+    pthread_mutex_unlock(& sigdb_lock);
+    if (old != NULL) release_sigdb(old);
+
+    sshguard_log(LOG_INFO, "Loaded %u signatures from '%s'.", db->num_sigs, filename);
+    return 0;
+}
+
+int signatures_match(signatures_cache_t **restrict cache, const char *restrict message, attack_t *restrict attack, char *restrict host, size_t hostlen) {
+    const unsigned char *p;
+    const char *start, *end;
+    const signature_t *sig;
+    const sigdb_t *db;
+    signatures_cache_t *c;
+    uint32_t state = 0, next;
+
+    if (*cache == NULL) {
+        *cache = (signatures_cache_t *)calloc(1, sizeof(signatures_cache_t));
+        if (*cache == NULL) return 1;
+    }
+    c = *cache;
+    db = hold_sigdb(c);
+    if (db == NULL || db->num_sigs == 0 || c->num_states == 0) return 1;
+
+    /* which signature matches, if any: no lock, the states are this parser's */
+    for (p = (const unsigned char *)message; *p != '\0' && c->accept[state] < 0; ++p) {
+        next = c->next[state * db->num_classes + db->byte_class[*p]];
+        state = (next != STATE_UNKNOWN) ? next : step(c, state, db->byte_class[*p]);
+    }
+    if (c->accept[state] < 0) return 1;
+
+    /* where the address is */
+    sig = & db->sigs[c->accept[state]];
+    if (find_address(sig, message, & start, & end) != 0
+            || store_address(start, end - start, attack, host, hostlen) != 0)
+        return 1;
+    attack->service = sig->service;
+    attack->dangerousness = sig->dangerousness;
+
+    return 0;
+}
+
+void signatures_cache_free(signatures_cache_t *cache) {
+    if (cache == NULL) return;
+    cache_clear(cache);
+    if (cache->db != NULL) release_sigdb(cache->db);
+    free(cache);
+}
+
+void signatures_fin(void) {
+    sigdb_t *old;
+
+    pthread_mutex_lock(& sigdb_lock);
+    old = sigdb;
+    sigdb = NULL;
+    pthread_mutex_unlock(& sigdb_lock);
+    if (old != NULL) release_sigdb(old);
+}
+
+
+/* parse "service dangerousness pattern" */
+static int parse_signature(const char *restrict line, signature_t *restrict sig) {
+    const char *cur;
+    char *end;
+    long num;
+    unsigned int addrs = 0, literals = 0;
+
+    num = strtol(line, & end, 10);
+    if (end == line || (*end != ' ' && *end != '\t') || num <= 0) return -1;
+    sig->service = (int)num;
+    cur = end;
+    num = strtol(cur, & end, 10);
+    if (end == cur || (*end != ' ' && *end != '\t') || num <= 0) return -1;
+    sig->dangerousness = (unsigned int)num;
+    for (cur = end; *cur == ' ' || *cur == '\t'; ++cur);
+
+    /* no pattern has more elements than characters, plus one for <addr> */
+    sig->elems = (sig_elem_t *)malloc((strlen(cur) + 1) * sizeof(sig_elem_t));
+    if (sig->elems == NULL) return -1;
+    sig->len = 0;
+
+    while (*cur != '\0') {
+        if (*cur == '*') {
+            /* "**" is just "*" */
+            if (sig->len == 0 || sig->elems[sig->len-1].type != ELEM_ANY)
+                sig->elems[sig->len++].type = ELEM_ANY;
+            ++cur;
+        } else if (strncmp(cur, "<addr>", 6) == 0) {
+            sig->elems[sig->len++].type = ELEM_ADDR_FIRST;
+            sig->elems[sig->len++].type = ELEM_ADDR_REST;
+            ++addrs;
+            cur += 6;
+        } else {
+            if (*cur == '\\') {
+                ++cur;
+                if (*cur == '\0') break;
+            }
+            sig->elems[sig->len].type = ELEM_LITERAL;
+            sig->elems[sig->len++].ch = (unsigned char)*cur;
+            ++literals;
+            ++cur;
+        }
+    }
+
+    /* one address, and some text to tell the message */
+    if (*cur != '\0' || addrs != 1 || literals == 0) {
+        free(sig->elems);
+        sig->elems = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* first position in set from the given one on, or -1. Sets are mostly empty */
+static int next_position(const uint32_t *restrict set, unsigned int words, unsigned int from) {
+    /* index of the lowest bit set, by de Bruijn sequence */
+    static const int lowest_bit[32] = {
+        0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+        31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+    };
+    unsigned int w = from / 32;
+    uint32_t bits;
+
+    if (w >= words) return -1;
+    bits = set[w] & ~((1u << (from % 32)) - 1);
+    while (bits == 0) {
+        if (++w == words) return -1;
+        bits = set[w];
+    }
+    return w * 32 + lowest_bit[((bits & -bits) * 0x077CB531u) >> 27];
+}
+
+/* hash of a set of positions, FNV-1a style but by words */
+static uint32_t hash_set(const uint32_t *restrict set, unsigned int words) {
+    uint32_t h = 0x811c9dc5u;
+    unsigned int w;
+
+    for (w = 0; w < words; ++w) {
+        h = (h ^ set[w]) * 0x01000193u;
+    }
+    return h ^ (h >> 16);
+}
+
+/* add to set the positions reachable without reading */
+static void close_set(const sigdb_t *restrict db, uint32_t *restrict set) {
+    int p;
+
+    /* "*" and address tails can be skipped; these only lead forward */
+    for (p = next_position(set, db->words, 0); p >= 0; p = next_position(set, db->words, p+1)) {
+        if (db->pos_type[p] == ELEM_ANY || db->pos_type[p] == ELEM_ADDR_REST)
+            SET_ADD(set, p+1);
+    }
+}
+
+/* prepare the automaton recognizing any of the signatures of db */
+static int compile(sigdb_t *restrict db) {
+    unsigned int i, j, p, c;
+    int rep[256];
+    uint8_t literal[256];
+
+    for (i = 0; i < db->num_sigs; ++i) {
+        db->sigs[i].first_pos = db->num_positions;
+        db->num_positions += db->sigs[i].len + 1;
+    }
+    db->pos_type = (unsigned char *)malloc(db->num_positions + 1);
+    db->pos_ch = (unsigned char *)malloc(db->num_positions + 1);
+    db->pos_sig = (unsigned int *)malloc((db->num_positions + 1) * sizeof(unsigned int));
+    if (db->pos_type == NULL || db->pos_ch == NULL || db->pos_sig == NULL) return -1;
+    memset(literal, 0x00, sizeof(literal));
+    for (i = 0; i < db->num_sigs; ++i) {
+        for (j = 0; j <= db->sigs[i].len; ++j) {
+            p = db->sigs[i].first_pos + j;
+            db->pos_sig[p] = i;
+            if (j == db->sigs[i].len) {
+                db->pos_type[p] = ELEM_MATCHED;
+                continue;
+            }
+            db->pos_type[p] = db->sigs[i].elems[j].type;
+            db->pos_ch[p] = db->sigs[i].elems[j].ch;
+            if (db->pos_type[p] == ELEM_LITERAL) literal[db->pos_ch[p]] = 1;
+        }
+    }
+
+    /* byte classes: each literal on its own, then address and other characters */
+    db->num_classes = 2;
+    for (c = 0; c < 256; ++c) {
+        if (literal[c]) {
+            db->byte_class[c] = db->num_classes++;
+        } else {
+            db->byte_class[c] = IS_ADDR_CHAR(c) ? 1 : 0;
+        }
+    }
+    for (c = 0; c < 256; ++c) rep[c] = -1;
+    for (c = 255; c > 0; --c) {
+        rep[db->byte_class[c]] = c;
+    }
+    for (c = 0; c < db->num_classes; ++c) {
+        db->class_is_addr[c] = (rep[c] >= 0 && IS_ADDR_CHAR(rep[c]));
+    }
+
+    /* start: the beginning of every pattern. Patterns can match anywhere,
+     * so the start is added back after each byte */
+    db->words = (db->num_positions + 31) / 32;
+    db->start = (uint32_t *)calloc(db->words, sizeof(uint32_t));
+    if (db->start == NULL) return -1;
+    for (i = 0; i < db->num_sigs; ++i) {
+        SET_ADD(db->start, db->sigs[i].first_pos);
+    }
+    close_set(db, db->start);
+
+    return 0;
+}
+
+/* the sigdb in use, with the states of cache made for it. NULL if none */
+static sigdb_t *hold_sigdb(signatures_cache_t *restrict cache) {
+    sigdb_t *db, *old;
+
+    /* states stay valid as long as the same sigdb is in use */
+    pthread_mutex_lock(& sigdb_lock);
+    db = sigdb;
+    old = cache->db;
+    if (db == old) {
+        pthread_mutex_unlock(& sigdb_lock);
+        return db;
+    }
+    if (db != NULL) ++db->refs;
+    cache->db = db;
+    pthread_mutex_unlock(& sigdb_lock);
+
+    if (old != NULL) release_sigdb(old);
+    cache_clear(cache);
+    if (db != NULL && cache_prepare(cache, db) != 0) {
+        sshguard_log(LOG_ERR, "Unable to allocate the automaton of signatures: %s.", strerror(errno));
+        cache_clear(cache);
+    }
+    return db;
+}
+
+/* drop a reference to db, freeing it with the last one */
+static void release_sigdb(sigdb_t *db) {
+    unsigned int refs;
+
+    pthread_mutex_lock(& sigdb_lock);
+    refs = --db->refs;
+    pthread_mutex_unlock(& sigdb_lock);
+    if (refs == 0) free_sigdb(db);
+}
+
+/* room for the states of db in cache, and its start state */
+static int cache_prepare(signatures_cache_t *restrict cache, sigdb_t *restrict db) {
+    cache->max_states = 64;
+    cache->sets = (uint32_t *)malloc(cache->max_states * db->words * sizeof(uint32_t));
+    cache->next = (uint32_t *)malloc(cache->max_states * db->num_classes * sizeof(uint32_t));
+    cache->accept = (int *)malloc(cache->max_states * sizeof(int));
+    for (cache->hash_size = 1; cache->hash_size < 2 * SIGNATURES_MAX_STATES; cache->hash_size *= 2);
+    cache->hash = (int *)malloc(cache->hash_size * sizeof(int));
+    cache->scratch = (uint32_t *)malloc(db->words * sizeof(uint32_t));
+    if (cache->sets == NULL || cache->next == NULL || cache->accept == NULL || cache->hash == NULL || cache->scratch == NULL) return -1;
+    memset(cache->hash, 0xff, cache->hash_size * sizeof(int));
+
+    return (add_state(cache, db->start) == 0) ? 0 : -1;
+}
+
+/* drop all the states of cache */
+static void cache_clear(signatures_cache_t *restrict cache) {
+    free(cache->sets);
+    free(cache->next);
+    free(cache->accept);
+    free(cache->hash);
+    free(cache->scratch);
+    cache->sets = cache->next = cache->scratch = NULL;
+    cache->accept = cache->hash = NULL;
+    cache->num_states = cache->max_states = 0;
+}
+
+/* find the state of a set of positions, or make it. -1 if no room is left */
+static int add_state(signatures_cache_t *restrict cache, const uint32_t *restrict set) {
+    const sigdb_t *db = cache->db;
+    unsigned int h, c;
+    int p;
+    size_t setsize = db->words * sizeof(uint32_t);
+
+    for (h = hash_set(set, db->words) & (cache->hash_size-1); cache->hash[h] >= 0; h = (h+1) & (cache->hash_size-1)) {
+        if (memcmp(& cache->sets[cache->hash[h] * db->words], set, setsize) == 0) return cache->hash[h];
+    }
+
+    if (cache->num_states == cache->max_states) {
+        uint32_t *newsets, *newnext;
+        int *newaccept;
+
+        if (cache->max_states >= SIGNATURES_MAX_STATES) return -1;
+        cache->max_states *= 2;
+        if (cache->max_states > SIGNATURES_MAX_STATES) cache->max_states = SIGNATURES_MAX_STATES;
+        newsets = (uint32_t *)realloc(cache->sets, cache->max_states * setsize);
+        if (newsets != NULL) cache->sets = newsets;
+        newnext = (uint32_t *)realloc(cache->next, cache->max_states * db->num_classes * sizeof(uint32_t));
+        if (newnext != NULL) cache->next = newnext;
+        newaccept = (int *)realloc(cache->accept, cache->max_states * sizeof(int));
+        if (newaccept != NULL) cache->accept = newaccept;
+        if (newsets == NULL || newnext == NULL || newaccept == NULL) {
+            cache->max_states = cache->num_states;
+            return -1;
+        }
+    }
+
+    memcpy(& cache->sets[cache->num_states * db->words], set, setsize);
+    for (c = 0; c < db->num_classes; ++c) {
+        cache->next[cache->num_states * db->num_classes + c] = STATE_UNKNOWN;
+    }
+    /* completed pattern? The lowest (first in file) wins */
+    cache->accept[cache->num_states] = -1;
+    for (p = next_position(set, db->words, 0); p >= 0; p = next_position(set, db->words, p+1)) {
+        if (db->pos_type[p] == ELEM_MATCHED) {
+            cache->accept[cache->num_states] = db->pos_sig[p];
+            break;
+        }
+    }
+    cache->hash[h] = cache->num_states;
+
+    return cache->num_states++;
+}
+
+/* build the transition from state reading a byte of class c */
+static uint32_t step(signatures_cache_t *restrict cache, uint32_t state, unsigned int c) {
+    const sigdb_t *db = cache->db;
+    const uint32_t *cur = & cache->sets[state * db->words];
+    unsigned int i;
+    int p, next;
+
+    /* the start, plus whatever reading the byte leads to */
+    memcpy(cache->scratch, db->start, db->words * sizeof(uint32_t));
+    for (p = next_position(cur, db->words, 0); p >= 0; p = next_position(cur, db->words, p+1)) {
+        switch (db->pos_type[p]) {
+            case ELEM_LITERAL:
+                if (db->byte_class[db->pos_ch[p]] == c) SET_ADD(cache->scratch, p+1);
+                break;
+            case ELEM_ANY:
+                SET_ADD(cache->scratch, p);
+                break;
+            case ELEM_ADDR_FIRST:
+                if (db->class_is_addr[c]) SET_ADD(cache->scratch, p+1);
+                break;
+            case ELEM_ADDR_REST:
+                if (db->class_is_addr[c]) SET_ADD(cache->scratch, p);
+                break;
+        }
+    }
+    close_set(db, cache->scratch);
+
+    next = add_state(cache, cache->scratch);
+    if (next < 0) {
+        /* out of room: drop all states but the start, and go on from here */
+        cache->num_states = 1;
+        memset(cache->hash, 0xff, cache->hash_size * sizeof(int));
+        cache->hash[hash_set(cache->sets, db->words) & (cache->hash_size-1)] = 0;
+        for (i = 0; i < db->num_classes; ++i) {
+            cache->next[i] = STATE_UNKNOWN;
+        }
+        return add_state(cache, cache->scratch);
+    }
+
+    cache->next[state * db->num_classes + c] = next;
+    return next;
+}
+
+static void free_sigdb(sigdb_t *db) {
+    unsigned int i;
+
+    for (i = 0; i < db->num_sigs; ++i) {
+        free(db->sigs[i].elems);
+    }
+    free(db->sigs);
+    free(db->pos_type);
+    free(db->pos_ch);
+    free(db->pos_sig);
+    free(db->start);
+    free(db);
+}
+
+/* find where the address is in a message known to match sig. 0 if found */
+static int find_address(const signature_t *restrict sig, const char *restrict message, const char **restrict start, const char **restrict end) {
+    const char *cur;
+    unsigned int steps = 0;
+
+    /* leftmost match */
+    for (cur = message; *cur != '\0'; ++cur) {
+        if (match_here(sig->elems, sig->len, cur, start, end, & steps)) return 0;
+        if (steps > CAPTURE_MAX_STEPS) break;
+    }
+
+    return -1;
+}
+
+/* match elems at str, with "*" and the address as long as possible */
+static int match_here(const sig_elem_t *restrict elems, unsigned int len, const char *restrict str, const char **restrict start, const char **restrict end, unsigned int *restrict steps) {
+    const char *cur;
+
+    if (++*steps > CAPTURE_MAX_STEPS) return 0;
+
+    /* patterns can end anywhere in the message */
+    if (len == 0) return 1;
+
+    switch (elems[0].type) {
+        case ELEM_LITERAL:
+            return (*str == (char)elems[0].ch) && match_here(elems+1, len-1, str+1, start, end, steps);
+
+        case ELEM_ANY:
+            for (cur = str + strlen(str); cur >= str; --cur) {
+                if (match_here(elems+1, len-1, cur, start, end, steps)) return 1;
+            }
+            return 0;
+
+        case ELEM_ADDR_FIRST:
+            /* followed by ELEM_ADDR_REST, taken here */
+            for (cur = str; IS_ADDR_CHAR(*cur); ++cur);
+            for (; cur > str; --cur) {
+                if (match_here(elems+2, len-2, cur, start, end, steps)) {
+                    *start = str;
+                    *end = cur;
+                    return 1;
+                }
+            }
+            return 0;
+    }
+
+    return 0;
+}
+
+/* store the address found in a message in attack, or in host if it's a name. 0 if valid */
+static int store_address(const char *restrict start, size_t len, attack_t *restrict attack, char *restrict host, size_t hostlen) {
+    char addr[INET6_ADDRSTRLEN + 1];
+    struct in6_addr addr6;
+    struct in_addr addr4;
+    size_t i;
+    int letters = 0;
+
+    if (len < sizeof(addr)) {
+        memcpy(addr, start, len);
+        addr[len] = '\0';
+
+        if (inet_pton(AF_INET, addr, & addr4) == 1) {
+            attack->address.kind = ADDRKIND_IPv4;
+            strcpy(attack->address.value, addr);
+            return 0;
+        }
+        if (inet_pton(AF_INET6, addr, & addr6) == 1) {
+            if (IN6_IS_ADDR_V4MAPPED(& addr6)) {
+                /* an IPv4 address packed in IPv6 */
+                attack->address.kind = ADDRKIND_IPv4;
+                inet_ntop(AF_INET, & addr6.s6_addr[12], attack->address.value, sizeof(attack->address.value));
+            } else {
+                attack->address.kind = ADDRKIND_IPv6;
+                strcpy(attack->address.value, addr);
+            }
+            return 0;
+        }
+    }
+
+    /* a host name then? (or the address with some trailing punctuation) */
+    while (len > 0 && (start[len-1] == '.' || start[len-1] == ':' || start[len-1] == '-' || start[len-1] == '_')) --len;
+    if (len == 0 || len >= hostlen) return -1;
+    for (i = 0; i < len; ++i) {
+        if (start[i] == ':' || start[i] == '_') return -1;
+        if ((start[i] >= 'a' && start[i] <= 'z') || (start[i] >= 'A' && start[i] <= 'Z')) letters = 1;
+    }
+    if (! letters) {
+        /* "1.2.3.4." */
+        if (len >= sizeof(addr)) return -1;
+        memcpy(addr, start, len);
+        addr[len] = '\0';
+        if (inet_pton(AF_INET, addr, & addr4) != 1) return -1;
+        attack->address.kind = ADDRKIND_IPv4;
+        strcpy(attack->address.value, addr);
+        return 0;
+    }
+    memcpy(host, start, len);
+    host[len] = '\0';
+    return 0;
+}
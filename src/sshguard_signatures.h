@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#ifndef SSHGUARD_SIGNATURES_H
+#define SSHGUARD_SIGNATURES_H
+
+#include <stddef.h>
+
+#include "sshguard_attack.h"
+
+/* most signatures taken from a file */
+#define SIGNATURES_MAX              1024
+
+/* most states of the automaton kept at once; it is rebuilt when they run out */
+#define SIGNATURES_MAX_STATES       4096
+
+/* states of the automaton reached by one parser */
+typedef struct signatures_cache signatures_cache_t;
+
+/**
+ * Load attack signatures from a file, replacing those loaded before (if
+ * the file has errors, those are kept). Can be called while other threads
+ * match lines.
+ *
+ * Each line of the file is "service dangerousness pattern", or a comment
+ * if starting with '#'. In patterns, "*" stands for any text (possibly
+ * none), and "<addr>" for the address of the attacker (IPv4, IPv6 or host
+ * name), which must appear exactly once. Everything else is taken as it is,
+ * "\*", "\<" and "\\" for the characters themselves. Patterns can match
+ * anywhere in a log message: e.g. "100 10 Invalid user * from <addr>".
+ *
+ * All patterns are compiled into a single automaton, so lines are read
+ * once no matter how many signatures are loaded. Its states are built the
+ * first time lines reach them, so that complex sets of patterns only cost
+ * the states that real logs use. Each parser builds its own, so that they
+ * match lines in parallel.
+ *
+ * @return 0 on success, -1 on error
+ */
+int signatures_load(const char *restrict filename);
+
+/**
+ * Match a log message against the loaded signatures. If one matches (the
+ * first in the file, if more do), its service and dangerousness are
+ * stored in attack. Its address too, if the message gives an IP address;
+ * if it gives a host name, that is stored in host instead, and
+ * attack->address is left alone.
+ *
+ * @param cache     states of the caller, made on the first call (*cache
+ *                  NULL) and remade when other signatures are loaded
+ *
+ * @return 0 if a signature matched, 1 if none did (or none is loaded)
+ */
+int signatures_match(signatures_cache_t **restrict cache, const char *restrict message, attack_t *restrict attack, char *restrict host, size_t hostlen);
+
+/**
+ * Free the states made by signatures_match(). NULL is ignored.
+ */
+void signatures_cache_free(signatures_cache_t *cache);
+
+/**
+ * Drop all loaded signatures.
+ */
+void signatures_fin(void);
+
+#endif
@@ -0,0 +1,667 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#include "config.h"
+
+#if defined(HAVE_KQUEUE) && ! defined(HAVE_EPOLL_CREATE)
+/* see sshguard_logsuck.c */
+#undef _XOPEN_SOURCE
+#define _BSD_SOURCE
+#   include <sys/types.h>
+#   include <sys/event.h>
+#   include <sys/time.h>
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+
+#if defined(HAVE_EPOLL_CREATE)
+#   include <sys/epoll.h>
+#elif ! defined(HAVE_KQUEUE)
+#   include <poll.h>
+#endif
+
+#include "fnv.h"
+
+#include "sshguard.h"
+#include "sshguard_log.h"
+
+#include "sshguard_tcpsource.h"
+
+
+/* bytes buffered per connection beyond the longest message taken (see -m):
+ * room for its framing, "MSG-LEN SP" or a trailing CR LF */
+#define TCPSOURCE_FRAME_ROOM        16
+
+/* maximum number of listening sockets */
+#define TCPSOURCE_MAX_LISTENERS     16
+
+/* maximum number of events collected at each check */
+#define TCPSOURCE_MAX_EVENTS        64
+
+/* a connection from a syslog sender */
+typedef struct tcpconn {
+    int fd;                             /* socket descriptor */
+    sourceid_t source_id;               /* ID of this connection as log source */
+    char peer[ADDRLEN + 8];             /* "address:port" of the sender, for logging */
+
+    size_t start;                       /* data received and not yet consumed in buf begins here ... */
+    size_t len;                         /* ... and is this long */
+
+    size_t skip;                        /* bytes still to drop from a truncated counted message */
+    int skip_line;                      /* drop data up to the next LF (truncated LF-framed message) */
+    int closing;                        /* sender closed: deliver what is left, then close */
+
+    int queued;                         /* is it in the ready queue? */
+    struct tcpconn *next_ready;         /* next connection in the ready queue */
+
+    size_t bufsize;                     /* room in buf. Longer messages are truncated */
+    char buf[];
+} tcpconn_t;
+
+
+/* listening sockets */
+static int listeners[TCPSOURCE_MAX_LISTENERS];
+static int num_listeners = 0;
+
+/* connections, indexed by their file descriptor */
+static tcpconn_t **conns = NULL;
+static int conns_size = 0;
+static int num_connections = 0;
+
+/* room in the buffer of new connections, after the messages asked for */
+static size_t conn_bufsize = 0;
+
+/* serial number of connections, for telling apart sources from the same sender */
+static unsigned int conn_serial = 0;
+
+/* who to tell when a connection closes */
+static logsuck_source_ended_t conn_closed = NULL;
+
+/* connections possibly holding complete messages, served in FIFO order for fairness */
+static tcpconn_t *ready_head = NULL;
+static tcpconn_t *ready_tail = NULL;
+
+
+/* set of descriptors to watch for activity */
+#if defined(HAVE_EPOLL_CREATE) || defined(HAVE_KQUEUE)
+static int evq = -1;
+#else
+static struct pollfd pollfds[TCPSOURCE_MAX_LISTENERS + MAX_TCP_CONNECTIONS];
+static int num_pollfds = 0;
+#endif
+
+static int evq_init(void);
+static int evq_add(int fd);
+static void evq_del(int fd);
+/* collect descriptors with activity, without waiting. Return their number */
+static int evq_collect(int fds[], int maxfds);
+
+static int is_listener(int fd);
+static void accept_connections(int listenfd);
+static void read_connection(tcpconn_t *restrict c);
+static void close_connection(tcpconn_t *restrict c);
+/* extract next complete message from connection into buf. Return 1 if got one, 0 otherwise */
+static int extract_message(tcpconn_t *restrict c, char *restrict buf, size_t buflen);
+static void ready_push(tcpconn_t *restrict c);
+static tcpconn_t *ready_pop(void);
+
+
+int tcpsource_init(logsuck_source_ended_t closed) {
+    conn_closed = closed;
+    return evq_init();
+}
+
+int tcpsource_listen(const char *restrict endpoint) {
+    struct addrinfo hints, *res, *ai;
+    char host[ADDRLEN + 2];
+    const char *port;
+    const char *sep;
+    int fd, ret, one = 1, num_bound = 0;
+
+    assert(endpoint != NULL);
+
+    /* split endpoint in host and port */
+    host[0] = '\0';
+    sep = strrchr(endpoint, ':');
+    if (sep == NULL) {
+        port = endpoint;
+    } else {
+        port = sep + 1;
+        if (endpoint[0] == '[' && sep > endpoint && sep[-1] == ']') {
+            /* "[address]:port" */
+            if (sep - endpoint - 2 >= sizeof(host)) return -1;
+            memcpy(host, endpoint + 1, sep - endpoint - 2);
+            host[sep - endpoint - 2] = '\0';
+        } else {
+            if (sep - endpoint >= sizeof(host)) return -1;
+            memcpy(host, endpoint, sep - endpoint);
+            host[sep - endpoint] = '\0';
+        }
+    }
+
+    memset(& hints, 0x00, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICHOST;
+    ret = getaddrinfo((host[0] == '\0' ? NULL : host), port, & hints, & res);
+    if (ret != 0) {
+        sshguard_log(LOG_ERR, "Unable to interpret '%s' as TCP endpoint: %s.", endpoint, gai_strerror(ret));
+        return -1;
+    }
+
+    for (ai = res; ai != NULL; ai = ai->ai_next) {
+        if (num_listeners >= TCPSOURCE_MAX_LISTENERS) {
+            sshguard_log(LOG_ERR, "I can listen on at most %d TCP sockets! See TCPSOURCE_MAX_LISTENERS.", TCPSOURCE_MAX_LISTENERS);
+            break;
+        }
+
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, & one, sizeof(one));
+#ifdef IPV6_V6ONLY
+        /* have IPv4 senders on the IPv4 socket, if any */
+        if (ai->ai_family == AF_INET6)
+            setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, & one, sizeof(one));
+#endif
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            /* wildcards may resolve to both families, and bind the same port once on dual stacks */
+            if (errno != EADDRINUSE || num_bound == 0)
+                sshguard_log(LOG_ERR, "Unable to bind to '%s': %s.", endpoint, strerror(errno));
+            close(fd);
+            continue;
+        }
+        if (listen(fd, SOMAXCONN) != 0 || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) == -1 || evq_add(fd) != 0) {
+            sshguard_log(LOG_ERR, "Unable to listen on '%s': %s.", endpoint, strerror(errno));
+            close(fd);
+            continue;
+        }
+        listeners[num_listeners++] = fd;
+        ++num_bound;
+    }
+    freeaddrinfo(res);
+
+    if (num_bound == 0)
+        return -1;
+
+    sshguard_log(LOG_DEBUG, "Listening for syslog messages on '%s' (%d sockets).", endpoint, num_bound);
+    return 0;
+}
+
+int tcpsource_descriptor(void) {
+#if defined(HAVE_EPOLL_CREATE) || defined(HAVE_KQUEUE)
+    return evq;
+#else
+    return -1;
+#endif
+}
+
+int tcpsource_getline(char *restrict buf, size_t buflen, sourceid_t *restrict whichsource) {
+    int fds[TCPSOURCE_MAX_EVENTS];
+    int num, i;
+    tcpconn_t *c;
+
+    assert(buf != NULL && buflen > 1);
+
+    /* connections hold a message as long as the caller takes, with its framing */
+    conn_bufsize = buflen + TCPSOURCE_FRAME_ROOM;
+
+    while (1) {
+        /* serve connections already holding data, one message each in turn */
+        while ((c = ready_pop()) != NULL) {
+            if (extract_message(c, buf, buflen)) {
+                if (whichsource != NULL) *whichsource = c->source_id;
+                /* there may be more: get back in line */
+                ready_push(c);
+                return 0;
+            }
+            if (c->closing) close_connection(c);
+        }
+
+        /* collect new activity. Drain it all, for our descriptor to be quiet when we say so */
+        num = evq_collect(fds, TCPSOURCE_MAX_EVENTS);
+        if (num < 0) return -1;
+        if (num == 0) break;
+        for (i = 0; i < num; ++i) {
+            if (is_listener(fds[i])) {
+                accept_connections(fds[i]);
+            } else if (fds[i] < conns_size && conns[fds[i]] != NULL) {
+                read_connection(conns[fds[i]]);
+            }
+        }
+    }
+
+    return 1;
+}
+
+int tcpsource_fin(void) {
+    int i;
+
+    while (ready_pop() != NULL);
+    for (i = 0; i < conns_size; ++i) {
+        if (conns[i] != NULL) close_connection(conns[i]);
+    }
+    free(conns);
+    conns = NULL;
+    conns_size = 0;
+
+    for (i = 0; i < num_listeners; ++i) {
+        close(listeners[i]);
+    }
+    num_listeners = 0;
+
+#if defined(HAVE_EPOLL_CREATE) || defined(HAVE_KQUEUE)
+    close(evq);
+    evq = -1;
+#endif
+
+    return 0;
+}
+
+
+static int is_listener(int fd) {
+    int i;
+
+    for (i = 0; i < num_listeners; ++i) {
+        if (listeners[i] == fd) return 1;
+    }
+    return 0;
+}
+
+static void accept_connections(int listenfd) {
+    struct sockaddr_storage peer;
+    socklen_t peerlen;
+    char host[ADDRLEN], port[8], idstr[ADDRLEN + 20];
+    tcpconn_t *c;
+    int fd;
+
+    while (1) {
+        peerlen = sizeof(peer);
+        fd = accept(listenfd, (struct sockaddr *)& peer, & peerlen);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED)
+                sshguard_log(LOG_ERR, "Unable to accept syslog connection: %s.", strerror(errno));
+            return;
+        }
+
+        if (num_connections >= MAX_TCP_CONNECTIONS) {
+            sshguard_log(LOG_WARNING, "Refusing syslog connection: I serve at most %d senders. See MAX_TCP_CONNECTIONS.", MAX_TCP_CONNECTIONS);
+            close(fd);
+            continue;
+        }
+
+        /* make room in the connections table */
+        if (fd >= conns_size) {
+            int newsize = (conns_size == 0 ? 64 : conns_size);
+            tcpconn_t **newconns;
+
+            while (newsize <= fd) newsize *= 2;
+            newconns = (tcpconn_t **)realloc(conns, newsize * sizeof(tcpconn_t *));
+            if (newconns == NULL) {
+                close(fd);
+                continue;
+            }
+            memset(newconns + conns_size, 0x00, (newsize - conns_size) * sizeof(tcpconn_t *));
+            conns = newconns;
+            conns_size = newsize;
+        }
+
+        c = (tcpconn_t *)malloc(sizeof(tcpconn_t) + conn_bufsize);
+        if (c == NULL || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) == -1 || evq_add(fd) != 0) {
+            sshguard_log(LOG_ERR, "Unable to set up syslog connection: %s.", strerror(errno));
+            free(c);
+            close(fd);
+            continue;
+        }
+        memset(c, 0x00, sizeof(tcpconn_t));
+        c->bufsize = conn_bufsize;
+        c->fd = fd;
+        if (getnameinfo((struct sockaddr *)& peer, peerlen, host, sizeof(host), port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV) != 0) {
+            strcpy(host, "?");
+            strcpy(port, "?");
+        }
+        snprintf(c->peer, sizeof(c->peer), "%s:%s", host, port);
+        /* ID is unique across connections from the same sender */
+        snprintf(idstr, sizeof(idstr), "tcp:%s#%u", c->peer, conn_serial++);
+        c->source_id = fnv_32a_str(idstr, 0);
+
+        conns[fd] = c;
+        ++num_connections;
+        sshguard_log(LOG_INFO, "Accepted syslog connection from %s (%d active).", c->peer, num_connections);
+    }
+}
+
+static void read_connection(tcpconn_t *restrict c) {
+    ssize_t ret;
+
+    if (c->closing) return;
+
+    /* move unconsumed data to the front to make room */
+    if (c->start > 0) {
+        memmove(c->buf, c->buf + c->start, c->len);
+        c->start = 0;
+    }
+
+    while (c->len < c->bufsize) {
+        ret = read(c->fd, c->buf + c->len, c->bufsize - c->len);
+        if (ret > 0) {
+            c->len += ret;
+            continue;
+        }
+        if (ret == 0) {
+            /* sender closed */
+            c->closing = 1;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            sshguard_log(LOG_NOTICE, "Error while reading from syslog sender %s: %s.", c->peer, strerror(errno));
+            c->closing = 1;
+        }
+        break;
+    }
+
+    if (c->closing) evq_del(c->fd);
+    ready_push(c);
+}
+
+static void close_connection(tcpconn_t *restrict c) {
+    assert(! c->queued);
+
+    if (! c->closing) evq_del(c->fd);
+    close(c->fd);
+    conns[c->fd] = NULL;
+    --num_connections;
+    sshguard_log(LOG_INFO, "Closed syslog connection from %s (%d active).", c->peer, num_connections);
+
+    /* the source is gone for good */
+    if (conn_closed != NULL) conn_closed(c->source_id);
+    free(c);
+}
+
+/* drop n bytes from the head of the connection buffer */
+static inline void consume(tcpconn_t *restrict c, size_t n) {
+    assert(n <= c->len);
+    c->start += n;
+    c->len -= n;
+    if (c->len == 0) c->start = 0;
+}
+
+/* copy a message into buf, without transport dressing. Return its length */
+static size_t store_message(char *restrict buf, size_t buflen, const char *restrict msg, size_t len) {
+    /* drop trailing CR/LF. "<PRI>" is left to the parser, which tells RFC 5424 from it */
+    while (len > 0 && (msg[len-1] == '\n' || msg[len-1] == '\r')) --len;
+
+    if (len >= buflen) len = buflen - 1;
+    memcpy(buf, msg, len);
+    buf[len] = '\0';
+
+    return len;
+}
+
+static int extract_message(tcpconn_t *restrict c, char *restrict buf, size_t buflen) {
+    const char *data;
+    const char *end;
+    size_t pos, msglen, framelen, hdrlen;
+
+    while (c->len > 0) {
+        data = c->buf + c->start;
+
+        /* drop the rest of a message that did not fit in the buffer */
+        if (c->skip > 0) {
+            pos = (c->skip < c->len ? c->skip : c->len);
+            consume(c, pos);
+            c->skip -= pos;
+            continue;
+        }
+        if (c->skip_line) {
+            end = memchr(data, '\n', c->len);
+            if (end == NULL) {
+                consume(c, c->len);
+                break;
+            }
+            consume(c, end - data + 1);
+            c->skip_line = 0;
+            continue;
+        }
+
+        /* octet counting: "MSG-LEN SP SYSLOG-MSG" */
+        if (data[0] >= '1' && data[0] <= '9') {
+            msglen = 0;
+            for (pos = 0; pos < c->len && pos < 9 && isdigit((unsigned char)data[pos]); ++pos) {
+                msglen = 10 * msglen + (data[pos] - '0');
+            }
+            if (pos == c->len && ! c->closing)
+                return 0;
+            if (pos < c->len && data[pos] == ' ') {
+                hdrlen = pos + 1;
+                framelen = msglen;
+                if (hdrlen + msglen > c->len) {
+                    /* wait for the rest, or for as much as fits */
+                    if ((hdrlen + msglen <= c->bufsize || c->len < c->bufsize) && ! c->closing)
+                        return 0;
+                    /* can't hold it all: take the head, drop the rest when it comes */
+                    framelen = c->len - hdrlen;
+                    c->skip = msglen - framelen;
+                    sshguard_log(LOG_INFO, "Truncating %lu bytes long message from syslog sender %s.", (unsigned long)msglen, c->peer);
+                }
+                pos = store_message(buf, buflen, data + hdrlen, framelen);
+                consume(c, hdrlen + framelen);
+                if (pos == 0) continue;
+                return 1;
+            }
+            /* not a counted frame: must be a LF-terminated message */
+        }
+
+        /* non-transparent framing: message is terminated by LF */
+        end = memchr(data, '\n', c->len);
+        if (end != NULL) {
+            framelen = end - data;
+            pos = store_message(buf, buflen, data, framelen);
+            consume(c, framelen + 1);
+        } else {
+            if (c->len < c->bufsize && ! c->closing)
+                return 0;   /* wait for the rest */
+            /* full buffer and no LF, or sender gone: take what we have */
+            if (! c->closing) {
+                c->skip_line = 1;
+                sshguard_log(LOG_INFO, "Truncating too long message from syslog sender %s.", c->peer);
+            }
+            pos = store_message(buf, buflen, data, c->len);
+            consume(c, c->len);
+        }
+        if (pos == 0) continue;
+        return 1;
+    }
+
+    return 0;
+}
+
+static void ready_push(tcpconn_t *restrict c) {
+    if (c->queued) return;
+
+    c->queued = 1;
+    c->next_ready = NULL;
+    if (ready_tail != NULL)
+        ready_tail->next_ready = c;
+    else
+        ready_head = c;
+    ready_tail = c;
+}
+
+static tcpconn_t *ready_pop(void) {
+    tcpconn_t *c = ready_head;
+
+    if (c == NULL) return NULL;
+
+    ready_head = c->next_ready;
+    if (ready_head == NULL) ready_tail = NULL;
+    c->queued = 0;
+
+    return c;
+}
+
+
+/*      descriptor set: epoll, kqueue, or plain poll() as last resort       */
+
+#if defined(HAVE_EPOLL_CREATE)
+
+static int evq_init(void) {
+    evq = epoll_create(MAX_TCP_CONNECTIONS);
+    if (evq < 0) {
+        sshguard_log(LOG_CRIT, "Unable to create epoll set! %s.", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int evq_add(int fd) {
+    struct epoll_event ev;
+
+    memset(& ev, 0x00, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    return epoll_ctl(evq, EPOLL_CTL_ADD, fd, & ev);
+}
+
+static void evq_del(int fd) {
+    struct epoll_event ev;
+
+    /* old kernels want non-NULL events even if ignored */
+    epoll_ctl(evq, EPOLL_CTL_DEL, fd, & ev);
+}
+
+static int evq_collect(int fds[], int maxfds) {
+    struct epoll_event evs[TCPSOURCE_MAX_EVENTS];
+    int ret, i;
+
+    if (maxfds > TCPSOURCE_MAX_EVENTS) maxfds = TCPSOURCE_MAX_EVENTS;
+    do {
+        ret = epoll_wait(evq, evs, maxfds, 0);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+        sshguard_log(LOG_ERR, "Error in epoll_wait(): %s.", strerror(errno));
+        return -1;
+    }
+    for (i = 0; i < ret; ++i) {
+        fds[i] = evs[i].data.fd;
+    }
+    return ret;
+}
+
+#elif defined(HAVE_KQUEUE)
+
+static int evq_init(void) {
+    evq = kqueue();
+    if (evq < 0) {
+        sshguard_log(LOG_CRIT, "Unable to create kqueue! %s.", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int evq_add(int fd) {
+    struct kevent kev;
+
+    EV_SET(& kev, fd, EVFILT_READ, EV_ADD | EV_ENABLE, 0, 0, 0);
+    return kevent(evq, & kev, 1, NULL, 0, NULL);
+}
+
+static void evq_del(int fd) {
+    struct kevent kev;
+
+    EV_SET(& kev, fd, EVFILT_READ, EV_DELETE, 0, 0, 0);
+    kevent(evq, & kev, 1, NULL, 0, NULL);
+}
+
+static int evq_collect(int fds[], int maxfds) {
+    struct kevent kevs[TCPSOURCE_MAX_EVENTS];
+    struct timespec nowait = { 0, 0 };
+    int ret, i;
+
+    if (maxfds > TCPSOURCE_MAX_EVENTS) maxfds = TCPSOURCE_MAX_EVENTS;
+    ret = kevent(evq, NULL, 0, kevs, maxfds, & nowait);
+    if (ret < 0) {
+        if (errno == EINTR) return 0;
+        sshguard_log(LOG_ERR, "Error in kevent(): %s.", strerror(errno));
+        return -1;
+    }
+    for (i = 0; i < ret; ++i) {
+        fds[i] = (int)kevs[i].ident;
+    }
+    return ret;
+}
+
+#else
+
+static int evq_init(void) {
+    num_pollfds = 0;
+    return 0;
+}
+
+static int evq_add(int fd) {
+    if (num_pollfds >= sizeof(pollfds)/sizeof(pollfds[0])) {
+        errno = EMFILE;
+        return -1;
+    }
+    pollfds[num_pollfds].fd = fd;
+    pollfds[num_pollfds].events = POLLIN;
+    pollfds[num_pollfds].revents = 0;
+    ++num_pollfds;
+    return 0;
+}
+
+static void evq_del(int fd) {
+    int i;
+
+    for (i = 0; i < num_pollfds; ++i) {
+        if (pollfds[i].fd == fd) {
+            pollfds[i] = pollfds[--num_pollfds];
+            return;
+        }
+    }
+}
+
+static int evq_collect(int fds[], int maxfds) {
+    int ret, i, num;
+
+    ret = poll(pollfds, num_pollfds, 0);
+    if (ret < 0) {
+        if (errno == EINTR) return 0;
+        sshguard_log(LOG_ERR, "Error in poll(): %s.", strerror(errno));
+        return -1;
+    }
+    for (i = 0, num = 0; i < num_pollfds && num < ret && num < maxfds; ++i) {
+        if (pollfds[i].revents != 0) fds[num++] = pollfds[i].fd;
+    }
+    return num;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2011 Mij <mij@sshguard.net>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * SSHGuard. See http://www.sshguard.net
+ */
+
+#ifndef SSHGUARD_TCPSOURCE_H
+#define SSHGUARD_TCPSOURCE_H
+
+#include <stddef.h>
+
+/* for sourceid_t */
+#include "sshguard_logsuck.h"
+
+
+/**
+ * Initialize the subsystem receiving syslog messages over TCP.
+ *
+ * @param closed    called with the identifier of each connection closed
+ *
+ * @return 0 on success, -1 on error
+ */
+int tcpsource_init(logsuck_source_ended_t closed);
+
+/**
+ * Accept syslog senders on a TCP endpoint.
+ *
+ * The endpoint is given as "port", "address:port" or "[address]:port".
+ * Senders can frame messages either with octet counting or with a trailing
+ * LF (RFC 6587), and may switch from one to the other at any message.
+ *
+ * @return 0 on success, -1 on error
+ */
+int tcpsource_listen(const char *restrict endpoint);
+
+/**
+ * Get a descriptor that becomes readable when any listener or connection
+ * has activity, for waiting on it together with other sources.
+ *
+ * @return the descriptor, or -1 if the platform can't provide one (then
+ *          the caller needs to poll tcpsource_getline() periodically)
+ */
+int tcpsource_descriptor(void);
+
+/**
+ * Get the next message received from any sender, without blocking.
+ *
+ * Every connection is a source on its own: whichsource is set to the
+ * identifier of the connection the message was received from.
+ *
+ * Connections accepted here buffer messages as long as buflen: longer ones
+ * are truncated, as soon as the buffer fills or the sender closes.
+ *
+ * @return 0 if a message was stored in buf, 1 if no message is available,
+ *          -1 on error
+ */
+int tcpsource_getline(char *restrict buf, size_t buflen, sourceid_t *restrict whichsource);
+
+/**
+ * Finalize the subsystem, closing all listeners and connections.
+ *
+ * @return 0 on success, -1 on error
+ */
+int tcpsource_fin(void);
+
+#endif
@@ -22,9 +22,16 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <limits.h>
 #include <regex.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -32,7 +39,6 @@
 #include <errno.h>
 #include <assert.h>
 
-#include "simclist.h"
 #include "sshguard_log.h"
 #include "regexlib.h"
 #include "sshguard_whitelist.h"
@@ -43,298 +49,563 @@
 #define IPV4_BITS                   32
 #define IPV6_BITS                   128
 
+/* the image of the whitelist from file F is cached in file F + this */
+#define WHITELIST_CACHE_SUFFIX      ".cache"
+#define WHITELIST_CACHE_MAGIC       "SSHGWL1\n"
+#define WHITELIST_CACHE_BYTEORDER   0x01020304
 
-regex_t wl_ip4reg, wl_ip6reg, wl_hostreg;
-list_t whitelist;
+/* tries of whitelist files at most, besides that of entries given otherwise */
+#define WHITELIST_MAX_FILES         16
 
-/* an address with mask */
+
+regex_t wl_hostreg;
+
+/*
+ * Entries are kept in a path-compressed binary trie (Patricia) per address
+ * kind, keyed by the bits of the address in network order. A node stands
+ * for the prefix of its first bitlen bits; its children extend it by a 0
+ * or a 1 bit, and whatever else they have in common. Entries below one
+ * that covers them are useless, and not kept; two entries that make up a
+ * block one bit shorter are merged into it.
+ *
+ * Nodes refer to their children by position, so that a trie can be saved
+ * to a file as is, and used again mapped in memory.
+ */
 typedef struct {
-    int addrkind;
-    union {
-        struct {
-            in_addr_t address;
-            in_addr_t mask;
-        } ip4;  /* an IPv4 address w/ mask */
-        struct {
-            struct in6_addr address;
-            struct in6_addr mask;
-        } ip6;  /* an IPv6 address w/ mask */
-    } address;
-} addrblock_t;
-
-
-/* tell if IPv4 addr1 and addr2 are equivalent modulo mask */
-static int match_ip4(in_addr_t addr1, in_addr_t addr2, in_addr_t mask) {
-    return ((addr1 & mask) == (addr2 & mask)) ? 1 : 0;
-}
-
-/* tell if IPv6 addr1 and addr2 are equivalent modulo mask */
-static int match_ip6(const struct in6_addr *restrict addr1, const struct in6_addr *restrict addr2, const struct in6_addr *restrict mask) {
-    int i;
+    uint8_t prefix[16];             /* bits past bitlen are 0 */
+    uint32_t bitlen;
+    uint32_t whitelisted;           /* the prefix is an entry, not just a branching point */
+    uint32_t child[2];              /* position in nodes + 1, or 0 if none */
+} wl_node_t;
+
+typedef struct {
+    wl_node_t *nodes;
+    uint32_t num_nodes, max_nodes;
+    uint32_t root[2];               /* for IPv4 and IPv6 resp, as for child */
+    int has_hosts;                  /* entries came from resolving names */
+    void *map;                      /* if not NULL, nodes are in this image, read-only */
+    size_t map_len;
+} wl_trie_t;
+
+/* header of a cached image, followed by the nodes */
+typedef struct {
+    char magic[8];
+    uint32_t byteorder;             /* images are only valid on the host that wrote them */
+    uint32_t nodesize;
+    uint32_t source_len;            /* of the file the image was made from */
+    uint32_t source_hash;
+    uint32_t num_nodes;
+    uint32_t root[2];
+    uint32_t nodes_hash;
+    uint32_t header_hash;           /* of all the fields above */
+} wl_cache_header_t;
+
+/* a whole whitelist: entries given one by one, then those of each file */
+typedef struct {
+    wl_trie_t tries[1 + WHITELIST_MAX_FILES];
+    int num_tries;
+} wl_set_t;
+
+/* an argument of whitelist_add() or whitelist_file(), to make the whitelist up again */
+typedef struct {
+    char *arg;
+    int is_file;
+    int cached;                     /* for files: keep their image in a cache file */
+} wl_source_t;
+
+/* the whitelist looked up, only replaced as a whole, with wl_lock held */
+static wl_set_t *wl_active;
+static pthread_mutex_t wl_lock = PTHREAD_MUTEX_INITIALIZER;
+/* the whitelist being made up (wl_active, but during whitelist_reload()), and where entries go */
+static wl_set_t *wl_building;
+static wl_trie_t *wl_current;
+
+static wl_source_t *wl_sources;
+static unsigned int wl_num_sources;
+
+static int add_entry(const char *restrict str);
+static int load_file(const char *restrict filename, int cached);
+static int add_source(const char *restrict arg, int is_file, int cached);
+static int parse_block(const char *restrict str, int *restrict addrkind, uint8_t *restrict key, unsigned int *restrict bitlen);
+static int whitelist_insert(int addrkind, const uint8_t *restrict key, unsigned int bitlen);
+static int cache_load(wl_trie_t *restrict trie, const char *restrict cachename, uint32_t source_len, uint32_t source_hash);
+static void cache_save(const wl_trie_t *restrict trie, const char *restrict cachename, uint32_t source_len, uint32_t source_hash);
+
+
+/* FNV-1a over a buffer */
+static uint32_t hash_bytes(const void *restrict buf, size_t len) {
+    const unsigned char *pos = (const unsigned char *)buf;
+    uint32_t hval = 0x811c9dc5;
+
+    while (len-- > 0) {
+        hval ^= (uint32_t)*pos++;
+        hval *= 0x01000193;
+    }
+
+    return hval;
+}
+
+/* bit pos of key, from the most significant one */
+static int key_bit(const uint8_t *restrict key, unsigned int pos) {
+    return (key[pos / 8] >> (7 - pos % 8)) & 1;
+}
+
+/* number of leading bits a and b have in common, up to maxbits */
+static unsigned int common_bits(const uint8_t *restrict a, const uint8_t *restrict b, unsigned int maxbits) {
+    unsigned int pos = 0;
+
+    while (pos + 8 <= maxbits && a[pos / 8] == b[pos / 8]) pos += 8;
+    while (pos < maxbits && key_bit(a, pos) == key_bit(b, pos)) ++pos;
 
-    for (i = 0; i < sizeof(addr1->s6_addr) && mask->s6_addr[i] != 0; i++) {
-        if ((addr1->s6_addr[i] & mask->s6_addr[i]) != (addr2->s6_addr[i] & mask->s6_addr[i]))
-            return 0;
+    return pos;
+}
+
+/* tell if bits from..to of a and b are the same */
+static int same_bits(const uint8_t *restrict a, const uint8_t *restrict b, unsigned int from, unsigned int to) {
+    for (; from < to && from % 8 != 0; ++from) {
+        if (key_bit(a, from) != key_bit(b, from)) return 0;
+    }
+    for (; from + 8 <= to; from += 8) {
+        if (a[from / 8] != b[from / 8]) return 0;
+    }
+    for (; from < to; ++from) {
+        if (key_bit(a, from) != key_bit(b, from)) return 0;
     }
 
     return 1;
 }
 
+/* make room for two more nodes, so that inserting keeps node pointers valid */
+static int trie_reserve(wl_trie_t *restrict trie) {
+    wl_node_t *newnodes;
+    uint32_t newmax;
 
-static size_t whitelist_meter(const void *el) { return sizeof(addrblock_t); }
+    if (trie->num_nodes + 2 <= trie->max_nodes) return 0;
+    newmax = (trie->max_nodes > 0 ? 2 * trie->max_nodes : 64);
+    newnodes = (wl_node_t *)realloc(trie->nodes, newmax * sizeof(wl_node_t));
+    if (newnodes == NULL) return -1;
+    trie->nodes = newnodes;
+    trie->max_nodes = newmax;
 
-static int whitelist_compare(const void *a, const void *b) {
-    int ret;
-    const addrblock_t *A = (const addrblock_t *)a;
-    const addrblock_t *B = (const addrblock_t *)b;
+    return 0;
+}
 
-    if ( A->addrkind != B->addrkind )
-        return (A->addrkind > B->addrkind ? 1 : -1);
+/* position + 1 of a new node, within the room reserved */
+static uint32_t node_new(wl_trie_t *restrict trie, const uint8_t *restrict key, unsigned int bitlen, int whitelisted) {
+    wl_node_t *node = & trie->nodes[trie->num_nodes];
 
-    switch (A->addrkind) {
-        case ADDRKIND_IPv4:
-            if (A->address.ip4.address != B->address.ip4.address)
-                return (A->address.ip4.address > B->address.ip4.address ? 1 : -1);
-            if (A->address.ip4.mask != B->address.ip4.mask)
-                return (A->address.ip4.mask > B->address.ip4.mask ? 1 : -1);
-            break;
+    memset(node, 0x00, sizeof(wl_node_t));
+    memcpy(node->prefix, key, (bitlen + 7) / 8);
+    if (bitlen % 8 != 0) node->prefix[bitlen / 8] &= (uint8_t)(0xFF << (8 - bitlen % 8));
+    node->bitlen = bitlen;
+    node->whitelisted = whitelisted;
 
-        case ADDRKIND_IPv6:
-            ret = memcmp(& A->address.ip6.address, & B->address.ip6.address, sizeof(B->address.ip6.address));
-            if (ret != 0) return ret;
-            ret = memcmp(& A->address.ip6.mask, & B->address.ip6.mask, sizeof(B->address.ip6.mask));
-            if (ret != 0) return ret;
+    return ++trie->num_nodes;
+}
+
+#define NODE(trie, ref)     (& (trie)->nodes[(ref) - 1])
+
+/* add the prefix of bitlen bits of key to a trie. Return 0 if added, 1 if
+ * covered by an entry already, -1 if out of memory. Nodes dropped are
+ * left unreferenced, and not saved with the trie */
+static int trie_insert(wl_trie_t *restrict trie, int family, const uint8_t *restrict key, unsigned int bitlen) {
+    uint32_t *link = & trie->root[family];
+    uint32_t path[IPV6_BITS + 2];   /* nodes passed through, for merging afterwards */
+    unsigned int depth = 0, common;
+    wl_node_t *node, *parent;
+    uint32_t glue;
+
+    if (trie_reserve(trie) != 0) return -1;
+
+    while (*link != 0) {
+        node = NODE(trie, *link);
+        common = common_bits(node->prefix, key, (node->bitlen < bitlen ? node->bitlen : bitlen));
+        if (common == node->bitlen) {
+            /* key goes in node's subtree */
+            if (node->whitelisted) return 1;
+            if (bitlen == node->bitlen) {
+                /* a branching point becomes an entry, and covers what's below */
+                node->child[0] = node->child[1] = 0;
+                node->whitelisted = 1;
+                break;
+            }
+            path[depth++] = *link;
+            link = & node->child[key_bit(key, node->bitlen)];
+            continue;
+        }
+
+        if (common == bitlen) {
+            /* key covers node */
+            *link = node_new(trie, key, bitlen, 1);
             break;
+        }
+
+        /* key and node part ways after common bits */
+        glue = node_new(trie, key, common, 0);
+        NODE(trie, glue)->child[key_bit(node->prefix, common)] = *link;
+        NODE(trie, glue)->child[key_bit(key, common)] = node_new(trie, key, bitlen, 1);
+        *link = glue;
+        path[depth++] = glue;
+        break;
+    }
+    if (*link == 0) {
+        *link = node_new(trie, key, bitlen, 1);
+    }
+
+    /* merge blocks that make up one a bit shorter, from below */
+    while (depth > 0) {
+        parent = NODE(trie, path[--depth]);
+        if (parent->child[0] == 0 || parent->child[1] == 0) break;
+        node = NODE(trie, parent->child[0]);
+        if (! node->whitelisted || node->bitlen != parent->bitlen + 1) break;
+        node = NODE(trie, parent->child[1]);
+        if (! node->whitelisted || node->bitlen != parent->bitlen + 1) break;
+        parent->child[0] = parent->child[1] = 0;
+        parent->whitelisted = 1;
     }
 
     return 0;
 }
 
-int whitelist_conf_init(void) {
-    /* IPv4 address regex */
-    if (regcomp(&wl_ip4reg, "^" REGEXLIB_IPV4 "$", REG_EXTENDED) != 0) {
-        return -1;
+/* tell if an address of maxbits bits falls in any entry of a trie */
+static int trie_match(const wl_trie_t *restrict trie, int family, const uint8_t *restrict addr, unsigned int maxbits) {
+    uint32_t ref = trie->root[family];
+    const wl_node_t *node;
+    unsigned int checked = 0;
+
+    while (ref != 0) {
+        node = NODE(trie, ref);
+        /* bits up to checked are known to match already */
+        if (! same_bits(node->prefix, addr, checked, node->bitlen)) return 0;
+        if (node->whitelisted) return 1;
+        if (node->bitlen >= maxbits) return 0;
+        checked = node->bitlen;
+        ref = node->child[key_bit(addr, node->bitlen)];
     }
 
-    /* IPv6 address regex */
-    if (regcomp(&wl_ip6reg, "^" REGEXLIB_IPV6 "$", REG_EXTENDED) != 0) {
-        return -1;
+    return 0;
+}
+
+static void trie_fin(wl_trie_t *restrict trie) {
+    if (trie->map != NULL) {
+        munmap(trie->map, trie->map_len);
+    } else {
+        free(trie->nodes);
     }
+    memset(trie, 0x00, sizeof(wl_trie_t));
+}
 
-    /* hostname regex */
-    if (regcomp(&wl_hostreg, "^" REGEXLIB_HOSTNAME "$", REG_EXTENDED) != 0) {
-        whitelist_fin();
-        return -1;
+static wl_set_t *set_new(void) {
+    wl_set_t *set;
+
+    set = (wl_set_t *)calloc(1, sizeof(wl_set_t));
+    if (set == NULL) return NULL;
+    set->num_tries = 1;
+
+    return set;
+}
+
+static void set_free(wl_set_t *set) {
+    int i;
+
+    if (set == NULL) return;
+    for (i = 0; i < set->num_tries; ++i) {
+        trie_fin(& set->tries[i]);
+    }
+    free(set);
+}
+
+/* parse a decimal number of at most maxval, at *str. Leading zeros are not allowed */
+static int parse_decimal(const char *restrict *str, unsigned int maxval, unsigned int *restrict val) {
+    const char *pos = *str;
+
+    if (*pos < '0' || *pos > '9') return -1;
+    if (*pos == '0' && pos[1] >= '0' && pos[1] <= '9') return -1;
+    for (*val = 0; *pos >= '0' && *pos <= '9'; ++pos) {
+        *val = *val * 10 + (unsigned int)(*pos - '0');
+        if (*val > maxval) return -1;
+    }
+    *str = pos;
+
+    return 0;
+}
+
+/*
+ * Tell an address or address block in str, and get it in key (network
+ * order) with bitlen significant bits.
+ *
+ * @return 0 if successful, 1 if str is not an address (maybe a host name),
+ *         -1 if it is an address with an invalid mask
+ */
+static int parse_block(const char *restrict str, int *restrict addrkind, uint8_t *restrict key, unsigned int *restrict bitlen) {
+    char buf[ADDRLEN];
+    const char *pos, *slash;
+    unsigned int i, octet;
+    size_t len;
+
+    slash = strchr(str, '/');
+    len = (slash != NULL ? (size_t)(slash - str) : strlen(str));
+    if (len == 0 || len >= sizeof(buf)) return 1;
+
+    memset(key, 0x00, 16);
+    if (memchr(str, ':', len) != NULL) {
+        /* IPv6 */
+        memcpy(buf, str, len);
+        buf[len] = '\0';
+        if (inet_pton(AF_INET6, buf, key) != 1) return 1;
+        *addrkind = ADDRKIND_IPv6;
+        *bitlen = IPV6_BITS;
+    } else {
+        /* IPv4: a.b.c.d, in decimal */
+        pos = str;
+        for (i = 0; i < 4; ++i) {
+            if (i > 0 && *pos++ != '.') return 1;
+            if (parse_decimal(& pos, 255, & octet) != 0) return 1;
+            key[i] = (uint8_t)octet;
+        }
+        if (pos != str + len) return 1;
+        *addrkind = ADDRKIND_IPv4;
+        *bitlen = IPV4_BITS;
+    }
+
+    if (slash != NULL) {
+        /* CIDR form (net block) */
+        pos = slash + 1;
+        if (parse_decimal(& pos, *bitlen, bitlen) != 0 || *pos != '\0') {
+            sshguard_log(LOG_WARNING, "whitelist: mask specified as '/%s' makes no sense for IPv%d.", slash + 1, *addrkind);
+            return -1;
+        }
     }
 
     return 0;
 }
 
+int whitelist_conf_init(void) {
+    /* hostname regex (addresses are told apart by parse_block()). On
+     * failure the whitelist is left alone: whitelist_reload() keeps it */
+    if (regcomp(&wl_hostreg, "^" REGEXLIB_HOSTNAME "$", REG_EXTENDED) != 0)
+        return -1;
+
+    return 0;
+}
+
 int whitelist_conf_fin(void) {
-    regfree(&wl_ip4reg);
-    regfree(&wl_ip6reg);
     regfree(&wl_hostreg);
     return 0;
 }
 
 int whitelist_init(void) {
-    list_init(&whitelist);
-    list_attributes_copy(&whitelist, whitelist_meter, 1);
-    list_attributes_comparator(&whitelist, whitelist_compare);
+    wl_active = wl_building = set_new();
+    if (wl_active == NULL) return -1;
+    wl_current = & wl_building->tries[0];
+    wl_sources = NULL;
+    wl_num_sources = 0;
     
     return 0;
 }
 
 int whitelist_fin(void) {
-    list_destroy(&whitelist);
+    unsigned int i;
+
+    pthread_mutex_lock(& wl_lock);
+    set_free(wl_active);
+    wl_active = wl_building = NULL;
+    wl_current = NULL;
+    pthread_mutex_unlock(& wl_lock);
+
+    for (i = 0; i < wl_num_sources; ++i) {
+        free(wl_sources[i].arg);
+    }
+    free(wl_sources);
+    wl_sources = NULL;
+    wl_num_sources = 0;
     return 0;
 }
 
-int whitelist_file(const char *restrict filename) {
-    FILE *src;
+int whitelist_reload(void) {
+    wl_set_t *newset, *oldset;
+    unsigned int i;
+    int ret = 0;
+
+    newset = set_new();
+    if (newset == NULL || whitelist_conf_init() != 0) {
+        sshguard_log(LOG_ERR, "whitelist: unable to make up the whitelist again, keeping the current one.");
+        set_free(newset);
+        return -1;
+    }
+
+    /* make the new whitelist up off to the side, while lookups go on in the current one */
+    wl_building = newset;
+    wl_current = & newset->tries[0];
+    for (i = 0; i < wl_num_sources; ++i) {
+        ret = (wl_sources[i].is_file ? load_file(wl_sources[i].arg, wl_sources[i].cached) : add_entry(wl_sources[i].arg));
+        if (ret != 0) break;
+    }
+    whitelist_conf_fin();
+
+    if (ret != 0) {
+        sshguard_log(LOG_ERR, "whitelist: unable to handle '%s' again, keeping the current whitelist.", wl_sources[i].arg);
+        wl_building = wl_active;
+        wl_current = & wl_building->tries[0];
+        set_free(newset);
+        return -1;
+    }
+
+    /* swap it in: once the lock is released, no lookup is left in the old one */
+    pthread_mutex_lock(& wl_lock);
+    oldset = wl_active;
+    wl_active = newset;
+    pthread_mutex_unlock(& wl_lock);
+    set_free(oldset);
+    sshguard_log(LOG_DEBUG, "whitelist: made up again from %u entries and files.", wl_num_sources);
+
+    return 0;
+}
+
+int whitelist_file(const char *restrict filename, int cached) {
+    if (filename == NULL) return -1;
+    if (load_file(filename, cached) != 0) return -1;
+
+    return add_source(filename, 1, cached);
+}
+
+int whitelist_add(const char *restrict str) {
+    if (add_entry(str) != 0) return -1;
+
+    return add_source(str, 0, 0);
+}
+
+static int load_file(const char *restrict filename, int cached) {
     char line[WHITELIST_SRCLINE_LEN];
-    int lineno = 0;
+    char *cachename, *source, *pos, *end, *eol;
+    wl_trie_t *trie;
+    struct stat st;
+    uint32_t source_hash;
+    int fd, lineno = 0;
     size_t len;
 
 
-    if (filename == NULL) return -1;
+    if (wl_building->num_tries == 1 + WHITELIST_MAX_FILES) {
+        sshguard_log(LOG_ERR, "whitelist: too many whitelist files, at most %d supported.", WHITELIST_MAX_FILES);
+        return -1;
+    }
 
-    src = fopen(filename, "r");
-    if (src == NULL) {
+    fd = open(filename, O_RDONLY);
+    if (fd == -1 || fstat(fd, & st) != 0) {
         sshguard_log(LOG_ERR, "whitelist: unable to open input file %s: %s", filename, strerror(errno));
+        if (fd != -1) close(fd);
         return -1;
     }
+    source = (char *)malloc((size_t)st.st_size + 1);
+    if (source == NULL || read(fd, source, (size_t)st.st_size) != st.st_size) {
+        sshguard_log(LOG_ERR, "whitelist: unable to read input file %s.", filename);
+        free(source);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    source[st.st_size] = '\0';
+    source_hash = hash_bytes(source, (size_t)st.st_size);
+
+    cachename = (char *)malloc(strlen(filename) + sizeof(WHITELIST_CACHE_SUFFIX));
+    if (cachename == NULL) {
+        free(source);
+        return -1;
+    }
+    sprintf(cachename, "%s%s", filename, WHITELIST_CACHE_SUFFIX);
+
+    /* the file gets a trie of its own, taken from its image if up to date */
+    trie = & wl_building->tries[wl_building->num_tries++];
+    if (cached && cache_load(trie, cachename, (uint32_t)st.st_size, source_hash) == 0) {
+        sshguard_log(LOG_DEBUG, "whitelist: entries of %s taken from %s.", filename, cachename);
+        free(cachename);
+        free(source);
+        return 0;
+    }
 
-    while (fgets(line, WHITELIST_SRCLINE_LEN, src) != NULL) {
+    wl_current = trie;
+    for (pos = source, end = source + st.st_size; pos < end; pos = eol + 1) {
         lineno++;
+        eol = memchr(pos, '\n', (size_t)(end - pos));
+        if (eol == NULL) eol = end;
+        /* strip trailing blanks */
+        for (len = (size_t)(eol - pos); len > 0 && (pos[len-1] == '\r' || pos[len-1] == ' ' || pos[len-1] == '\t'); --len);
         /* handle comment lines */
-        if (line[0] == '#' || line[0] == '\n') continue;
-        /* strip trailing '\n' */
-        len = strlen(line);
-        if (len == 0) continue;
-        if (line[len-1] == '\n') line[len-1] = '\0';
+        if (len == 0 || pos[0] == '#') continue;
+        if (len >= sizeof(line)) {
+            sshguard_log(LOG_ERR, "whitelist: line %d from whitelist file \"%s\" is too long.", lineno, filename);
+            continue;
+        }
+        memcpy(line, pos, len);
+        line[len] = '\0';
         /* handling line */
-        if (whitelist_add(line) != 0) {
+        if (add_entry(line) != 0) {
             sshguard_log(LOG_ERR, "whitelist: Unable to handle line %d from whitelist file \"%s\".", lineno, filename);
         }
     }
-    fclose(src);
+    wl_current = & wl_building->tries[0];
+
+    if (cached && ! trie->has_hosts) {
+        cache_save(trie, cachename, (uint32_t)st.st_size, source_hash);
+    }
+    free(cachename);
+    free(source);
 
     return 0;
 }
 
 
-int whitelist_add(const char *str) {
+static int add_entry(const char *restrict str) {
+    uint8_t key[16];
+    unsigned int bitlen;
+    int addrkind;
+
     /* try address/mask first */
-    if (regexec(&wl_ip4reg, str, 0, NULL, 0) == 0) {         /* plain IPv4 address */
-        sshguard_log(LOG_DEBUG, "whitelist: add '%s' as plain IPv4.", str);
-        return whitelist_add_ipv4(str);
-    } else if (regexec(&wl_ip6reg, str, 0, NULL, 0) == 0) {            /* plain IPv6 address */
-        sshguard_log(LOG_DEBUG, "whitelist: add '%s' as plain IPv6.", str);
-        return whitelist_add_ipv6(str);
-    } else if (regexec(&wl_hostreg, str, 0, NULL, 0) == 0) {        /* hostname to be resolved */
-        sshguard_log(LOG_DEBUG, "whitelist: add '%s' as host.", str);
-        return whitelist_add_host(str);
-    } else if (strrchr(str, '/') != NULL) {                         /* CIDR form (net block) */
-        char *pos;
-        char buf[ADDRLEN+5];
-        unsigned int masklen;
-
-        strncpy(buf, str, sizeof(buf));
-        pos = strrchr(buf, '/');
-        *pos = '\0';
-        masklen = (unsigned int)strtol(pos+1, (char **)NULL, 10);
-        if (masklen == 0 && pos[1] != '0') {
-            sshguard_log(LOG_WARNING, "whitelist: mask specified as '/%s' makes no sense.", pos+1);
+    switch (parse_block(str, & addrkind, key, & bitlen)) {
+        case 0:
+            return whitelist_insert(addrkind, key, bitlen);
+        case -1:
             return -1;
-        }
+    }
 
-        if (masklen == 0 && errno != EINVAL) {
-            /* could not convert the mask to an integer value */
-            sshguard_log(LOG_WARNING, "whitelist: could not parse line \"%s\" as plain IP nor IP block nor host name", str);
-            return -1;
-        }
-        if (regexec(&wl_ip4reg, buf, 0, NULL, 0) == 0) {
-            if (masklen > IPV4_BITS) {     /* sanity check for netmask */
-                sshguard_log(LOG_WARNING, "whitelist: mask length '%u' makes no sense for IPv4.", masklen);
-                return -1;
-            }
-            if (masklen == IPV4_BITS) {
-                /* de-genere case with full mask --> plain address */
-                return whitelist_add_ipv4(buf);
-            }
-            return whitelist_add_block4(buf, masklen);
-        } else if (regexec(&wl_ip6reg, buf, 0, NULL, 0) == 0) {
-            if (masklen > IPV6_BITS) {     /* sanity check for netmask */
-                sshguard_log(LOG_WARNING, "whitelist: mask length '%u' makes no sense for IPv6.", masklen);
-                return -1;
-            }
-            if (masklen == IPV6_BITS) {
-                /* de-genere case with full mask --> plain address */
-                return whitelist_add_ipv6(buf);
-            }
-            return whitelist_add_block6(buf, masklen);
-        }
-    } else {
-        /* line not recognized */
-        sshguard_log(LOG_WARNING, "whitelist: could not parse line \"%s\" as plain IP nor IP block nor host name.", str);
-        return -1;
+    if (regexec(&wl_hostreg, str, 0, NULL, 0) == 0) {        /* hostname to be resolved */
+        sshguard_log(LOG_DEBUG, "whitelist: add '%s' as host.", str);
+        return whitelist_add_host(str);
     }
 
+    /* line not recognized */
+    sshguard_log(LOG_WARNING, "whitelist: could not parse line \"%s\" as plain IP nor IP block nor host name.", str);
     return -1;
 }
 
 int whitelist_add_block4(const char *restrict address, int masklen) {
-    addrblock_t ab;
+    struct in_addr addr;
 
-    /* parse block line */
-    ab.addrkind = ADDRKIND_IPv4;
-    if (inet_pton(AF_INET, address, & ab.address.ip4.address) != 1) {
+    if (inet_pton(AF_INET, address, & addr) != 1) {
         sshguard_log(LOG_WARNING, "whitelist: could not interpret address '%s': %s.", address, strerror(errno));
         return -1;
     }
-    ab.address.ip4.mask = htonl(0xFFFFFFFF << (IPV4_BITS-masklen));
 
-    if (! list_contains(& whitelist, &ab)) {
-        list_append(& whitelist, &ab);
-        sshguard_log(LOG_DEBUG, "whitelist: add IPv4 block: %s with mask %d.", address, masklen);
-    } else {
-        sshguard_log(LOG_DEBUG, "whitelist: skipping IPv4 block: %s/%d -- already present.", address, masklen);
-    }
-
-    return 0;
+    return whitelist_insert(ADDRKIND_IPv4, (const uint8_t *)& addr.s_addr, (unsigned int)masklen);
 }
 
 int whitelist_add_block6(const char *restrict address, int masklen) {
-    addrblock_t ab;
-    int bytelen, bitlen;
-    uint8_t bitmask;
+    struct in6_addr addr;
 
-    /* parse block line */
-    ab.addrkind = ADDRKIND_IPv6;
-    if (inet_pton(AF_INET6, address, & ab.address.ip6.address.s6_addr) != 1) {
+    if (inet_pton(AF_INET6, address, & addr.s6_addr) != 1) {
         sshguard_log(LOG_WARNING, "whitelist: could not interpret address '%s': %s.", address, strerror(errno));
         return -1;
     }
 
-    bytelen = masklen / 8;
-    /* compile the "all 1s" part */
-    memset(ab.address.ip6.mask.s6_addr, 0xFF, bytelen);
-    /* compile the "crossing byte" */
-    if (bytelen == sizeof(ab.address.ip6.mask.s6_addr))
-        return 0;
-
-    /* compile the remainder "all 0s" part */
-    bitlen = masklen % 8;
-    bitmask = 0xFF << (8 - bitlen);
-    ab.address.ip6.mask.s6_addr[bytelen] = bitmask;
-    memset(& ab.address.ip6.mask.s6_addr[bytelen+1], 0x00, sizeof(ab.address.ip6.mask.s6_addr) - bytelen);
-
-    if (! list_contains(& whitelist, &ab)) {
-        list_append(& whitelist, &ab);
-        sshguard_log(LOG_DEBUG, "whitelist: add IPv6 block: %s with mask %d.", address, masklen);
-    } else {
-        sshguard_log(LOG_DEBUG, "whitelist: skipping IPv6 block: %s/%d -- already present.", address, masklen);
-    }
-
-    return 0;
+    return whitelist_insert(ADDRKIND_IPv6, addr.s6_addr, (unsigned int)masklen);
 }
 
 int whitelist_add_ipv4(const char *restrict ip) {
-    addrblock_t ab;
-
-    ab.addrkind = ADDRKIND_IPv4;
-    inet_pton(AF_INET, ip, & ab.address.ip4.address);
-    ab.address.ip4.mask = 0xFFFFFFFF;
-
-    if (! list_contains(& whitelist, &ab)) {
-        list_append(&whitelist, & ab);
-        sshguard_log(LOG_DEBUG, "whitelist: add plain IPv4 %s.", ip);
-    } else {
-        sshguard_log(LOG_DEBUG, "whitelist: skipping plain IPv4 %s -- already present.", ip);
-    }
-    return 0;
+    return whitelist_add_block4(ip, IPV4_BITS);
 }
 
 int whitelist_add_ipv6(const char *restrict ip) {
-    addrblock_t ab;
-
-    ab.addrkind = ADDRKIND_IPv6;
-
-    if (inet_pton(AF_INET6, ip, &ab.address.ip6.address.s6_addr) != 1) {
-        sshguard_log(LOG_ERR, "whitelist: add ipv6: Could not add %s.", ip);
-        return -1;
-    }
-
-    memset(ab.address.ip6.mask.s6_addr, 0xFF, sizeof(ab.address.ip6.mask.s6_addr));
-
-    if (! list_contains(& whitelist, &ab)) {
-        list_append(&whitelist, & ab);
-        sshguard_log(LOG_DEBUG, "whitelist: add plain IPv6 %s.", ip);
-    } else {
-        sshguard_log(LOG_DEBUG, "whitelist: skipping plain IPv6 %s -- already present.", ip);
-    }
-    return 0;
+    return whitelist_add_block6(ip, IPV6_BITS);
 }
 
 int whitelist_add_host(const char *restrict host) {
@@ -369,16 +640,19 @@ int whitelist_add_host(const char *restrict host) {
 
     /* free all resolve stuff */
     freeaddrinfo(hostaddrs);
+    /* what names resolve to can change: don't cache this whitelist */
+    wl_current->has_hosts = 1;
 
     sshguard_log(LOG_DEBUG, "whitelist: add hostname '%s' with %d addresses.", host, numaddresses);
     
     return 0;
 }
 
+
 int whitelist_match(const char *restrict addr, int addrkind) {
-    in_addr_t addrent;
+    struct in_addr addrent;
     struct in6_addr addrent6;
-    addrblock_t *entry;
+    int i, ret = 0;
 
     switch (addrkind) {
         case ADDRKIND_IPv4:
@@ -386,18 +660,11 @@ int whitelist_match(const char *restrict addr, int addrkind) {
                 sshguard_log(LOG_WARNING, "whitelist: could not interpret ip address '%s'.", addr);
                 return 0;
             }
-            /* compare with every IPv4 entry in the list */
-            list_iterator_start(&whitelist);
-            while (list_iterator_hasnext(&whitelist)) {
-                entry = (addrblock_t *)list_iterator_next(&whitelist);
-                if (entry->addrkind != ADDRKIND_IPv4)
-                    continue;
-                if (match_ip4(addrent, entry->address.ip4.address, entry->address.ip4.mask)) {
-                    list_iterator_stop(&whitelist);
-                    return 1;
-                }
+            pthread_mutex_lock(& wl_lock);
+            for (i = 0; i < wl_active->num_tries && ! ret; ++i) {
+                ret = trie_match(& wl_active->tries[i], 0, (const uint8_t *)& addrent.s_addr, IPV4_BITS);
             }
-            list_iterator_stop(&whitelist);
+            pthread_mutex_unlock(& wl_lock);
             break;
 
         case ADDRKIND_IPv6:
@@ -405,18 +672,11 @@ int whitelist_match(const char *restrict addr, int addrkind) {
                 sshguard_log(LOG_WARNING, "whitelist: could not interpret ip address '%s'.", addr);
                 return 0;
             }
-            /* compare with every IPv6 entry in the list */
-            list_iterator_start(&whitelist);
-            while (list_iterator_hasnext(&whitelist)) {
-                entry = (addrblock_t *)list_iterator_next(&whitelist);
-                if (entry->addrkind != ADDRKIND_IPv6)
-                    continue;
-                if (match_ip6(&addrent6, &entry->address.ip6.address, &entry->address.ip6.mask)) {
-                    list_iterator_stop(&whitelist);
-                    return 1;
-                }
+            pthread_mutex_lock(& wl_lock);
+            for (i = 0; i < wl_active->num_tries && ! ret; ++i) {
+                ret = trie_match(& wl_active->tries[i], 1, addrent6.s6_addr, IPV6_BITS);
             }
-            list_iterator_stop(&whitelist);
+            pthread_mutex_unlock(& wl_lock);
             break;
 
         default:       /* not recognized */
@@ -424,5 +684,175 @@ int whitelist_match(const char *restrict addr, int addrkind) {
             assert(0);
     }
 
+    return ret;
+}
+
+
+/* remember an argument, to handle it again on whitelist_reload() */
+static int add_source(const char *restrict arg, int is_file, int cached) {
+    wl_source_t *newsources;
+
+    /* not while making the whitelist up again from them */
+    if (wl_building != wl_active) return 0;
+
+    newsources = (wl_source_t *)realloc(wl_sources, (wl_num_sources + 1) * sizeof(wl_source_t));
+    if (newsources == NULL) return -1;
+    wl_sources = newsources;
+    wl_sources[wl_num_sources].arg = strdup(arg);
+    if (wl_sources[wl_num_sources].arg == NULL) return -1;
+    wl_sources[wl_num_sources].is_file = is_file;
+    wl_sources[wl_num_sources].cached = cached;
+    ++wl_num_sources;
+
+    return 0;
+}
+
+/* add an entry to the current trie, logging how it went */
+static int whitelist_insert(int addrkind, const uint8_t *restrict key, unsigned int bitlen) {
+    char address[ADDRLEN];
+    int ret;
+
+    if (bitlen > (addrkind == ADDRKIND_IPv4 ? IPV4_BITS : IPV6_BITS)) {
+        sshguard_log(LOG_WARNING, "whitelist: mask %u makes no sense for IPv%d.", bitlen, addrkind);
+        return -1;
+    }
+    ret = trie_insert(wl_current, (addrkind == ADDRKIND_IPv4 ? 0 : 1), key, bitlen);
+    if (inet_ntop((addrkind == ADDRKIND_IPv4 ? AF_INET : AF_INET6), key, address, sizeof(address)) == NULL) {
+        strcpy(address, "?");
+    }
+    switch (ret) {
+        case 0:
+            sshguard_log(LOG_DEBUG, "whitelist: add IPv%d block: %s with mask %u.", addrkind, address, bitlen);
+            break;
+        case 1:
+            sshguard_log(LOG_DEBUG, "whitelist: skipping IPv%d block: %s/%u -- already present.", addrkind, address, bitlen);
+            break;
+        default:
+            sshguard_log(LOG_ERR, "whitelist: out of memory adding %s/%u.", address, bitlen);
+            return -1;
+    }
+
     return 0;
 }
+
+/* map the image of a trie, if it was made from the same source and is sound */
+static int cache_load(wl_trie_t *restrict trie, const char *restrict cachename, uint32_t source_len, uint32_t source_hash) {
+    wl_cache_header_t header;
+    const wl_node_t *nodes;
+    struct stat st;
+    void *map;
+    uint32_t i, j, ipv4_end, end;
+    int fd, sound;
+
+    fd = open(cachename, O_RDONLY);
+    if (fd == -1) return -1;
+    if (fstat(fd, & st) != 0 || (size_t)st.st_size < sizeof(header)) {
+        close(fd);
+        return -1;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    memcpy(& header, map, sizeof(header));
+    nodes = (const wl_node_t *)((const char *)map + sizeof(header));
+    if (memcmp(header.magic, WHITELIST_CACHE_MAGIC, sizeof(header.magic)) != 0
+            || header.header_hash != hash_bytes(& header, offsetof(wl_cache_header_t, header_hash))
+            || header.byteorder != WHITELIST_CACHE_BYTEORDER || header.nodesize != sizeof(wl_node_t)
+            || header.source_len != source_len || header.source_hash != source_hash
+            || (size_t)st.st_size != sizeof(header) + (size_t)header.num_nodes * sizeof(wl_node_t)
+            || header.nodes_hash != hash_bytes(nodes, (size_t)header.num_nodes * sizeof(wl_node_t))) {
+        sshguard_log(LOG_DEBUG, "whitelist: cached image %s is stale or damaged, not used.", cachename);
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+
+    /* lookups must only go down, and within the image. As cache_save()
+     * writes them, IPv4 nodes come first, then the IPv6 ones from root[1] */
+    ipv4_end = (header.root[1] != 0) ? header.root[1] - 1 : header.num_nodes;
+    sound = (header.root[0] <= ipv4_end && header.root[1] <= header.num_nodes);
+    for (i = 0; sound && i < header.num_nodes; ++i) {
+        end = (i < ipv4_end) ? ipv4_end : header.num_nodes;
+        if (nodes[i].bitlen > (i < ipv4_end ? IPV4_BITS : IPV6_BITS)) sound = 0;
+        for (j = 0; j < 2; ++j) {
+            if (nodes[i].child[j] > end || (nodes[i].child[j] != 0
+                        && (nodes[i].child[j] - 1 < i || nodes[nodes[i].child[j] - 1].bitlen <= nodes[i].bitlen)))
+                sound = 0;
+        }
+    }
+    if (! sound) {
+        sshguard_log(LOG_WARNING, "whitelist: cached image %s is inconsistent, not used.", cachename);
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+
+    trie->nodes = (wl_node_t *)nodes;
+    trie->num_nodes = trie->max_nodes = header.num_nodes;
+    trie->root[0] = header.root[0];
+    trie->root[1] = header.root[1];
+    trie->map = map;
+    trie->map_len = (size_t)st.st_size;
+
+    return 0;
+}
+
+/* copy the nodes in use of the subtree at ref to out, and get the position + 1 of its root there */
+static uint32_t cache_copy(const wl_trie_t *restrict trie, uint32_t ref, wl_node_t *restrict out, uint32_t *restrict num) {
+    uint32_t pos;
+
+    if (ref == 0) return 0;
+    pos = (*num)++;
+    out[pos] = *NODE(trie, ref);
+    out[pos].child[0] = cache_copy(trie, NODE(trie, ref)->child[0], out, num);
+    out[pos].child[1] = cache_copy(trie, NODE(trie, ref)->child[1], out, num);
+
+    return pos + 1;
+}
+
+/* save the image of a trie, for later runs. Failing is harmless */
+static void cache_save(const wl_trie_t *restrict trie, const char *restrict cachename, uint32_t source_len, uint32_t source_hash) {
+    wl_cache_header_t header;
+    wl_node_t *nodes;
+    char *tmpname;
+    uint32_t num = 0;
+    size_t len;
+    int fd, ret = -1;
+
+    nodes = (wl_node_t *)malloc((trie->num_nodes > 0 ? trie->num_nodes : 1) * sizeof(wl_node_t));
+    tmpname = (char *)malloc(strlen(cachename) + sizeof(".tmp"));
+    if (nodes == NULL || tmpname == NULL) {
+        free(nodes);
+        free(tmpname);
+        return;
+    }
+    sprintf(tmpname, "%s.tmp", cachename);
+
+    memset(& header, 0x00, sizeof(header));
+    memcpy(header.magic, WHITELIST_CACHE_MAGIC, sizeof(header.magic));
+    header.byteorder = WHITELIST_CACHE_BYTEORDER;
+    header.nodesize = sizeof(wl_node_t);
+    header.source_len = source_len;
+    header.source_hash = source_hash;
+    header.root[0] = cache_copy(trie, trie->root[0], nodes, & num);
+    header.root[1] = cache_copy(trie, trie->root[1], nodes, & num);
+    header.num_nodes = num;
+    len = (size_t)num * sizeof(wl_node_t);
+    header.nodes_hash = hash_bytes(nodes, len);
+    header.header_hash = hash_bytes(& header, offsetof(wl_cache_header_t, header_hash));
+
+    fd = open(tmpname, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd != -1) {
+        if (write(fd, & header, sizeof(header)) == (ssize_t)sizeof(header) && write(fd, nodes, len) == (ssize_t)len)
+            ret = 0;
+        if (close(fd) != 0) ret = -1;
+        if (ret == 0) ret = rename(tmpname, cachename);
+        if (ret != 0) unlink(tmpname);
+    }
+    if (ret == 0) {
+        sshguard_log(LOG_DEBUG, "whitelist: image of %u nodes cached in %s.", num, cachename);
+    } else {
+        sshguard_log(LOG_DEBUG, "whitelist: unable to cache image in %s: %s.", cachename, strerror(errno));
+    }
+    free(nodes);
+    free(tmpname);
+}
@@ -44,7 +44,7 @@ int whitelist_init(void);
  * Calls to whitelist_add*() must occur only between this
  * function's call and whitelist_conf_fin()'s call.
  *
- * @return 0 if success, <0 if compile failed
+ * @return 0 if success, <0 if compile failed (the whitelist is kept)
  *
  * @see whitelist_conf_fin()
  */
@@ -67,6 +67,20 @@ int whitelist_conf_fin(void);
  */
 int whitelist_fin(void);
 
+/**
+ * Make the whitelist up again from the same entries and files given so
+ * far to whitelist_add() and whitelist_file(), e.g. after files changed
+ * or host names resolve to other addresses.
+ *
+ * The new whitelist is made up aside, and replaces the current one as a
+ * whole: whitelist_match() can be called by other threads meanwhile, and
+ * sees either. If any entry or file can't be handled, the current
+ * whitelist is kept.
+ *
+ * @return  0 if success, -1 if failure
+ */
+int whitelist_reload(void);
+
 /**
  * Adds entries to whitelist from file.
  *
@@ -83,10 +97,15 @@ int whitelist_fin(void);
  *  rome-fw.enterprise.com
  *  hosts.friends.com
  *
+ * If cached, and unless it contains host names, the whitelist made from
+ * the file is saved in filename + ".cache", and taken from there by later
+ * calls as long as the file content does not change.
+ *
  * @param filename  The filename containing whitelist entries
+ * @param cached    Whether to keep the whitelist made in a cache file
  * @return          0 if success, -1 if unable to open filename 
  */
-int whitelist_file(const char *restrict filename);
+int whitelist_file(const char *restrict filename, int cached);
 
 /**
  * Wrapper for _add_ip, _add_block and _add_host.
@@ -149,6 +168,8 @@ int whitelist_add_host(const char *restrict host);
 /**
  * search for an address in the whitelist
  *
+ * Can be called while whitelist_reload() runs in another thread.
+ *
  * @param addr the address to search for
  * @param addrkind the type of address, one of
  *                 ADDRKIND_IPv4 or ADDRKIND_IPv6